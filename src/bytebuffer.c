@@ -93,6 +93,65 @@ bytebuffer_destroy(const RTCTX *ctx, bytebuffer_t *s)
   return;
 }
 
+/**
+* Take the idle bytebuffer_t kept on the context, if any, or allocate
+* a new one. Give it back with bytebuffer_release or
+* bytebuffer_release_bytes.
+*/
+bytebuffer_t*
+bytebuffer_create_scratch(const RTCTX *ctx)
+{
+  bytebuffer_t *s = ctx->scratch_bb;
+
+  if ( ! s )
+    return bytebuffer_create(ctx);
+
+  ((RTCTX*)ctx)->scratch_bb = NULL;
+  bytebuffer_clear(ctx, s);
+  return s;
+}
+
+/**
+* Keep the bytebuffer_t on the context for the next
+* bytebuffer_create_scratch if reuse is enabled and there is room,
+* free it otherwise.
+*/
+void
+bytebuffer_release(const RTCTX *ctx, bytebuffer_t *s)
+{
+  if ( ! ctx->scratch_bb && s->capacity <= ctx->scratch_max_size )
+    ((RTCTX*)ctx)->scratch_bb = s;
+  else
+    bytebuffer_destroy(ctx, s);
+}
+
+/**
+* Release the bytebuffer_t, returning its content in memory of its own
+* that the caller frees with rtfree. The internal buffer is handed over
+* when the bytebuffer_t is not kept for reuse.
+*/
+uint8_t*
+bytebuffer_release_bytes(const RTCTX *ctx, bytebuffer_t *s, size_t *size)
+{
+  size_t len = bytebuffer_getlength(ctx, s);
+  uint8_t *bytes;
+
+  if ( size )
+    *size = len;
+
+  if ( ! ctx->scratch_bb && s->capacity <= ctx->scratch_max_size )
+  {
+    bytes = rtalloc(ctx, len ? len : 1);
+    memcpy(bytes, s->buf_start, len);
+    ((RTCTX*)ctx)->scratch_bb = s;
+    return bytes;
+  }
+
+  bytes = s->buf_start;
+  rtfree(ctx, s);
+  return bytes;
+}
+
 /**
 * Set the read cursor to the beginning
 */
@@ -167,6 +226,20 @@ bytebuffer_append_bulk(const RTCTX *ctx, bytebuffer_t *s, void * start, size_t s
   return;
 }
 
+/**
+* Inserts size bytes at offset, moving up what was already written there
+*/
+void
+bytebuffer_insert_bulk(const RTCTX *ctx, bytebuffer_t *s, size_t offset, const void *start, size_t size)
+{
+  size_t tail = (s->writecursor - s->buf_start) - offset;
+  bytebuffer_makeroom(ctx, s, size);
+  memmove(s->buf_start + offset + size, s->buf_start + offset, tail);
+  memcpy(s->buf_start + offset, start, size);
+  s->writecursor += size;
+  return;
+}
+
 /**
 * Writes a uint8_t value to the buffer
 */
@@ -189,12 +262,23 @@ void
 bytebuffer_append_varint(const RTCTX *ctx, bytebuffer_t *b, const int64_t val)
 {
   size_t size;
-  bytebuffer_makeroom(ctx, b, 8);
+  bytebuffer_makeroom(ctx, b, VARINT_MAX_SIZE);
   size = varint_s64_encode_buf(ctx, val, b->writecursor);
   b->writecursor += size;
   return;
 }
 
+/**
+* Writes an array of signed varInts to the buffer
+*/
+void
+bytebuffer_append_varints(const RTCTX *ctx, bytebuffer_t *b, const int64_t *vals, size_t n)
+{
+  bytebuffer_makeroom(ctx, b, n * VARINT_MAX_SIZE);
+  b->writecursor += varint_s64_encode_n(ctx, vals, n, b->writecursor);
+  return;
+}
+
 /**
 * Writes a unsigned varInt to the buffer
 */
@@ -202,7 +286,7 @@ void
 bytebuffer_append_uvarint(const RTCTX *ctx, bytebuffer_t *b, const uint64_t val)
 {
   size_t size;
-  bytebuffer_makeroom(ctx, b, 8);
+  bytebuffer_makeroom(ctx, b, VARINT_MAX_SIZE);
   size = varint_u64_encode_buf(ctx, val, b->writecursor);
   b->writecursor += size;
   return;
@@ -48,9 +48,13 @@ void bytebuffer_init_with_size(const RTCTX *ctx, bytebuffer_t *b, size_t size);
 bytebuffer_t *bytebuffer_create_with_size(const RTCTX *ctx, size_t size);
 bytebuffer_t *bytebuffer_create(const RTCTX *ctx);
 void bytebuffer_destroy(const RTCTX *ctx, bytebuffer_t *s);
+bytebuffer_t *bytebuffer_create_scratch(const RTCTX *ctx);
+void bytebuffer_release(const RTCTX *ctx, bytebuffer_t *s);
+uint8_t *bytebuffer_release_bytes(const RTCTX *ctx, bytebuffer_t *s, size_t *size);
 void bytebuffer_clear(const RTCTX *ctx, bytebuffer_t *s);
 void bytebuffer_append_byte(const RTCTX *ctx, bytebuffer_t *s, const uint8_t val);
 void bytebuffer_append_varint(const RTCTX *ctx, bytebuffer_t *s, const int64_t val);
+void bytebuffer_append_varints(const RTCTX *ctx, bytebuffer_t *s, const int64_t *vals, size_t n);
 void bytebuffer_append_uvarint(const RTCTX *ctx, bytebuffer_t *s, const uint64_t val);
 uint64_t bytebuffer_read_uvarint(const RTCTX *ctx, bytebuffer_t *s);
 int64_t bytebuffer_read_varint(const RTCTX *ctx, bytebuffer_t *s);
@@ -60,6 +64,7 @@ void bytebuffer_reset_reading(const RTCTX *ctx, bytebuffer_t *s);
 
 void bytebuffer_append_bytebuffer(const RTCTX *ctx, bytebuffer_t *write_to,bytebuffer_t *write_from);
 void bytebuffer_append_bulk(const RTCTX *ctx, bytebuffer_t *s, void * start, size_t size);
+void bytebuffer_insert_bulk(const RTCTX *ctx, bytebuffer_t *s, size_t offset, const void *start, size_t size);
 void bytebuffer_append_int(const RTCTX *ctx, bytebuffer_t *buf, const int val, int swap);
 void bytebuffer_append_double(const RTCTX *ctx, bytebuffer_t *buf, const double val, int swap);
 #endif /* _BYTEBUFFER_H */
@@ -519,8 +519,8 @@ static int rt_arc_calculate_gbox_cartesian(const RTCTX *ctx, const RTPOINT4D *p1
 
 int ptarray_calculate_gbox_cartesian(const RTCTX *ctx, const RTPOINTARRAY *pa, RTGBOX *gbox )
 {
-  int i;
-  RTPOINT4D p;
+  int i, ndims;
+  const double *dp;
   int has_z, has_m;
 
   if ( ! pa ) return RT_FAILURE;
@@ -529,33 +529,35 @@ int ptarray_calculate_gbox_cartesian(const RTCTX *ctx, const RTPOINTARRAY *pa, R
 
   has_z = RTFLAGS_GET_Z(pa->flags);
   has_m = RTFLAGS_GET_M(pa->flags);
+  ndims = RTFLAGS_NDIMS(pa->flags);
   gbox->flags = gflags(ctx, has_z, has_m, 0);
   RTDEBUGF(ctx, 4, "ptarray_calculate_gbox Z: %d M: %d", has_z, has_m);
 
-  rt_getPoint4d_p(ctx, pa, 0, &p);
-  gbox->xmin = gbox->xmax = p.x;
-  gbox->ymin = gbox->ymax = p.y;
+  /* Read ordinates in place, M follows Z when both are there */
+  dp = (const double*)rt_getPoint_internal(ctx, pa, 0);
+  gbox->xmin = gbox->xmax = dp[0];
+  gbox->ymin = gbox->ymax = dp[1];
   if ( has_z )
-    gbox->zmin = gbox->zmax = p.z;
+    gbox->zmin = gbox->zmax = dp[2];
   if ( has_m )
-    gbox->mmin = gbox->mmax = p.m;
+    gbox->mmin = gbox->mmax = dp[2 + has_z];
 
   for ( i = 1 ; i < pa->npoints; i++ )
   {
-    rt_getPoint4d_p(ctx, pa, i, &p);
-    gbox->xmin = FP_MIN(gbox->xmin, p.x);
-    gbox->xmax = FP_MAX(gbox->xmax, p.x);
-    gbox->ymin = FP_MIN(gbox->ymin, p.y);
-    gbox->ymax = FP_MAX(gbox->ymax, p.y);
+    dp += ndims;
+    gbox->xmin = FP_MIN(gbox->xmin, dp[0]);
+    gbox->xmax = FP_MAX(gbox->xmax, dp[0]);
+    gbox->ymin = FP_MIN(gbox->ymin, dp[1]);
+    gbox->ymax = FP_MAX(gbox->ymax, dp[1]);
     if ( has_z )
     {
-      gbox->zmin = FP_MIN(gbox->zmin, p.z);
-      gbox->zmax = FP_MAX(gbox->zmax, p.z);
+      gbox->zmin = FP_MIN(gbox->zmin, dp[2]);
+      gbox->zmax = FP_MAX(gbox->zmax, dp[2]);
     }
     if ( has_m )
     {
-      gbox->mmin = FP_MIN(gbox->mmin, p.m);
-      gbox->mmax = FP_MAX(gbox->mmax, p.m);
+      gbox->mmin = FP_MIN(gbox->mmin, dp[2 + has_z]);
+      gbox->mmax = FP_MAX(gbox->mmax, dp[2 + has_z]);
     }
   }
   return RT_SUCCESS;
@@ -653,8 +655,37 @@ static int rtcollection_calculate_gbox_cartesian(const RTCTX *ctx, RTCOLLECTION
   return result;
 }
 
+typedef struct
+{
+  RTGBOX *gbox;
+  int result;
+} GBOX_VISIT;
+
+static int rtgeom_calculate_gbox_cartesian_visitor(const RTCTX *ctx, const RTGEOM *geom, int index, const RTPOINTARRAY *pa, void *data)
+{
+  GBOX_VISIT *v = (GBOX_VISIT*)data;
+  RTGBOX subbox;
+
+  /* Just need to check outer rings */
+  if ( index > 0 && geom->type == RTPOLYGONTYPE )
+    return 0;
+
+  if ( ptarray_calculate_gbox_cartesian(ctx, pa, &subbox) == RT_SUCCESS )
+  {
+    if ( v->result == RT_FAILURE )
+      gbox_duplicate(ctx, &subbox, v->gbox);
+    else
+      gbox_merge(ctx, &subbox, v->gbox);
+    v->result = RT_SUCCESS;
+  }
+  return 0;
+}
+
 int rtgeom_calculate_gbox_cartesian(const RTCTX *ctx, const RTGEOM *rtgeom, RTGBOX *gbox)
 {
+  GBOX_VISIT v;
+
+
   if ( ! rtgeom ) return RT_FAILURE;
   RTDEBUGF(ctx, 4, "rtgeom_calculate_gbox got type (%d) - %s", rtgeom->type, rttype_name(ctx, rtgeom->type));
 
@@ -670,15 +701,21 @@ int rtgeom_calculate_gbox_cartesian(const RTCTX *ctx, const RTGEOM *rtgeom, RTGB
     return rtpoly_calculate_gbox_cartesian(ctx, (RTPOLY *)rtgeom, gbox);
   case RTTRIANGLETYPE:
     return rttriangle_calculate_gbox_cartesian(ctx, (RTTRIANGLE *)rtgeom, gbox);
-  case RTCOMPOUNDTYPE:
-  case RTCURVEPOLYTYPE:
   case RTMULTIPOINTTYPE:
   case RTMULTILINETYPE:
-  case RTMULTICURVETYPE:
   case RTMULTIPOLYGONTYPE:
-  case RTMULTISURFACETYPE:
   case RTPOLYHEDRALSURFACETYPE:
   case RTTINTYPE:
+    /* No arcs in there, fold all point arrays without recursing */
+    if ( ! gbox ) return RT_FAILURE;
+    v.gbox = gbox;
+    v.result = RT_FAILURE;
+    rtgeom_visit_ptarrays(ctx, rtgeom, rtgeom_calculate_gbox_cartesian_visitor, &v);
+    return v.result;
+  case RTCOMPOUNDTYPE:
+  case RTCURVEPOLYTYPE:
+  case RTMULTICURVETYPE:
+  case RTMULTISURFACETYPE:
   case RTCOLLECTIONTYPE:
     return rtcollection_calculate_gbox_cartesian(ctx, (RTCOLLECTION *)rtgeom, gbox);
   }
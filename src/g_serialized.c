@@ -985,6 +985,140 @@ GSERIALIZED* gserialized_from_rtgeom(const RTCTX *ctx, RTGEOM *geom, int is_geod
   return g;
 }
 
+/***********************************************************************
+* Serialize many RTGEOM into one contiguous buffer.
+*/
+
+/*
+* Make sure the geometry has the box it will be serialized with and
+* return its serialized size, without recursing for the simple types.
+*/
+static size_t gserialized_from_rtgeom_batch_size(const RTCTX *ctx, RTGEOM *geom)
+{
+  size_t ptsize = sizeof(double) * RTFLAGS_NDIMS(geom->flags);
+  size_t size = 16; /* Header, type and count. */
+  int i;
+
+  if ( (! geom->bbox) && rtgeom_needs_bbox(ctx, geom) && (!rtgeom_is_empty(ctx, geom)) )
+    rtgeom_add_bbox(ctx, geom);
+  if ( geom->bbox )
+  {
+    RTFLAGS_SET_BBOX(geom->flags, 1);
+    size += gbox_serialized_size(ctx, geom->flags);
+  }
+
+  switch (geom->type)
+  {
+  case RTPOINTTYPE:
+    return size + ((RTPOINT *)geom)->point->npoints * ptsize;
+  case RTLINETYPE:
+    return size + ((RTLINE *)geom)->points->npoints * ptsize;
+  case RTPOLYGONTYPE:
+  {
+    const RTPOLY *poly = (RTPOLY *)geom;
+    size += 4 * (poly->nrings + poly->nrings % 2);
+    for ( i = 0; i < poly->nrings; i++ )
+      size += poly->rings[i]->npoints * ptsize;
+    return size;
+  }
+  default:
+    return gserialized_from_rtgeom_size(ctx, geom);
+  }
+}
+
+/*
+* Write a simple point array geometry body, as gserialized_from_rtline does.
+*/
+static size_t gserialized_from_ptarray_body(const RTCTX *ctx, uint32_t type, uint8_t flags, const RTPOINTARRAY *pa, uint8_t *buf)
+{
+  uint8_t *loc = buf;
+  size_t size;
+
+  if ( RTFLAGS_GET_ZM(flags) != RTFLAGS_GET_ZM(pa->flags) )
+    rterror(ctx, "Dimensions mismatch in %s", rttype_name(ctx, type));
+
+  memcpy(loc, &type, sizeof(uint32_t));
+  loc += sizeof(uint32_t);
+  memcpy(loc, &(pa->npoints), sizeof(uint32_t));
+  loc += sizeof(uint32_t);
+
+  if ( pa->npoints > 0 )
+  {
+    size = pa->npoints * ptarray_point_size(ctx, pa);
+    memcpy(loc, rt_getPoint_internal(ctx, pa, 0), size);
+    loc += size;
+  }
+
+  return (size_t)(loc - buf);
+}
+
+/* Public function */
+
+size_t gserialized_from_rtgeom_batch(const RTCTX *ctx, RTGEOM **geoms, int ngeoms, uint8_t *buf, size_t buf_size, size_t *offsets)
+{
+  size_t total = 0;
+  int i;
+
+  assert(offsets);
+
+  /* Size pass, also adds the boxes that will be serialized. */
+  for ( i = 0; i < ngeoms; i++ )
+  {
+    offsets[i] = total;
+    total += gserialized_from_rtgeom_batch_size(ctx, geoms[i]);
+  }
+  offsets[ngeoms] = total;
+
+  if ( ! buf )
+    return total;
+
+  if ( buf_size < total )
+  {
+    rterror(ctx, "%s: buffer size (%d) smaller than required size (%d)", __func__, buf_size, total);
+    return 0;
+  }
+
+  /* Write pass */
+  for ( i = 0; i < ngeoms; i++ )
+  {
+    RTGEOM *geom = geoms[i];
+    GSERIALIZED *g = (GSERIALIZED *)(buf + offsets[i]);
+    uint8_t *ptr = g->data;
+    size_t expected_size = offsets[i+1] - offsets[i];
+
+    if ( geom->bbox )
+      ptr += gserialized_from_gbox(ctx, geom->bbox, ptr);
+
+    switch (geom->type)
+    {
+    case RTPOINTTYPE:
+      ptr += gserialized_from_ptarray_body(ctx, RTPOINTTYPE, geom->flags, ((RTPOINT *)geom)->point, ptr);
+      break;
+    case RTLINETYPE:
+      ptr += gserialized_from_ptarray_body(ctx, RTLINETYPE, geom->flags, ((RTLINE *)geom)->points, ptr);
+      break;
+    case RTPOLYGONTYPE:
+      ptr += gserialized_from_rtpoly(ctx, (RTPOLY *)geom, ptr);
+      break;
+    default:
+      ptr += gserialized_from_rtgeom_any(ctx, geom, ptr);
+      break;
+    }
+
+    if ( (size_t)(ptr - (uint8_t *)g) != expected_size ) /* Uh oh! */
+    {
+      rterror(ctx, "Return size (%d) not equal to expected size (%d)!", (size_t)(ptr - (uint8_t *)g), expected_size);
+      return 0;
+    }
+
+    g->size = expected_size << 2;
+    gserialized_set_srid(ctx, g, geom->srid);
+    g->flags = geom->flags;
+  }
+
+  return total;
+}
+
 /***********************************************************************
 * De-serialize GSERIALIZED into an RTGEOM.
 */
@@ -1296,7 +1430,8 @@ RTGEOM* rtgeom_from_gserialized(const RTCTX *ctx, const GSERIALIZED *g)
   {
     rtgeom->bbox = gbox_copy(ctx, &bbox);
   }
-  else if ( rtgeom_needs_bbox(ctx, rtgeom) && (rtgeom_calculate_gbox(ctx, rtgeom, &bbox) == RT_SUCCESS) )
+  else if ( ctx->bbox_cache != RTBBOX_CACHE_NONE && rtgeom_needs_bbox(ctx, rtgeom) &&
+            (rtgeom_calculate_gbox(ctx, rtgeom, &bbox) == RT_SUCCESS) )
   {
     rtgeom->bbox = gbox_copy(ctx, &bbox);
   }
@@ -1305,8 +1440,184 @@ RTGEOM* rtgeom_from_gserialized(const RTCTX *ctx, const GSERIALIZED *g)
     rtgeom->bbox = NULL;
   }
 
+  if ( ctx->bbox_cache == RTBBOX_CACHE_DEEP )
+    rtgeom_add_bbox(ctx, rtgeom);
+
   rtgeom_set_srid(ctx, rtgeom, g_srid);
 
   return rtgeom;
 }
 
+
+/***********************************************************************
+* Lazy, allocation free, access to GSERIALIZED contents.
+*/
+
+/*
+* Walk the point arrays of a serialized (sub)geometry in storage order,
+* adding them to *nrings and their points to *npoints. When the
+* array numbered "want" is reached its ordinates and point count are
+* returned in *ring and *ring_npoints and the walk stops early.
+* Returns the size in bytes of the walked geometry.
+*/
+static size_t gserialized_view_walk(const RTCTX *ctx, const uint8_t *data_ptr, uint8_t g_flags, int want,
+                                    uint32_t *nrings, uint32_t *npoints, const uint8_t **ring, uint32_t *ring_npoints)
+{
+  const uint8_t *start_ptr = data_ptr;
+  size_t ptsize = sizeof(double) * RTFLAGS_NDIMS(g_flags);
+  uint32_t type, num, i;
+
+  type = rt_get_uint32_t(ctx, data_ptr);
+  num = rt_get_uint32_t(ctx, data_ptr + 4);
+  data_ptr += 8; /* Skip past the type and count. */
+
+  switch (type)
+  {
+  case RTPOINTTYPE:
+  case RTLINETYPE:
+  case RTCIRCSTRINGTYPE:
+  case RTTRIANGLETYPE:
+    if ( num == 0 )
+      return data_ptr - start_ptr;
+    if ( (int)*nrings == want )
+    {
+      *ring = data_ptr;
+      *ring_npoints = num;
+    }
+    (*nrings)++;
+    *npoints += num;
+    data_ptr += ptsize * num;
+    break;
+  case RTPOLYGONTYPE:
+  {
+    const uint8_t *ordinate_ptr = data_ptr + num * 4;
+    if ( num % 2 ) /* Skip the padding too. */
+      ordinate_ptr += 4;
+    for ( i = 0; i < num; i++ )
+    {
+      uint32_t np = rt_get_uint32_t(ctx, data_ptr + i * 4);
+      if ( (int)*nrings == want )
+      {
+        *ring = ordinate_ptr;
+        *ring_npoints = np;
+        break;
+      }
+      (*nrings)++;
+      *npoints += np;
+      ordinate_ptr += ptsize * np;
+    }
+    data_ptr = ordinate_ptr;
+    break;
+  }
+  case RTMULTIPOINTTYPE:
+  case RTMULTILINETYPE:
+  case RTMULTIPOLYGONTYPE:
+  case RTCOMPOUNDTYPE:
+  case RTCURVEPOLYTYPE:
+  case RTMULTICURVETYPE:
+  case RTMULTISURFACETYPE:
+  case RTPOLYHEDRALSURFACETYPE:
+  case RTTINTYPE:
+  case RTCOLLECTIONTYPE:
+    for ( i = 0; i < num && ! *ring; i++ )
+      data_ptr += gserialized_view_walk(ctx, data_ptr, g_flags, want, nrings, npoints, ring, ring_npoints);
+    break;
+  default:
+    rterror(ctx, "Unknown geometry type: %d - %s", type, rttype_name(ctx, type));
+    break;
+  }
+
+  return data_ptr - start_ptr;
+}
+
+void gserialized_view_init(const RTCTX *ctx, const GSERIALIZED *g, GSERIALIZED_VIEW *view)
+{
+  assert(g && view);
+
+  view->data = g->data;
+  view->flags = g->flags;
+  if ( RTFLAGS_GET_BBOX(g->flags) )
+    view->data += gbox_serialized_size(ctx, g->flags);
+  RTFLAGS_SET_BBOX(view->flags, 0);
+  view->type = gserialized_get_type(ctx, g);
+  view->srid = gserialized_get_srid(ctx, g);
+}
+
+uint32_t gserialized_view_ngeoms(const RTCTX *ctx, const GSERIALIZED_VIEW *view)
+{
+  uint32_t num = rt_get_uint32_t(ctx, view->data + 4);
+
+  if ( rttype_is_collection(ctx, view->type) )
+    return num;
+  return num ? 1 : 0;
+}
+
+int gserialized_view_get_geom(const RTCTX *ctx, const GSERIALIZED_VIEW *view, int n, GSERIALIZED_VIEW *subview)
+{
+  const uint8_t *data_ptr = view->data;
+  uint32_t nrings = 0, npoints = 0, ring_npoints = 0;
+  const uint8_t *ring = NULL;
+  int i;
+
+  if ( ! rttype_is_collection(ctx, view->type) )
+    return RT_FAILURE;
+  if ( n < 0 || (uint32_t)n >= rt_get_uint32_t(ctx, data_ptr + 4) )
+    return RT_FAILURE;
+
+  data_ptr += 8; /* Skip past the type and ngeoms. */
+  for ( i = 0; i < n; i++ )
+    data_ptr += gserialized_view_walk(ctx, data_ptr, view->flags, -1, &nrings, &npoints, &ring, &ring_npoints);
+
+  subview->data = data_ptr;
+  subview->type = rt_get_uint32_t(ctx, data_ptr);
+  subview->srid = view->srid;
+  subview->flags = view->flags;
+  return RT_SUCCESS;
+}
+
+uint32_t gserialized_view_nrings(const RTCTX *ctx, const GSERIALIZED_VIEW *view)
+{
+  uint32_t nrings = 0, npoints = 0, ring_npoints = 0;
+  const uint8_t *ring = NULL;
+
+  gserialized_view_walk(ctx, view->data, view->flags, -1, &nrings, &npoints, &ring, &ring_npoints);
+  return nrings;
+}
+
+uint32_t gserialized_view_npoints(const RTCTX *ctx, const GSERIALIZED_VIEW *view)
+{
+  uint32_t nrings = 0, npoints = 0, ring_npoints = 0;
+  const uint8_t *ring = NULL;
+
+  /* Simple types carry their point count in the header */
+  switch (view->type)
+  {
+  case RTPOINTTYPE:
+  case RTLINETYPE:
+  case RTCIRCSTRINGTYPE:
+  case RTTRIANGLETYPE:
+    return rt_get_uint32_t(ctx, view->data + 4);
+  }
+
+  gserialized_view_walk(ctx, view->data, view->flags, -1, &nrings, &npoints, &ring, &ring_npoints);
+  return npoints;
+}
+
+int gserialized_view_get_ring(const RTCTX *ctx, const GSERIALIZED_VIEW *view, int n, RTPOINTARRAY *pa)
+{
+  uint32_t nrings = 0, npoints = 0, ring_npoints = 0;
+  const uint8_t *ring = NULL;
+
+  if ( n < 0 )
+    return RT_FAILURE;
+
+  gserialized_view_walk(ctx, view->data, view->flags, n, &nrings, &npoints, &ring, &ring_npoints);
+  if ( ! ring )
+    return RT_FAILURE;
+
+  pa->flags = gflags(ctx, RTFLAGS_GET_Z(view->flags), RTFLAGS_GET_M(view->flags), RTFLAGS_GET_GEODETIC(view->flags));
+  RTFLAGS_SET_READONLY(pa->flags, 1);
+  pa->npoints = pa->maxpoints = ring_npoints;
+  pa->serialized_pointlist = (uint8_t*)ring;
+  return RT_SUCCESS;
+}
@@ -172,6 +172,10 @@ struct RTCTX_T {
   void * notice_logger_arg;
   rtdebuglogger debug_logger;
   void * debug_logger_arg;
+  RTBBOXCACHE bbox_cache;
+  size_t scratch_max_size; /* see rtgeom_set_scratch_size */
+  void *scratch_sb; /* idle stringbuffer_t kept for reuse, or NULL */
+  void *scratch_bb; /* idle bytebuffer_t kept for reuse, or NULL */
 };
 
 typedef struct
@@ -501,6 +505,15 @@ int gbox_centroid(const RTCTX *ctx, const RTGBOX* gbox, RTPOINT2D* out);
 /* Utilities */
 extern void trim_trailing_zeros(const RTCTX *ctx, char *num);
 
+/* Locale independent double formatting, see rtprint.c */
+extern int rtprint_double_fixed(const RTCTX *ctx, double d, int precision, char *buf);
+extern int rtprint_double_fixed_padded(const RTCTX *ctx, double d, int precision, char *buf);
+extern int rtprint_double_general(const RTCTX *ctx, double d, int precision, char *buf, size_t bufsize);
+extern int rtprint_double_shortest(const RTCTX *ctx, double d, char *buf);
+
+/* Locale independent number reading for the text parsers, see rtin_wkt.c */
+extern const char* rtparse_double(const RTCTX *ctx, const char *p, double *d);
+
 extern uint8_t RTMULTITYPE[RTNUMTYPES];
 
 extern rtinterrupt_callback *_rtgeom_interrupt_callback;
@@ -519,6 +532,13 @@ extern int _rtgeom_interrupt_requested;
 int ptarray_npoints_in_rect(const RTCTX *ctx, const RTPOINTARRAY *pa, const RTGBOX *gbox);
 int gbox_contains_point2d(const RTCTX *ctx, const RTGBOX *g, const RTPOINT2D *p);
 int rtpoly_contains_point(const RTCTX *ctx, const RTPOLY *poly, const RTPOINT2D *pt);
+
+/*
+* GEOS fallbacks for the native binary predicates.
+* Return RT_TRUE, RT_FALSE or -1 on error.
+*/
+int rtgeom_contains_geos(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2);
+int rtgeom_covers_geos(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2);
 double distance2d_pt_seg(const RTCTX *ctx, const RTPOINT2D *p, const RTPOINT2D *A, const RTPOINT2D *B);
 
 /*------------------------------------------------------
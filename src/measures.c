@@ -31,8 +31,15 @@
 #include <stdlib.h>
 
 #include "measures.h"
+#include "rttree.h"
 #include "rtgeom_log.h"
 
+/*
+* Pairs of point arrays with more than this many vertex combinations
+* are measured through rect trees rather than edge by edge.
+*/
+#define RT_DIST2D_TREE_MIN_PAIRS 1024
+
 
 
 /*------------------------------------------------------------------------------------------------------------
@@ -228,6 +235,47 @@ rtgeom_mindistance2d_tolerance(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM
   return FLT_MAX;
 }
 
+/**
+  Minimum distance from one probe to many targets. The probe's edge
+  trees are built once and searched against each target in turn;
+  curved inputs go through the general code.
+*/
+int
+rtgeom_mindistance2d_many(const RTCTX *ctx, const RTGEOM *probe, RTGEOM **targets, int ntargets, double tolerance, double *distances)
+{
+  RTPREPARED *prep = NULL;
+  int i;
+
+  if ( tolerance < 0.0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero\n");
+    return RT_FAILURE;
+  }
+
+  if ( probe && ! rtgeom_is_empty(ctx, probe) && ! rtgeom_has_arc(ctx, probe) )
+  {
+    prep = rtgeom_prepare(ctx, probe);
+    if ( ! prep )
+      return RT_FAILURE;
+  }
+
+  for ( i = 0; i < ntargets; i++ )
+  {
+    const RTGEOM *target = targets[i];
+
+    if ( ! probe || ! target || rtgeom_is_empty(ctx, probe) || rtgeom_is_empty(ctx, target) )
+      distances[i] = FLT_MAX;
+    else if ( prep && ! rtgeom_has_arc(ctx, target) )
+      distances[i] = rtprepared_mindistance_tolerance(ctx, prep, target, tolerance);
+    else
+      distances[i] = rtgeom_mindistance2d_tolerance(ctx, probe, target, tolerance);
+  }
+
+  if ( prep )
+    rtprepared_free(ctx, prep);
+  return RT_SUCCESS;
+}
+
 
 /*------------------------------------------------------------------------------------------------------------
 End of Initializing functions
@@ -265,6 +313,7 @@ rt_dist2d_is_collection(const RTCTX *ctx, const RTGEOM *g)
   case RTMULTISURFACETYPE:
   case RTCOMPOUNDTYPE:
   case RTPOLYHEDRALSURFACETYPE:
+  case RTTINTYPE:
     return RT_TRUE;
     break;
 
@@ -273,6 +322,33 @@ rt_dist2d_is_collection(const RTCTX *ctx, const RTGEOM *g)
   }
 }
 
+/**
+A triangle measured as the one-ring polygon it is, viewed through
+caller provided storage
+*/
+static RTGEOM *
+rt_dist2d_triangle_as_poly(const RTCTX *ctx, RTGEOM *g, RTPOLY *poly, RTPOINTARRAY **ring)
+{
+  RTTRIANGLE *tri = (RTTRIANGLE *)g;
+
+  if ( g->type != RTTRIANGLETYPE )
+    return g;
+
+  /* The view must not get a box of its own, it would never be freed */
+  if ( ctx->bbox_cache != RTBBOX_CACHE_NONE )
+    rtgeom_add_bbox(ctx, g);
+
+  ring[0] = tri->points;
+  poly->type = RTPOLYGONTYPE;
+  poly->flags = tri->flags;
+  poly->bbox = tri->bbox;
+  poly->srid = tri->srid;
+  poly->nrings = 1;
+  poly->maxrings = 1;
+  poly->rings = ring;
+  return (RTGEOM *)poly;
+}
+
 /**
 This is a recursive function delivering every possible combinatin of subgeometries
 */
@@ -285,6 +361,8 @@ int rt_dist2d_recursive(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2
   RTGEOM *g2 = NULL;
   RTCOLLECTION *c1 = NULL;
   RTCOLLECTION *c2 = NULL;
+  RTPOLY tpoly1, tpoly2;
+  RTPOINTARRAY *tring1, *tring2;
 
   RTDEBUGF(ctx, 2, "rt_dist2d_comp is called with type1=%d, type2=%d", rtg1->type, rtg2->type);
 
@@ -321,6 +399,8 @@ int rt_dist2d_recursive(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2
       if (!rt_dist2d_recursive(ctx, g1, rtg2, dl)) return RT_FALSE;
       continue;
     }
+    g1 = rt_dist2d_triangle_as_poly(ctx, g1, &tpoly1, &tring1);
+
     for ( j = 0; j < n2; j++ )
     {
       if (rt_dist2d_is_collection(ctx, rtg2))
@@ -337,15 +417,7 @@ int rt_dist2d_recursive(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2
         if (!rt_dist2d_recursive(ctx, g1, g2, dl)) return RT_FALSE;
         continue;
       }
-
-      if ( ! g1->bbox )
-      {
-        rtgeom_add_bbox(ctx, g1);
-      }
-      if ( ! g2->bbox )
-      {
-        rtgeom_add_bbox(ctx, g2);
-      }
+      g2 = rt_dist2d_triangle_as_poly(ctx, g2, &tpoly2, &tring2);
 
       /*If one of geometries is empty, return. True here only means continue searching. False would have stoped the process*/
       if (rtgeom_is_empty(ctx, g1)||rtgeom_is_empty(ctx, g2)) return RT_TRUE;
@@ -499,15 +571,26 @@ We have to check for overlapping bboxes
 int
 rt_dist2d_check_overlap(const RTCTX *ctx, RTGEOM *rtg1,RTGEOM *rtg2)
 {
+  RTGBOX box1, box2;
+
   RTDEBUG(ctx, 2, "rt_dist2d_check_overlap is called");
-  if ( ! rtg1->bbox )
-    rtgeom_calculate_gbox(ctx, rtg1, rtg1->bbox);
-  if ( ! rtg2->bbox )
-    rtgeom_calculate_gbox(ctx, rtg2, rtg2->bbox);
+
+  /* Without a caching policy the boxes are only computed on the stack */
+  if ( ctx->bbox_cache != RTBBOX_CACHE_NONE )
+  {
+    rtgeom_add_bbox(ctx, rtg1);
+    rtgeom_add_bbox(ctx, rtg2);
+  }
+  if ( rtgeom_get_bbox_p(ctx, rtg1, &box1) != RT_SUCCESS ||
+       rtgeom_get_bbox_p(ctx, rtg2, &box2) != RT_SUCCESS )
+  {
+    RTDEBUG(ctx, 3, "empty geometry, no box to check");
+    return RT_TRUE;
+  }
 
   /*Check if the geometries intersect.
   */
-  if ((rtg1->bbox->xmax<rtg2->bbox->xmin||rtg1->bbox->xmin>rtg2->bbox->xmax||rtg1->bbox->ymax<rtg2->bbox->ymin||rtg1->bbox->ymin>rtg2->bbox->ymax))
+  if ((box1.xmax<box2.xmin||box1.xmin>box2.xmax||box1.ymax<box2.ymin||box1.ymin>box2.ymax))
   {
     RTDEBUG(ctx, 3, "geometries bboxes did not overlap");
     return RT_FALSE;
@@ -554,7 +637,8 @@ rt_dist2d_distribute_fast(const RTCTX *ctx, RTGEOM *rtg1, RTGEOM *rtg2, DISTPTS
     return RT_FALSE;
   }
   dl->twisted=1;
-  return rt_dist2d_fast_ptarray_ptarray(ctx, pa1, pa2, dl, rtg1->bbox, rtg2->bbox);
+  /* Boxes don't overlap, so the shells are all we need to measure */
+  return rt_dist2d_ptarray_ptarray(ctx, pa1, pa2, dl);
 }
 
 /*------------------------------------------------------------------------------------------------------------
@@ -1126,6 +1210,34 @@ rt_dist2d_pt_ptarrayarc(const RTCTX *ctx, const RTPOINT2D *p, const RTPOINTARRAY
 
 
 
+/**
+* Measure two point arrays (straight or circular) by descending their
+* rect trees, for inputs too large for the pairwise loops below.
+*/
+static int
+rt_dist2d_tree_ptarray_ptarray(const RTCTX *ctx, const RTPOINTARRAY *pa, int pa_arc, const RTPOINTARRAY *pb, int pb_arc, DISTPTS *dl)
+{
+  RECT_NODE *ta, *tb;
+  int ret;
+
+  ta = pa_arc ? rect_tree_new_arcs(ctx, pa) : rect_tree_new(ctx, pa);
+  if ( ! ta ) ta = rect_tree_new_points(ctx, pa);
+  tb = pb_arc ? rect_tree_new_arcs(ctx, pb) : rect_tree_new(ctx, pb);
+  if ( ! tb ) tb = rect_tree_new_points(ctx, pb);
+
+  ret = rect_tree_mindistance(ctx, ta, tb, dl);
+
+  rect_tree_free(ctx, ta);
+  rect_tree_free(ctx, tb);
+  return ret;
+}
+
+static int
+rt_dist2d_use_tree(const RTPOINTARRAY *pa, const RTPOINTARRAY *pb)
+{
+  return (double)pa->npoints * pb->npoints > RT_DIST2D_TREE_MIN_PAIRS;
+}
+
 /**
 * test each segment of l1 against each segment of l2.
 */
@@ -1154,6 +1266,10 @@ rt_dist2d_ptarray_ptarray(const RTCTX *ctx, RTPOINTARRAY *l1, RTPOINTARRAY *l2,D
       }
     }
   }
+  else if ( rt_dist2d_use_tree(l1, l2) )
+  {
+    return rt_dist2d_tree_ptarray_ptarray(ctx, l1, RT_FALSE, l2, RT_FALSE, dl);
+  }
   else
   {
     start = rt_getPoint2d_cp(ctx, l1, 0);
@@ -1205,6 +1321,10 @@ rt_dist2d_ptarray_ptarrayarc(const RTCTX *ctx, const RTPOINTARRAY *pa, const RTP
     rterror(ctx, "rt_dist2d_ptarray_ptarrayarc does not currently support DIST_MAX mode");
     return RT_FALSE;
   }
+  else if ( rt_dist2d_use_tree(pa, pb) )
+  {
+    return rt_dist2d_tree_ptarray_ptarray(ctx, pa, RT_FALSE, pb, RT_TRUE, dl);
+  }
   else
   {
     A1 = rt_getPoint2d_cp(ctx, pa, 0);
@@ -1254,6 +1374,10 @@ rt_dist2d_ptarrayarc_ptarrayarc(const RTCTX *ctx, const RTPOINTARRAY *pa, const
     rterror(ctx, "rt_dist2d_ptarrayarc_ptarrayarc does not currently support DIST_MAX mode");
     return RT_FALSE;
   }
+  else if ( rt_dist2d_use_tree(pa, pb) )
+  {
+    return rt_dist2d_tree_ptarray_ptarray(ctx, pa, RT_TRUE, pb, RT_TRUE, dl);
+  }
   else
   {
     A1 = rt_getPoint2d_cp(ctx, pa, 0);
@@ -1302,7 +1426,12 @@ rt_dist2d_seg_arc(const RTCTX *ctx, const RTPOINT2D *A1, const RTPOINT2D *A2, co
 
   /* What if the "arc" is a point? */
   if ( rt_arc_is_pt(ctx, B1, B2, B3) )
-    return rt_dist2d_pt_seg(ctx, B1, A1, A2, dl);
+  {
+    dl->twisted = -1 * dl->twisted;
+    rt_dist2d_pt_seg(ctx, B1, A1, A2, dl);
+    dl->twisted = -1 * dl->twisted;
+    return RT_TRUE;
+  }
 
   /* Calculate center and radius of the circle. */
   radius_C = rt_arc_center(ctx, B1, B2, B3, &C);
@@ -1416,8 +1545,11 @@ rt_dist2d_seg_arc(const RTCTX *ctx, const RTPOINT2D *A1, const RTPOINT2D *A2, co
   /* or, one of the arc end points is the closest */
   else if  ( pt_in_seg && ! pt_in_arc )
   {
+    /* Points come from B here, keep dl->p1 on A */
+    dl->twisted = -1 * dl->twisted;
     rt_dist2d_pt_seg(ctx, B1, A1, A2, dl);
     rt_dist2d_pt_seg(ctx, B3, A1, A2, dl);
+    dl->twisted = -1 * dl->twisted;
     return RT_TRUE;
   }
   /* Finally, one of the end-point to end-point combos is the closest. */
@@ -1469,8 +1601,8 @@ rt_dist2d_pt_arc(const RTCTX *ctx, const RTPOINT2D* P, const RTPOINT2D* A1, cons
   else
   {
     /* Distance is the minimum of the distances to the arc end points */
-    rt_dist2d_pt_pt(ctx, A1, P, dl);
-    rt_dist2d_pt_pt(ctx, A3, P, dl);
+    rt_dist2d_pt_pt(ctx, P, A1, dl);
+    rt_dist2d_pt_pt(ctx, P, A3, dl);
   }
   return RT_TRUE;
 }
@@ -41,8 +41,15 @@
 #include <stdlib.h>
 
 #include "measures3d.h"
+#include "rttree3d.h"
 #include "rtgeom_log.h"
 
+/**
+Above this many vertex pairs, geometries are measured through a
+bounding volume hierarchy instead of pair by pair
+*/
+#define RT_DIST3D_TREE_MIN_PAIRS 1024
+
 
 static inline int
 get_3dvector_from_points(const RTCTX *ctx, RTPOINT3DZ *p1,RTPOINT3DZ *p2, VECTOR3D *v)
@@ -385,6 +392,82 @@ rtgeom_mindistance3d_tolerance(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM
   return FLT_MAX;
 }
 
+/**
+  Minimum 3D distance from one probe to many targets.
+  The probe is counted and, once a target is large enough to need
+  one, indexed a single time for all of the targets.
+*/
+int
+rtgeom_mindistance3d_many(const RTCTX *ctx, const RTGEOM *probe, RTGEOM **targets, int ntargets, double tolerance, double *distances)
+{
+  DISTPTS3D thedl;
+  RECT3D_TREE *probe_tree = NULL;
+  RECT3D_TREE *target_tree;
+  int probe_empty, probe_nv;
+  int i, ret;
+
+  if ( tolerance < 0.0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero\n");
+    return RT_FAILURE;
+  }
+
+  /* A flat probe makes every measure 2D: let that code share its trees */
+  if ( ! probe || ! rtgeom_has_z(ctx, probe) )
+  {
+    rtnotice(ctx, "One or both of the geometries is missing z-value. The unknown z-value will be regarded as \"any value\"");
+    return rtgeom_mindistance2d_many(ctx, probe, targets, ntargets, tolerance, distances);
+  }
+
+  probe_empty = rtgeom_is_empty(ctx, probe);
+  probe_nv = rtgeom_count_vertices(ctx, probe);
+
+  for ( i = 0; i < ntargets; i++ )
+  {
+    const RTGEOM *target = targets[i];
+
+    if ( ! target || probe_empty || rtgeom_is_empty(ctx, target) )
+    {
+      distances[i] = FLT_MAX;
+      continue;
+    }
+    if ( ! rtgeom_has_z(ctx, target) )
+    {
+      distances[i] = rtgeom_mindistance3d_tolerance(ctx, probe, target, tolerance);
+      continue;
+    }
+
+    thedl.mode = DIST_MIN;
+    thedl.distance = FLT_MAX;
+    thedl.tolerance = tolerance;
+    if ( (double)probe_nv * rtgeom_count_vertices(ctx, target) > RT_DIST3D_TREE_MIN_PAIRS )
+    {
+      if ( ! probe_tree )
+        probe_tree = rect3d_tree_new(ctx, probe);
+      target_tree = probe_tree ? rect3d_tree_new(ctx, target) : NULL;
+      ret = target_tree && rect3d_tree_distance(ctx, probe_tree, target_tree, &thedl);
+      if ( target_tree )
+        rect3d_tree_free(ctx, target_tree);
+    }
+    else
+    {
+      ret = rt_dist3d_recursive(ctx, probe, target, &thedl);
+    }
+    if ( ! ret )
+    {
+      if ( probe_tree )
+        rect3d_tree_free(ctx, probe_tree);
+      rterror(ctx, "Some unspecified error.");
+      return RT_FAILURE;
+    }
+    distances[i] = thedl.distance;
+  }
+
+  if ( probe_tree )
+    rect3d_tree_free(ctx, probe_tree);
+  return RT_SUCCESS;
+}
+
 
 /*------------------------------------------------------------------------------------------------------------
 End of Initializing functions
@@ -395,6 +478,41 @@ Preprocessing functions
 Functions preparing geometries for distance-calculations
 --------------------------------------------------------------------------------------------------------------*/
 
+static int
+rt_dist3d_use_tree(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2)
+{
+  return (double)rtgeom_count_vertices(ctx, rtg1) * rtgeom_count_vertices(ctx, rtg2) > RT_DIST3D_TREE_MIN_PAIRS;
+}
+
+/**
+Build a tree over the points, segments and faces of each geometry and
+search them together, pruning the pairs whose boxes can't improve on
+the distance found so far
+*/
+static int
+rt_dist3d_tree(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS3D *dl)
+{
+  RECT3D_TREE *tree1, *tree2;
+  int ret;
+
+  RTDEBUG(ctx, 2, "rt_dist3d_tree is called");
+
+  tree1 = rect3d_tree_new(ctx, rtg1);
+  if ( ! tree1 )
+    return RT_FALSE;
+  tree2 = rect3d_tree_new(ctx, rtg2);
+  if ( ! tree2 )
+  {
+    rect3d_tree_free(ctx, tree1);
+    return RT_FALSE;
+  }
+
+  ret = rect3d_tree_distance(ctx, tree1, tree2, dl);
+
+  rect3d_tree_free(ctx, tree1);
+  rect3d_tree_free(ctx, tree2);
+  return ret;
+}
 
 /**
 This is a recursive function delivering every possible combination of subgeometries
@@ -411,6 +529,9 @@ int rt_dist3d_recursive(const RTCTX *ctx, const RTGEOM *rtg1,const RTGEOM *rtg2,
 
   RTDEBUGF(ctx, 2, "rt_dist3d_recursive is called with type1=%d, type2=%d", rtg1->type, rtg2->type);
 
+  if (rt_dist3d_use_tree(ctx, rtg1, rtg2))
+    return rt_dist3d_tree(ctx, rtg1, rtg2, dl);
+
   if (rtgeom_is_collection(ctx, rtg1))
   {
     RTDEBUG(ctx, 3, "First geometry is collection");
@@ -475,6 +596,22 @@ int rt_dist3d_recursive(const RTCTX *ctx, const RTGEOM *rtg1,const RTGEOM *rtg2,
 
 
 
+/**
+Wraps a triangle into a polygon borrowing its point array
+*/
+static const RTGEOM *
+rt_dist3d_triangle_as_poly(const RTTRIANGLE *tri, RTPOLY *poly, RTPOINTARRAY **ring)
+{
+  *ring = tri->points;
+  poly->type = RTPOLYGONTYPE;
+  poly->flags = tri->flags;
+  poly->bbox = NULL;
+  poly->srid = tri->srid;
+  poly->nrings = poly->maxrings = 1;
+  poly->rings = ring;
+  return (RTGEOM *)poly;
+}
+
 /**
 
 This function distributes the brute-force for 3D so far the only type, tasks depending on type
@@ -488,6 +625,18 @@ rt_dist3d_distribute_bruteforce(const RTCTX *ctx, const RTGEOM *rtg1, const RTGE
 
   RTDEBUGF(ctx, 2, "rt_dist3d_distribute_bruteforce is called with typ1=%d, type2=%d", rtg1->type, rtg2->type);
 
+  /*Triangles are measured as polygons with a single ring*/
+  if ( t1 == RTTRIANGLETYPE || t2 == RTTRIANGLETYPE )
+  {
+    RTPOLY tri1, tri2;
+    RTPOINTARRAY *ring1, *ring2;
+    if ( t1 == RTTRIANGLETYPE )
+      rtg1 = rt_dist3d_triangle_as_poly((RTTRIANGLE *)rtg1, &tri1, &ring1);
+    if ( t2 == RTTRIANGLETYPE )
+      rtg2 = rt_dist3d_triangle_as_poly((RTTRIANGLE *)rtg2, &tri2, &ring2);
+    return rt_dist3d_distribute_bruteforce(ctx, rtg1, rtg2, dl);
+  }
+
   if  ( t1 == RTPOINTTYPE )
   {
     if  ( t2 == RTPOINTTYPE )
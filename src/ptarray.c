@@ -33,6 +33,135 @@
 #include "librttopo_geom_internal.h"
 #include "rtgeom_log.h"
 
+/*
+ * Coordinate storage allocated by this module is reference counted,
+ * so that ptarray_clone_deep can share it between point arrays and
+ * only copy it when one of the sharers is about to modify it.
+ * The counter lives right before the first ordinate, in a header
+ * sized so that ordinates stay double aligned.
+ */
+typedef union
+{
+  int32_t refcount;
+  double align;
+}
+RTPTARRAY_STORAGE;
+
+#define PTARRAY_STORAGE(pa) (((RTPTARRAY_STORAGE *)((pa)->serialized_pointlist)) - 1)
+
+#if defined(__GNUC__)
+#define PTARRAY_STORAGE_REF(st) __sync_add_and_fetch(&((st)->refcount), 1)
+#define PTARRAY_STORAGE_UNREF(st) __sync_sub_and_fetch(&((st)->refcount), 1)
+#else
+#define PTARRAY_STORAGE_REF(st) (++((st)->refcount))
+#define PTARRAY_STORAGE_UNREF(st) (--((st)->refcount))
+#endif
+
+/*
+ * Give the point array a newly allocated, unshared storage
+ * with room for maxpoints points. Old storage is not released.
+ */
+static void
+ptarray_storage_alloc(const RTCTX *ctx, RTPOINTARRAY *pa, uint32_t maxpoints)
+{
+  RTPTARRAY_STORAGE *st;
+  size_t size = (size_t)maxpoints * ptarray_point_size(ctx, pa);
+
+  st = rtalloc(ctx, sizeof(RTPTARRAY_STORAGE) + size);
+  st->refcount = 1;
+  pa->serialized_pointlist = (uint8_t *)(st + 1);
+  RTFLAGS_SET_SHARED(pa->flags, 1);
+  RTFLAGS_SET_READONLY(pa->flags, 0);
+}
+
+/*
+ * Grow (or shrink) the storage of a point array to maxpoints points.
+ * The point array must not be sharing its storage, see ptarray_unshare.
+ */
+static void
+ptarray_storage_realloc(const RTCTX *ctx, RTPOINTARRAY *pa, uint32_t maxpoints)
+{
+  size_t size = (size_t)maxpoints * ptarray_point_size(ctx, pa);
+
+  if ( RTFLAGS_GET_SHARED(pa->flags) )
+  {
+    RTPTARRAY_STORAGE *st = PTARRAY_STORAGE(pa);
+    st = rtrealloc(ctx, st, sizeof(RTPTARRAY_STORAGE) + size);
+    pa->serialized_pointlist = (uint8_t *)(st + 1);
+  }
+  else
+  {
+    pa->serialized_pointlist = rtrealloc(ctx, pa->serialized_pointlist, size);
+  }
+}
+
+/*
+ * Drop the point array reference to its storage, releasing the
+ * memory if this was the last reference. Read-only storage is
+ * never released.
+ */
+static void
+ptarray_storage_release(const RTCTX *ctx, RTPOINTARRAY *pa)
+{
+  if ( ! pa->serialized_pointlist || RTFLAGS_GET_READONLY(pa->flags) )
+    return;
+
+  if ( RTFLAGS_GET_SHARED(pa->flags) )
+  {
+    RTPTARRAY_STORAGE *st = PTARRAY_STORAGE(pa);
+    if ( PTARRAY_STORAGE_UNREF(st) == 0 )
+      rtfree(ctx, st);
+  }
+  else
+  {
+    rtfree(ctx, pa->serialized_pointlist);
+  }
+  pa->serialized_pointlist = NULL;
+}
+
+int
+ptarray_unshare(const RTCTX *ctx, RTPOINTARRAY *pa)
+{
+  RTPTARRAY_STORAGE *st;
+  uint8_t *ptlist;
+
+  /* Borrowed memory is never written to, take a private copy */
+  if ( RTFLAGS_GET_READONLY(pa->flags) )
+  {
+    ptlist = pa->serialized_pointlist;
+    if ( ! ptlist )
+    {
+      RTFLAGS_SET_READONLY(pa->flags, 0);
+      return RT_FALSE;
+    }
+    RTDEBUGF(ctx, 3, "ptarray_unshare: copying %d read-only points", pa->npoints);
+    if ( pa->maxpoints < pa->npoints )
+      pa->maxpoints = pa->npoints;
+    ptarray_storage_alloc(ctx, pa, pa->maxpoints);
+    memcpy(pa->serialized_pointlist, ptlist, (size_t)pa->npoints * ptarray_point_size(ctx, pa));
+    return RT_TRUE;
+  }
+
+  if ( ! RTFLAGS_GET_SHARED(pa->flags) )
+    return RT_FALSE;
+
+  st = PTARRAY_STORAGE(pa);
+  if ( st->refcount == 1 )
+    return RT_FALSE;
+
+  RTDEBUGF(ctx, 3, "ptarray_unshare: copying %d points shared %d times", pa->npoints, st->refcount);
+
+  ptlist = pa->serialized_pointlist;
+  ptarray_storage_alloc(ctx, pa, pa->maxpoints);
+  memcpy(pa->serialized_pointlist, ptlist, (size_t)pa->npoints * ptarray_point_size(ctx, pa));
+
+  /* Another sharer may have gone away in the meantime */
+  if ( PTARRAY_STORAGE_UNREF(st) == 0 )
+    rtfree(ctx, st);
+
+  return RT_TRUE;
+}
+
 int
 ptarray_has_z(const RTCTX *ctx, const RTPOINTARRAY *pa)
 {
@@ -82,9 +211,7 @@ ptarray_construct_empty(const RTCTX *ctx, char hasz, char hasm, uint32_t maxpoin
 
   /* Allocate the coordinate array */
   if ( maxpoints > 0 )
-    pa->serialized_pointlist = rtalloc(ctx, maxpoints * ptarray_point_size(ctx, pa));
-  else
-    pa->serialized_pointlist = NULL;
+    ptarray_storage_alloc(ctx, pa, maxpoints);
 
   return pa;
 }
@@ -100,12 +227,6 @@ ptarray_insert_point(const RTCTX *ctx, RTPOINTARRAY *pa, const RTPOINT4D *p, int
   RTDEBUGF(ctx, 5,"pa = %p; p = %p; where = %d", pa, p, where);
   RTDEBUGF(ctx, 5,"pa->npoints = %d; pa->maxpoints = %d", pa->npoints, pa->maxpoints);
 
-  if ( RTFLAGS_GET_READONLY(pa->flags) )
-  {
-    rterror(ctx, "ptarray_insert_point: called on read-only point array");
-    return RT_FAILURE;
-  }
-
   /* Error on invalid offset value */
   if ( where > pa->npoints || where < 0)
   {
@@ -118,7 +239,11 @@ ptarray_insert_point(const RTCTX *ctx, RTPOINTARRAY *pa, const RTPOINT4D *p, int
   {
     pa->maxpoints = 32;
     pa->npoints = 0;
-    pa->serialized_pointlist = rtalloc(ctx, ptarray_point_size(ctx, pa) * pa->maxpoints);
+    ptarray_storage_alloc(ctx, pa, pa->maxpoints);
+  }
+  else
+  {
+    ptarray_unshare(ctx, pa);
   }
 
   /* Error out if we have a bad situation */
@@ -132,7 +257,7 @@ ptarray_insert_point(const RTCTX *ctx, RTPOINTARRAY *pa, const RTPOINT4D *p, int
   if( pa->npoints == pa->maxpoints )
   {
     pa->maxpoints *= 2;
-    pa->serialized_pointlist = rtrealloc(ctx, pa->serialized_pointlist, ptarray_point_size(ctx, pa) * pa->maxpoints);
+    ptarray_storage_realloc(ctx, pa, pa->maxpoints);
   }
 
   /* Make space to insert the new point */
@@ -203,18 +328,13 @@ ptarray_append_ptarray(const RTCTX *ctx, RTPOINTARRAY *pa1, RTPOINTARRAY *pa2, d
 
   if ( ! npoints ) return RT_SUCCESS; /* nothing more to do */
 
-  if( RTFLAGS_GET_READONLY(pa1->flags) )
-  {
-    rterror(ctx, "ptarray_append_ptarray: target pointarray is read-only");
-    return RT_FAILURE;
-  }
-
   if( RTFLAGS_GET_ZM(pa1->flags) != RTFLAGS_GET_ZM(pa2->flags) )
   {
     rterror(ctx, "ptarray_append_ptarray: appending mixed dimensionality is not allowed");
     return RT_FAILURE;
   }
 
+  ptarray_unshare(ctx, pa1);
   ptsize = ptarray_point_size(ctx, pa1);
 
   /* Check for duplicate end point */
@@ -243,7 +363,10 @@ ptarray_append_ptarray(const RTCTX *ctx, RTPOINTARRAY *pa1, RTPOINTARRAY *pa2, d
   {
     pa1->maxpoints = ncap > pa1->maxpoints*2 ?
                      ncap : pa1->maxpoints*2;
-    pa1->serialized_pointlist = rtrealloc(ctx, pa1->serialized_pointlist, ptsize * pa1->maxpoints);
+    if ( pa1->serialized_pointlist )
+      ptarray_storage_realloc(ctx, pa1, pa1->maxpoints);
+    else
+      ptarray_storage_alloc(ctx, pa1, pa1->maxpoints);
   }
 
   memcpy(rt_getPoint_internal(ctx, pa1, pa1->npoints),
@@ -277,6 +400,8 @@ ptarray_remove_point(const RTCTX *ctx, RTPOINTARRAY *pa, int where)
     return RT_FAILURE;
   }
 
+  ptarray_unshare(ctx, pa);
+
   /* If the point is any but the last, we need to copy the data back one point */
   if( where < pa->npoints - 1 )
   {
@@ -317,7 +442,7 @@ ptarray_construct_copy_data(const RTCTX *ctx, char hasz, char hasm, uint32_t npo
 
   if ( npoints > 0 )
   {
-    pa->serialized_pointlist = rtalloc(ctx, ptarray_point_size(ctx, pa) * npoints);
+    ptarray_storage_alloc(ctx, pa, npoints);
     memcpy(pa->serialized_pointlist, ptlist, ptarray_point_size(ctx, pa) * npoints);
   }
   else
@@ -332,8 +457,7 @@ void ptarray_free(const RTCTX *ctx, RTPOINTARRAY *pa)
 {
   if(pa)
   {
-    if(pa->serialized_pointlist && ( ! RTFLAGS_GET_READONLY(pa->flags) ) )
-      rtfree(ctx, pa->serialized_pointlist);
+    ptarray_storage_release(ctx, pa);
     rtfree(ctx, pa);
     RTDEBUG(ctx, 5,"Freeing a PointArray");
   }
@@ -350,6 +474,8 @@ ptarray_reverse(const RTCTX *ctx, RTPOINTARRAY *pa)
   int last = pa->npoints-1;
   int mid = pa->npoints/2;
 
+  ptarray_unshare(ctx, pa);
+
   for (i=0; i<mid; i++)
   {
     uint8_t *from, *to;
@@ -630,6 +756,10 @@ ptarray_merge(const RTCTX *ctx, RTPOINTARRAY *pa1, RTPOINTARRAY *pa2)
 
 /**
  * @brief Deep clone a pointarray (also clones serialized pointlist)
+ *
+ * Reference counted storage is shared rather than copied: the actual
+ * copy is deferred to the first modification of either point array
+ * (see ptarray_unshare).
  */
 RTPOINTARRAY *
 ptarray_clone_deep(const RTCTX *ctx, const RTPOINTARRAY *in)
@@ -643,11 +773,24 @@ ptarray_clone_deep(const RTCTX *ctx, const RTPOINTARRAY *in)
   out->npoints = in->npoints;
   out->maxpoints = in->maxpoints;
 
+  if ( RTFLAGS_GET_SHARED(in->flags) && ! RTFLAGS_GET_READONLY(in->flags) )
+  {
+    PTARRAY_STORAGE_REF(PTARRAY_STORAGE(in));
+    out->serialized_pointlist = in->serialized_pointlist;
+    return out;
+  }
+
   RTFLAGS_SET_READONLY(out->flags, 0);
+  RTFLAGS_SET_SHARED(out->flags, 0);
+  out->serialized_pointlist = NULL;
+  out->maxpoints = in->npoints;
 
-  size = in->npoints * ptarray_point_size(ctx, in);
-  out->serialized_pointlist = rtalloc(ctx, size);
-  memcpy(out->serialized_pointlist, in->serialized_pointlist, size);
+  if ( in->npoints > 0 )
+  {
+    size = in->npoints * ptarray_point_size(ctx, in);
+    ptarray_storage_alloc(ctx, out, in->npoints);
+    memcpy(out->serialized_pointlist, in->serialized_pointlist, size);
+  }
 
   return out;
 }
@@ -667,6 +810,7 @@ ptarray_clone(const RTCTX *ctx, const RTPOINTARRAY *in)
   out->maxpoints = in->maxpoints;
 
   RTFLAGS_SET_READONLY(out->flags, 1);
+  RTFLAGS_SET_SHARED(out->flags, 0);
 
   out->serialized_pointlist = in->serialized_pointlist;
 
@@ -1019,7 +1163,17 @@ ptarray_force_dims(const RTCTX *ctx, const RTPOINTARRAY *pa, int hasz, int hasm)
   int in_hasz = RTFLAGS_GET_Z(pa->flags);
   int in_hasm = RTFLAGS_GET_M(pa->flags);
   RTPOINT4D pt;
-  RTPOINTARRAY *pa_out = ptarray_construct_empty(ctx, hasz, hasm, pa->npoints);
+  RTPOINTARRAY *pa_out;
+
+  /* Nothing to convert, share the coordinates */
+  if ( (!hasz) == (!in_hasz) && (!hasm) == (!in_hasm) )
+  {
+    pa_out = ptarray_clone_deep(ctx, pa);
+    RTFLAGS_SET_GEODETIC(pa_out->flags, 0);
+    return pa_out;
+  }
+
+  pa_out = ptarray_construct_empty(ctx, hasz, hasm, pa->npoints);
 
   for( i = 0; i < pa->npoints; i++ )
   {
@@ -1396,6 +1550,8 @@ ptarray_longitude_shift(const RTCTX *ctx, RTPOINTARRAY *pa)
   int i;
   double x;
 
+  ptarray_unshare(ctx, pa);
+
   for (i=0; i<pa->npoints; i++)
   {
     memcpy(&x, rt_getPoint_internal(ctx, pa, i), sizeof(double));
@@ -1410,7 +1566,8 @@ ptarray_longitude_shift(const RTCTX *ctx, RTPOINTARRAY *pa)
  * Returns a RTPOINTARRAY with consecutive equal points
  * removed. Equality test on all dimensions of input.
  *
- * Artays returns a newly allocated object.
+ * Artays returns a newly allocated object, possibly sharing
+ * coordinates with the input when nothing was removed.
  *
  */
 RTPOINTARRAY *
@@ -1433,16 +1590,14 @@ ptarray_remove_repeated_points_minpoints(const RTCTX *ctx, const RTPOINTARRAY *i
 
   RTDEBUGF(ctx, 3, " ptsize: %d", ptsize);
 
-  /* Allocate enough space for all points */
-  out = ptarray_construct(ctx, RTFLAGS_GET_Z(in->flags),
-                          RTFLAGS_GET_M(in->flags), in->npoints);
-
-  /* Now fill up the actual points (NOTE: could be optimized) */
+  /*
+   * Output is only allocated once the first repeated point is
+   * found, arrays with no repeated points are shared instead.
+   */
+  out = NULL;
 
   opn=1;
-  memcpy(rt_getPoint_internal(ctx, out, 0), rt_getPoint_internal(ctx, in, 0), ptsize);
   last_point = rt_getPoint2d_cp(ctx, in, 0);
-  RTDEBUGF(ctx, 3, " first point copied, out points: %d", opn);
   for ( ipn = 1; ipn < in->npoints; ++ipn)
   {
     this_point = rt_getPoint2d_cp(ctx, in, ipn);
@@ -1452,10 +1607,27 @@ ptarray_remove_repeated_points_minpoints(const RTCTX *ctx, const RTPOINTARRAY *i
     {
       /* The point is different from the previous,
        * we add it to output */
-      memcpy(rt_getPoint_internal(ctx, out, opn++), rt_getPoint_internal(ctx, in, ipn), ptsize);
+      if ( out )
+        memcpy(rt_getPoint_internal(ctx, out, opn), rt_getPoint_internal(ctx, in, ipn), ptsize);
+      opn++;
       last_point = this_point;
       RTDEBUGF(ctx, 3, " Point %d differs from point %d. Out points: %d", ipn, ipn-1, opn);
     }
+    else if ( ! out )
+    {
+      /* First repeated point, all previous points were kept */
+      out = ptarray_construct(ctx, RTFLAGS_GET_Z(in->flags),
+                              RTFLAGS_GET_M(in->flags), in->npoints);
+      memcpy(rt_getPoint_internal(ctx, out, 0), rt_getPoint_internal(ctx, in, 0), ptsize * opn);
+    }
+  }
+
+  if ( ! out )
+  {
+    RTDEBUG(ctx, 3, " no repeated points, sharing input");
+    out = ptarray_clone_deep(ctx, in);
+    RTFLAGS_SET_GEODETIC(out->flags, 0);
+    return out;
   }
 
   RTDEBUGF(ctx, 3, " in:%d out:%d", out->npoints, opn);
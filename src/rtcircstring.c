@@ -70,6 +70,7 @@ rtcircstring_construct(const RTCTX *ctx, int srid, RTGBOX *bbox, RTPOINTARRAY *p
 
   result->flags = points->flags;
   RTFLAGS_SET_BBOX(result->flags, bbox?1:0);
+  RTFLAGS_SET_SHARED(result->flags, 0);
 
   result->srid = srid;
   result->points = points;
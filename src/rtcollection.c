@@ -230,6 +230,15 @@ RTCOLLECTION* rtcollection_add_rtgeom(const RTCTX *ctx, RTCOLLECTION *col, const
 
   col->geoms[col->ngeoms] = (RTGEOM*)geom;
   col->ngeoms++;
+
+  /* Grow the cached box, if any, rather than dropping it */
+  if ( col->bbox )
+  {
+    RTGBOX gbox;
+    if ( rtgeom_get_bbox_p(ctx, geom, &gbox) == RT_SUCCESS )
+      gbox_merge(ctx, &gbox, col->bbox);
+  }
+
   return col;
 }
 
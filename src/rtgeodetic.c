@@ -28,6 +28,7 @@
 #include "rttopo_config.h"
 #include "librttopo_geom_internal.h"
 #include "rtgeodetic.h"
+#include "rtgeodetic_tree.h"
 #include "rtgeom_log.h"
 
 /**
@@ -681,58 +682,6 @@ edge_point_side(const RTCTX *ctx, const GEOGRAPHIC_EDGE *e, const GEOGRAPHIC_POI
     return 1;
 }
 
-/**
-* Returns the angle in radians at point B of the triangle formed by A-B-C
-*/
-static double
-sphere_angle(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b,  const GEOGRAPHIC_POINT *c)
-{
-  POINT3D normal1, normal2;
-  robust_cross_product(ctx, b, a, &normal1);
-  robust_cross_product(ctx, b, c, &normal2);
-  normalize(ctx, &normal1);
-  normalize(ctx, &normal2);
-  return sphere_distance_cartesian(ctx, &normal1, &normal2);
-}
-
-/**
-* Computes the spherical area of a triangle. If C is to the left of A/B,
-* the area is negative. If C is to the right of A/B, the area is positive.
-*
-* @param a The first triangle vertex.
-* @param b The second triangle vertex.
-* @param c The last triangle vertex.
-* @return the signed area in radians.
-*/
-static double
-sphere_signed_area(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, const GEOGRAPHIC_POINT *c)
-{
-  double angle_a, angle_b, angle_c;
-  double area_radians = 0.0;
-  int side;
-  GEOGRAPHIC_EDGE e;
-
-  angle_a = sphere_angle(ctx, b,a,c);
-  angle_b = sphere_angle(ctx, a,b,c);
-  angle_c = sphere_angle(ctx, b,c,a);
-
-  area_radians = angle_a + angle_b + angle_c - M_PI;
-
-  /* What's the direction of the B/C edge? */
-  e.start = *a;
-  e.end = *b;
-  side = edge_point_side(ctx, &e, c);
-
-  /* Co-linear points implies no area */
-  if ( side == 0 )
-    return 0.0;
-
-  /* Add the sign to the area */
-  return side * area_radians;
-}
-
-
-
 /**
 * Returns true if the point p is on the great circle plane.
 * Forms the scalar triple product of A,B,p and if the volume of the
@@ -1712,6 +1661,300 @@ rtgeom_segmentize_sphere(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_
 }
 
 
+/*
+* Tolerance driven segmentization. Edges are split at the mid point of
+* their great circle arc for as long as the arc strays from the straight
+* lon/lat segment drawn in its place by more than the tolerance.
+*/
+
+/* Deepest split of a single input edge */
+#define SEGMENTIZE_MAX_DEPTH 24
+
+typedef struct
+{
+  double tolerance; /* degrees */
+  int hasz;
+  int hasm;
+  rtgeom_point_visitor visitor;
+  void *data;
+} SEGMENTIZE_STATE;
+
+/* Longitude difference brought into [-180, 180] */
+static double
+segmentize_delta_lon(double d)
+{
+  while ( d > 180.0 ) d -= 360.0;
+  while ( d < -180.0 ) d += 360.0;
+  return d;
+}
+
+/**
+* Largest distance, in lon/lat degrees, between the straight segment
+* p1/p2 and the great circle arc q1/q2, sampled at a quarter, half and
+* three quarters of the arc. Three samples catch the arcs that cross
+* the equator, whose mid point falls on the segment.
+*/
+static double
+segmentize_deviation(const RTCTX *ctx, const POINT3D *q1, const RTPOINT4D *p1, const POINT3D *q2, const RTPOINT4D *p2)
+{
+  static const double t[3] = { 0.25, 0.5, 0.75 };
+  POINT3D q;
+  GEOGRAPHIC_POINT g;
+  double x1, x2, sx, sy, px, py, len2, f, dx, dy, d;
+  double deviation = 0.0;
+  int i;
+
+  /* Longitude is free at a pole: follow the meridian of the other end */
+  x1 = p1->x;
+  x2 = p2->x;
+  if ( FP_EQUALS(fabs(p1->y), 90.0) )
+    x1 = x2;
+  else if ( FP_EQUALS(fabs(p2->y), 90.0) )
+    x2 = x1;
+
+  sx = segmentize_delta_lon(x2 - x1);
+  sy = p2->y - p1->y;
+  len2 = sx * sx + sy * sy;
+
+  for ( i = 0; i < 3; i++ )
+  {
+    q.x = q1->x + t[i] * (q2->x - q1->x);
+    q.y = q1->y + t[i] * (q2->y - q1->y);
+    q.z = q1->z + t[i] * (q2->z - q1->z);
+    normalize(ctx, &q);
+    cart2geog(ctx, &q, &g);
+    px = segmentize_delta_lon(rad2deg(g.lon) - x1);
+    py = rad2deg(g.lat) - p1->y;
+
+    /* Distance to the closest point of the segment */
+    f = len2 > 0.0 ? (px * sx + py * sy) / len2 : 0.0;
+    f = FP_MAX(0.0, FP_MIN(1.0, f));
+    dx = px - f * sx;
+    dy = py - f * sy;
+    d = sqrt(dx * dx + dy * dy);
+    deviation = FP_MAX(deviation, d);
+  }
+  return deviation;
+}
+
+/**
+* Which pole, +1 north or -1 south, the arc q1/q2 runs over strictly
+* between its ends, or 0. There the arc leaves the lon/lat plane along
+* the pole line, however short it is.
+*/
+static int
+segmentize_pole_on_arc(const RTCTX *ctx, const POINT3D *q1, const RTPOINT4D *p1, const POINT3D *q2, const RTPOINT4D *p2)
+{
+  POINT3D n, a, b, pole;
+  double len;
+
+  if ( FP_EQUALS(fabs(p1->y), 90.0) || FP_EQUALS(fabs(p2->y), 90.0) )
+    return 0;
+
+  /* The pole must be in the plane of the arc */
+  cross_product(ctx, q1, q2, &n);
+  len = sqrt(dot_product(ctx, &n, &n));
+  if ( FP_IS_ZERO(len) || fabs(n.z) / len > FP_TOLERANCE )
+    return 0;
+
+  /* And on the minor arc between q1 and q2 */
+  pole.x = pole.y = 0.0;
+  pole.z = q1->z + q2->z > 0.0 ? 1.0 : -1.0;
+  cross_product(ctx, q1, &pole, &a);
+  cross_product(ctx, &pole, q2, &b);
+  if ( dot_product(ctx, &a, &n) > 0.0 && dot_product(ctx, &b, &n) > 0.0 )
+    return (int)pole.z;
+  return 0;
+}
+
+/**
+* Send the points after p1 up to p2 of the edge p1/p2 to the visitor,
+* splitting it as needed. Returns nonzero if the visitor did.
+*/
+static int
+segmentize_edge(const RTCTX *ctx, const SEGMENTIZE_STATE *state, const POINT3D *q1, const RTPOINT4D *p1, const POINT3D *q2, const RTPOINT4D *p2, int depth)
+{
+  POINT3D qm;
+  GEOGRAPHIC_POINT g;
+  RTPOINT4D pm, pm2;
+  double f;
+  int rv, pole;
+
+  /*
+  * Over a pole the arc runs along the pole line, between the meridians
+  * of its ends: pin it there with one vertex on each meridian.
+  */
+  pole = depth < SEGMENTIZE_MAX_DEPTH ? segmentize_pole_on_arc(ctx, q1, p1, q2, p2) : 0;
+  if ( pole )
+  {
+    qm.x = qm.y = 0.0;
+    qm.z = pole;
+    f = sphere_distance_cartesian(ctx, q1, &qm) / sphere_distance_cartesian(ctx, q1, q2);
+    pm.x = p1->x;
+    pm.y = 90.0 * pole;
+    pm.z = state->hasz ? p1->z + f * (p2->z - p1->z) : 0.0;
+    pm.m = state->hasm ? p1->m + f * (p2->m - p1->m) : 0.0;
+    pm2 = pm;
+    pm2.x = p2->x;
+
+    rv = segmentize_edge(ctx, state, q1, p1, &qm, &pm, depth + 1);
+    if ( rv ) return rv;
+    if ( pm2.x != pm.x )
+    {
+      rv = state->visitor(ctx, &pm2, state->data);
+      if ( rv ) return rv;
+    }
+    return segmentize_edge(ctx, state, &qm, &pm2, q2, p2, depth + 1);
+  }
+
+  /*
+  * Arc length alone says nothing near the poles, where a short arc can
+  * span any longitude range: only the deviation decides.
+  */
+  if ( depth < SEGMENTIZE_MAX_DEPTH &&
+       segmentize_deviation(ctx, q1, p1, q2, p2) > state->tolerance )
+  {
+    vector_sum(ctx, q1, q2, &qm);
+
+    /* Antipodal ends have no defined arc */
+    if ( ! ( FP_IS_ZERO(qm.x) && FP_IS_ZERO(qm.y) && FP_IS_ZERO(qm.z) ) )
+    {
+      normalize(ctx, &qm);
+      cart2geog(ctx, &qm, &g);
+      pm.x = rad2deg(g.lon);
+      pm.y = rad2deg(g.lat);
+      pm.z = state->hasz ? (p1->z + p2->z) / 2.0 : 0.0;
+      pm.m = state->hasm ? (p1->m + p2->m) / 2.0 : 0.0;
+
+      rv = segmentize_edge(ctx, state, q1, p1, &qm, &pm, depth + 1);
+      if ( rv ) return rv;
+      return segmentize_edge(ctx, state, &qm, &pm, q2, p2, depth + 1);
+    }
+  }
+  return state->visitor(ctx, p2, state->data);
+}
+
+int
+ptarray_segmentize_sphere_visit(const RTCTX *ctx, const RTPOINTARRAY *pa, double tolerance, rtgeom_point_visitor visitor, void *data)
+{
+  SEGMENTIZE_STATE state;
+  RTPOINT4D p1, p2;
+  GEOGRAPHIC_POINT g;
+  POINT3D q1, q2;
+  int i, rv;
+
+  if ( tolerance <= 0.0 )
+  {
+    rterror(ctx, "%s: tolerance must be positive", __func__);
+    return -1;
+  }
+  if ( ! pa->npoints )
+    return 0;
+
+  state.tolerance = tolerance;
+  state.hasz = ptarray_has_z(ctx, pa);
+  state.hasm = ptarray_has_m(ctx, pa);
+  state.visitor = visitor;
+  state.data = data;
+
+  rt_getPoint4d_p(ctx, pa, 0, &p1);
+  geographic_point_init(ctx, p1.x, p1.y, &g);
+  geog2cart(ctx, &g, &q1);
+  rv = visitor(ctx, &p1, data);
+  if ( rv ) return rv;
+
+  for ( i = 1; i < pa->npoints; i++ )
+  {
+    rt_getPoint4d_p(ctx, pa, i, &p2);
+
+    /* Skip duplicate points (except in case of 2-point lines!) */
+    if ( pa->npoints > 2 && p4d_same(ctx, &p1, &p2) )
+      continue;
+
+    geographic_point_init(ctx, p2.x, p2.y, &g);
+    geog2cart(ctx, &g, &q2);
+    rv = segmentize_edge(ctx, &state, &q1, &p1, &q2, &p2, 0);
+    if ( rv ) return rv;
+
+    p1 = p2;
+    q1 = q2;
+  }
+  return 0;
+}
+
+static int
+segmentize_append_point(const RTCTX *ctx, const RTPOINT4D *pt, void *data)
+{
+  ptarray_append_point(ctx, (RTPOINTARRAY*)data, pt, RT_TRUE);
+  return 0;
+}
+
+static RTPOINTARRAY*
+ptarray_segmentize_sphere_tolerance(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double tolerance)
+{
+  RTPOINTARRAY *pa_out = ptarray_construct_empty(ctx, ptarray_has_z(ctx, pa_in), ptarray_has_m(ctx, pa_in), pa_in->npoints);
+  ptarray_segmentize_sphere_visit(ctx, pa_in, tolerance, segmentize_append_point, pa_out);
+  return pa_out;
+}
+
+RTGEOM*
+rtgeom_segmentize_sphere_tolerance(const RTCTX *ctx, const RTGEOM *rtg_in, double tolerance)
+{
+  RTPOINTARRAY *pa_out;
+  RTPOLY *rtpoly_in, *rtpoly_out;
+  RTCOLLECTION *rtcol_in, *rtcol_out;
+  int i;
+
+  /* Reflect NULL */
+  if ( ! rtg_in )
+    return NULL;
+
+  if ( tolerance <= 0.0 )
+  {
+    rterror(ctx, "%s: tolerance must be positive", __func__);
+    return NULL;
+  }
+
+  /* Clone empty */
+  if ( rtgeom_is_empty(ctx, rtg_in) )
+    return rtgeom_clone(ctx, rtg_in);
+
+  switch (rtg_in->type)
+  {
+  case RTMULTIPOINTTYPE:
+  case RTPOINTTYPE:
+    return rtgeom_clone_deep(ctx, rtg_in);
+  case RTLINETYPE:
+    pa_out = ptarray_segmentize_sphere_tolerance(ctx, ((RTLINE*)rtg_in)->points, tolerance);
+    return rtline_as_rtgeom(ctx, rtline_construct(ctx, rtg_in->srid, NULL, pa_out));
+  case RTPOLYGONTYPE:
+    rtpoly_in = rtgeom_as_rtpoly(ctx, rtg_in);
+    rtpoly_out = rtpoly_construct_empty(ctx, rtg_in->srid, rtgeom_has_z(ctx, rtg_in), rtgeom_has_m(ctx, rtg_in));
+    for ( i = 0; i < rtpoly_in->nrings; i++ )
+    {
+      pa_out = ptarray_segmentize_sphere_tolerance(ctx, rtpoly_in->rings[i], tolerance);
+      rtpoly_add_ring(ctx, rtpoly_out, pa_out);
+    }
+    return rtpoly_as_rtgeom(ctx, rtpoly_out);
+  case RTMULTILINETYPE:
+  case RTMULTIPOLYGONTYPE:
+  case RTCOLLECTIONTYPE:
+    rtcol_in = rtgeom_as_rtcollection(ctx, rtg_in);
+    rtcol_out = rtcollection_construct_empty(ctx, rtg_in->type, rtg_in->srid, rtgeom_has_z(ctx, rtg_in), rtgeom_has_m(ctx, rtg_in));
+    for ( i = 0; i < rtcol_in->ngeoms; i++ )
+    {
+      rtcollection_add_rtgeom(ctx, rtcol_out, rtgeom_segmentize_sphere_tolerance(ctx, rtcol_in->geoms[i], tolerance));
+    }
+    return rtcollection_as_rtgeom(ctx, rtcol_out);
+  default:
+    rterror(ctx, "rtgeom_segmentize_sphere_tolerance: unsupported input geometry type: %d - %s",
+            rtg_in->type, rttype_name(ctx, rtg_in->type));
+    break;
+  }
+  return NULL;
+}
+
+
 /**
 * Returns the area of the ring (ring must be closed) in square radians (surface of
 * the sphere is 4*PI).
@@ -1719,9 +1962,11 @@ rtgeom_segmentize_sphere(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_
 double
 ptarray_area_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa)
 {
-  int i;
+  int i, side;
   const RTPOINT2D *p;
   GEOGRAPHIC_POINT a, b, c;
+  POINT3D n_ab, n_ba, n_ac, n_ca, n_bc, n_cb, pt;
+  double area_radians, w;
   double area = 0.0;
 
   /* Return zero on nonsensical inputs */
@@ -1733,17 +1978,58 @@ ptarray_area_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa)
   p = rt_getPoint2d_cp(ctx, pa, 1);
   geographic_point_init(ctx, p->x, p->y, &b);
 
+  /*
+  * Fan of triangles a/b/c, each adding its spherical excess (the sum
+  * of its angles less pi), negative if c is left of a/b. The plane
+  * normals on the a/c side of a triangle are the ones on the a/b side
+  * of the next, so they are only computed once.
+  */
+  robust_cross_product(ctx, &a, &b, &n_ab);
+  normalize(ctx, &n_ab);
+  robust_cross_product(ctx, &b, &a, &n_ba);
+  normalize(ctx, &n_ba);
+
   for ( i = 2; i < pa->npoints-1; i++ )
   {
     p = rt_getPoint2d_cp(ctx, pa, i);
     geographic_point_init(ctx, p->x, p->y, &c);
-    area += sphere_signed_area(ctx, &a, &b, &c);
+
+    robust_cross_product(ctx, &a, &c, &n_ac);
+    normalize(ctx, &n_ac);
+    robust_cross_product(ctx, &b, &c, &n_bc);
+    normalize(ctx, &n_bc);
+    robust_cross_product(ctx, &c, &b, &n_cb);
+    normalize(ctx, &n_cb);
+    robust_cross_product(ctx, &c, &a, &n_ca);
+    normalize(ctx, &n_ca);
+
+    /* Angles at a, b and c */
+    area_radians = sphere_distance_cartesian(ctx, &n_ab, &n_ac) +
+                   sphere_distance_cartesian(ctx, &n_ba, &n_bc) +
+                   sphere_distance_cartesian(ctx, &n_cb, &n_ca) - M_PI;
+
+    /* Side of c from the a/b edge, as in edge_point_side */
+    geog2cart(ctx, &c, &pt);
+    w = dot_product(ctx, &n_ab, &pt);
+    side = FP_IS_ZERO(w) ? 0 : ( w < 0 ? -1 : 1 );
+
+    /* Co-linear points implies no area */
+    if ( side )
+      area += side * area_radians;
+
     b = c;
+    n_ab = n_ac;
+    n_ba = n_ca;
   }
 
   return fabs(area);
 }
 
+/*
+* Below this many edge pairs, lines are compared pair by pair, which
+* costs less than building their circle trees.
+*/
+#define RT_GEODETIC_TREE_MIN_PAIRS 1024
 
 static double ptarray_distance_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa1, const RTPOINTARRAY *pa2, const SPHEROID *s, double tolerance, int check_intersection)
 {
@@ -1857,6 +2143,17 @@ static double ptarray_distance_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa
 
   }
 
+  /* Long lines: search trees of edge circles instead of all edge pairs */
+  if ( (double)pa1->npoints * pa2->npoints > RT_GEODETIC_TREE_MIN_PAIRS )
+  {
+    CIRC_NODE *tree1 = circ_tree_new(ctx, pa1);
+    CIRC_NODE *tree2 = circ_tree_new(ctx, pa2);
+    distance = circ_tree_distance_tree(ctx, tree1, tree2, s, tolerance);
+    circ_tree_free(ctx, tree1);
+    circ_tree_free(ctx, tree2);
+    return distance;
+  }
+
   /* Initialize start of line 1 */
   p = rt_getPoint2d_cp(ctx, pa1, 0);
   geographic_point_init(ctx, p->x, p->y, &(e1.start));
@@ -2349,6 +2646,19 @@ int rtgeom_covers_rtgeom_sphere(const RTCTX *ctx, const RTGEOM *rtgeom1, const R
     rtgeom_calculate_gbox_geodetic(ctx, rtgeom2, &gbox2);
 
 
+  /* Many points against one polygon: build its ring trees once */
+  if ( type1 == RTPOLYGONTYPE && rttype_is_collection(ctx, type2) &&
+       ((RTCOLLECTION*)rtgeom2)->ngeoms > 1 )
+  {
+    RTPREPARED_GEODETIC *prep = rtgeom_prepare_geodetic(ctx, rtgeom1);
+    int covers;
+    if ( ! prep )
+      return RT_FALSE;
+    covers = rtprepared_geodetic_covers(ctx, prep, rtgeom2);
+    rtprepared_geodetic_free(ctx, prep);
+    return covers;
+  }
+
   /* Handle the polygon/point case */
   if ( type1 == RTPOLYGONTYPE && type2 == RTPOINTTYPE )
   {
@@ -2846,54 +3156,38 @@ int rtgeom_force_geodetic(const RTCTX *ctx, RTGEOM *geom)
 
 double ptarray_length_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa, const SPHEROID *s)
 {
-  GEOGRAPHIC_POINT a, b;
-  double za = 0.0, zb = 0.0;
-  RTPOINT4D p;
-  int i;
-  int hasz = RT_FALSE;
+  double *seglengths;
+  double za, zb;
+  int i, nsegs;
   double length = 0.0;
-  double seglength = 0.0;
 
   /* Return zero on non-sensical inputs */
   if ( ! pa || pa->npoints < 2 )
     return 0.0;
 
-  /* See if we have a third dimension */
-  hasz = RTFLAGS_GET_Z(pa->flags);
-
-  /* Initialize first point */
-  rt_getPoint4d_p(ctx, pa, 0, &p);
-  geographic_point_init(ctx, p.x, p.y, &a);
-  if ( hasz )
-    za = p.z;
+  /* Special sphere case, or the spheroid */
+  nsegs = pa->npoints - 1;
+  seglengths = rtalloc(ctx, sizeof(double) * nsegs);
+  ptarray_geodesic_segments(ctx, pa, s, s->a == s->b ? RTGEODESIC_FAST : RTGEODESIC_KARNEY, seglengths, NULL);
 
-  /* Loop and sum the length for each segment */
-  for ( i = 1; i < pa->npoints; i++ )
+  /* Add in the vertical displacement if we're in 3D */
+  if ( RTFLAGS_GET_Z(pa->flags) )
   {
-    seglength = 0.0;
-    rt_getPoint4d_p(ctx, pa, i, &p);
-    geographic_point_init(ctx, p.x, p.y, &b);
-    if ( hasz )
-      zb = p.z;
-
-    /* Special sphere case */
-    if ( s->a == s->b )
-      seglength = s->radius * sphere_distance(ctx, &a, &b);
-    /* Spheroid case */
-    else
-      seglength = spheroid_distance(ctx, &a, &b, s);
-
-    /* Add in the vertical displacement if we're in 3D */
-    if ( hasz )
-      seglength = sqrt( (zb-za)*(zb-za) + seglength*seglength );
-
-    /* Add this segment length to the total */
-    length += seglength;
-
-    /* B gets incremented in the next loop, so we save the value here */
-    a = b;
-    za = zb;
+    za = rt_getPoint3dz_cp(ctx, pa, 0)->z;
+    for ( i = 0; i < nsegs; i++ )
+    {
+      zb = rt_getPoint3dz_cp(ctx, pa, i + 1)->z;
+      length += sqrt( (zb-za)*(zb-za) + seglengths[i]*seglengths[i] );
+      za = zb;
+    }
   }
+  else
+  {
+    for ( i = 0; i < nsegs; i++ )
+      length += seglengths[i];
+  }
+
+  rtfree(ctx, seglengths);
   return length;
 }
 
@@ -3086,7 +3380,7 @@ point_in_cone(const RTCTX *ctx, const POINT3D *A1, const POINT3D *A2, const POIN
 /**
 * Utility function for ptarray_contains_point_sphere(ctx)
 */
-static int
+int
 point3d_equals(const RTCTX *ctx, const POINT3D *p1, const POINT3D *p2)
 {
   return FP_EQUALS(p1->x, p2->x) && FP_EQUALS(p1->y, p2->y) && FP_EQUALS(p1->z, p2->z);
@@ -0,0 +1,881 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ *
+ * Trees of bounding circles over the great circle edges of geodetic
+ * point arrays, and prepared geodetic geometries built on them for
+ * repeated distance, dwithin and covers probes.
+ *
+ **********************************************************************/
+
+
+#include "rttopo_config.h"
+#include <string.h>
+#include <float.h>
+
+/*#define RTGEOM_DEBUG_LEVEL 4*/
+#include "rtgeom_log.h"
+
+#include "librttopo_geom_internal.h"
+#include "rtgeodetic.h"
+#include "rtgeodetic_tree.h"
+
+
+static int circ_node_is_leaf(const CIRC_NODE *node)
+{
+  return node->num_nodes == 0;
+}
+
+static CIRC_NODE* circ_node_point_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  CIRC_NODE *node = rtalloc(ctx, sizeof(CIRC_NODE));
+  node->p1 = node->p2 = rt_getPoint2d_cp(ctx, pa, 0);
+  geographic_point_init(ctx, node->p1->x, node->p1->y, &(node->center));
+  node->radius = 0.0;
+  node->num_nodes = 0;
+  node->nodes = NULL;
+  return node;
+}
+
+/**
+* Leaf for the edge from point i to point i+1, centered on its mid
+* point. Zero length edges get no leaf, NULL is returned.
+*/
+static CIRC_NODE* circ_node_leaf_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i)
+{
+  const RTPOINT2D *p1 = rt_getPoint2d_cp(ctx, pa, i);
+  const RTPOINT2D *p2 = rt_getPoint2d_cp(ctx, pa, i + 1);
+  GEOGRAPHIC_POINT g1, g2;
+  POINT3D q1, q2, c;
+  CIRC_NODE *node;
+  double diameter;
+
+  ll2cart(ctx, p1, &q1);
+  ll2cart(ctx, p2, &q2);
+  if ( point3d_equals(ctx, &q1, &q2) )
+    return NULL;
+
+  geographic_point_init(ctx, p1->x, p1->y, &g1);
+  geographic_point_init(ctx, p2->x, p2->y, &g2);
+  diameter = sphere_distance(ctx, &g1, &g2);
+
+  node = rtalloc(ctx, sizeof(CIRC_NODE));
+  node->p1 = p1;
+  node->p2 = p2;
+  node->num_nodes = 0;
+  node->nodes = NULL;
+
+  vector_sum(ctx, &q1, &q2, &c);
+  if ( FP_IS_ZERO(c.x) && FP_IS_ZERO(c.y) && FP_IS_ZERO(c.z) )
+  {
+    /* Antipodal ends, no usable mid point */
+    node->center = g1;
+    node->radius = diameter;
+  }
+  else
+  {
+    normalize(ctx, &c);
+    cart2geog(ctx, &c, &(node->center));
+    node->radius = diameter / 2.0;
+  }
+  return node;
+}
+
+/**
+* Parent of num_nodes nodes. The center is their normalized mean
+* center, the radius the farthest reach of any of them from it.
+*/
+CIRC_NODE* circ_node_internal_new(const RTCTX *ctx, CIRC_NODE **c, int num_nodes)
+{
+  CIRC_NODE *node;
+  POINT3D sum, p;
+  double r;
+  int i;
+
+  node = rtalloc(ctx, sizeof(CIRC_NODE));
+  node->p1 = node->p2 = NULL;
+  node->num_nodes = num_nodes;
+  node->nodes = rtalloc(ctx, sizeof(CIRC_NODE*) * num_nodes);
+  memcpy(node->nodes, c, sizeof(CIRC_NODE*) * num_nodes);
+
+  sum.x = sum.y = sum.z = 0.0;
+  for ( i = 0; i < num_nodes; i++ )
+  {
+    geog2cart(ctx, &(c[i]->center), &p);
+    sum.x += p.x;
+    sum.y += p.y;
+    sum.z += p.z;
+  }
+  if ( FP_IS_ZERO(sum.x) && FP_IS_ZERO(sum.y) && FP_IS_ZERO(sum.z) )
+  {
+    node->center = c[0]->center;
+  }
+  else
+  {
+    normalize(ctx, &sum);
+    cart2geog(ctx, &sum, &(node->center));
+  }
+
+  node->radius = 0.0;
+  for ( i = 0; i < num_nodes; i++ )
+  {
+    r = sphere_distance(ctx, &(node->center), &(c[i]->center)) + c[i]->radius;
+    node->radius = FP_MAX(node->radius, r);
+  }
+  return node;
+}
+
+/**
+* Merge nodes into parents of CIRC_NODE_SIZE children, level by
+* level, until a single root is left. Overwrites the nodes array.
+*/
+static CIRC_NODE* circ_nodes_merge(const RTCTX *ctx, CIRC_NODE **nodes, int num_nodes)
+{
+  CIRC_NODE *inodes[CIRC_NODE_SIZE];
+  int i, j, num_parents;
+
+  while ( num_nodes > 1 )
+  {
+    num_parents = 0;
+    j = 0;
+    for ( i = 0; i < num_nodes; i++ )
+    {
+      inodes[j++] = nodes[i];
+      if ( j == CIRC_NODE_SIZE )
+      {
+        nodes[num_parents++] = circ_node_internal_new(ctx, inodes, j);
+        j = 0;
+      }
+    }
+    if ( j == 1 )
+      nodes[num_parents++] = inodes[0];
+    else if ( j > 1 )
+      nodes[num_parents++] = circ_node_internal_new(ctx, inodes, j);
+    num_nodes = num_parents;
+  }
+  return nodes[0];
+}
+
+/**
+* Build a tree over the edges of a lon/lat point array, which is
+* borrowed and must outlive the tree. Arrays with a single point, or
+* only zero length edges, get a single point leaf. Returns NULL for
+* empty arrays.
+*/
+CIRC_NODE* circ_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  CIRC_NODE **nodes;
+  CIRC_NODE *node, *tree;
+  int i, j = 0;
+
+  if ( ! pa || pa->npoints < 1 )
+    return NULL;
+  if ( pa->npoints == 1 )
+    return circ_node_point_new(ctx, pa);
+
+  nodes = rtalloc(ctx, sizeof(CIRC_NODE*) * (pa->npoints - 1));
+  for ( i = 0; i < pa->npoints - 1; i++ )
+  {
+    node = circ_node_leaf_new(ctx, pa, i);
+    if ( node )
+      nodes[j++] = node;
+  }
+
+  if ( j == 0 )
+    tree = circ_node_point_new(ctx, pa);
+  else
+    tree = circ_nodes_merge(ctx, nodes, j);
+
+  rtfree(ctx, nodes);
+  return tree;
+}
+
+void circ_tree_free(const RTCTX *ctx, CIRC_NODE *node)
+{
+  int i;
+
+  if ( ! node ) return;
+  for ( i = 0; i < node->num_nodes; i++ )
+    circ_tree_free(ctx, node->nodes[i]);
+  if ( node->nodes )
+    rtfree(ctx, node->nodes);
+  rtfree(ctx, node);
+}
+
+/**
+* Number of edges below node crossed by the stab line from S1 to S2,
+* counted as ptarray_contains_point_sphere does.
+*/
+static int circ_tree_crossings(const RTCTX *ctx, const CIRC_NODE *node, const GEOGRAPHIC_EDGE *stab, const POINT3D *S1, const POINT3D *S2, int *on_boundary)
+{
+  GEOGRAPHIC_POINT closest;
+  POINT3D E1, E2;
+  int i, inter, count = 0;
+
+  if ( *on_boundary )
+    return 0;
+
+  /* Stab line doesn't touch this circle, so it can't cross the edges inside */
+  if ( edge_distance_to_point(ctx, stab, &(node->center), &closest) > node->radius + FP_TOLERANCE )
+    return 0;
+
+  if ( ! circ_node_is_leaf(node) )
+  {
+    for ( i = 0; i < node->num_nodes; i++ )
+      count += circ_tree_crossings(ctx, node->nodes[i], stab, S1, S2, on_boundary);
+    return count;
+  }
+
+  if ( node->p1 == node->p2 )
+    return 0;
+
+  ll2cart(ctx, node->p1, &E1);
+  ll2cart(ctx, node->p2, &E2);
+
+  /* On an edge end */
+  if ( point3d_equals(ctx, S1, &E1) || point3d_equals(ctx, S1, &E2) )
+  {
+    *on_boundary = RT_TRUE;
+    return 0;
+  }
+
+  inter = edge_intersects(ctx, S1, S2, &E1, &E2);
+  if ( inter & PIR_INTERSECTS )
+  {
+    /* Stab line touching the edge means the point is on it */
+    if ( (inter & PIR_A_TOUCH_RIGHT) || (inter & PIR_A_TOUCH_LEFT) )
+    {
+      *on_boundary = RT_TRUE;
+      return 0;
+    }
+    /* Disregard right side touches and co-linear runs, to avoid double counts */
+    if ( ! ( (inter & PIR_B_TOUCH_RIGHT) || (inter & PIR_COLINEAR) ) )
+      return 1;
+  }
+  return 0;
+}
+
+/**
+* Is pt inside, or on the boundary of, the ring under node?
+* pt_outside must be guaranteed outside the ring (see gbox_pt_outside).
+* If on_boundary is not NULL it is set when pt lies on the ring.
+*/
+int circ_tree_contains_point(const RTCTX *ctx, const CIRC_NODE *node, const RTPOINT2D *pt, const RTPOINT2D *pt_outside, int *on_boundary)
+{
+  GEOGRAPHIC_EDGE stab;
+  POINT3D S1, S2;
+  int boundary = RT_FALSE;
+  int count;
+
+  geographic_point_init(ctx, pt->x, pt->y, &(stab.start));
+  geographic_point_init(ctx, pt_outside->x, pt_outside->y, &(stab.end));
+  ll2cart(ctx, pt, &S1);
+  ll2cart(ctx, pt_outside, &S2);
+
+  count = circ_tree_crossings(ctx, node, &stab, &S1, &S2, &boundary);
+
+  if ( on_boundary )
+    *on_boundary = boundary;
+  return boundary || (count % 2);
+}
+
+/**
+* Lowest distance on the unit sphere between anything under n1 and
+* anything under n2.
+*/
+static double circ_node_distance(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2)
+{
+  double d = sphere_distance(ctx, &(n1->center), &(n2->center)) - n1->radius - n2->radius - FP_TOLERANCE;
+  return d < 0.0 ? 0.0 : d;
+}
+
+/**
+* Distance on the unit sphere between two leaves, with their closest
+* points.
+*/
+static double circ_leaf_distance(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, GEOGRAPHIC_POINT *c1, GEOGRAPHIC_POINT *c2)
+{
+  GEOGRAPHIC_EDGE e1, e2;
+  POINT3D A1, A2, B1, B2;
+
+  geographic_point_init(ctx, n1->p1->x, n1->p1->y, &(e1.start));
+  geographic_point_init(ctx, n1->p2->x, n1->p2->y, &(e1.end));
+  geographic_point_init(ctx, n2->p1->x, n2->p1->y, &(e2.start));
+  geographic_point_init(ctx, n2->p2->x, n2->p2->y, &(e2.end));
+
+  if ( n1->p1 == n1->p2 && n2->p1 == n2->p2 )
+  {
+    *c1 = e1.start;
+    *c2 = e2.start;
+    return sphere_distance(ctx, &(e1.start), &(e2.start));
+  }
+  if ( n1->p1 == n1->p2 )
+  {
+    *c1 = e1.start;
+    return edge_distance_to_point(ctx, &e2, &(e1.start), c2);
+  }
+  if ( n2->p1 == n2->p2 )
+  {
+    *c2 = e2.start;
+    return edge_distance_to_point(ctx, &e1, &(e2.start), c1);
+  }
+
+  geog2cart(ctx, &(e1.start), &A1);
+  geog2cart(ctx, &(e1.end), &A2);
+  geog2cart(ctx, &(e2.start), &B1);
+  geog2cart(ctx, &(e2.end), &B2);
+  if ( edge_intersects(ctx, &A1, &A2, &B1, &B2) )
+  {
+    if ( ! edge_intersection(ctx, &e1, &e2, c1) )
+      *c1 = e1.start;
+    *c2 = *c1;
+    return 0.0;
+  }
+  return edge_distance_to_edge(ctx, &e1, &e2, c1, c2);
+}
+
+/**
+* A pair of nodes waiting in the search queue, keyed on the lowest
+* distance any two of their edges can have.
+*/
+typedef struct
+{
+  const CIRC_NODE *n1;
+  const CIRC_NODE *n2;
+  double d;
+} CIRC_PAIR;
+
+typedef struct
+{
+  CIRC_PAIR *pairs;
+  int npairs;
+  int maxpairs;
+  CIRC_PAIR *stack; /* initial storage, not to be freed */
+} CIRC_QUEUE;
+
+static void circ_queue_push(const RTCTX *ctx, CIRC_QUEUE *q, const CIRC_NODE *n1, const CIRC_NODE *n2, double d)
+{
+  int i, parent;
+
+  if ( q->npairs == q->maxpairs )
+  {
+    q->maxpairs *= 2;
+    if ( q->pairs == q->stack )
+    {
+      q->pairs = rtalloc(ctx, sizeof(CIRC_PAIR) * q->maxpairs);
+      memcpy(q->pairs, q->stack, sizeof(CIRC_PAIR) * q->npairs);
+    }
+    else
+    {
+      q->pairs = rtrealloc(ctx, q->pairs, sizeof(CIRC_PAIR) * q->maxpairs);
+    }
+  }
+
+  i = q->npairs++;
+  while ( i > 0 )
+  {
+    parent = (i - 1) / 2;
+    if ( q->pairs[parent].d <= d ) break;
+    q->pairs[i] = q->pairs[parent];
+    i = parent;
+  }
+  q->pairs[i].n1 = n1;
+  q->pairs[i].n2 = n2;
+  q->pairs[i].d = d;
+}
+
+static CIRC_PAIR circ_queue_pop(CIRC_QUEUE *q)
+{
+  CIRC_PAIR top = q->pairs[0];
+  CIRC_PAIR last = q->pairs[--q->npairs];
+  int i = 0, child;
+
+  while ( (child = 2 * i + 1) < q->npairs )
+  {
+    if ( child + 1 < q->npairs && q->pairs[child + 1].d < q->pairs[child].d )
+      child++;
+    if ( last.d <= q->pairs[child].d ) break;
+    q->pairs[i] = q->pairs[child];
+    i = child;
+  }
+  if ( q->npairs )
+    q->pairs[i] = last;
+  return top;
+}
+
+/**
+* Minimum distance on the unit sphere between the edges of two trees.
+* Only distances below *min_dist are considered; the best one found
+* goes to *min_dist and its ends to closest1 and closest2. Pairs are
+* searched closest circles first, and the search stops once *min_dist
+* is at or below threshold (radians).
+*/
+void circ_tree_distance_sphere(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, double threshold, double *min_dist, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2)
+{
+  CIRC_PAIR stack[64];
+  CIRC_QUEUE q;
+  CIRC_PAIR pair;
+  GEOGRAPHIC_POINT c1, c2;
+  const CIRC_NODE *split, *other;
+  double d;
+  int i;
+
+  q.pairs = q.stack = stack;
+  q.npairs = 0;
+  q.maxpairs = 64;
+
+  circ_queue_push(ctx, &q, n1, n2, circ_node_distance(ctx, n1, n2));
+
+  while ( q.npairs )
+  {
+    pair = circ_queue_pop(&q);
+
+    /* Nothing left in the queue can do better */
+    if ( pair.d >= *min_dist )
+      break;
+
+    if ( circ_node_is_leaf(pair.n1) && circ_node_is_leaf(pair.n2) )
+    {
+      d = circ_leaf_distance(ctx, pair.n1, pair.n2, &c1, &c2);
+      if ( d < *min_dist )
+      {
+        *min_dist = d;
+        *closest1 = c1;
+        *closest2 = c2;
+        if ( d <= threshold )
+          break;
+      }
+      continue;
+    }
+
+    /* Split the larger internal node */
+    if ( circ_node_is_leaf(pair.n1) ||
+         ( ! circ_node_is_leaf(pair.n2) && pair.n2->radius > pair.n1->radius ) )
+    {
+      split = pair.n2;
+      other = pair.n1;
+      for ( i = 0; i < split->num_nodes; i++ )
+      {
+        d = circ_node_distance(ctx, other, split->nodes[i]);
+        if ( d < *min_dist ) circ_queue_push(ctx, &q, other, split->nodes[i], d);
+      }
+    }
+    else
+    {
+      split = pair.n1;
+      other = pair.n2;
+      for ( i = 0; i < split->num_nodes; i++ )
+      {
+        d = circ_node_distance(ctx, split->nodes[i], other);
+        if ( d < *min_dist ) circ_queue_push(ctx, &q, split->nodes[i], other, d);
+      }
+    }
+  }
+
+  if ( q.pairs != q.stack )
+    rtfree(ctx, q.pairs);
+}
+
+/**
+* Distance between the sphere radians and the spheroid units of a
+* threshold, shrunk a little on the spheroid so that a sphere distance
+* just under it can't turn into a spheroid distance over it.
+*/
+static double circ_threshold_radians(const SPHEROID *spheroid, double threshold)
+{
+  if ( spheroid->a == spheroid->b )
+    return threshold / spheroid->radius;
+  return 0.95 * threshold / spheroid->radius;
+}
+
+/**
+* Final distance in spheroid units, from the closest points found on
+* the sphere.
+*/
+static double circ_spheroid_distance(const RTCTX *ctx, double min_dist, const GEOGRAPHIC_POINT *c1, const GEOGRAPHIC_POINT *c2, const SPHEROID *spheroid)
+{
+  if ( min_dist == 0.0 )
+    return 0.0;
+  if ( spheroid->a == spheroid->b )
+    return spheroid->radius * min_dist;
+  return spheroid_distance(ctx, c1, c2, spheroid);
+}
+
+/**
+* Distance between the edges of two trees on the spheroid, stopping
+* once a distance below threshold (spheroid units) is found.
+*/
+double circ_tree_distance_tree(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, const SPHEROID *spheroid, double threshold)
+{
+  double min_dist = FLT_MAX;
+  GEOGRAPHIC_POINT c1, c2;
+
+  circ_tree_distance_sphere(ctx, n1, n2, circ_threshold_radians(spheroid, threshold), &min_dist, &c1, &c2);
+  return circ_spheroid_distance(ctx, min_dist, &c1, &c2, spheroid);
+}
+
+
+/*
+* Prepared geodetic geometries
+*/
+
+/**
+* One point, line or polygon of a prepared geodetic geometry.
+*/
+typedef struct
+{
+  const RTGEOM *geom;
+  const RTPOINT2D *first; /* first point, for containment tests */
+  RTGBOX gbox;            /* polygons only */
+  RTPOINT2D pt_outside;   /* polygons only */
+  int nrings;
+  CIRC_NODE **rings;      /* one tree per ring, by ring number; NULL for empty rings */
+  CIRC_NODE *tree;        /* all the ring trees under one root */
+} RTGEODETIC_PART;
+
+struct RTPREPARED_GEODETIC_T
+{
+  const RTGEOM *geom;
+  int nparts;
+  int maxparts;
+  int nareas;
+  RTGEODETIC_PART *parts;
+};
+
+static int
+rtprepared_geodetic_add_ptarray(const RTCTX *ctx, const RTGEOM *geom, int index, const RTPOINTARRAY *pa, void *data)
+{
+  RTPREPARED_GEODETIC *prep = (RTPREPARED_GEODETIC*)data;
+  RTGEODETIC_PART *part;
+
+  if ( geom->type != RTPOINTTYPE && geom->type != RTLINETYPE && geom->type != RTPOLYGONTYPE )
+  {
+    rterror(ctx, "rtgeom_prepare_geodetic: unsupported geometry type: %s", rttype_name(ctx, geom->type));
+    return -1;
+  }
+
+  if ( index == 0 )
+  {
+    if ( prep->nparts == prep->maxparts )
+    {
+      prep->maxparts = prep->maxparts ? prep->maxparts * 2 : 4;
+      prep->parts = rtrealloc(ctx, prep->parts, sizeof(RTGEODETIC_PART) * prep->maxparts);
+    }
+    part = &(prep->parts[prep->nparts++]);
+    part->geom = geom;
+    part->first = pa->npoints ? rt_getPoint2d_cp(ctx, pa, 0) : NULL;
+    part->nrings = 0;
+    part->rings = rtalloc(ctx, sizeof(CIRC_NODE*) *
+      (geom->type == RTPOLYGONTYPE ? ((RTPOLY*)geom)->nrings : 1));
+    part->tree = NULL;
+  }
+  part = &(prep->parts[prep->nparts - 1]);
+  part->rings[part->nrings++] = circ_tree_new(ctx, pa);
+  return 0;
+}
+
+/**
+* Put the ring trees of a part under one root, and get the box and
+* outside point of polygons. Returns RT_FALSE for empty parts.
+*/
+static int
+rtprepared_geodetic_finish_part(const RTCTX *ctx, RTGEODETIC_PART *part)
+{
+  CIRC_NODE **nodes;
+  int i, n = 0;
+
+  if ( ! part->first || ! part->rings[0] )
+    return RT_FALSE;
+
+  nodes = rtalloc(ctx, sizeof(CIRC_NODE*) * part->nrings);
+  for ( i = 0; i < part->nrings; i++ )
+  {
+    if ( part->rings[i] )
+      nodes[n++] = part->rings[i];
+  }
+  if ( n == 1 )
+    part->tree = nodes[0];
+  else
+    part->tree = circ_node_internal_new(ctx, nodes, n);
+  rtfree(ctx, nodes);
+
+  if ( part->geom->type == RTPOLYGONTYPE )
+  {
+    if ( part->geom->bbox )
+      part->gbox = *(part->geom->bbox);
+    else
+      rtgeom_calculate_gbox_geodetic(ctx, part->geom, &(part->gbox));
+    gbox_pt_outside(ctx, &(part->gbox), &(part->pt_outside));
+  }
+  return RT_TRUE;
+}
+
+static void
+rtprepared_geodetic_free_part(const RTCTX *ctx, RTGEODETIC_PART *part)
+{
+  int i;
+
+  if ( part->tree )
+  {
+    /* Ring trees are the leaves, or all, of the part tree */
+    circ_tree_free(ctx, part->tree);
+  }
+  else
+  {
+    for ( i = 0; i < part->nrings; i++ )
+      circ_tree_free(ctx, part->rings[i]);
+  }
+  rtfree(ctx, part->rings);
+}
+
+RTPREPARED_GEODETIC *
+rtgeom_prepare_geodetic(const RTCTX *ctx, const RTGEOM *geom)
+{
+  RTPREPARED_GEODETIC *prep;
+  int i, n = 0;
+
+  prep = rtalloc(ctx, sizeof(RTPREPARED_GEODETIC));
+  prep->geom = geom;
+  prep->nparts = prep->maxparts = prep->nareas = 0;
+  prep->parts = NULL;
+
+  if ( rtgeom_visit_ptarrays(ctx, geom, rtprepared_geodetic_add_ptarray, prep) != 0 )
+  {
+    rtprepared_geodetic_free(ctx, prep);
+    return NULL;
+  }
+
+  /* Drop the empty parts */
+  for ( i = 0; i < prep->nparts; i++ )
+  {
+    if ( ! rtprepared_geodetic_finish_part(ctx, &(prep->parts[i])) )
+    {
+      rtprepared_geodetic_free_part(ctx, &(prep->parts[i]));
+      continue;
+    }
+    if ( prep->parts[i].geom->type == RTPOLYGONTYPE )
+      prep->nareas++;
+    prep->parts[n++] = prep->parts[i];
+  }
+  prep->nparts = n;
+
+  return prep;
+}
+
+void
+rtprepared_geodetic_free(const RTCTX *ctx, RTPREPARED_GEODETIC *prep)
+{
+  int i;
+
+  if ( ! prep ) return;
+  for ( i = 0; i < prep->nparts; i++ )
+    rtprepared_geodetic_free_part(ctx, &(prep->parts[i]));
+  if ( prep->parts )
+    rtfree(ctx, prep->parts);
+  rtfree(ctx, prep);
+}
+
+/**
+* Same answer as rtpoly_covers_point2d, for a polygon part.
+*/
+static int
+rtgeodetic_part_covers_point(const RTCTX *ctx, const RTGEODETIC_PART *part, const RTPOINT2D *pt)
+{
+  const RTPOLY *poly = (const RTPOLY*)(part->geom);
+  GEOGRAPHIC_POINT g;
+  POINT3D p;
+  int i, in_hole_count = 0;
+
+  if ( part->geom->type != RTPOLYGONTYPE )
+    return RT_FALSE;
+
+  geographic_point_init(ctx, pt->x, pt->y, &g);
+  geog2cart(ctx, &g, &p);
+  if ( ! gbox_contains_point3d(ctx, &(part->gbox), &p) )
+    return RT_FALSE;
+
+  if ( poly->rings[0]->npoints < 4 ||
+       ! circ_tree_contains_point(ctx, part->rings[0], pt, &(part->pt_outside), NULL) )
+    return RT_FALSE;
+
+  for ( i = 1; i < part->nrings; i++ )
+  {
+    if ( part->rings[i] && poly->rings[i]->npoints >= 4 &&
+         circ_tree_contains_point(ctx, part->rings[i], pt, &(part->pt_outside), NULL) )
+      in_hole_count++;
+  }
+  return in_hole_count % 2 ? RT_FALSE : RT_TRUE;
+}
+
+/**
+* Distance between two prepared geometries, following the rules of
+* rtgeom_distance_spheroid: zero when a polygon covers the first point
+* of another part, otherwise the distance between their edges.
+*/
+static double
+rtgeodetic_distance(const RTCTX *ctx, const RTPREPARED_GEODETIC *a, const RTPREPARED_GEODETIC *b, const SPHEROID *spheroid, double tolerance)
+{
+  GEOGRAPHIC_POINT c1, c2;
+  double threshold = circ_threshold_radians(spheroid, tolerance);
+  double min_dist = FLT_MAX;
+  int i, j;
+
+  if ( ! a->nparts || ! b->nparts )
+    return -1.0;
+
+  if ( a->nareas || b->nareas )
+  {
+    for ( i = 0; i < a->nparts; i++ )
+    {
+      for ( j = 0; j < b->nparts; j++ )
+      {
+        if ( rtgeodetic_part_covers_point(ctx, &(a->parts[i]), b->parts[j].first) ||
+             rtgeodetic_part_covers_point(ctx, &(b->parts[j]), a->parts[i].first) )
+          return 0.0;
+      }
+    }
+  }
+
+  for ( i = 0; i < a->nparts; i++ )
+  {
+    for ( j = 0; j < b->nparts; j++ )
+    {
+      circ_tree_distance_sphere(ctx, a->parts[i].tree, b->parts[j].tree, threshold, &min_dist, &c1, &c2);
+      if ( min_dist <= threshold )
+        return circ_spheroid_distance(ctx, min_dist, &c1, &c2, spheroid);
+    }
+  }
+  return circ_spheroid_distance(ctx, min_dist, &c1, &c2, spheroid);
+}
+
+double
+rtprepared_geodetic_distance(const RTCTX *ctx, const RTPREPARED_GEODETIC *prep, const RTGEOM *probe, const SPHEROID *spheroid, double tolerance)
+{
+  RTPREPARED_GEODETIC *pprobe;
+  double d;
+
+  if ( ! probe || rtgeom_is_empty(ctx, probe) )
+    return -1.0;
+
+  /* Single points, the common probe, are wrapped on the stack */
+  if ( probe->type == RTPOINTTYPE )
+  {
+    RTPREPARED_GEODETIC pt_prep;
+    RTGEODETIC_PART pt_part;
+    CIRC_NODE pt_node;
+
+    pt_node.p1 = pt_node.p2 = rt_getPoint2d_cp(ctx, ((RTPOINT*)probe)->point, 0);
+    geographic_point_init(ctx, pt_node.p1->x, pt_node.p1->y, &(pt_node.center));
+    pt_node.radius = 0.0;
+    pt_node.num_nodes = 0;
+    pt_node.nodes = NULL;
+
+    pt_part.geom = probe;
+    pt_part.first = pt_node.p1;
+    pt_part.nrings = 0;
+    pt_part.rings = NULL;
+    pt_part.tree = &pt_node;
+
+    pt_prep.geom = probe;
+    pt_prep.nparts = pt_prep.maxparts = 1;
+    pt_prep.nareas = 0;
+    pt_prep.parts = &pt_part;
+
+    return rtgeodetic_distance(ctx, prep, &pt_prep, spheroid, tolerance);
+  }
+
+  pprobe = rtgeom_prepare_geodetic(ctx, probe);
+  if ( ! pprobe )
+    return -1.0;
+  d = rtgeodetic_distance(ctx, prep, pprobe, spheroid, tolerance);
+  rtprepared_geodetic_free(ctx, pprobe);
+  return d;
+}
+
+int
+rtprepared_geodetic_dwithin(const RTCTX *ctx, const RTPREPARED_GEODETIC *prep, const RTGEOM *probe, const SPHEROID *spheroid, double distance)
+{
+  double d;
+
+  if ( distance < 0.0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero\n");
+    return RT_FALSE;
+  }
+  d = rtprepared_geodetic_distance(ctx, prep, probe, spheroid, distance);
+  return d >= 0.0 && d <= distance;
+}
+
+/**
+* Is pt on the edges, or one of the points, of a line or point part?
+*/
+static int
+rtgeodetic_part_touches_point(const RTCTX *ctx, const RTGEODETIC_PART *part, const RTPOINT2D *pt)
+{
+  GEOGRAPHIC_POINT c1, c2;
+  CIRC_NODE pt_node;
+  double min_dist = FLT_MAX;
+
+  pt_node.p1 = pt_node.p2 = pt;
+  geographic_point_init(ctx, pt->x, pt->y, &(pt_node.center));
+  pt_node.radius = 0.0;
+  pt_node.num_nodes = 0;
+  pt_node.nodes = NULL;
+
+  circ_tree_distance_sphere(ctx, part->tree, &pt_node, FP_TOLERANCE, &min_dist, &c1, &c2);
+  return min_dist <= FP_TOLERANCE;
+}
+
+static int
+rtprepared_geodetic_covers_ptarray(const RTCTX *ctx, const RTGEOM *geom, int index, const RTPOINTARRAY *pa, void *data)
+{
+  const RTPREPARED_GEODETIC *prep = (const RTPREPARED_GEODETIC*)data;
+  const RTPOINT2D *pt;
+  int i;
+
+  if ( geom->type != RTPOINTTYPE )
+  {
+    rterror(ctx, "rtprepared_geodetic_covers: only POINT probes are currently supported");
+    return -1;
+  }
+  if ( ! pa->npoints )
+    return 0;
+
+  pt = rt_getPoint2d_cp(ctx, pa, 0);
+  for ( i = 0; i < prep->nparts; i++ )
+  {
+    const RTGEODETIC_PART *part = &(prep->parts[i]);
+    if ( part->geom->type == RTPOLYGONTYPE ?
+         rtgeodetic_part_covers_point(ctx, part, pt) :
+         rtgeodetic_part_touches_point(ctx, part, pt) )
+      return 0;
+  }
+  /* Not covered, stop here */
+  return 1;
+}
+
+int
+rtprepared_geodetic_covers(const RTCTX *ctx, const RTPREPARED_GEODETIC *prep, const RTGEOM *probe)
+{
+  /* Nothing covers an empty probe, as with rtprepared_covers */
+  if ( rtgeom_is_empty(ctx, probe) )
+    return RT_FALSE;
+
+  return rtgeom_visit_ptarrays(ctx, probe, rtprepared_geodetic_covers_ptarray, (void*)prep) == 0;
+}
@@ -0,0 +1,50 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#ifndef _RTGEODETIC_TREE_H
+#define _RTGEODETIC_TREE_H 1
+
+#include "rtgeodetic.h"
+
+#define CIRC_NODE_SIZE 8
+
+/**
+* Node of a tree of circles (spherical caps) on the unit sphere, each
+* enclosing the great circle edges below it. Leaves hold one edge of
+* a point array, from p1 to p2, or a single point (p1 == p2).
+*/
+typedef struct circ_node
+{
+  GEOGRAPHIC_POINT center;
+  double radius; /* angular, in radians */
+  int num_nodes;
+  struct circ_node **nodes;
+  const RTPOINT2D *p1;
+  const RTPOINT2D *p2;
+} CIRC_NODE;
+
+CIRC_NODE* circ_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa);
+CIRC_NODE* circ_node_internal_new(const RTCTX *ctx, CIRC_NODE **c, int num_nodes);
+void circ_tree_free(const RTCTX *ctx, CIRC_NODE *node);
+int circ_tree_contains_point(const RTCTX *ctx, const CIRC_NODE *node, const RTPOINT2D *pt, const RTPOINT2D *pt_outside, int *on_boundary);
+void circ_tree_distance_sphere(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, double threshold, double *min_dist, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2);
+double circ_tree_distance_tree(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, const SPHEROID *spheroid, double threshold);
+
+#endif /* !defined _RTGEODETIC_TREE_H */
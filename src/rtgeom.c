@@ -442,7 +442,8 @@ rtgeom_clone(const RTCTX *ctx, const RTGEOM *rtgeom)
 }
 
 /**
-* Deep-clone an #RTGEOM object. #RTPOINTARRAY <em>are</em> copied.
+* Deep-clone an #RTGEOM object. #RTPOINTARRAY <em>are</em> copied,
+* lazily (see ptarray_clone_deep).
 */
 RTGEOM *
 rtgeom_clone_deep(const RTCTX *ctx, const RTGEOM *rtgeom)
@@ -608,7 +609,8 @@ rtgeom_drop_bbox(const RTCTX *ctx, RTGEOM *rtgeom)
 /**
  * Ensure there's a box in the RTGEOM.
  * If the box is already there just return,
- * else compute it.
+ * else compute it. With the deep caching policy
+ * sub-geometries get their own box too.
  */
 void
 rtgeom_add_bbox(const RTCTX *ctx, RTGEOM *rtgeom)
@@ -616,10 +618,21 @@ rtgeom_add_bbox(const RTCTX *ctx, RTGEOM *rtgeom)
   /* an empty RTGEOM has no bbox */
   if ( rtgeom_is_empty(ctx, rtgeom) ) return;
 
-  if ( rtgeom->bbox ) return;
-  RTFLAGS_SET_BBOX(rtgeom->flags, 1);
-  rtgeom->bbox = gbox_new(ctx, rtgeom->flags);
-  rtgeom_calculate_gbox(ctx, rtgeom, rtgeom->bbox);
+  if ( ! rtgeom->bbox )
+  {
+    RTFLAGS_SET_BBOX(rtgeom->flags, 1);
+    rtgeom->bbox = gbox_new(ctx, rtgeom->flags);
+    rtgeom_calculate_gbox(ctx, rtgeom, rtgeom->bbox);
+  }
+
+  if ( ctx->bbox_cache == RTBBOX_CACHE_DEEP && rtgeom_is_collection(ctx, rtgeom) )
+  {
+    int i;
+    RTCOLLECTION *rtcol = (RTCOLLECTION*)rtgeom;
+
+    for ( i = 0; i < rtcol->ngeoms; i++ )
+      rtgeom_add_bbox(ctx, rtcol->geoms[i]);
+  }
 }
 
 void
@@ -659,6 +672,53 @@ rtgeom_get_bbox(const RTCTX *ctx, const RTGEOM *rtg)
   return rtg->bbox;
 }
 
+int
+rtgeom_get_bbox_p(const RTCTX *ctx, const RTGEOM *rtgeom, RTGBOX *gbox)
+{
+  if ( rtgeom_is_empty(ctx, rtgeom) ) return RT_FAILURE;
+
+  if ( rtgeom->bbox )
+  {
+    memcpy(gbox, rtgeom->bbox, sizeof(RTGBOX));
+    return RT_SUCCESS;
+  }
+
+  return rtgeom_calculate_gbox(ctx, rtgeom, gbox);
+}
+
+/**
+ * Recompute the box of this geometry only, reusing its storage.
+ * Used by mutators that already recurse into sub-geometries.
+ */
+static void
+rtgeom_update_bbox(const RTCTX *ctx, RTGEOM *rtgeom)
+{
+  if ( ! rtgeom->bbox ) return;
+
+  if ( rtgeom_is_empty(ctx, rtgeom) )
+  {
+    rtgeom_drop_bbox(ctx, rtgeom);
+    return;
+  }
+
+  rtgeom_calculate_gbox(ctx, rtgeom, rtgeom->bbox);
+}
+
+void
+rtgeom_refresh_bbox(const RTCTX *ctx, RTGEOM *rtgeom)
+{
+  if ( rtgeom_is_collection(ctx, rtgeom) )
+  {
+    int i;
+    RTCOLLECTION *rtcol = (RTCOLLECTION*)rtgeom;
+
+    for ( i = 0; i < rtcol->ngeoms; i++ )
+      rtgeom_refresh_bbox(ctx, rtcol->geoms[i]);
+  }
+
+  rtgeom_update_bbox(ctx, rtgeom);
+}
+
 
 /**
 * Calculate the gbox for this goemetry, a cartesian box or
@@ -928,20 +988,20 @@ rtgeom_longitude_shift(const RTCTX *ctx, RTGEOM *rtgeom)
   case RTPOINTTYPE:
     point = (RTPOINT *)rtgeom;
     ptarray_longitude_shift(ctx, point->point);
-    return;
+    break;
   case RTLINETYPE:
     line = (RTLINE *)rtgeom;
     ptarray_longitude_shift(ctx, line->points);
-    return;
+    break;
   case RTPOLYGONTYPE:
     poly = (RTPOLY *)rtgeom;
     for (i=0; i<poly->nrings; i++)
       ptarray_longitude_shift(ctx, poly->rings[i]);
-    return;
+    break;
   case RTTRIANGLETYPE:
     triangle = (RTTRIANGLE *)rtgeom;
     ptarray_longitude_shift(ctx, triangle->points);
-    return;
+    break;
   case RTMULTIPOINTTYPE:
   case RTMULTILINETYPE:
   case RTMULTIPOLYGONTYPE:
@@ -951,11 +1011,14 @@ rtgeom_longitude_shift(const RTCTX *ctx, RTGEOM *rtgeom)
     coll = (RTCOLLECTION *)rtgeom;
     for (i=0; i<coll->ngeoms; i++)
       rtgeom_longitude_shift(ctx, coll->geoms[i]);
-    return;
+    break;
   default:
     rterror(ctx, "rtgeom_longitude_shift: unsupported geom type: %s",
             rttype_name(ctx, rtgeom->type));
+    return;
   }
+
+  rtgeom_update_bbox(ctx, rtgeom);
 }
 
 int
@@ -1152,6 +1215,13 @@ int rtgeom_needs_bbox(const RTCTX *ctx, const RTGEOM *geom)
 /**
 * Count points in an #RTGEOM.
 */
+static int
+rtgeom_count_vertices_visitor(const RTCTX *ctx, const RTGEOM *geom, int index, const RTPOINTARRAY *pa, void *data)
+{
+  *((int*)data) += pa->npoints;
+  return 0;
+}
+
 int rtgeom_count_vertices(const RTCTX *ctx, const RTGEOM *geom)
 {
   int result = 0;
@@ -1162,39 +1232,8 @@ int rtgeom_count_vertices(const RTCTX *ctx, const RTGEOM *geom)
   RTDEBUGF(ctx, 4, "rtgeom_count_vertices got type %s",
            rttype_name(ctx, geom->type));
 
-  /* Empty? Zero. */
-  if( rtgeom_is_empty(ctx, geom) ) return 0;
+  rtgeom_visit_ptarrays(ctx, geom, rtgeom_count_vertices_visitor, &result);
 
-  switch (geom->type)
-  {
-  case RTPOINTTYPE:
-    result = 1;
-    break;
-  case RTTRIANGLETYPE:
-  case RTCIRCSTRINGTYPE:
-  case RTLINETYPE:
-    result = rtline_count_vertices(ctx, (RTLINE *)geom);
-    break;
-  case RTPOLYGONTYPE:
-    result = rtpoly_count_vertices(ctx, (RTPOLY *)geom);
-    break;
-  case RTCOMPOUNDTYPE:
-  case RTCURVEPOLYTYPE:
-  case RTMULTICURVETYPE:
-  case RTMULTISURFACETYPE:
-  case RTMULTIPOINTTYPE:
-  case RTMULTILINETYPE:
-  case RTMULTIPOLYGONTYPE:
-  case RTPOLYHEDRALSURFACETYPE:
-  case RTTINTYPE:
-  case RTCOLLECTIONTYPE:
-    result = rtcollection_count_vertices(ctx, (RTCOLLECTION *)geom);
-    break;
-  default:
-    rterror(ctx, "%s: unsupported input geometry type: %s",
-            __func__, rttype_name(ctx, geom->type));
-    break;
-  }
   RTDEBUGF(ctx, 3, "counted %d vertices", result);
   return result;
 }
@@ -1544,11 +1583,8 @@ void rtgeom_swap_ordinates(const RTCTX *ctx, RTGEOM *in, RTORD o1, RTORD o2)
   }
 
   /* only refresh bbox if X or Y changed */
-  if ( in->bbox && (o1 < 2 || o2 < 2) )
-  {
-    rtgeom_drop_bbox(ctx, in);
-    rtgeom_add_bbox(ctx, in);
-  }
+  if ( o1 < 2 || o2 < 2 )
+    rtgeom_update_bbox(ctx, in);
 }
 
 void rtgeom_set_srid(const RTCTX *ctx, RTGEOM *geom, int32_t srid)
@@ -1751,6 +1787,7 @@ rtgeom_affine(const RTCTX *ctx, RTGEOM *geom, const RTAFFINE *affine)
     }
   }
 
+  rtgeom_update_bbox(ctx, geom);
 }
 
 void
@@ -1839,6 +1876,10 @@ rtgeom_construct_empty(const RTCTX *ctx, uint8_t type, int srid, char hasz, char
     case RTMULTIPOINTTYPE:
     case RTMULTILINETYPE:
     case RTMULTIPOLYGONTYPE:
+    case RTMULTICURVETYPE:
+    case RTMULTISURFACETYPE:
+    case RTPOLYHEDRALSURFACETYPE:
+    case RTTINTYPE:
     case RTCOLLECTIONTYPE:
       return rtcollection_as_rtgeom(ctx, rtcollection_construct_empty(ctx, type, srid, hasz, hasm));
     default:
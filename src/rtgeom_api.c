@@ -553,6 +553,7 @@ ptarray_set_point4d(const RTCTX *ctx, RTPOINTARRAY *pa, int n, const RTPOINT4D *
 {
   uint8_t *ptr;
   assert(n >= 0 && n < pa->npoints);
+  ptarray_unshare(ctx, pa);
   ptr=rt_getPoint_internal(ctx, pa, n);
   switch ( RTFLAGS_GET_ZM(pa->flags) )
   {
@@ -1385,6 +1385,62 @@ rtgeom_is_simple(const RTCTX *ctx, const RTGEOM *geom)
   return simple ? 1 : 0;
 }
 
+/*
+* GEOS backed binary predicates, used by the native ones in
+* rtpredicate.c and rtprepared.c for the cases they can't settle.
+* Expressed as DE-9IM patterns, which every GEOS version can match.
+*/
+static int
+rtgeom_geos_relate_pattern(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2, const char *pattern)
+{
+  GEOSGeometry *g1, *g2;
+  char result;
+
+  if ( rtgeom_is_empty(ctx, geom1) || rtgeom_is_empty(ctx, geom2) )
+    return RT_FALSE;
+
+  rtgeom_geos_ensure_init(ctx);
+
+  g1 = RTGEOM2GEOS(ctx, geom1, 0);
+  if ( 0 == g1 )   /* exception thrown at construction */
+  {
+    rterror(ctx, "First argument geometry could not be converted to GEOS: %s", rtgeom_get_last_geos_error(ctx));
+    return -1;
+  }
+  g2 = RTGEOM2GEOS(ctx, geom2, 0);
+  if ( 0 == g2 )   /* exception thrown at construction */
+  {
+    rterror(ctx, "Second argument geometry could not be converted to GEOS: %s", rtgeom_get_last_geos_error(ctx));
+    GEOSGeom_destroy_r(ctx->gctx, g1);
+    return -1;
+  }
+
+  result = GEOSRelatePattern_r(ctx->gctx, g1, g2, pattern);
+  GEOSGeom_destroy_r(ctx->gctx, g1);
+  GEOSGeom_destroy_r(ctx->gctx, g2);
+
+  if ( result == 2 ) /* exception thrown */
+  {
+    rterror(ctx, "GEOSRelatePattern: %s", rtgeom_get_last_geos_error(ctx));
+    return -1;
+  }
+
+  return result ? RT_TRUE : RT_FALSE;
+}
+
+int
+rtgeom_contains_geos(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2)
+{
+  return rtgeom_geos_relate_pattern(ctx, geom1, geom2, "T*****FF*");
+}
+
+int
+rtgeom_covers_geos(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2)
+{
+  /* Non-empty and nothing of geom2 outside geom1 */
+  return rtgeom_geos_relate_pattern(ctx, geom1, geom2, "******FF*");
+}
+
 /* ------------ end of BuildArea stuff ---------------------------------------------------------------------} */
 
 RTGEOM*
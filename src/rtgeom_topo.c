@@ -634,7 +634,7 @@ _rtt_CheckEdgeCrossing( RTT_TOPOLOGY* topo,
   int i, num_nodes, num_edges;
   RTT_ISO_EDGE *edges;
   RTT_ISO_NODE *nodes;
-  const RTGBOX *edgebox;
+  RTGBOX edgebox;
   GEOSGeometry *edgegg;
   const GEOSPreparedGeometry* prepared_edge;
   const RTT_BE_IFACE *iface = topo->be_iface;
@@ -651,10 +651,15 @@ _rtt_CheckEdgeCrossing( RTT_TOPOLOGY* topo,
     rterror(iface->ctx, "Could not prepare edge geometry: %s", rtgeom_get_last_geos_error(iface->ctx));
     return -1;
   }
-  edgebox = rtgeom_get_bbox(iface->ctx,  rtline_as_rtgeom(iface->ctx, geom) );
+  if ( rtgeom_get_bbox_p(iface->ctx, rtline_as_rtgeom(iface->ctx, geom), &edgebox) != RT_SUCCESS ) {
+    GEOSPreparedGeom_destroy_r(iface->ctx->gctx, prepared_edge);
+    GEOSGeom_destroy_r(iface->ctx->gctx, edgegg);
+    rterror(iface->ctx, "Could not compute box of empty edge geometry");
+    return -1;
+  }
 
   /* loop over each node within the edge's gbox */
-  nodes = rtt_be_getNodeWithinBox2D( topo, edgebox, &num_nodes,
+  nodes = rtt_be_getNodeWithinBox2D( topo, &edgebox, &num_nodes,
                                             RTT_COL_NODE_ALL, 0 );
   RTDEBUGF(iface->ctx, 1, "rtt_be_getNodeWithinBox2D returned %d nodes", num_nodes);
   if ( num_nodes == -1 ) {
@@ -696,7 +701,7 @@ _rtt_CheckEdgeCrossing( RTT_TOPOLOGY* topo,
                /* may be NULL if num_nodes == 0 */
 
   /* loop over each edge within the edge's gbox */
-  edges = rtt_be_getEdgeWithinBox2D( topo, edgebox, &num_edges, RTT_COL_EDGE_ALL, 0 );
+  edges = rtt_be_getEdgeWithinBox2D( topo, &edgebox, &num_edges, RTT_COL_EDGE_ALL, 0 );
   RTDEBUGF(iface->ctx, 1, "rtt_be_getEdgeWithinBox2D returned %d edges", num_edges);
   if ( num_edges == -1 ) {
     GEOSPreparedGeom_destroy_r(iface->ctx->gctx, prepared_edge);
@@ -1947,7 +1952,15 @@ _rtt_AddFaceSplit( RTT_TOPOLOGY* topo,
   int isccw = ptarray_isccw(iface->ctx, pa);
   RTDEBUGF(iface->ctx, 1, "Ring of edge %" RTTFMT_ELEMID " is %sclockwise",
               sedge, isccw ? "counter" : "");
-  const RTGBOX* shellbox = rtgeom_get_bbox(iface->ctx, rtpoly_as_rtgeom(iface->ctx, shell));
+  RTGBOX shellbox;
+  if ( rtgeom_get_bbox_p(iface->ctx, rtpoly_as_rtgeom(iface->ctx, shell), &shellbox) != RT_SUCCESS )
+  {
+    rtfree(iface->ctx,  signed_edge_ids );
+    rtt_release_edges(iface->ctx, ring_edges, numedges);
+    rtpoly_free(iface->ctx, shell);
+    rterror(iface->ctx, "Could not compute box of empty ring of edge %" RTTFMT_ELEMID, sedge);
+    return -2;
+  }
 
   if ( face == 0 )
   {
@@ -1972,13 +1985,13 @@ _rtt_AddFaceSplit( RTT_TOPOLOGY* topo,
     {{
       RTT_ISO_FACE updface;
       updface.face_id = face;
-      updface.mbr = (RTGBOX *)shellbox; /* const cast, we won't free it, later */
+      updface.mbr = &shellbox;
       int ret = rtt_be_updateFacesById( topo, &updface, 1 );
       if ( ret == -1 )
       {
         rtfree(iface->ctx,  signed_edge_ids );
         rtt_release_edges(iface->ctx, ring_edges, numedges);
-        rtpoly_free(iface->ctx, shell); /* NOTE: owns shellbox above */
+        rtpoly_free(iface->ctx, shell);
         rterror(iface->ctx, "Backend error: %s", rtt_be_lastErrorMessage(topo->be_iface));
         return -2;
       }
@@ -1986,14 +1999,14 @@ _rtt_AddFaceSplit( RTT_TOPOLOGY* topo,
       {
         rtfree(iface->ctx,  signed_edge_ids );
         rtt_release_edges(iface->ctx, ring_edges, numedges);
-        rtpoly_free(iface->ctx, shell); /* NOTE: owns shellbox above */
+        rtpoly_free(iface->ctx, shell);
         rterror(iface->ctx, "Unexpected error: %d faces found when expecting 1", ret);
         return -2;
       }
     }}
     rtfree(iface->ctx,  signed_edge_ids );
     rtt_release_edges(iface->ctx, ring_edges, numedges);
-    rtpoly_free(iface->ctx, shell); /* NOTE: owns shellbox above */
+    rtpoly_free(iface->ctx, shell);
     return -1; /* mbr only was requested */
   }
 
@@ -2008,7 +2021,7 @@ _rtt_AddFaceSplit( RTT_TOPOLOGY* topo,
     if ( nfaces == -1 )
     {
       rtfree(iface->ctx,  signed_edge_ids );
-      rtpoly_free(iface->ctx, shell); /* NOTE: owns shellbox */
+      rtpoly_free(iface->ctx, shell);
       rtt_release_edges(iface->ctx, ring_edges, numedges);
       rterror(iface->ctx, "Backend error: %s", rtt_be_lastErrorMessage(topo->be_iface));
       return -2;
@@ -2016,7 +2029,7 @@ _rtt_AddFaceSplit( RTT_TOPOLOGY* topo,
     if ( nfaces != 1 )
     {
       rtfree(iface->ctx,  signed_edge_ids );
-      rtpoly_free(iface->ctx, shell); /* NOTE: owns shellbox */
+      rtpoly_free(iface->ctx, shell);
       rtt_release_edges(iface->ctx, ring_edges, numedges);
       rterror(iface->ctx, "Unexpected error: %d faces found when expecting 1", nfaces);
       return -2;
@@ -2025,7 +2038,7 @@ _rtt_AddFaceSplit( RTT_TOPOLOGY* topo,
   }}
   else
   {
-    newface.mbr = (RTGBOX *)shellbox; /* const cast, we won't free it, later */
+    newface.mbr = &shellbox;
   }
 
   /* Insert the new face */
@@ -2033,7 +2046,7 @@ _rtt_AddFaceSplit( RTT_TOPOLOGY* topo,
   if ( ret == -1 )
   {
     rtfree(iface->ctx,  signed_edge_ids );
-    rtpoly_free(iface->ctx, shell); /* NOTE: owns shellbox */
+    rtpoly_free(iface->ctx, shell);
     rtt_release_edges(iface->ctx, ring_edges, numedges);
     rterror(iface->ctx, "Backend error: %s", rtt_be_lastErrorMessage(topo->be_iface));
     return -2;
@@ -2041,7 +2054,7 @@ _rtt_AddFaceSplit( RTT_TOPOLOGY* topo,
   if ( ret != 1 )
   {
     rtfree(iface->ctx,  signed_edge_ids );
-    rtpoly_free(iface->ctx, shell); /* NOTE: owns shellbox */
+    rtpoly_free(iface->ctx, shell);
     rtt_release_edges(iface->ctx, ring_edges, numedges);
     rterror(iface->ctx, "Unexpected error: %d faces inserted when expecting 1", ret);
     return -2;
@@ -5047,16 +5060,15 @@ rtt_GetFaceByPoint(RTT_TOPOLOGY *topo, RTPOINT *pt, double tol)
 static double
 _rtt_minTolerance(const RTCTX *ctx,  RTGEOM *g )
 {
-  const RTGBOX* gbox;
+  RTGBOX gbox;
   double max;
   double ret;
 
-  gbox = rtgeom_get_bbox(ctx, g);
-  if ( ! gbox ) return 0; /* empty */
-  max = FP_ABS(gbox->xmin);
-  if ( max < FP_ABS(gbox->xmax) ) max = FP_ABS(gbox->xmax);
-  if ( max < FP_ABS(gbox->ymin) ) max = FP_ABS(gbox->ymin);
-  if ( max < FP_ABS(gbox->ymax) ) max = FP_ABS(gbox->ymax);
+  if ( rtgeom_get_bbox_p(ctx, g, &gbox) != RT_SUCCESS ) return 0; /* empty */
+  max = FP_ABS(gbox.xmin);
+  if ( max < FP_ABS(gbox.xmax) ) max = FP_ABS(gbox.xmax);
+  if ( max < FP_ABS(gbox.ymin) ) max = FP_ABS(gbox.ymin);
+  if ( max < FP_ABS(gbox.ymax) ) max = FP_ABS(gbox.ymax);
 
   ret = 3.6 * pow(10,  - ( 15 - log10(max?max:1.0) ) );
 
@@ -5440,11 +5452,14 @@ _rtt_GetEqualEdge( RTT_TOPOLOGY *topo, RTLINE *edge )
   RTT_ELEMID id;
   RTT_ISO_EDGE *edges;
   int num, i;
-  const RTGBOX *qbox = rtgeom_get_bbox(iface->ctx,  rtline_as_rtgeom(iface->ctx, edge) );
+  RTGBOX qbox;
   GEOSGeometry *edgeg;
   const int flds = RTT_COL_EDGE_EDGE_ID|RTT_COL_EDGE_GEOM;
 
-  edges = rtt_be_getEdgeWithinBox2D( topo, qbox, &num, flds, 0 );
+  /* An empty edge has no equal */
+  if ( rtgeom_get_bbox_p(iface->ctx, rtline_as_rtgeom(iface->ctx, edge), &qbox) != RT_SUCCESS )
+    return 0;
+  edges = rtt_be_getEdgeWithinBox2D( topo, &qbox, &num, flds, 0 );
   if ( num == -1 )
   {
     rterror(iface->ctx, "Backend error: %s", rtt_be_lastErrorMessage(topo->be_iface));
@@ -5748,7 +5763,13 @@ _rtt_AddLine(RTT_TOPOLOGY* topo, RTLINE* line, double tol, int* nedges,
   if ( ! noded ) return NULL; /* should have called rterror already */
   RTDEBUGG(iface->ctx, 1, noded, "Noded");
 
-  qbox = *rtgeom_get_bbox(iface->ctx,  rtline_as_rtgeom(iface->ctx, line) );
+  if ( rtgeom_get_bbox_p(iface->ctx, rtline_as_rtgeom(iface->ctx, line), &qbox) != RT_SUCCESS )
+  {
+    /* Empty line, nothing to add */
+    rtgeom_free(iface->ctx, noded);
+    *nedges = 0;
+    return NULL;
+  }
   RTDEBUGF(iface->ctx, 1, "Line BOX is %.15g %.15g, %.15g %.15g", qbox.xmin, qbox.ymin,
                                           qbox.xmax, qbox.ymax);
   gbox_expand(iface->ctx, &qbox, tol);
@@ -6061,7 +6082,12 @@ rtt_AddPolygon(RTT_TOPOLOGY* topo, RTPOLY* poly, double tol, int* nfaces)
   -- Find faces covered by input polygon
   -- NOTE: potential snapping changed polygon edges
   */
-  qbox = *rtgeom_get_bbox(iface->ctx,  rtpoly_as_rtgeom(iface->ctx, poly) );
+  if ( rtgeom_get_bbox_p(iface->ctx, rtpoly_as_rtgeom(iface->ctx, poly), &qbox) != RT_SUCCESS )
+  {
+    /* Empty polygon, it covers no face */
+    *nfaces = 0;
+    return NULL;
+  }
   gbox_expand(iface->ctx, &qbox, tol);
   faces = rtt_be_getFaceWithinBox2D( topo, &qbox, &nfacesinbox,
                                      RTT_COL_FACE_ALL, 0 );
@@ -6644,9 +6670,11 @@ _rtt_EdgeRingGetBbox(const RTCTX *ctx, RTT_EDGERING *ring)
     {
       RTT_EDGERING_ELEM *elem = ring->elems[i];
       RTLINE *g = elem->edge->geom;
-      const RTGBOX *newbox = rtgeom_get_bbox(ctx, rtline_as_rtgeom(ctx, g));
-      if ( ! i ) ring->env = gbox_clone( ctx, newbox );
-      else gbox_merge( ctx, newbox, ring->env );
+      RTGBOX newbox;
+      if ( rtgeom_get_bbox_p(ctx, rtline_as_rtgeom(ctx, g), &newbox) != RT_SUCCESS )
+        continue;
+      if ( ! ring->env ) ring->env = gbox_clone( ctx, &newbox );
+      else gbox_merge( ctx, &newbox, ring->env );
     }
   }
 
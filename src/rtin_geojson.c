@@ -25,575 +25,965 @@
 
 
 
-#include <assert.h>
-#include "librttopo_geom.h"
-#include "rtgeom_log.h"
 #include "rttopo_config.h"
+/*#define RTGEOM_DEBUG_LEVEL 4*/
+#include "librttopo_geom_internal.h"
+#include "rtgeom_log.h"
+#include <string.h>
 
-#if defined(HAVE_LIBJSON) || defined(HAVE_LIBJSON_C) /* --{ */
+/*
+* GeoJSON is read straight from the text, without building a JSON
+* document first. Members may come in any order: a "coordinates" seen
+* before the "type" is skipped and read again once the type is known.
+* Point arrays are counted before they are read, so each one gets its
+* exact size in a single allocation.
+*/
+
+/**
+* Used for passing the parse state between the parsing functions.
+*/
+typedef struct
+{
+  const char *json; /* Start of the input, for error positions */
+  const char *pos; /* Current parse position */
+  int ndims; /* 2 or 3 once the first position is seen, 0 before */
+  int drop_z; /* A position without Z followed 3D ones */
+  int depth; /* Nesting depth, to bound the recursion */
+  char **srs; /* Where to put the "crs" name, if wanted */
+} geojson_parse_state;
+
+#define RTGEOJSON_MAX_DEPTH 64
+
+#define RTGEOJSON_READER_FEATURES 0
+#define RTGEOJSON_READER_SINGLE 1
+#define RTGEOJSON_READER_DONE 2
+#define RTGEOJSON_READER_FAILED 3
+
+struct RTGEOJSON_READER_T
+{
+  geojson_parse_state s;
+  int mode; /* One of the RTGEOJSON_READER_* states */
+  uint32_t nfeatures; /* Features returned so far */
+};
 
-#ifdef HAVE_LIBJSON_C
-#include <json-c/json.h>
-#include <json-c/json_object_private.h>
-#else
-#include <json/json.h>
-#include <json/json_object_private.h>
-#endif
+static const struct
+{
+  const char *name;
+  uint8_t type;
+} geojson_types[] =
+{
+  { "Point", RTPOINTTYPE },
+  { "LineString", RTLINETYPE },
+  { "Polygon", RTPOLYGONTYPE },
+  { "MultiPoint", RTMULTIPOINTTYPE },
+  { "MultiLineString", RTMULTILINETYPE },
+  { "MultiPolygon", RTMULTIPOLYGONTYPE },
+  { "GeometryCollection", RTCOLLECTIONTYPE }
+};
 
-#ifndef JSON_C_VERSION
-/* Adds support for libjson < 0.10 */
-# define json_tokener_error_desc(x) json_tokener_errors[(x)]
-#endif
+static int geojson_parse_object(const RTCTX *ctx, geojson_parse_state *s, RTGEOJSON_FEATURE *feature, RTGEOM **geom);
 
-#include <string.h>
+#define GJ_LOWER(c) (((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
 
-static void geojson_rterror(char *msg, int error_code)
+static void geojson_error(const RTCTX *ctx, const geojson_parse_state *s, const char *msg)
 {
-  RTDEBUGF(ctx, 3, "rtgeom_from_geojson ERROR %i", error_code);
-  rterror(ctx, "%s", msg);
+  rterror(ctx, "%s at character %d of GeoJSON input", msg, (int)(s->pos - s->json));
 }
 
-/* Prototype */
-static RTGEOM* parse_geojson(json_object *geojson, int *hasz, int root_srid);
+static inline void geojson_skip_space(geojson_parse_state *s)
+{
+  while ( *s->pos == ' ' || *s->pos == '\t' || *s->pos == '\n' || *s->pos == '\r' )
+    s->pos++;
+}
 
-static json_object*
-findMemberByName(json_object* poObj, const char* pszName )
+static int geojson_accept(geojson_parse_state *s, char c)
 {
-  json_object* poTmp;
-  json_object_iter it;
+  geojson_skip_space(s);
+  if ( *s->pos != c )
+    return RT_FALSE;
+  s->pos++;
+  return RT_TRUE;
+}
 
-  poTmp = poObj;
+static int geojson_expect(const RTCTX *ctx, geojson_parse_state *s, char c)
+{
+  if ( geojson_accept(s, c) )
+    return RT_SUCCESS;
 
-  if( NULL == pszName || NULL == poObj)
-    return NULL;
+  rterror(ctx, "Expected '%c' at character %d of GeoJSON input", c, (int)(s->pos - s->json));
+  return RT_FAILURE;
+}
 
-  it.key = NULL;
-  it.val = NULL;
-  it.entry = NULL;
+/**
+* Read a string, returning its raw text between the quotes, escapes
+* left as they are.
+*/
+static int geojson_string(const RTCTX *ctx, geojson_parse_state *s, const char **str, int *len)
+{
+  const char *p;
 
-  if( NULL != json_object_get_object(poTmp) )
-  {
-    if( NULL == json_object_get_object(poTmp)->head )
-    {
-      geojson_rterror("invalid GeoJSON representation", 2);
-      return NULL;
-    }
+  if ( ! geojson_expect(ctx, s, '"') )
+    return RT_FAILURE;
 
-    for( it.entry = json_object_get_object(poTmp)->head;
-            ( it.entry ?
-              ( it.key = (char*)it.entry->k,
-                it.val = (json_object*)it.entry->v, it.entry) : 0);
-            it.entry = it.entry->next)
+  for ( p = s->pos; *p != '"'; p++ )
+  {
+    if ( *p == '\\' && p[1] )
+      p++;
+    else if ( ! *p )
     {
-      if( strcasecmp((char *)it.key, pszName )==0 )
-        return it.val;
+      geojson_error(ctx, s, "Unterminated string");
+      return RT_FAILURE;
     }
   }
 
-  return NULL;
+  *str = s->pos;
+  *len = p - s->pos;
+  s->pos = p + 1;
+  return RT_SUCCESS;
 }
 
-
-static int
-parse_geojson_coord(json_object *poObj, int *hasz, RTPOINTARRAY *pa)
+/**
+* Whether the string equals keyword, ignoring case as the json-c based
+* reader did.
+*/
+static int geojson_string_is(const char *str, int len, const char *keyword)
 {
-  RTPOINT4D pt;
+  int i;
+  for ( i = 0; i < len && keyword[i]; i++ )
+    if ( GJ_LOWER(str[i]) != GJ_LOWER(keyword[i]) )
+      return RT_FALSE;
+  return i == len && keyword[i] == '\0';
+}
 
-  RTDEBUGF(ctx, 3, "parse_geojson_coord called for object %s.", json_object_to_json_string( poObj ) );
+/**
+* Decode the escapes of a raw string into a new null terminated copy.
+*/
+static char* geojson_string_copy(const RTCTX *ctx, const char *str, int len)
+{
+  char *out = rtalloc(ctx, len + 1);
+  char *o = out;
+  const char *p, *end = str + len;
 
-  if( json_type_array == json_object_get_type( poObj ) )
+  for ( p = str; p < end; p++ )
   {
-
-    json_object* poObjCoord = NULL;
-    const int nSize = json_object_array_length( poObj );
-    RTDEBUGF(ctx, 3, "parse_geojson_coord called for array size %d.", nSize );
-
-    if ( nSize < 2 )
+    if ( *p != '\\' || p + 1 == end )
     {
-      geojson_rterror("Too few ordinates in GeoJSON", 4);
-      return RT_FAILURE;
+      *o++ = *p;
+      continue;
+    }
+    switch ( *++p )
+    {
+    case 'b': *o++ = '\b'; break;
+    case 'f': *o++ = '\f'; break;
+    case 'n': *o++ = '\n'; break;
+    case 'r': *o++ = '\r'; break;
+    case 't': *o++ = '\t'; break;
+    case 'u':
+    {
+      unsigned int u = 0;
+      int i;
+      for ( i = 0; i < 4 && p + 1 < end; i++ )
+      {
+        char c = *++p;
+        u = u * 16 + ( c >= '0' && c <= '9' ? c - '0' : ( GJ_LOWER(c) - 'a' + 10 ) % 16 );
+      }
+      /* UTF-8, at most as long as the escape it replaces */
+      if ( u < 0x80 )
+        *o++ = u;
+      else if ( u < 0x800 )
+      {
+        *o++ = 0xC0 | (u >> 6);
+        *o++ = 0x80 | (u & 0x3F);
+      }
+      else
+      {
+        *o++ = 0xE0 | (u >> 12);
+        *o++ = 0x80 | ((u >> 6) & 0x3F);
+        *o++ = 0x80 | (u & 0x3F);
+      }
+      break;
+    }
+    default: *o++ = *p; break;
     }
+  }
+  *o = '\0';
+  return out;
+}
 
-    /* Read X coordinate */
-    poObjCoord = json_object_array_get_idx( poObj, 0 );
-    pt.x = json_object_get_double( poObjCoord );
-    RTDEBUGF(ctx, 3, "parse_geojson_coord pt.x = %f.", pt.x );
+/**
+* Step over any value: a string, a literal, or a whole object or array.
+*/
+static int geojson_skip_value(const RTCTX *ctx, geojson_parse_state *s)
+{
+  const char *str;
+  int len, depth = 0;
 
-    /* Read Y coordinate */
-    poObjCoord = json_object_array_get_idx( poObj, 1 );
-    pt.y = json_object_get_double( poObjCoord );
-    RTDEBUGF(ctx, 3, "parse_geojson_coord pt.y = %f.", pt.y );
+  geojson_skip_space(s);
 
-    if( nSize > 2 ) /* should this be >= 3 ? */
-    {
-      /* Read Z coordinate */
-      poObjCoord = json_object_array_get_idx( poObj, 2 );
-      pt.z = json_object_get_double( poObjCoord );
-      RTDEBUGF(ctx, 3, "parse_geojson_coord pt.z = %f.", pt.z );
-      *hasz = RT_TRUE;
-    }
-    else if ( nSize == 2 )
+  if ( *s->pos == '"' )
+    return geojson_string(ctx, s, &str, &len);
+
+  if ( *s->pos != '{' && *s->pos != '[' )
+  {
+    const char *start = s->pos;
+    while ( *s->pos && ! strchr(",:}] \t\n\r", *s->pos) )
+      s->pos++;
+    if ( s->pos == start )
     {
-      *hasz = RT_FALSE;
-      /* Initialize Z coordinate, if required */
-      if ( RTFLAGS_GET_Z(pa->flags) ) pt.z = 0.0;
+      geojson_error(ctx, s, "Expected a value");
+      return RT_FAILURE;
     }
-    else
+    return RT_SUCCESS;
+  }
+
+  for (;;)
+  {
+    switch ( *s->pos )
     {
-      /* TODO: should we account for nSize > 3 ? */
-      /* more than 3 coordinates, we're just dropping dimensions here... */
+    case '\0':
+      geojson_error(ctx, s, "Unexpected end of input");
+      return RT_FAILURE;
+    case '"':
+      if ( ! geojson_string(ctx, s, &str, &len) )
+        return RT_FAILURE;
+      continue;
+    case '{':
+    case '[':
+      depth++;
+      break;
+    case '}':
+    case ']':
+      if ( --depth == 0 )
+      {
+        s->pos++;
+        return RT_SUCCESS;
+      }
+      break;
     }
+    s->pos++;
+  }
+}
 
-    /* Initialize M coordinate, if required */
-    if ( RTFLAGS_GET_M(pa->flags) ) pt.m = 0.0;
-
+/**
+* Whether the next value is the null literal, consuming it if so.
+*/
+static int geojson_accept_null(geojson_parse_state *s)
+{
+  geojson_skip_space(s);
+  if ( strncmp(s->pos, "null", 4) == 0 )
+  {
+    s->pos += 4;
+    return RT_TRUE;
   }
+  return RT_FALSE;
+}
+
+/**
+* Read a number with the RFC 8259 grammar: no leading zeros, digits
+* on both sides of a dot, and a finite value.
+*/
+static int geojson_number(const RTCTX *ctx, geojson_parse_state *s, double *d)
+{
+  const char *p = s->pos;
+  const char *end;
+
+  if ( *p == '-' ) p++;
+  if ( *p == '0' )
+    p++;
+  else if ( *p >= '1' && *p <= '9' )
+    while ( *p >= '0' && *p <= '9' ) p++;
   else
+    goto fail;
+  if ( *p == '.' )
   {
-    /* If it's not an array, just don't handle it */
+    if ( ! ( *++p >= '0' && *p <= '9' ) )
+      goto fail;
+    while ( *p >= '0' && *p <= '9' ) p++;
+  }
+  if ( *p == 'e' || *p == 'E' )
+  {
+    p++;
+    if ( *p == '+' || *p == '-' ) p++;
+    if ( ! ( *p >= '0' && *p <= '9' ) )
+      goto fail;
+    while ( *p >= '0' && *p <= '9' ) p++;
+  }
+
+  end = rtparse_double(ctx, s->pos, d);
+  if ( end != p )
+    goto fail;
+  if ( ! isfinite(*d) )
+  {
+    geojson_error(ctx, s, "Number out of range");
     return RT_FAILURE;
   }
+  s->pos = end;
+  return RT_SUCCESS;
 
-  return ptarray_append_point(ctx, pa, &pt, RT_TRUE);
+fail:
+  geojson_error(ctx, s, "Expected a number");
+  return RT_FAILURE;
 }
 
-static RTGEOM*
-parse_geojson_point(json_object *geojson, int *hasz, int root_srid)
+/**
+* Read a position into ords, fixing the dimensionality on the first
+* one. Ordinates past Z are ignored, a missing Z reads as 0 and makes
+* the whole geometry 2D in the end.
+*/
+static int geojson_parse_position(const RTCTX *ctx, geojson_parse_state *s, double *ords)
 {
-  RTGEOM *geom;
-  RTPOINTARRAY *pa;
-  json_object* coords = NULL;
+  double d;
+  int n = 0;
 
-  RTDEBUGF(ctx, 3, "parse_geojson_point called with root_srid = %d.", root_srid );
+  if ( ! geojson_expect(ctx, s, '[') )
+    return RT_FAILURE;
 
-  coords = findMemberByName( geojson, "coordinates" );
-  if ( ! coords )
+  do
   {
-    geojson_rterror("Unable to find 'coordinates' in GeoJSON string", 4);
-    return NULL;
+    geojson_skip_space(s);
+    if ( ! geojson_number(ctx, s, n < 3 ? &ords[n] : &d) )
+      return RT_FAILURE;
+    n++;
   }
+  while ( geojson_accept(s, ',') );
 
-  pa = ptarray_construct_empty(ctx, 1, 0, 1);
-  parse_geojson_coord(coords, hasz, pa);
+  if ( ! geojson_expect(ctx, s, ']') )
+    return RT_FAILURE;
 
-  geom = (RTGEOM *) rtpoint_construct(ctx, root_srid, NULL, pa);
-  RTDEBUG(ctx, 2, "parse_geojson_point finished.");
-  return geom;
+  if ( n < 2 )
+  {
+    geojson_error(ctx, s, "Too few ordinates in GeoJSON");
+    return RT_FAILURE;
+  }
+
+  if ( ! s->ndims )
+    s->ndims = n > 2 ? 3 : 2;
+  else if ( n == 2 && s->ndims == 3 )
+  {
+    ords[2] = 0;
+    s->drop_z = RT_TRUE;
+  }
+  return RT_SUCCESS;
 }
 
-static RTGEOM*
-parse_geojson_linestring(json_object *geojson, int *hasz, int root_srid)
+/**
+* Number of array or object elements in the array starting at the
+* current position; scalars are not counted.
+*/
+static uint32_t geojson_count_elements(const geojson_parse_state *s)
 {
-  RTGEOM *geom;
-  RTPOINTARRAY *pa;
-  json_object* points = NULL;
-  int i = 0;
+  const char *p = s->pos;
+  uint32_t n = 0;
+  int depth = 0;
 
-  RTDEBUG(ctx, 2, "parse_geojson_linestring called.");
+  while ( *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' )
+    p++;
+  if ( *p != '[' )
+    return 0;
 
-  points = findMemberByName( geojson, "coordinates" );
-  if ( ! points )
+  for ( ; *p; p++ )
   {
-    geojson_rterror("Unable to find 'coordinates' in GeoJSON string", 4);
-  return NULL;
+    if ( *p == '[' || *p == '{' )
+    {
+      if ( ++depth == 2 )
+        n++;
+    }
+    else if ( *p == ']' || *p == '}' )
+    {
+      if ( --depth == 0 )
+        break;
+    }
+    else if ( *p == '"' )
+    {
+      for ( p++; *p && *p != '"'; p++ )
+      {
+        if ( *p == '\\' && p[1] )
+          p++;
+      }
+      if ( ! *p )
+        break;
+    }
   }
+  return n;
+}
+
+/**
+* An array of positions, sized by counting them first.
+*/
+static RTPOINTARRAY* geojson_parse_ptarray(const RTCTX *ctx, geojson_parse_state *s)
+{
+  RTPOINTARRAY *pa;
+  uint32_t npoints = geojson_count_elements(s), i;
+  double ords[3];
 
-  pa = ptarray_construct_empty(ctx, 1, 0, 1);
+  if ( ! geojson_expect(ctx, s, '[') )
+    return NULL;
+
+  if ( geojson_accept(s, ']') )
+    return ptarray_construct_empty(ctx, s->ndims == 3, 0, 1);
+
+  if ( ! geojson_parse_position(ctx, s, ords) )
+    return NULL;
 
-  if( json_type_array == json_object_get_type( points ) )
+  pa = ptarray_construct(ctx, s->ndims == 3, 0, npoints);
+  memcpy(rt_getPoint_internal(ctx, pa, 0), ords, s->ndims * sizeof(double));
+
+  for ( i = 1; i < npoints; i++ )
   {
-    const int nPoints = json_object_array_length( points );
-    for(i = 0; i < nPoints; ++i)
+    if ( ! geojson_expect(ctx, s, ',') || ! geojson_parse_position(ctx, s, ords) )
     {
-      json_object* coords = NULL;
-      coords = json_object_array_get_idx( points, i );
-      parse_geojson_coord(coords, hasz, pa);
+      ptarray_free(ctx, pa);
+      return NULL;
     }
+    memcpy(rt_getPoint_internal(ctx, pa, i), ords, s->ndims * sizeof(double));
   }
 
-  geom = (RTGEOM *) rtline_construct(ctx, root_srid, NULL, pa);
-
-  RTDEBUG(ctx, 2, "parse_geojson_linestring finished.");
-  return geom;
+  if ( ! geojson_expect(ctx, s, ']') )
+  {
+    ptarray_free(ctx, pa);
+    return NULL;
+  }
+  return pa;
 }
 
-static RTGEOM*
-parse_geojson_polygon(json_object *geojson, int *hasz, int root_srid)
+static RTGEOM* geojson_parse_point(const RTCTX *ctx, geojson_parse_state *s)
 {
-  RTPOINTARRAY **ppa = NULL;
-  json_object* rings = NULL;
-  json_object* points = NULL;
-  int i = 0, j = 0;
-  int nRings = 0, nPoints = 0;
+  RTPOINTARRAY *pa;
+  const char *start = s->pos;
+  double ords[3];
 
-  rings = findMemberByName( geojson, "coordinates" );
-  if ( ! rings )
-  {
-    geojson_rterror("Unable to find 'coordinates' in GeoJSON string", 4);
+  if ( ! geojson_expect(ctx, s, '[') )
     return NULL;
-  }
 
-  if ( json_type_array != json_object_get_type(rings) )
-  {
-    geojson_rterror("The 'coordinates' in GeoJSON are not an array", 4);
+  if ( geojson_accept(s, ']') )
+    return rtpoint_as_rtgeom(ctx, rtpoint_construct_empty(ctx, SRID_UNKNOWN, s->ndims == 3, 0));
+
+  s->pos = start;
+  if ( ! geojson_parse_position(ctx, s, ords) )
     return NULL;
-  }
 
-  nRings = json_object_array_length( rings );
+  pa = ptarray_construct(ctx, s->ndims == 3, 0, 1);
+  memcpy(rt_getPoint_internal(ctx, pa, 0), ords, s->ndims * sizeof(double));
+  return rtpoint_as_rtgeom(ctx, rtpoint_construct(ctx, SRID_UNKNOWN, NULL, pa));
+}
 
-  /* No rings => POLYGON EMPTY */
-  if ( ! nRings )
-  {
-    return (RTGEOM *)rtpoly_construct_empty(ctx, root_srid, 0, 0);
-  }
+static RTGEOM* geojson_parse_line(const RTCTX *ctx, geojson_parse_state *s)
+{
+  RTPOINTARRAY *pa = geojson_parse_ptarray(ctx, s);
 
-  for ( i = 0; i < nRings; i++ )
-  {
-    points = json_object_array_get_idx(rings, i);
-    if ( ! points || json_object_get_type(points) != json_type_array )
-    {
-      geojson_rterror("The 'coordinates' in GeoJSON ring are not an array", 4);
-      return NULL;
-    }
-    nPoints = json_object_array_length(points);
+  if ( ! pa )
+    return NULL;
+  return rtline_as_rtgeom(ctx, rtline_construct(ctx, SRID_UNKNOWN, NULL, pa));
+}
+
+static RTGEOM* geojson_parse_polygon(const RTCTX *ctx, geojson_parse_state *s)
+{
+  RTPOINTARRAY **rings, *pa = NULL;
+  uint32_t nrings = geojson_count_elements(s), i = 0;
 
-    /* Skip empty rings */
-    if ( nPoints == 0 ) continue;
+  if ( ! geojson_expect(ctx, s, '[') )
+    return NULL;
 
-    if ( ! ppa )
-      ppa = (RTPOINTARRAY**)rtalloc(ctx, sizeof(RTPOINTARRAY*) * nRings);
+  if ( geojson_accept(s, ']') )
+    return rtpoly_as_rtgeom(ctx, rtpoly_construct_empty(ctx, SRID_UNKNOWN, s->ndims == 3, 0));
 
-    ppa[i] = ptarray_construct_empty(ctx, 1, 0, 1);
-    for ( j = 0; j < nPoints; j++ )
+  rings = rtalloc(ctx, nrings * sizeof(RTPOINTARRAY*));
+  do
+  {
+    if ( i == nrings )
     {
-      json_object* coords = NULL;
-      coords = json_object_array_get_idx( points, j );
-      parse_geojson_coord(coords, hasz, ppa[i]);
+      geojson_error(ctx, s, "Expected a GeoJSON ring");
+      pa = NULL;
+      break;
     }
+    if ( ! (pa = geojson_parse_ptarray(ctx, s)) )
+      break;
+    rings[i++] = pa;
   }
+  while ( geojson_accept(s, ',') );
 
-  /* All the rings were empty! */
-  if ( ! ppa )
-    return (RTGEOM *)rtpoly_construct_empty(ctx, root_srid, 0, 0);
-
-  return (RTGEOM *) rtpoly_construct(ctx, root_srid, NULL, nRings, ppa);
+  if ( ! pa || ! geojson_expect(ctx, s, ']') || i != nrings )
+  {
+    while ( i )
+      ptarray_free(ctx, rings[--i]);
+    rtfree(ctx, rings);
+    return NULL;
+  }
+  return rtpoly_as_rtgeom(ctx, rtpoly_construct(ctx, SRID_UNKNOWN, NULL, nrings, rings));
 }
 
-static RTGEOM*
-parse_geojson_multipoint(json_object *geojson, int *hasz, int root_srid)
+/**
+* Members of collections parsed before the first position fixed the
+* dimensionality were built 2D; bring them in line.
+*/
+static void geojson_fix_dims(const RTCTX *ctx, RTGEOM *geom)
 {
-  RTGEOM *geom;
-  int i = 0;
-  json_object* poObjPoints = NULL;
+  int i;
 
-  if (!root_srid)
+  RTFLAGS_SET_Z(geom->flags, 1);
+  switch ( geom->type )
   {
-    geom = (RTGEOM *)rtcollection_construct_empty(ctx, RTMULTIPOINTTYPE, root_srid, 1, 0);
-  }
-  else
-  {
-    geom = (RTGEOM *)rtcollection_construct_empty(ctx, RTMULTIPOINTTYPE, -1, 1, 0);
+  case RTPOINTTYPE:
+    RTFLAGS_SET_Z(((RTPOINT*)geom)->point->flags, 1);
+    break;
+  case RTLINETYPE:
+    RTFLAGS_SET_Z(((RTLINE*)geom)->points->flags, 1);
+    break;
+  case RTPOLYGONTYPE:
+    for ( i = 0; i < ((RTPOLY*)geom)->nrings; i++ )
+      RTFLAGS_SET_Z(((RTPOLY*)geom)->rings[i]->flags, 1);
+    break;
+  default:
+    for ( i = 0; i < ((RTCOLLECTION*)geom)->ngeoms; i++ )
+      geojson_fix_dims(ctx, ((RTCOLLECTION*)geom)->geoms[i]);
+    break;
   }
+}
 
-  poObjPoints = findMemberByName( geojson, "coordinates" );
-  if ( ! poObjPoints )
-  {
-    geojson_rterror("Unable to find 'coordinates' in GeoJSON string", 4);
+/**
+* MultiPoint, MultiLineString, MultiPolygon from their coordinates,
+* GeometryCollection from its geometries.
+*/
+static RTGEOM* geojson_parse_collection(const RTCTX *ctx, geojson_parse_state *s, uint8_t type)
+{
+  RTGEOM **geoms, *geom = NULL;
+  uint32_t ngeoms = geojson_count_elements(s), i = 0;
+
+  if ( ! geojson_expect(ctx, s, '[') )
     return NULL;
-  }
 
-  if( json_type_array == json_object_get_type( poObjPoints ) )
+  if ( geojson_accept(s, ']') )
+    return rtcollection_as_rtgeom(ctx, rtcollection_construct_empty(ctx, type, SRID_UNKNOWN, s->ndims == 3, 0));
+
+  geoms = rtalloc(ctx, ngeoms * sizeof(RTGEOM*));
+  do
   {
-    const int nPoints = json_object_array_length( poObjPoints );
-    for( i = 0; i < nPoints; ++i)
+    if ( i == ngeoms )
     {
-      RTPOINTARRAY *pa;
-      json_object* poObjCoords = NULL;
-      poObjCoords = json_object_array_get_idx( poObjPoints, i );
-
-      pa = ptarray_construct_empty(ctx, 1, 0, 1);
-      parse_geojson_coord(poObjCoords, hasz, pa);
-
-      geom = (RTGEOM*)rtmpoint_add_rtpoint(ctx, (RTMPOINT*)geom,
-                                           (RTPOINT*)rtpoint_construct(ctx, root_srid, NULL, pa));
+      geojson_error(ctx, s, "Expected a GeoJSON geometry");
+      geom = NULL;
+      break;
+    }
+    switch ( type )
+    {
+    case RTMULTIPOINTTYPE:
+      geom = geojson_parse_point(ctx, s);
+      break;
+    case RTMULTILINETYPE:
+      geom = geojson_parse_line(ctx, s);
+      break;
+    case RTMULTIPOLYGONTYPE:
+      geom = geojson_parse_polygon(ctx, s);
+      break;
+    default:
+      geojson_skip_space(s);
+      if ( *s->pos != '{' )
+      {
+        geojson_error(ctx, s, "Expected a GeoJSON geometry");
+        geom = NULL;
+      }
+      else if ( ! geojson_parse_object(ctx, s, NULL, &geom) )
+        geom = NULL;
+      break;
     }
+    if ( ! geom )
+      break;
+    geoms[i++] = geom;
   }
+  while ( geojson_accept(s, ',') );
 
-  return geom;
-}
-
-static RTGEOM*
-parse_geojson_multilinestring(json_object *geojson, int *hasz, int root_srid)
-{
-  RTGEOM *geom = NULL;
-  int i, j;
-  json_object* poObjLines = NULL;
-
-  if (!root_srid)
+  if ( ! geom || ! geojson_expect(ctx, s, ']') || i != ngeoms )
   {
-    geom = (RTGEOM *)rtcollection_construct_empty(ctx, RTMULTILINETYPE, root_srid, 1, 0);
+    while ( i )
+      rtgeom_free(ctx, geoms[--i]);
+    rtfree(ctx, geoms);
+    return NULL;
   }
-  else
+
+  if ( s->ndims == 3 )
   {
-    geom = (RTGEOM *)rtcollection_construct_empty(ctx, RTMULTILINETYPE, -1, 1, 0);
+    for ( i = 0; i < ngeoms; i++ )
+      geojson_fix_dims(ctx, geoms[i]);
   }
+  return rtcollection_as_rtgeom(ctx, rtcollection_construct(ctx, type, SRID_UNKNOWN, NULL, ngeoms, geoms));
+}
 
-  poObjLines = findMemberByName( geojson, "coordinates" );
-  if ( ! poObjLines )
+static RTGEOM* geojson_parse_coordinates(const RTCTX *ctx, geojson_parse_state *s, uint8_t type)
+{
+  switch ( type )
   {
-    geojson_rterror("Unable to find 'coordinates' in GeoJSON string", 4);
-    return NULL;
+  case RTPOINTTYPE:
+    return geojson_parse_point(ctx, s);
+  case RTLINETYPE:
+    return geojson_parse_line(ctx, s);
+  case RTPOLYGONTYPE:
+    return geojson_parse_polygon(ctx, s);
+  default:
+    return geojson_parse_collection(ctx, s, type);
   }
+}
+
+/**
+* Pick the name out of a "crs" member.
+*/
+static int geojson_parse_crs(const RTCTX *ctx, geojson_parse_state *s)
+{
+  const char *key, *name;
+  int keylen, namelen;
+
+  if ( geojson_accept_null(s) )
+    return RT_SUCCESS;
+  if ( ! geojson_expect(ctx, s, '{') )
+    return RT_FAILURE;
+  if ( geojson_accept(s, '}') )
+    return RT_SUCCESS;
 
-  if( json_type_array == json_object_get_type( poObjLines ) )
+  do
   {
-    const int nLines = json_object_array_length( poObjLines );
-    for( i = 0; i < nLines; ++i)
+    if ( ! geojson_string(ctx, s, &key, &keylen) || ! geojson_expect(ctx, s, ':') )
+      return RT_FAILURE;
+    if ( geojson_string_is(key, keylen, "properties") && geojson_accept(s, '{') )
     {
-      RTPOINTARRAY *pa = NULL;
-      json_object* poObjLine = NULL;
-      poObjLine = json_object_array_get_idx( poObjLines, i );
-      pa = ptarray_construct_empty(ctx, 1, 0, 1);
-
-      if( json_type_array == json_object_get_type( poObjLine ) )
+      if ( geojson_accept(s, '}') )
+        continue;
+      do
       {
-        const int nPoints = json_object_array_length( poObjLine );
-        for(j = 0; j < nPoints; ++j)
+        if ( ! geojson_string(ctx, s, &key, &keylen) || ! geojson_expect(ctx, s, ':') )
+          return RT_FAILURE;
+        geojson_skip_space(s);
+        if ( geojson_string_is(key, keylen, "name") && *s->pos == '"' )
         {
-          json_object* coords = NULL;
-          coords = json_object_array_get_idx( poObjLine, j );
-          parse_geojson_coord(coords, hasz, pa);
+          if ( ! geojson_string(ctx, s, &name, &namelen) )
+            return RT_FAILURE;
+          if ( *s->srs )
+            rtfree(ctx, *s->srs);
+          *s->srs = geojson_string_copy(ctx, name, namelen);
         }
-
-        geom = (RTGEOM*)rtmline_add_rtline(ctx, (RTMLINE*)geom,
-                                           (RTLINE*)rtline_construct(ctx, root_srid, NULL, pa));
+        else if ( ! geojson_skip_value(ctx, s) )
+          return RT_FAILURE;
       }
+      while ( geojson_accept(s, ',') );
+      if ( ! geojson_expect(ctx, s, '}') )
+        return RT_FAILURE;
     }
+    else if ( ! geojson_skip_value(ctx, s) )
+      return RT_FAILURE;
   }
+  while ( geojson_accept(s, ',') );
 
-  return geom;
+  return geojson_expect(ctx, s, '}');
 }
 
-static RTGEOM*
-parse_geojson_multipolygon(json_object *geojson, int *hasz, int root_srid)
+/**
+* Parse a geometry object or, when feature is given, a Feature as well.
+* The "coordinates" (or "geometries") are read as soon as the type is
+* known, going back for them if they came first. For a Feature, geom
+* gets its geometry, NULL if that is null.
+*/
+static int geojson_parse_object(const RTCTX *ctx, geojson_parse_state *s, RTGEOJSON_FEATURE *feature, RTGEOM **geom)
 {
-  RTGEOM *geom = NULL;
-  int i, j, k;
-  json_object* poObjPolys = NULL;
+  const char *key, *str, *value, *coords = NULL;
+  int keylen, len;
+  size_t i;
+  int type = 0; /* Geometry type, or -1 for a Feature */
+  RTGEOM *result = NULL, *member = NULL;
 
-  if (!root_srid)
-  {
-    geom = (RTGEOM *)rtcollection_construct_empty(ctx, RTMULTIPOLYGONTYPE, root_srid, 1, 0);
-  }
-  else
+  *geom = NULL;
+
+  if ( ++s->depth > RTGEOJSON_MAX_DEPTH )
   {
-    geom = (RTGEOM *)rtcollection_construct_empty(ctx, RTMULTIPOLYGONTYPE, -1, 1, 0);
+    geojson_error(ctx, s, "GeoJSON nesting too deep");
+    return RT_FAILURE;
   }
 
-  poObjPolys = findMemberByName( geojson, "coordinates" );
-  if ( ! poObjPolys )
+  /* A Feature or a top level geometry starts a new dimensionality */
+  if ( feature )
   {
-    geojson_rterror("Unable to find 'coordinates' in GeoJSON string", 4);
-    return NULL;
+    s->ndims = 0;
+    s->drop_z = RT_FALSE;
   }
 
-  if( json_type_array == json_object_get_type( poObjPolys ) )
+  if ( ! geojson_expect(ctx, s, '{') )
+    goto fail;
+
+  if ( ! geojson_accept(s, '}') ) do
   {
-    const int nPolys = json_object_array_length( poObjPolys );
+    if ( ! geojson_string(ctx, s, &key, &keylen) || ! geojson_expect(ctx, s, ':') )
+      goto fail;
+    geojson_skip_space(s);
+    value = s->pos;
 
-    for(i = 0; i < nPolys; ++i)
+    if ( geojson_string_is(key, keylen, "type") )
     {
-      json_object* poObjPoly = json_object_array_get_idx( poObjPolys, i );
-
-      if( json_type_array == json_object_get_type( poObjPoly ) )
+      if ( type )
       {
-        RTPOLY *rtpoly = rtpoly_construct_empty(ctx, geom->srid, rtgeom_has_z(ctx, geom), rtgeom_has_m(ctx, geom));
-        int nRings = json_object_array_length( poObjPoly );
-
-        for(j = 0; j < nRings; ++j)
-        {
-          json_object* points = json_object_array_get_idx( poObjPoly, j );
-
-          if( json_type_array == json_object_get_type( points ) )
-          {
-
-            RTPOINTARRAY *pa = ptarray_construct_empty(ctx, 1, 0, 1);
-
-            int nPoints = json_object_array_length( points );
-            for ( k=0; k < nPoints; k++ )
-            {
-              json_object* coords = json_object_array_get_idx( points, k );
-              parse_geojson_coord(coords, hasz, pa);
-            }
-
-            rtpoly_add_ring(ctx, rtpoly, pa);
-          }
-        }
-        geom = (RTGEOM*)rtmpoly_add_rtpoly(ctx, (RTMPOLY*)geom, rtpoly);
+        geojson_error(ctx, s, "Duplicate GeoJSON type");
+        goto fail;
+      }
+      if ( ! geojson_string(ctx, s, &str, &len) )
+        goto fail;
+      if ( feature && geojson_string_is(str, len, "Feature") )
+        type = -1;
+      for ( i = 0; ! type && i < sizeof(geojson_types) / sizeof(geojson_types[0]); i++ )
+      {
+        int j, n = strlen(geojson_types[i].name);
+        for ( j = 0; j < n && j < len && GJ_LOWER(str[j]) == GJ_LOWER(geojson_types[i].name[j]); j++ );
+        if ( j == n && n == len )
+          type = geojson_types[i].type;
+      }
+      if ( ! type )
+      {
+        s->pos = value;
+        geojson_error(ctx, s, "Unknown GeoJSON type");
+        goto fail;
+      }
+      /* Go back for coordinates that came first */
+      if ( coords && type > 0 )
+      {
+        s->pos = coords;
+        if ( ! (result = geojson_parse_coordinates(ctx, s, type)) )
+          goto fail;
+        s->pos = value;
+        if ( ! geojson_skip_value(ctx, s) )
+          goto fail;
+      }
+    }
+    else if ( ( geojson_string_is(key, keylen, "coordinates") && type != RTCOLLECTIONTYPE ) ||
+              ( geojson_string_is(key, keylen, "geometries") && ( type == 0 || type == RTCOLLECTIONTYPE ) ) )
+    {
+      if ( result || coords )
+      {
+        geojson_error(ctx, s, "Duplicate GeoJSON coordinates");
+        goto fail;
+      }
+      if ( type > 0 )
+      {
+        if ( ! (result = geojson_parse_coordinates(ctx, s, type)) )
+          goto fail;
+      }
+      else
+      {
+        coords = value;
+        if ( ! geojson_skip_value(ctx, s) )
+          goto fail;
       }
     }
+    else if ( feature && geojson_string_is(key, keylen, "geometry") )
+    {
+      if ( member )
+      {
+        rtgeom_free(ctx, member);
+        member = NULL;
+      }
+      if ( ! geojson_accept_null(s) && ! geojson_parse_object(ctx, s, NULL, &member) )
+        goto fail;
+    }
+    else if ( feature && geojson_string_is(key, keylen, "id") )
+    {
+      if ( ! geojson_skip_value(ctx, s) )
+        goto fail;
+      feature->id = value;
+      feature->id_len = s->pos - value;
+    }
+    else if ( feature && geojson_string_is(key, keylen, "properties") )
+    {
+      if ( geojson_accept_null(s) )
+        continue;
+      if ( ! geojson_skip_value(ctx, s) )
+        goto fail;
+      feature->properties = value;
+      feature->properties_len = s->pos - value;
+    }
+    else if ( s->srs && s->depth == 1 && geojson_string_is(key, keylen, "crs") )
+    {
+      if ( ! geojson_parse_crs(ctx, s) )
+        goto fail;
+    }
+    else if ( ! geojson_skip_value(ctx, s) )
+      goto fail;
   }
+  while ( geojson_accept(s, ',') );
 
-  return geom;
-}
-
-static RTGEOM*
-parse_geojson_geometrycollection(json_object *geojson, int *hasz, int root_srid)
-{
-  RTGEOM *geom = NULL;
-  int i;
-  json_object* poObjGeoms = NULL;
+  if ( ! geojson_expect(ctx, s, '}') )
+    goto fail;
 
-  if (!root_srid)
+  if ( type == -1 )
   {
-    geom = (RTGEOM *)rtcollection_construct_empty(ctx, RTCOLLECTIONTYPE, root_srid, 1, 0);
+    if ( result )
+      rtgeom_free(ctx, result);
+    result = member;
   }
   else
   {
-    geom = (RTGEOM *)rtcollection_construct_empty(ctx, RTCOLLECTIONTYPE, -1, 1, 0);
-  }
-
-  poObjGeoms = findMemberByName( geojson, "geometries" );
-  if ( ! poObjGeoms )
-  {
-    geojson_rterror("Unable to find 'geometries' in GeoJSON string", 4);
-    return NULL;
+    if ( member )
+      rtgeom_free(ctx, member);
+    if ( ! type )
+    {
+      geojson_error(ctx, s, "Unknown GeoJSON type");
+      goto fail_result;
+    }
+    if ( ! result )
+    {
+      geojson_error(ctx, s, type == RTCOLLECTIONTYPE ?
+                    "Unable to find 'geometries' in GeoJSON string" :
+                    "Unable to find 'coordinates' in GeoJSON string");
+      goto fail_result;
+    }
   }
 
-  if( json_type_array == json_object_get_type( poObjGeoms ) )
+  /* Some positions had no Z: the whole geometry is 2D */
+  if ( feature && s->drop_z && result )
   {
-    const int nGeoms = json_object_array_length( poObjGeoms );
-    json_object* poObjGeom = NULL;
-    for(i = 0; i < nGeoms; ++i )
-    {
-      poObjGeom = json_object_array_get_idx( poObjGeoms, i );
-      geom = (RTGEOM*)rtcollection_add_rtgeom(ctx, (RTCOLLECTION *)geom,
-                                              parse_geojson(poObjGeom, hasz, root_srid));
-    }
+    RTGEOM *tmp = rtgeom_force_2d(ctx, result);
+    rtgeom_free(ctx, result);
+    result = tmp;
   }
 
-  return geom;
+  s->depth--;
+  *geom = result;
+  return RT_SUCCESS;
+
+fail:
+  if ( member )
+    rtgeom_free(ctx, member);
+fail_result:
+  if ( result )
+    rtgeom_free(ctx, result);
+  return RT_FAILURE;
 }
 
-static RTGEOM*
-parse_geojson(json_object *geojson, int *hasz, int root_srid)
+RTGEOM*
+rtgeom_from_geojson(const RTCTX *ctx, const char *geojson, char **srs)
 {
-  json_object* type = NULL;
-  const char* name;
+  geojson_parse_state s;
+  RTGEOJSON_FEATURE feature;
+  RTGEOM *geom;
 
-  if( NULL == geojson )
+  if ( srs )
+    *srs = NULL;
+  memset(&feature, 0, sizeof(RTGEOJSON_FEATURE));
+  memset(&s, 0, sizeof(geojson_parse_state));
+  s.json = s.pos = geojson;
+  s.srs = srs;
+
+  if ( ! geojson_parse_object(ctx, &s, &feature, &geom) )
+    goto fail;
+
+  geojson_skip_space(&s);
+  if ( *s.pos )
   {
-    geojson_rterror("invalid GeoJSON representation", 2);
-    return NULL;
+    if ( geom )
+      rtgeom_free(ctx, geom);
+    geojson_error(ctx, &s, "Unexpected text after GeoJSON object");
+    goto fail;
   }
 
-  type = findMemberByName( geojson, "type" );
-  if( NULL == type )
+  if ( ! geom )
   {
-    geojson_rterror("unknown GeoJSON type", 3);
-    return NULL;
+    rterror(ctx, "invalid GeoJson representation");
+    goto fail;
   }
 
-  name = json_object_get_string( type );
+  if ( ctx->bbox_cache != RTBBOX_CACHE_NONE )
+    rtgeom_add_bbox(ctx, geom);
 
-  if( strcasecmp( name, "Point" )==0 )
-    return parse_geojson_point(geojson, hasz, root_srid);
+  return geom;
 
-  if( strcasecmp( name, "LineString" )==0 )
-    return parse_geojson_linestring(geojson, hasz, root_srid);
+fail:
+  if ( srs && *srs )
+  {
+    rtfree(ctx, *srs);
+    *srs = NULL;
+  }
+  return NULL;
+}
 
-  if( strcasecmp( name, "Polygon" )==0 )
-    return parse_geojson_polygon(geojson, hasz, root_srid);
+RTGEOJSON_READER*
+rtgeojson_reader_new(const RTCTX *ctx, const char *geojson)
+{
+  RTGEOJSON_READER *r;
+  geojson_parse_state *s;
+  const char *key;
+  int keylen;
 
-  if( strcasecmp( name, "MultiPoint" )==0 )
-    return parse_geojson_multipoint(geojson, hasz, root_srid);
+  r = rtalloc(ctx, sizeof(RTGEOJSON_READER));
+  memset(r, 0, sizeof(RTGEOJSON_READER));
+  s = &(r->s);
+  s->json = s->pos = geojson;
 
-  if( strcasecmp( name, "MultiLineString" )==0 )
-    return parse_geojson_multilinestring(geojson, hasz, root_srid);
+  if ( ! geojson_expect(ctx, s, '{') )
+    goto fail;
 
-  if( strcasecmp( name, "MultiPolygon" )==0 )
-    return parse_geojson_multipolygon(geojson, hasz, root_srid);
+  /* Look for the features of a FeatureCollection, wherever they are */
+  if ( ! geojson_accept(s, '}') ) do
+  {
+    if ( ! geojson_string(ctx, s, &key, &keylen) || ! geojson_expect(ctx, s, ':') )
+      goto fail;
+    if ( geojson_string_is(key, keylen, "features") )
+    {
+      if ( ! geojson_expect(ctx, s, '[') )
+        goto fail;
+      r->mode = RTGEOJSON_READER_FEATURES;
+      return r;
+    }
+    if ( ! geojson_skip_value(ctx, s) )
+      goto fail;
+  }
+  while ( geojson_accept(s, ',') );
 
-  if( strcasecmp( name, "GeometryCollection" )==0 )
-    return parse_geojson_geometrycollection(geojson, hasz, root_srid);
+  /* Otherwise a single Feature or geometry */
+  s->pos = geojson;
+  r->mode = RTGEOJSON_READER_SINGLE;
+  return r;
 
-  rterror(ctx, "invalid GeoJson representation");
-  return NULL; /* Never reach */
+fail:
+  rtfree(ctx, r);
+  return NULL;
 }
 
-#endif /* HAVE_LIBJSON or HAVE_LIBJSON_C --} */
-
-RTGEOM*
-rtgeom_from_geojson(const RTCTX *ctx, const char *geojson, char **srs)
+int
+rtgeojson_reader_next(const RTCTX *ctx, RTGEOJSON_READER *r, RTGEOJSON_FEATURE *feature)
 {
-#ifndef HAVE_LIBJSON
-  *srs = NULL;
-  rterror(ctx, "You need JSON-C for rtgeom_from_geojson");
-  return NULL;
-#else /* HAVE_LIBJSON */
-
-  /* size_t geojson_size = strlen(geojson); */
-
-  RTGEOM *rtgeom;
-  int hasz=RT_TRUE;
-  json_tokener* jstok = NULL;
-  json_object* poObj = NULL;
-  json_object* poObjSrs = NULL;
-  *srs = NULL;
-
-  /* Begin to Parse json */
-  jstok = json_tokener_new();
-  poObj = json_tokener_parse_ex(jstok, geojson, -1);
-  if( jstok->err != json_tokener_success)
-  {
-    char err[256];
-    snprintf(err, 256, "%s (at offset %d)", json_tokener_error_desc(jstok->err), jstok->char_offset);
-    json_tokener_free(jstok);
-    json_object_put(poObj);
-    geojson_rterror(err, 1);
-    return NULL;
-  }
-  json_tokener_free(jstok);
+  geojson_parse_state *s = &(r->s);
+  RTGEOM *geom;
+
+  memset(feature, 0, sizeof(RTGEOJSON_FEATURE));
+
+  if ( r->mode == RTGEOJSON_READER_DONE )
+    return 0;
+  if ( r->mode == RTGEOJSON_READER_FAILED )
+    return -1;
 
-  poObjSrs = findMemberByName( poObj, "crs" );
-  if (poObjSrs != NULL)
+  if ( r->mode == RTGEOJSON_READER_FEATURES )
   {
-    json_object* poObjSrsType = findMemberByName( poObjSrs, "type" );
-    if (poObjSrsType != NULL)
+    if ( geojson_accept(s, ']') )
     {
-      json_object* poObjSrsProps = findMemberByName( poObjSrs, "properties" );
-      if ( poObjSrsProps )
-      {
-        json_object* poNameURL = findMemberByName( poObjSrsProps, "name" );
-        if ( poNameURL )
-        {
-          const char* pszName = json_object_get_string( poNameURL );
-          if ( pszName )
-          {
-            *srs = rtalloc(ctx, strlen(pszName) + 1);
-            strcpy(*srs, pszName);
-          }
-        }
-      }
+      r->mode = RTGEOJSON_READER_DONE;
+      return 0;
+    }
+    if ( r->nfeatures && ! geojson_expect(ctx, s, ',') )
+    {
+      r->mode = RTGEOJSON_READER_FAILED;
+      return -1;
     }
   }
 
-  rtgeom = parse_geojson(poObj, &hasz, 0);
-  json_object_put(poObj);
-
-  rtgeom_add_bbox(ctx, rtgeom);
-
-  if (!hasz)
+  if ( ! geojson_parse_object(ctx, s, feature, &geom) )
   {
-    RTGEOM *tmp = rtgeom_force_2d(ctx, rtgeom);
-    rtgeom_free(ctx, rtgeom);
-    rtgeom = tmp;
-
-    RTDEBUG(ctx, 2, "geom_from_geojson called.");
+    memset(feature, 0, sizeof(RTGEOJSON_FEATURE));
+    r->mode = RTGEOJSON_READER_FAILED;
+    return -1;
   }
 
-  return rtgeom;
-#endif /* HAVE_LIBJSON } */
+  feature->geom = geom;
+  r->nfeatures++;
+  if ( r->mode == RTGEOJSON_READER_SINGLE )
+    r->mode = RTGEOJSON_READER_DONE;
+  return 1;
 }
 
-
+void
+rtgeojson_reader_free(const RTCTX *ctx, RTGEOJSON_READER *r)
+{
+  rtfree(ctx, r);
+}
@@ -175,8 +175,10 @@ static RTPOINTARRAY* ptarray_from_twkb_state(const RTCTX *ctx, twkb_parse_state
 {
   RTPOINTARRAY *pa = NULL;
   uint32_t ndims = s->ndims;
-  int i;
+  uint32_t i, j;
+  size_t size;
   double *dlist;
+  double factors[4];
 
   RTDEBUG(ctx, 2,"Entering ptarray_from_twkb_state");
   RTDEBUGF(ctx, 4,"Pointarray has %d points", npoints);
@@ -185,32 +187,42 @@ static RTPOINTARRAY* ptarray_from_twkb_state(const RTCTX *ctx, twkb_parse_state
   if( npoints == 0 )
     return ptarray_construct_empty(ctx, s->has_z, s->has_m, 0);
 
+  /* Each point takes at least one byte per ordinate */
+  if( (size_t)(s->twkb_end - s->pos) < (size_t)npoints * ndims )
+  {
+    rterror(ctx, "%s: TWKB structure does not match expected size!", __func__);
+    return NULL;
+  }
+
+  j = 0;
+  factors[j++] = s->factor;
+  factors[j++] = s->factor;
+  if ( s->has_z )
+    factors[j++] = s->factor_z;
+  if ( s->has_m )
+    factors[j++] = s->factor_m;
+
   pa = ptarray_construct(ctx, s->has_z, s->has_m, npoints);
   dlist = (double*)(pa->serialized_pointlist);
+
+  /* Decode all the deltas in one go, into the ordinate storage */
+  size = varint_s64_decode_n(ctx, s->pos, s->twkb_end, (int64_t*)dlist, (size_t)npoints * ndims);
+  if ( ! size )
+  {
+    ptarray_free(ctx, pa);
+    return NULL;
+  }
+  twkb_parse_state_advance(ctx, s, size);
+
+  /* Then turn them into coordinates in place */
   for( i = 0; i < npoints; i++ )
   {
-    int j = 0;
-    /* X */
-    s->coords[j] += twkb_parse_state_varint(ctx, s);
-    dlist[ndims*i + j] = s->coords[j] / s->factor;
-    j++;
-    /* Y */
-    s->coords[j] += twkb_parse_state_varint(ctx, s);
-    dlist[ndims*i + j] = s->coords[j] / s->factor;
-    j++;
-    /* Z */
-    if ( s->has_z )
+    for( j = 0; j < ndims; j++ )
     {
-      s->coords[j] += twkb_parse_state_varint(ctx, s);
-      dlist[ndims*i + j] = s->coords[j] / s->factor_z;
-      j++;
-    }
-    /* M */
-    if ( s->has_m )
-    {
-      s->coords[j] += twkb_parse_state_varint(ctx, s);
-      dlist[ndims*i + j] = s->coords[j] / s->factor_m;
-      j++;
+      int64_t delta;
+      memcpy(&delta, dlist + ndims*i + j, sizeof(int64_t));
+      s->coords[j] += delta;
+      dlist[ndims*i + j] = s->coords[j] / factors[j];
     }
   }
 
@@ -600,7 +612,7 @@ RTGEOM* rtgeom_from_twkb_state(const RTCTX *ctx, twkb_parse_state *s)
       bbox.zmax = bbox.zmin + twkb_parse_state_double(ctx, s, s->factor_z);
     }
     /* M */
-    if ( s->has_z )
+    if ( s->has_m )
     {
       bbox.mmin = twkb_parse_state_double(ctx, s, s->factor_m);
       bbox.mmax = bbox.mmin + twkb_parse_state_double(ctx, s, s->factor_m);
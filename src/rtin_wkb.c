@@ -44,9 +44,20 @@ typedef struct
   int has_z; /* Z? */
   int has_m; /* M? */
   int has_srid; /* SRID? */
+  int borrow; /* Reference native coordinates in place? */
+  int borrowed; /* Was any point array referenced in place? */
   const uint8_t *pos; /* Current parse position */
 } wkb_parse_state;
 
+/*
+* Borrowed coordinates are read in place through double pointers, and
+* RTWKB puts them at any byte offset. Only runs aligned for double are
+* borrowed, the rest is copied. Coordinates follow headers of 5, 9,
+* 13 bytes and so on, so in a buffer that is itself aligned they never
+* are.
+*/
+#define RTWKB_BORROWABLE(pos) ( ((size_t)(pos) % sizeof(double)) == 0 )
+
 
 /**
 * Internal function declarations.
@@ -130,27 +141,23 @@ static inline void wkb_parse_state_check(const RTCTX *ctx, wkb_parse_state *s, s
 }
 
 /**
-* Take in an unknown kind of wkb type number and ensure it comes out
-* as an extended RTWKB type number (with Z/M/SRID flags masked onto the
-* high bits).
+* Decode a wkb type number into an rttype and its Z/M/SRID flags.
+* Returns 0 on unknown types.
 */
-static void rttype_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s, uint32_t wkb_type)
+static uint32_t rttype_from_wkb_type(uint32_t wkb_type, int *has_z, int *has_m, int *has_srid)
 {
   uint32_t wkb_simple_type;
 
-  RTDEBUG(ctx, 4, "Entered function");
-
-  s->has_z = RT_FALSE;
-  s->has_m = RT_FALSE;
-  s->has_srid = RT_FALSE;
+  *has_z = RT_FALSE;
+  *has_m = RT_FALSE;
+  *has_srid = RT_FALSE;
 
   /* If any of the higher bits are set, this is probably an extended type. */
   if( wkb_type & 0xF0000000 )
   {
-    if( wkb_type & RTWKBZOFFSET ) s->has_z = RT_TRUE;
-    if( wkb_type & RTWKBMOFFSET ) s->has_m = RT_TRUE;
-    if( wkb_type & RTWKBSRIDFLAG ) s->has_srid = RT_TRUE;
-    RTDEBUGF(ctx, 4, "Extended type: has_z=%d has_m=%d has_srid=%d", s->has_z, s->has_m, s->has_srid);
+    if( wkb_type & RTWKBZOFFSET ) *has_z = RT_TRUE;
+    if( wkb_type & RTWKBMOFFSET ) *has_m = RT_TRUE;
+    if( wkb_type & RTWKBSRIDFLAG ) *has_srid = RT_TRUE;
   }
 
   /* Mask off the flags */
@@ -161,82 +168,80 @@ static void rttype_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s, uint32_t
   /* Extract the Z/M information from ISO style numbers */
   if( wkb_type >= 3000 && wkb_type < 4000 )
   {
-    s->has_z = RT_TRUE;
-    s->has_m = RT_TRUE;
+    *has_z = RT_TRUE;
+    *has_m = RT_TRUE;
   }
   else if ( wkb_type >= 2000 && wkb_type < 3000 )
   {
-    s->has_m = RT_TRUE;
+    *has_m = RT_TRUE;
   }
   else if ( wkb_type >= 1000 && wkb_type < 2000 )
   {
-    s->has_z = RT_TRUE;
+    *has_z = RT_TRUE;
   }
 
   switch (wkb_simple_type)
   {
     case RTWKB_POINT_TYPE:
-      s->rttype = RTPOINTTYPE;
-      break;
+      return RTPOINTTYPE;
     case RTWKB_LINESTRING_TYPE:
-      s->rttype = RTLINETYPE;
-      break;
+      return RTLINETYPE;
     case RTWKB_POLYGON_TYPE:
-      s->rttype = RTPOLYGONTYPE;
-      break;
+      return RTPOLYGONTYPE;
     case RTWKB_MULTIPOINT_TYPE:
-      s->rttype = RTMULTIPOINTTYPE;
-      break;
+      return RTMULTIPOINTTYPE;
     case RTWKB_MULTILINESTRING_TYPE:
-      s->rttype = RTMULTILINETYPE;
-      break;
+      return RTMULTILINETYPE;
     case RTWKB_MULTIPOLYGON_TYPE:
-      s->rttype = RTMULTIPOLYGONTYPE;
-      break;
+      return RTMULTIPOLYGONTYPE;
     case RTWKB_GEOMETRYCOLLECTION_TYPE:
-      s->rttype = RTCOLLECTIONTYPE;
-      break;
+      return RTCOLLECTIONTYPE;
     case RTWKB_CIRCULARSTRING_TYPE:
-      s->rttype = RTCIRCSTRINGTYPE;
-      break;
+      return RTCIRCSTRINGTYPE;
     case RTWKB_COMPOUNDCURVE_TYPE:
-      s->rttype = RTCOMPOUNDTYPE;
-      break;
+      return RTCOMPOUNDTYPE;
     case RTWKB_CURVEPOLYGON_TYPE:
-      s->rttype = RTCURVEPOLYTYPE;
-      break;
+      return RTCURVEPOLYTYPE;
     case RTWKB_MULTICURVE_TYPE:
-      s->rttype = RTMULTICURVETYPE;
-      break;
+      return RTMULTICURVETYPE;
     case RTWKB_MULTISURFACE_TYPE:
-      s->rttype = RTMULTISURFACETYPE;
-      break;
+      return RTMULTISURFACETYPE;
     case RTWKB_POLYHEDRALSURFACE_TYPE:
-      s->rttype = RTPOLYHEDRALSURFACETYPE;
-      break;
+      return RTPOLYHEDRALSURFACETYPE;
     case RTWKB_TIN_TYPE:
-      s->rttype = RTTINTYPE;
-      break;
+      return RTTINTYPE;
     case RTWKB_TRIANGLE_TYPE:
-      s->rttype = RTTRIANGLETYPE;
-      break;
+      return RTTRIANGLETYPE;
 
     /* PostGIS 1.5 emits 13, 14 for CurvePolygon, MultiCurve */
     /* These numbers aren't SQL/MM (numbers currently only */
     /* go up to 12. We can handle the old data here (for now??) */
     /* converting them into the rttypes that are intended. */
     case RTWKB_CURVE_TYPE:
-      s->rttype = RTCURVEPOLYTYPE;
-      break;
+      return RTCURVEPOLYTYPE;
     case RTWKB_SURFACE_TYPE:
-      s->rttype = RTMULTICURVETYPE;
-      break;
-
-    default: /* Error! */
-      rterror(ctx, "Unknown RTWKB type (%d)! Full RTWKB type number was (%d).", wkb_simple_type, wkb_type);
-      break;
+      return RTMULTICURVETYPE;
   }
 
+  return 0;
+}
+
+/**
+* Take in an unknown kind of wkb type number and ensure it comes out
+* as an extended RTWKB type number (with Z/M/SRID flags masked onto the
+* high bits).
+*/
+static void rttype_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s, uint32_t wkb_type)
+{
+  RTDEBUG(ctx, 4, "Entered function");
+
+  s->rttype = rttype_from_wkb_type(wkb_type, &(s->has_z), &(s->has_m), &(s->has_srid));
+  RTDEBUGF(ctx, 4, "Type flags: has_z=%d has_m=%d has_srid=%d", s->has_z, s->has_m, s->has_srid);
+
+  /* Error! */
+  if ( ! s->rttype )
+    rterror(ctx, "Unknown RTWKB type (%d)! Full RTWKB type number was (%d).", (wkb_type & 0x0FFFFFFF) % 1000, wkb_type & 0x0FFFFFFF);
+
   RTDEBUGF(ctx, 4,"Got rttype %s (%u)", rttype_name(ctx, s->rttype), s->rttype);
 
   return;
@@ -322,6 +327,20 @@ static double double_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s)
   return d;
 }
 
+/**
+* Native endian coordinates at the parse position, referenced in place
+* when the state borrows, copied otherwise.
+*/
+static RTPOINTARRAY* ptarray_from_wkb_state_native(const RTCTX *ctx, wkb_parse_state *s, uint32_t npoints)
+{
+  if( s->borrow && RTWKB_BORROWABLE(s->pos) )
+  {
+    s->borrowed = RT_TRUE;
+    return ptarray_construct_reference_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
+  }
+  return ptarray_construct_copy_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
+}
+
 /**
 * RTPOINTARRAY
 * Read a dynamically sized point array and advance the parse state forward.
@@ -350,10 +369,10 @@ static RTPOINTARRAY* ptarray_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s
   /* Does the data we want to read exist? */
   wkb_parse_state_check(ctx, s, pa_size);
 
-  /* If we're in a native endianness, we can just copy the data directly! */
+  /* If we're in a native endianness, we can just copy (or borrow) the data directly! */
   if( ! s->swap_bytes )
   {
-    pa = ptarray_construct_copy_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
+    pa = ptarray_from_wkb_state_native(ctx, s, npoints);
     s->pos += pa_size;
   }
   /* Otherwise we have to read each double, separately. */
@@ -397,10 +416,10 @@ static RTPOINT* rtpoint_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s)
   /* Does the data we want to read exist? */
   wkb_parse_state_check(ctx, s, pa_size);
 
-  /* If we're in a native endianness, we can just copy the data directly! */
+  /* If we're in a native endianness, we can just copy (or borrow) the data directly! */
   if( ! s->swap_bytes )
   {
-    pa = ptarray_construct_copy_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
+    pa = ptarray_from_wkb_state_native(ctx, s, npoints);
     s->pos += pa_size;
   }
   /* Otherwise we have to read each double, separately */
@@ -761,9 +780,10 @@ RTGEOM* rtgeom_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s)
 * Check is a bitmask of: RT_PARSER_CHECK_MINPOINTS, RT_PARSER_CHECK_ODD,
 * RT_PARSER_CHECK_CLOSURE, RT_PARSER_CHECK_NONE, RT_PARSER_CHECK_ALL
 */
-RTGEOM* rtgeom_from_wkb(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_size, const char check)
+static RTGEOM* rtgeom_from_wkb_common(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_size, const char check, int borrow, int *borrowed)
 {
   wkb_parse_state s;
+  RTGEOM *geom;
 
   /* Initialize the state appropriately */
   s.wkb = wkb;
@@ -775,6 +795,8 @@ RTGEOM* rtgeom_from_wkb(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_s
   s.has_z = RT_FALSE;
   s.has_m = RT_FALSE;
   s.has_srid = RT_FALSE;
+  s.borrow = borrow;
+  s.borrowed = RT_FALSE;
   s.pos = wkb;
 
   /* Hand the check catch-all values */
@@ -783,7 +805,20 @@ RTGEOM* rtgeom_from_wkb(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_s
   else
     s.check = check;
 
-  return rtgeom_from_wkb_state(ctx, &s);
+  geom = rtgeom_from_wkb_state(ctx, &s);
+  if ( borrowed )
+    *borrowed = geom && s.borrowed;
+  return geom;
+}
+
+RTGEOM* rtgeom_from_wkb(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_size, const char check)
+{
+  return rtgeom_from_wkb_common(ctx, wkb, wkb_size, check, RT_FALSE, NULL);
+}
+
+RTGEOM* rtgeom_from_wkb_reference(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_size, const char check, int *borrowed)
+{
+  return rtgeom_from_wkb_common(ctx, wkb, wkb_size, check, RT_TRUE, borrowed);
 }
 
 RTGEOM* rtgeom_from_hexwkb(const RTCTX *ctx, const char *hexwkb, const char check)
@@ -804,3 +839,373 @@ RTGEOM* rtgeom_from_hexwkb(const RTCTX *ctx, const char *hexwkb, const char chec
   rtfree(ctx, wkb);
   return rtgeom;
 }
+
+
+/**********************************************************************
+* Streaming reader: records are framed by walking their structure
+* (concatenated streams) or by a 4-byte little endian length prefix,
+* and only complete records are handed to the parser.
+*/
+
+/* Nesting deeper than this is taken as garbage */
+#define RTWKB_SCAN_MAX_DEPTH 64
+
+struct RTWKB_READER_T
+{
+  uint8_t *buf; /* Buffered bytes, consumed ones at the front */
+  size_t size; /* Bytes in buf */
+  size_t capacity;
+  size_t start; /* First unconsumed byte */
+  size_t need; /* Unconsumed bytes needed before the next try */
+  size_t offset; /* Stream offset of buf[0], for error messages */
+  int framing;
+  int borrow;
+  char check;
+  uint32_t type_mask; /* Bits of the rttypes to return, 0 for all */
+  int has_box;
+  RTGBOX box; /* Records not touching this box are skipped */
+  int failed; /* Stream is out of sync, nothing more can be read */
+  wkb_parse_state s; /* Reused for every record */
+};
+
+/**
+* Structure walk over a record that may not be complete yet. Nothing
+* is allocated; coordinates are only looked at to build the extent.
+*/
+typedef struct
+{
+  const uint8_t *wkb;
+  size_t size; /* Bytes available */
+  size_t pos; /* Bytes walked, or bytes needed once short */
+  int machine_ndr;
+  uint32_t rttype; /* Type of the outer geometry */
+  int want_extent;
+  int has_extent;
+  double xmin, xmax, ymin, ymax;
+} wkb_scan_state;
+
+/* Scan results */
+#define RTWKB_SCAN_SHORT 0
+#define RTWKB_SCAN_DONE 1
+#define RTWKB_SCAN_INVALID -1
+
+static void wkb_scan_swap(uint8_t *bytes, int n)
+{
+  int i;
+  uint8_t tmp;
+
+  for ( i = 0; i < n / 2; i++ )
+  {
+    tmp = bytes[i];
+    bytes[i] = bytes[n - i - 1];
+    bytes[n - i - 1] = tmp;
+  }
+}
+
+static int wkb_scan_integer(wkb_scan_state *s, int swap, uint32_t *i)
+{
+  if ( s->size - s->pos < RTWKB_INT_SIZE )
+  {
+    s->pos += RTWKB_INT_SIZE;
+    return RTWKB_SCAN_SHORT;
+  }
+  memcpy(i, s->wkb + s->pos, RTWKB_INT_SIZE);
+  if ( swap )
+    wkb_scan_swap((uint8_t*)i, RTWKB_INT_SIZE);
+  s->pos += RTWKB_INT_SIZE;
+  return RTWKB_SCAN_DONE;
+}
+
+static int wkb_scan_points(wkb_scan_state *s, int swap, int ndims, uint32_t npoints)
+{
+  size_t stride = ndims * RTWKB_DOUBLE_SIZE;
+  const uint8_t *p;
+  double x, y;
+  uint32_t i;
+
+  if ( npoints > (SIZE_MAX - s->pos) / stride )
+    return RTWKB_SCAN_INVALID;
+  if ( s->size - s->pos < npoints * stride )
+  {
+    s->pos += npoints * stride;
+    return RTWKB_SCAN_SHORT;
+  }
+
+  if ( s->want_extent )
+  {
+    p = s->wkb + s->pos;
+    for ( i = 0; i < npoints; i++, p += stride )
+    {
+      memcpy(&x, p, RTWKB_DOUBLE_SIZE);
+      memcpy(&y, p + RTWKB_DOUBLE_SIZE, RTWKB_DOUBLE_SIZE);
+      if ( swap )
+      {
+        wkb_scan_swap((uint8_t*)&x, RTWKB_DOUBLE_SIZE);
+        wkb_scan_swap((uint8_t*)&y, RTWKB_DOUBLE_SIZE);
+      }
+      /* Empty points are NaN */
+      if ( isnan(x) || isnan(y) )
+        continue;
+      if ( ! s->has_extent )
+      {
+        s->xmin = s->xmax = x;
+        s->ymin = s->ymax = y;
+        s->has_extent = RT_TRUE;
+        continue;
+      }
+      s->xmin = FP_MIN(s->xmin, x);
+      s->xmax = FP_MAX(s->xmax, x);
+      s->ymin = FP_MIN(s->ymin, y);
+      s->ymax = FP_MAX(s->ymax, y);
+    }
+  }
+
+  s->pos += npoints * stride;
+  return RTWKB_SCAN_DONE;
+}
+
+static int wkb_scan_record(wkb_scan_state *s, int depth)
+{
+  uint32_t wkb_type, rttype, n, nrings, i;
+  int has_z, has_m, has_srid, swap, ndims, ret;
+  uint8_t endian;
+
+  if ( depth > RTWKB_SCAN_MAX_DEPTH )
+    return RTWKB_SCAN_INVALID;
+
+  if ( s->size - s->pos < RTWKB_BYTE_SIZE )
+  {
+    s->pos += RTWKB_BYTE_SIZE;
+    return RTWKB_SCAN_SHORT;
+  }
+  endian = s->wkb[s->pos];
+  if ( endian != 0 && endian != 1 )
+    return RTWKB_SCAN_INVALID;
+  swap = ( endian != s->machine_ndr );
+  s->pos += RTWKB_BYTE_SIZE;
+
+  if ( (ret = wkb_scan_integer(s, swap, &wkb_type)) != RTWKB_SCAN_DONE )
+    return ret;
+  rttype = rttype_from_wkb_type(wkb_type, &has_z, &has_m, &has_srid);
+  if ( ! rttype )
+    return RTWKB_SCAN_INVALID;
+  if ( depth == 0 )
+    s->rttype = rttype;
+  if ( has_srid && (ret = wkb_scan_integer(s, swap, &n)) != RTWKB_SCAN_DONE )
+    return ret;
+  ndims = 2 + has_z + has_m;
+
+  switch ( rttype )
+  {
+    case RTPOINTTYPE:
+      return wkb_scan_points(s, swap, ndims, 1);
+
+    case RTLINETYPE:
+    case RTCIRCSTRINGTYPE:
+      if ( (ret = wkb_scan_integer(s, swap, &n)) != RTWKB_SCAN_DONE )
+        return ret;
+      return wkb_scan_points(s, swap, ndims, n);
+
+    case RTPOLYGONTYPE:
+    case RTTRIANGLETYPE:
+      if ( (ret = wkb_scan_integer(s, swap, &nrings)) != RTWKB_SCAN_DONE )
+        return ret;
+      for ( i = 0; i < nrings; i++ )
+      {
+        if ( (ret = wkb_scan_integer(s, swap, &n)) != RTWKB_SCAN_DONE )
+          return ret;
+        if ( (ret = wkb_scan_points(s, swap, ndims, n)) != RTWKB_SCAN_DONE )
+          return ret;
+      }
+      return RTWKB_SCAN_DONE;
+
+    default:
+      /* Curve polygons and collections hold full records */
+      if ( (ret = wkb_scan_integer(s, swap, &n)) != RTWKB_SCAN_DONE )
+        return ret;
+      for ( i = 0; i < n; i++ )
+      {
+        if ( (ret = wkb_scan_record(s, depth + 1)) != RTWKB_SCAN_DONE )
+          return ret;
+      }
+      return RTWKB_SCAN_DONE;
+  }
+}
+
+RTWKB_READER* rtwkb_reader_new(const RTCTX *ctx, int framing, const char check, int borrow)
+{
+  RTWKB_READER *r;
+
+  if ( framing != RTWKB_STREAM_CONCATENATED && framing != RTWKB_STREAM_LENGTH_PREFIXED )
+  {
+    rterror(ctx, "%s: unknown framing %d", __func__, framing);
+    return NULL;
+  }
+
+  r = rtalloc(ctx, sizeof(RTWKB_READER));
+  memset(r, 0, sizeof(RTWKB_READER));
+  r->framing = framing;
+  r->borrow = borrow;
+  r->check = ( check & RT_PARSER_CHECK_NONE ) ? 0 : check;
+  return r;
+}
+
+void rtwkb_reader_free(const RTCTX *ctx, RTWKB_READER *r)
+{
+  if ( ! r ) return;
+  if ( r->buf )
+    rtfree(ctx, r->buf);
+  rtfree(ctx, r);
+}
+
+void rtwkb_reader_set_filter(const RTCTX *ctx, RTWKB_READER *r, uint32_t type_mask, const RTGBOX *box)
+{
+  r->type_mask = type_mask;
+  r->has_box = ( box != NULL );
+  if ( box )
+    r->box = *box;
+}
+
+int rtwkb_reader_feed(const RTCTX *ctx, RTWKB_READER *r, const uint8_t *bytes, size_t size)
+{
+  size_t capacity;
+
+  if ( r->failed )
+  {
+    rterror(ctx, "%s: stream is out of sync", __func__);
+    return RT_FAILURE;
+  }
+  if ( ! size )
+    return RT_SUCCESS;
+
+  /* Drop what has been consumed, views handed out so far go with it */
+  if ( r->start )
+  {
+    memmove(r->buf, r->buf + r->start, r->size - r->start);
+    r->size -= r->start;
+    r->offset += r->start;
+    r->start = 0;
+  }
+
+  if ( size > r->capacity - r->size )
+  {
+    capacity = r->capacity ? r->capacity : 4096;
+    while ( capacity < r->size + size )
+      capacity *= 2;
+    if ( r->buf )
+      r->buf = rtrealloc(ctx, r->buf, capacity);
+    else
+      r->buf = rtalloc(ctx, capacity);
+    r->capacity = capacity;
+  }
+
+  memcpy(r->buf + r->size, bytes, size);
+  r->size += size;
+  return RT_SUCCESS;
+}
+
+size_t rtwkb_reader_pending(const RTCTX *ctx, const RTWKB_READER *r)
+{
+  return r->size - r->start;
+}
+
+RTGEOM* rtwkb_reader_next(const RTCTX *ctx, RTWKB_READER *r)
+{
+  wkb_scan_state scan;
+  const uint8_t *rec;
+  size_t avail, prefix, len;
+  int ret, filter;
+
+  filter = ( r->type_mask || r->has_box );
+  scan.machine_ndr = ( getMachineEndian(ctx) == NDR );
+
+  while ( ! r->failed )
+  {
+    avail = r->size - r->start;
+    if ( ! avail || avail < r->need )
+      return NULL;
+    rec = r->buf + r->start;
+
+    scan.wkb = rec;
+    scan.size = avail;
+    scan.pos = 0;
+    scan.rttype = 0;
+    scan.want_extent = r->has_box;
+    scan.has_extent = RT_FALSE;
+
+    if ( r->framing == RTWKB_STREAM_LENGTH_PREFIXED )
+    {
+      if ( avail < RTWKB_INT_SIZE )
+      {
+        r->need = RTWKB_INT_SIZE;
+        return NULL;
+      }
+      len = (size_t)rec[0] | ((size_t)rec[1] << 8) |
+            ((size_t)rec[2] << 16) | ((size_t)rec[3] << 24);
+      prefix = RTWKB_INT_SIZE;
+      if ( avail - prefix < len )
+      {
+        r->need = prefix + len;
+        return NULL;
+      }
+      rec += prefix;
+      /* The prefix frames the record, only filters need the walk */
+      if ( filter )
+      {
+        scan.wkb = rec;
+        scan.size = len;
+        ret = wkb_scan_record(&scan, 0);
+        if ( ret != RTWKB_SCAN_DONE || scan.pos != len )
+          ret = RTWKB_SCAN_INVALID;
+      }
+      else
+        ret = RTWKB_SCAN_DONE;
+    }
+    else
+    {
+      prefix = 0;
+      ret = wkb_scan_record(&scan, 0);
+      if ( ret == RTWKB_SCAN_SHORT )
+      {
+        r->need = scan.pos;
+        return NULL;
+      }
+      len = scan.pos;
+    }
+
+    if ( ret == RTWKB_SCAN_INVALID )
+    {
+      r->failed = RT_TRUE;
+      rterror(ctx, "%s: invalid RTWKB record at stream offset %lu", __func__,
+              (unsigned long)(r->offset + r->start));
+      return NULL;
+    }
+
+    r->start += prefix + len;
+    r->need = 0;
+
+    if ( r->type_mask && ! (r->type_mask & RTWKB_READER_TYPE(scan.rttype)) )
+      continue;
+    if ( r->has_box && ( ! scan.has_extent ||
+         scan.xmax < r->box.xmin || scan.xmin > r->box.xmax ||
+         scan.ymax < r->box.ymin || scan.ymin > r->box.ymax ) )
+      continue;
+
+    r->s.wkb = rec;
+    r->s.wkb_size = len;
+    r->s.swap_bytes = RT_FALSE;
+    r->s.check = r->check;
+    r->s.rttype = 0;
+    r->s.srid = SRID_UNKNOWN;
+    r->s.has_z = RT_FALSE;
+    r->s.has_m = RT_FALSE;
+    r->s.has_srid = RT_FALSE;
+    r->s.borrow = r->borrow;
+    r->s.borrowed = RT_FALSE;
+    r->s.pos = rec;
+
+    return rtgeom_from_wkb_state(ctx, &(r->s));
+  }
+
+  return NULL;
+}
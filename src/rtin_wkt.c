@@ -0,0 +1,915 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+
+
+#include "rttopo_config.h"
+/*#define RTGEOM_DEBUG_LEVEL 4*/
+#include "librttopo_geom_internal.h" /* NOTE: includes rtgeom_log.h */
+#include "rtgeom_log.h"
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* Hand written, single pass reader for ISO, SFSQL and extended RTWKT.
+* Coordinates go straight from the text into point arrays sized up
+* front by counting the points of each list, and nothing is allocated
+* for tokens along the way.
+*/
+
+/**
+* Used for passing the parse state between the parsing functions.
+*/
+typedef struct
+{
+  const char *wkt; /* Start of the input, for error positions */
+  const char *pos; /* Current parse position */
+  int check; /* Simple validity checks on geometries */
+  int srid; /* SRID from the EWKT prefix */
+  int has_z; /* Z? */
+  int has_m; /* M? */
+  int ndims; /* Ordinates per point, 0 until declared or first seen */
+  int depth; /* Nesting depth, to bound the recursion */
+} wkt_parse_state;
+
+/**
+* Growable list of parsed sub-geometries.
+*/
+typedef struct
+{
+  RTGEOM **geoms;
+  uint32_t ngeoms;
+  uint32_t maxgeoms;
+} wkt_geom_list;
+
+#define RTWKT_MAX_DEPTH 64
+
+static const struct
+{
+  const char *name;
+  uint8_t type;
+} wkt_types[] =
+{
+  { "POINT", RTPOINTTYPE },
+  { "LINESTRING", RTLINETYPE },
+  { "POLYGON", RTPOLYGONTYPE },
+  { "MULTIPOINT", RTMULTIPOINTTYPE },
+  { "MULTILINESTRING", RTMULTILINETYPE },
+  { "MULTIPOLYGON", RTMULTIPOLYGONTYPE },
+  { "GEOMETRYCOLLECTION", RTCOLLECTIONTYPE },
+  { "CIRCULARSTRING", RTCIRCSTRINGTYPE },
+  { "COMPOUNDCURVE", RTCOMPOUNDTYPE },
+  { "CURVEPOLYGON", RTCURVEPOLYTYPE },
+  { "MULTICURVE", RTMULTICURVETYPE },
+  { "MULTISURFACE", RTMULTISURFACETYPE },
+  { "POLYHEDRALSURFACE", RTPOLYHEDRALSURFACETYPE },
+  { "TRIANGLE", RTTRIANGLETYPE },
+  { "TIN", RTTINTYPE }
+};
+
+/* Powers of ten that are exact in a double */
+static const double wkt_pow10[] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static RTGEOM* wkt_parse_body(const RTCTX *ctx, wkt_parse_state *s, uint8_t type);
+
+#define WKT_IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define WKT_IS_ALPHA(c) (((c) >= 'A' && (c) <= 'Z') || ((c) >= 'a' && (c) <= 'z'))
+#define WKT_UPPER(c) (((c) >= 'a' && (c) <= 'z') ? (c) - 'a' + 'A' : (c))
+
+static void wkt_error(const RTCTX *ctx, const wkt_parse_state *s, const char *msg)
+{
+  rterror(ctx, "%s at character %d of RTWKT input", msg, (int)(s->pos - s->wkt));
+}
+
+static inline void wkt_skip_space(wkt_parse_state *s)
+{
+  while ( *s->pos == ' ' || *s->pos == '\t' || *s->pos == '\n' || *s->pos == '\r' )
+    s->pos++;
+}
+
+/**
+* Length of the run of letters at the current position.
+*/
+static int wkt_word_length(const wkt_parse_state *s)
+{
+  int len = 0;
+  while ( WKT_IS_ALPHA(s->pos[len]) )
+    len++;
+  return len;
+}
+
+/**
+* Case insensitive comparison of a word against an upper case keyword.
+*/
+static int wkt_word_is(const char *word, int len, const char *keyword)
+{
+  int i;
+  for ( i = 0; i < len; i++ )
+  {
+    if ( ! keyword[i] || WKT_UPPER(word[i]) != keyword[i] )
+      return RT_FALSE;
+  }
+  return keyword[len] == '\0';
+}
+
+/**
+* Consume the keyword if it is the next word.
+*/
+static int wkt_accept_word(wkt_parse_state *s, const char *keyword)
+{
+  int len;
+  wkt_skip_space(s);
+  len = wkt_word_length(s);
+  if ( len && wkt_word_is(s->pos, len, keyword) )
+  {
+    s->pos += len;
+    return RT_TRUE;
+  }
+  return RT_FALSE;
+}
+
+static int wkt_accept(wkt_parse_state *s, char c)
+{
+  wkt_skip_space(s);
+  if ( *s->pos != c )
+    return RT_FALSE;
+  s->pos++;
+  return RT_TRUE;
+}
+
+static int wkt_expect(const RTCTX *ctx, wkt_parse_state *s, char c)
+{
+  if ( wkt_accept(s, c) )
+    return RT_SUCCESS;
+  if ( c == '(' )
+    wkt_error(ctx, s, "Expected '('");
+  else if ( c == ')' )
+    wkt_error(ctx, s, "Expected ')'");
+  else
+    wkt_error(ctx, s, "Unexpected character");
+  return RT_FAILURE;
+}
+
+/**
+* Fix the dimensionality, or check it against what was fixed before.
+*/
+static int wkt_set_dims(const RTCTX *ctx, wkt_parse_state *s, int has_z, int has_m)
+{
+  if ( s->ndims )
+  {
+    if ( s->has_z != has_z || s->has_m != has_m )
+    {
+      wkt_error(ctx, s, "Mixed dimensionality");
+      return RT_FAILURE;
+    }
+    return RT_SUCCESS;
+  }
+  s->has_z = has_z;
+  s->has_m = has_m;
+  s->ndims = 2 + has_z + has_m;
+  return RT_SUCCESS;
+}
+
+/**
+* Read a geometry type keyword with its dimensionality, either attached
+* (POINTM, extended RTWKT) or as a separate token (POINT ZM, ISO RTWKT).
+*/
+static int wkt_parse_type(const RTCTX *ctx, wkt_parse_state *s, uint8_t *type)
+{
+  const char *word;
+  size_t i;
+  int len, n;
+  int has_z = RT_FALSE, has_m = RT_FALSE, declared = RT_FALSE;
+
+  wkt_skip_space(s);
+  word = s->pos;
+  len = wkt_word_length(s);
+
+  for ( i = 0; i < sizeof(wkt_types) / sizeof(wkt_types[0]); i++ )
+  {
+    n = strlen(wkt_types[i].name);
+    if ( len < n || len > n + 2 || ! wkt_word_is(word, n, wkt_types[i].name) )
+      continue;
+    /* Attached dimension suffix */
+    if ( len == n )
+      break;
+    if ( wkt_word_is(word + n, len - n, "M") )
+      has_m = declared = RT_TRUE;
+    else if ( wkt_word_is(word + n, len - n, "Z") )
+      has_z = declared = RT_TRUE;
+    else if ( wkt_word_is(word + n, len - n, "ZM") )
+      has_z = has_m = declared = RT_TRUE;
+    else
+      continue;
+    break;
+  }
+
+  if ( i == sizeof(wkt_types) / sizeof(wkt_types[0]) )
+  {
+    wkt_error(ctx, s, "Unknown geometry type");
+    return RT_FAILURE;
+  }
+  *type = wkt_types[i].type;
+  s->pos += len;
+
+  /* Separate dimension token */
+  if ( ! declared )
+  {
+    if ( wkt_accept_word(s, "ZM") )
+      has_z = has_m = declared = RT_TRUE;
+    else if ( wkt_accept_word(s, "Z") )
+      has_z = declared = RT_TRUE;
+    else if ( wkt_accept_word(s, "M") )
+      has_m = declared = RT_TRUE;
+  }
+
+  if ( declared )
+    return wkt_set_dims(ctx, s, has_z, has_m);
+
+  return RT_SUCCESS;
+}
+
+/**
+* Parse a number, returning the position after it or NULL if there is
+* none. Up to 19 significant digits and a power of ten that is exact
+* in a double give a correctly rounded result with a single multiply
+* or divide; anything else goes through strtod.
+*/
+const char*
+rtparse_double(const RTCTX *ctx, const char *p, double *d)
+{
+  const char *start = p;
+  uint64_t mantissa = 0;
+  int digits = 0, ndigits = 0, exp10 = 0, truncated = RT_FALSE, negative = RT_FALSE;
+
+  if ( *p == '-' || *p == '+' )
+    negative = ( *p++ == '-' );
+
+  for ( ; WKT_IS_DIGIT(*p); p++, digits++ )
+  {
+    if ( ndigits < 19 )
+    {
+      mantissa = mantissa * 10 + (*p - '0');
+      if ( mantissa )
+        ndigits++;
+    }
+    else
+    {
+      exp10++;
+      if ( *p != '0' )
+        truncated = RT_TRUE;
+    }
+  }
+
+  if ( *p == '.' )
+  {
+    for ( p++; WKT_IS_DIGIT(*p); p++, digits++ )
+    {
+      if ( ndigits < 19 )
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        if ( mantissa )
+          ndigits++;
+        exp10--;
+      }
+      else if ( *p != '0' )
+        truncated = RT_TRUE;
+    }
+  }
+
+  if ( ! digits )
+    return NULL;
+
+  if ( *p == 'e' || *p == 'E' )
+  {
+    const char *q = p + 1;
+    int e = 0, eneg = RT_FALSE;
+    if ( *q == '-' || *q == '+' )
+      eneg = ( *q++ == '-' );
+    if ( WKT_IS_DIGIT(*q) )
+    {
+      for ( ; WKT_IS_DIGIT(*q); q++ )
+      {
+        if ( e < 100000 )
+          e = e * 10 + (*q - '0');
+      }
+      exp10 += eneg ? -e : e;
+      p = q;
+    }
+  }
+
+  if ( ! truncated && mantissa <= ((uint64_t)1 << 53) && exp10 >= -22 && exp10 <= 22 )
+  {
+    double v = (double)mantissa;
+    v = exp10 < 0 ? v / wkt_pow10[-exp10] : v * wkt_pow10[exp10];
+    *d = negative ? -v : v;
+    return p;
+  }
+
+  /* Slow path, with the decimal point the C library expects */
+  {
+    char buf[64];
+    char *num = buf;
+    size_t len = p - start, i;
+    char point = localeconv()->decimal_point[0];
+
+    if ( len >= sizeof(buf) )
+      num = rtalloc(ctx, len + 1);
+    for ( i = 0; i < len; i++ )
+      num[i] = ( start[i] == '.' ) ? point : start[i];
+    num[len] = '\0';
+    *d = strtod(num, NULL);
+    if ( num != buf )
+      rtfree(ctx, num);
+  }
+  return p;
+}
+
+/**
+* Read one point into ords, fixing the dimensionality on the first
+* point seen and checking it on all later ones.
+*/
+static int wkt_parse_coord(const RTCTX *ctx, wkt_parse_state *s, double *ords)
+{
+  const char *end;
+  int n = 0;
+
+  for (;;)
+  {
+    wkt_skip_space(s);
+    if ( ! ( WKT_IS_DIGIT(*s->pos) || *s->pos == '-' || *s->pos == '+' || *s->pos == '.' ) )
+      break;
+    if ( n == 4 )
+    {
+      wkt_error(ctx, s, "Too many ordinates");
+      return RT_FAILURE;
+    }
+    end = rtparse_double(ctx, s->pos, &ords[n]);
+    if ( ! end )
+    {
+      wkt_error(ctx, s, "Invalid number");
+      return RT_FAILURE;
+    }
+    s->pos = end;
+    n++;
+  }
+
+  if ( n < 2 )
+  {
+    wkt_error(ctx, s, "Expected a coordinate");
+    return RT_FAILURE;
+  }
+
+  if ( ! s->ndims )
+    return wkt_set_dims(ctx, s, n > 2, n > 3);
+
+  if ( n != s->ndims )
+  {
+    wkt_error(ctx, s, "Mixed dimensionality");
+    return RT_FAILURE;
+  }
+  return RT_SUCCESS;
+}
+
+/**
+* Parse a parenthesized list of points. The points are counted before
+* parsing, so the array gets its exact size in one allocation.
+*/
+static RTPOINTARRAY* wkt_parse_ptarray(const RTCTX *ctx, wkt_parse_state *s)
+{
+  RTPOINTARRAY *pa;
+  const char *p;
+  double ords[4];
+  uint32_t npoints = 1, i;
+  size_t size;
+
+  if ( ! wkt_expect(ctx, s, '(') )
+    return NULL;
+
+  for ( p = s->pos; *p && *p != ')' && *p != '('; p++ )
+  {
+    if ( *p == ',' )
+      npoints++;
+  }
+
+  if ( ! wkt_parse_coord(ctx, s, ords) )
+    return NULL;
+
+  pa = ptarray_construct(ctx, s->has_z, s->has_m, npoints);
+  size = s->ndims * sizeof(double);
+  memcpy(rt_getPoint_internal(ctx, pa, 0), ords, size);
+
+  for ( i = 1; i < npoints; i++ )
+  {
+    if ( ! wkt_expect(ctx, s, ',') || ! wkt_parse_coord(ctx, s, ords) )
+    {
+      ptarray_free(ctx, pa);
+      return NULL;
+    }
+    memcpy(rt_getPoint_internal(ctx, pa, i), ords, size);
+  }
+
+  if ( ! wkt_expect(ctx, s, ')') )
+  {
+    ptarray_free(ctx, pa);
+    return NULL;
+  }
+  return pa;
+}
+
+static int wkt_geom_list_add(const RTCTX *ctx, wkt_geom_list *list, RTGEOM *geom)
+{
+  if ( list->ngeoms == list->maxgeoms )
+  {
+    list->maxgeoms = list->maxgeoms ? list->maxgeoms * 2 : 4;
+    if ( list->geoms )
+      list->geoms = rtrealloc(ctx, list->geoms, list->maxgeoms * sizeof(RTGEOM*));
+    else
+      list->geoms = rtalloc(ctx, list->maxgeoms * sizeof(RTGEOM*));
+  }
+  list->geoms[list->ngeoms++] = geom;
+  return RT_SUCCESS;
+}
+
+static void wkt_geom_list_free(const RTCTX *ctx, wkt_geom_list *list)
+{
+  uint32_t i;
+  for ( i = 0; i < list->ngeoms; i++ )
+    rtgeom_free(ctx, list->geoms[i]);
+  if ( list->geoms )
+    rtfree(ctx, list->geoms);
+}
+
+/**
+* POINT
+*/
+static RTGEOM* wkt_parse_point(const RTCTX *ctx, wkt_parse_state *s)
+{
+  RTPOINTARRAY *pa = wkt_parse_ptarray(ctx, s);
+
+  if ( ! pa )
+    return NULL;
+
+  if ( pa->npoints != 1 )
+  {
+    ptarray_free(ctx, pa);
+    wkt_error(ctx, s, "POINT must have exactly one point");
+    return NULL;
+  }
+  return rtpoint_as_rtgeom(ctx, rtpoint_construct(ctx, s->srid, NULL, pa));
+}
+
+/**
+* LINESTRING, CIRCULARSTRING
+*/
+static RTGEOM* wkt_parse_line(const RTCTX *ctx, wkt_parse_state *s, uint8_t type)
+{
+  RTPOINTARRAY *pa = wkt_parse_ptarray(ctx, s);
+
+  if ( ! pa )
+    return NULL;
+
+  if ( type == RTLINETYPE )
+  {
+    if ( s->check & RT_PARSER_CHECK_MINPOINTS && pa->npoints < 2 )
+    {
+      ptarray_free(ctx, pa);
+      rterror(ctx, "%s must have at least two points", rttype_name(ctx, type));
+      return NULL;
+    }
+    return rtline_as_rtgeom(ctx, rtline_construct(ctx, s->srid, NULL, pa));
+  }
+
+  if ( s->check & RT_PARSER_CHECK_MINPOINTS && pa->npoints < 3 )
+  {
+    ptarray_free(ctx, pa);
+    rterror(ctx, "%s must have at least three points", rttype_name(ctx, type));
+    return NULL;
+  }
+
+  if ( s->check & RT_PARSER_CHECK_ODD && ! (pa->npoints % 2) )
+  {
+    ptarray_free(ctx, pa);
+    rterror(ctx, "%s must have an odd number of points", rttype_name(ctx, type));
+    return NULL;
+  }
+  return rtcircstring_as_rtgeom(ctx, rtcircstring_construct(ctx, s->srid, NULL, pa));
+}
+
+/**
+* Parse a closed ring of a POLYGON or TRIANGLE and run the ring checks.
+*/
+static RTPOINTARRAY* wkt_parse_ring(const RTCTX *ctx, wkt_parse_state *s, uint8_t type)
+{
+  RTPOINTARRAY *pa = wkt_parse_ptarray(ctx, s);
+
+  if ( ! pa )
+    return NULL;
+
+  if ( s->check & RT_PARSER_CHECK_MINPOINTS && pa->npoints < 4 )
+  {
+    ptarray_free(ctx, pa);
+    rterror(ctx, "%s must have at least four points in each ring", rttype_name(ctx, type));
+    return NULL;
+  }
+
+  if ( ( s->check & RT_PARSER_CHECK_CLOSURE && ! ptarray_is_closed_2d(ctx, pa) ) ||
+       ( s->check & RT_PARSER_CHECK_ZCLOSURE && ! ptarray_is_closed_z(ctx, pa) ) )
+  {
+    ptarray_free(ctx, pa);
+    rterror(ctx, "%s must have closed rings", rttype_name(ctx, type));
+    return NULL;
+  }
+  return pa;
+}
+
+/**
+* POLYGON
+*/
+static RTGEOM* wkt_parse_polygon(const RTCTX *ctx, wkt_parse_state *s)
+{
+  RTPOINTARRAY **rings = NULL, *pa;
+  uint32_t nrings = 0, maxrings = 0, i;
+
+  if ( ! wkt_expect(ctx, s, '(') )
+    return NULL;
+
+  do
+  {
+    pa = wkt_parse_ring(ctx, s, RTPOLYGONTYPE);
+    if ( ! pa )
+      break;
+    if ( nrings == maxrings )
+    {
+      maxrings = maxrings ? maxrings * 2 : 1;
+      if ( rings )
+        rings = rtrealloc(ctx, rings, maxrings * sizeof(RTPOINTARRAY*));
+      else
+        rings = rtalloc(ctx, maxrings * sizeof(RTPOINTARRAY*));
+    }
+    rings[nrings++] = pa;
+  }
+  while ( wkt_accept(s, ',') );
+
+  if ( ! pa || ! wkt_expect(ctx, s, ')') )
+  {
+    for ( i = 0; i < nrings; i++ )
+      ptarray_free(ctx, rings[i]);
+    if ( rings )
+      rtfree(ctx, rings);
+    return NULL;
+  }
+  return rtpoly_as_rtgeom(ctx, rtpoly_construct(ctx, s->srid, NULL, nrings, rings));
+}
+
+/**
+* TRIANGLE
+*/
+static RTGEOM* wkt_parse_triangle(const RTCTX *ctx, wkt_parse_state *s)
+{
+  RTPOINTARRAY *pa;
+
+  if ( ! wkt_expect(ctx, s, '(') )
+    return NULL;
+
+  pa = wkt_parse_ring(ctx, s, RTTRIANGLETYPE);
+  if ( ! pa )
+    return NULL;
+
+  if ( wkt_accept(s, ',') )
+  {
+    ptarray_free(ctx, pa);
+    wkt_error(ctx, s, "TRIANGLE must have exactly one ring");
+    return NULL;
+  }
+
+  if ( ! wkt_expect(ctx, s, ')') )
+  {
+    ptarray_free(ctx, pa);
+    return NULL;
+  }
+  return rttriangle_as_rtgeom(ctx, rttriangle_construct(ctx, s->srid, NULL, pa));
+}
+
+/**
+* MULTIPOINT members come bare (MULTIPOINT(0 0,1 1)) or parenthesized
+* (MULTIPOINT((0 0),(1 1))).
+*/
+static RTGEOM* wkt_parse_multipoint_member(const RTCTX *ctx, wkt_parse_state *s)
+{
+  RTPOINTARRAY *pa;
+  double ords[4];
+
+  if ( wkt_accept_word(s, "EMPTY") )
+    return rtpoint_as_rtgeom(ctx, rtpoint_construct_empty(ctx, s->srid, s->has_z, s->has_m));
+
+  if ( *s->pos == '(' )
+    return wkt_parse_point(ctx, s);
+
+  if ( ! wkt_parse_coord(ctx, s, ords) )
+    return NULL;
+
+  pa = ptarray_construct(ctx, s->has_z, s->has_m, 1);
+  memcpy(rt_getPoint_internal(ctx, pa, 0), ords, s->ndims * sizeof(double));
+  return rtpoint_as_rtgeom(ctx, rtpoint_construct(ctx, s->srid, NULL, pa));
+}
+
+/**
+* Members of a collection either name their type or, for the simple
+* collections, leave it implied (MULTILINESTRING((0 0,1 1))).
+*/
+static RTGEOM* wkt_parse_member(const RTCTX *ctx, wkt_parse_state *s, uint8_t parent)
+{
+  uint8_t type;
+  int len;
+
+  wkt_skip_space(s);
+  len = wkt_word_length(s);
+  if ( ! len || wkt_word_is(s->pos, len, "EMPTY") )
+  {
+    switch ( parent )
+    {
+    case RTMULTILINETYPE:
+    case RTCOMPOUNDTYPE:
+    case RTCURVEPOLYTYPE:
+    case RTMULTICURVETYPE:
+      return wkt_parse_body(ctx, s, RTLINETYPE);
+    case RTMULTIPOLYGONTYPE:
+    case RTMULTISURFACETYPE:
+    case RTPOLYHEDRALSURFACETYPE:
+      return wkt_parse_body(ctx, s, RTPOLYGONTYPE);
+    case RTTINTYPE:
+      return wkt_parse_body(ctx, s, RTTRIANGLETYPE);
+    default:
+      wkt_error(ctx, s, "Expected a geometry type");
+      return NULL;
+    }
+  }
+
+  if ( ! wkt_parse_type(ctx, s, &type) )
+    return NULL;
+
+  if ( ! rtcollection_allows_subtype(ctx, parent, type) )
+  {
+    rterror(ctx, "%s cannot contain %s element at character %d of RTWKT input",
+            rttype_name(ctx, parent), rttype_name(ctx, type), (int)(s->pos - s->wkt));
+    return NULL;
+  }
+  return wkt_parse_body(ctx, s, type);
+}
+
+/**
+* Empty members parsed before the first coordinate fixed the
+* dimensionality were built 2D; bring them in line.
+*/
+static void wkt_fix_dims(const RTCTX *ctx, RTGEOM *geom, int has_z, int has_m)
+{
+  RTPOINTARRAY *pa = NULL;
+  int i;
+
+  RTFLAGS_SET_Z(geom->flags, has_z);
+  RTFLAGS_SET_M(geom->flags, has_m);
+
+  switch ( geom->type )
+  {
+  case RTPOINTTYPE:
+    pa = ((RTPOINT*)geom)->point;
+    break;
+  case RTLINETYPE:
+  case RTCIRCSTRINGTYPE:
+  case RTTRIANGLETYPE:
+    pa = ((RTLINE*)geom)->points;
+    break;
+  case RTPOLYGONTYPE:
+    break;
+  case RTCURVEPOLYTYPE:
+    for ( i = 0; i < ((RTCURVEPOLY*)geom)->nrings; i++ )
+      wkt_fix_dims(ctx, ((RTCURVEPOLY*)geom)->rings[i], has_z, has_m);
+    break;
+  default:
+    for ( i = 0; i < ((RTCOLLECTION*)geom)->ngeoms; i++ )
+      wkt_fix_dims(ctx, ((RTCOLLECTION*)geom)->geoms[i], has_z, has_m);
+    break;
+  }
+
+  if ( pa && pa->npoints == 0 )
+  {
+    RTFLAGS_SET_Z(pa->flags, has_z);
+    RTFLAGS_SET_M(pa->flags, has_m);
+  }
+}
+
+/**
+* Collections, COMPOUNDCURVE and CURVEPOLYGON
+*/
+static RTGEOM* wkt_parse_collection(const RTCTX *ctx, wkt_parse_state *s, uint8_t type)
+{
+  wkt_geom_list list = { NULL, 0, 0 };
+  RTGEOM *geom = NULL;
+  int check = s->check;
+  uint32_t i;
+
+  if ( ! wkt_expect(ctx, s, '(') )
+    return NULL;
+
+  /* Be strict in polyhedral surface closures */
+  if ( type == RTPOLYHEDRALSURFACETYPE )
+    s->check |= RT_PARSER_CHECK_ZCLOSURE;
+
+  do
+  {
+    if ( type == RTMULTIPOINTTYPE )
+      geom = wkt_parse_multipoint_member(ctx, s);
+    else
+      geom = wkt_parse_member(ctx, s, type);
+    if ( ! geom )
+      break;
+    wkt_geom_list_add(ctx, &list, geom);
+  }
+  while ( wkt_accept(s, ',') );
+
+  s->check = check;
+
+  if ( ! geom || ! wkt_expect(ctx, s, ')') )
+  {
+    wkt_geom_list_free(ctx, &list);
+    return NULL;
+  }
+
+  if ( s->ndims > 2 )
+  {
+    for ( i = 0; i < list.ngeoms; i++ )
+      wkt_fix_dims(ctx, list.geoms[i], s->has_z, s->has_m);
+  }
+
+  if ( type == RTCOMPOUNDTYPE )
+  {
+    RTCOMPOUND *comp = rtcompound_construct_empty(ctx, s->srid, s->has_z, s->has_m);
+    for ( i = 0; i < list.ngeoms; i++ )
+    {
+      if ( rtcompound_add_rtgeom(ctx, comp, list.geoms[i]) != RT_SUCCESS )
+      {
+        rtgeom_free(ctx, rtcompound_as_rtgeom(ctx, comp));
+        /* The members added so far went with the compound */
+        memmove(list.geoms, list.geoms + i, (list.ngeoms - i) * sizeof(RTGEOM*));
+        list.ngeoms -= i;
+        wkt_geom_list_free(ctx, &list);
+        wkt_error(ctx, s, "COMPOUNDCURVE members must be non-empty and continuous");
+        return NULL;
+      }
+    }
+    rtfree(ctx, list.geoms);
+    return rtcompound_as_rtgeom(ctx, comp);
+  }
+
+  if ( type == RTCURVEPOLYTYPE )
+  {
+    RTCURVEPOLY *poly = rtcurvepoly_construct_empty(ctx, s->srid, s->has_z, s->has_m);
+    for ( i = 0; i < list.ngeoms; i++ )
+      rtcurvepoly_add_ring(ctx, poly, list.geoms[i]);
+    rtfree(ctx, list.geoms);
+    return rtcurvepoly_as_rtgeom(ctx, poly);
+  }
+
+  return rtcollection_as_rtgeom(ctx, rtcollection_construct(ctx, type, s->srid, NULL, list.ngeoms, list.geoms));
+}
+
+/**
+* Everything after the type keyword: EMPTY or the parenthesized body.
+*/
+static RTGEOM* wkt_parse_body(const RTCTX *ctx, wkt_parse_state *s, uint8_t type)
+{
+  RTGEOM *geom;
+
+  if ( wkt_accept_word(s, "EMPTY") )
+    return rtgeom_construct_empty(ctx, type, s->srid, s->has_z, s->has_m);
+
+  if ( *s->pos != '(' )
+  {
+    wkt_error(ctx, s, "Expected '(' or EMPTY");
+    return NULL;
+  }
+
+  if ( ++s->depth > RTWKT_MAX_DEPTH )
+  {
+    wkt_error(ctx, s, "Geometry nesting too deep");
+    return NULL;
+  }
+
+  switch ( type )
+  {
+  case RTPOINTTYPE:
+    geom = wkt_parse_point(ctx, s);
+    break;
+  case RTLINETYPE:
+  case RTCIRCSTRINGTYPE:
+    geom = wkt_parse_line(ctx, s, type);
+    break;
+  case RTPOLYGONTYPE:
+    geom = wkt_parse_polygon(ctx, s);
+    break;
+  case RTTRIANGLETYPE:
+    geom = wkt_parse_triangle(ctx, s);
+    break;
+  default:
+    geom = wkt_parse_collection(ctx, s, type);
+    break;
+  }
+
+  s->depth--;
+  return geom;
+}
+
+/**
+* Check is a bitmask of: RT_PARSER_CHECK_MINPOINTS, RT_PARSER_CHECK_ODD,
+* RT_PARSER_CHECK_CLOSURE, RT_PARSER_CHECK_NONE, RT_PARSER_CHECK_ALL
+*/
+RTGEOM* rtgeom_from_wkt(const RTCTX *ctx, const char *wkt, const char check)
+{
+  wkt_parse_state s;
+  RTGEOM *geom;
+  uint8_t type;
+
+  if ( ! wkt )
+  {
+    rterror(ctx, "rtgeom_from_wkt: null input");
+    return NULL;
+  }
+
+  s.wkt = wkt;
+  s.pos = wkt;
+  s.check = ( check & RT_PARSER_CHECK_NONE ) ? 0 : check;
+  s.srid = SRID_UNKNOWN;
+  s.has_z = RT_FALSE;
+  s.has_m = RT_FALSE;
+  s.ndims = 0;
+  s.depth = 0;
+
+  /* Extended RTWKT: SRID=4326;POINT(0 0) */
+  if ( wkt_accept_word(&s, "SRID") )
+  {
+    int srid = 0, negative = RT_FALSE;
+    if ( ! wkt_expect(ctx, &s, '=') )
+      return NULL;
+    wkt_skip_space(&s);
+    if ( *s.pos == '-' || *s.pos == '+' )
+      negative = ( *s.pos++ == '-' );
+    if ( ! WKT_IS_DIGIT(*s.pos) )
+    {
+      wkt_error(ctx, &s, "Invalid SRID");
+      return NULL;
+    }
+    for ( ; WKT_IS_DIGIT(*s.pos); s.pos++ )
+    {
+      if ( srid < 100000000 )
+        srid = srid * 10 + (*s.pos - '0');
+    }
+    if ( ! wkt_expect(ctx, &s, ';') )
+      return NULL;
+    s.srid = clamp_srid(ctx, negative ? -srid : srid);
+  }
+
+  if ( ! wkt_parse_type(ctx, &s, &type) )
+    return NULL;
+
+  geom = wkt_parse_body(ctx, &s, type);
+  if ( ! geom )
+    return NULL;
+
+  wkt_skip_space(&s);
+  if ( *s.pos )
+  {
+    rtgeom_free(ctx, geom);
+    wkt_error(ctx, &s, "Unexpected text after geometry");
+    return NULL;
+  }
+
+  return geom;
+}
+
+RTGEOM* rtgeom_from_ewkt(const RTCTX *ctx, const char *ewkt, const char check)
+{
+  return rtgeom_from_wkt(ctx, ewkt, check);
+}
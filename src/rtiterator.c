@@ -282,3 +282,56 @@ rtpointiterator_destroy(const RTCTX *ctx, RTPOINTITERATOR* s)
 
   rtfree(ctx, s);
 }
+
+int
+rtgeom_visit_ptarrays(const RTCTX *ctx, const RTGEOM *geom, rtgeom_ptarray_visitor visitor, void *data)
+{
+  int i, ret;
+
+  if ( ! geom ) return 0;
+
+  switch(geom->type)
+  {
+  case RTPOINTTYPE:
+  {
+    RTPOINT *p = (RTPOINT*)geom;
+    if ( p->point )
+      return visitor(ctx, geom, 0, p->point, data);
+    return 0;
+  }
+  /* Take advantage of fact tht ln/circ/tri have same memory structure */
+  case RTLINETYPE:
+  case RTCIRCSTRINGTYPE:
+  case RTTRIANGLETYPE:
+  {
+    RTLINE *l = (RTLINE*)geom;
+    if ( l->points )
+      return visitor(ctx, geom, 0, l->points, data);
+    return 0;
+  }
+  case RTPOLYGONTYPE:
+  {
+    RTPOLY *p = (RTPOLY*)geom;
+    for ( i = 0; i < p->nrings; i++ )
+    {
+      ret = visitor(ctx, geom, i, p->rings[i], data);
+      if ( ret != 0 ) return ret;
+    }
+    return 0;
+  }
+  default:
+    if ( rttype_is_collection(ctx, geom->type) )
+    {
+      /* Curve polygons share the collection memory structure */
+      RTCOLLECTION *c = (RTCOLLECTION*)geom;
+      for ( i = 0; i < c->ngeoms; i++ )
+      {
+        ret = rtgeom_visit_ptarrays(ctx, c->geoms[i], visitor, data);
+        if ( ret != 0 ) return ret;
+      }
+      return 0;
+    }
+    rterror(ctx, "%s: unsupported geometry type: %s", __func__, rttype_name(ctx, geom->type));
+    return -1;
+  }
+}
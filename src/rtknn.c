@@ -0,0 +1,346 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ *
+ * k-nearest-neighbour index over an array of geometries: a static
+ * binary box tree searched best-first, with candidates ranked by
+ * their exact 2D distance.
+ *
+ **********************************************************************/
+
+
+#include "rttopo_config.h"
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+
+/*#define RTGEOM_DEBUG_LEVEL 4*/
+#include "rtgeom_log.h"
+
+#include "librttopo_geom_internal.h"
+
+
+typedef struct
+{
+  double xmin, xmax, ymin, ymax;
+  int left;  /* child node numbers, -1 on leaves */
+  int right;
+  int item;  /* geometry number on leaves, -1 on internal nodes */
+} RTKNN_NODE;
+
+struct RTKNN_T
+{
+  RTGEOM **geoms;
+  int ngeoms;
+  RTKNN_NODE *nodes;
+  int nnodes;
+  int root; /* -1 when nothing is indexed */
+};
+
+/* Box center, used to order items while building */
+typedef struct
+{
+  double x, y;
+  int item;
+} RTKNN_ENTRY;
+
+static int
+rtknn_cmp_x(const void *a, const void *b)
+{
+  double xa = ((const RTKNN_ENTRY*)a)->x, xb = ((const RTKNN_ENTRY*)b)->x;
+  return xa < xb ? -1 : (xa > xb ? 1 : 0);
+}
+
+static int
+rtknn_cmp_y(const void *a, const void *b)
+{
+  double ya = ((const RTKNN_ENTRY*)a)->y, yb = ((const RTKNN_ENTRY*)b)->y;
+  return ya < yb ? -1 : (ya > yb ? 1 : 0);
+}
+
+/**
+* Give every component a box of its own, so that the distance code
+* finds them all in place and queries never write to the geometries.
+*/
+static void
+rtknn_add_bbox(const RTCTX *ctx, RTGEOM *geom)
+{
+  int i;
+
+  rtgeom_add_bbox(ctx, geom);
+  if ( rtgeom_is_collection(ctx, geom) )
+  {
+    RTCOLLECTION *col = (RTCOLLECTION*)geom;
+    for ( i = 0; i < col->ngeoms; i++ )
+      rtknn_add_bbox(ctx, col->geoms[i]);
+  }
+}
+
+/**
+* Build the subtree over entries[0..n-1], splitting at the median of
+* the longer side of the centers' extent. Returns the node number.
+*/
+static int
+rtknn_build_node(const RTCTX *ctx, RTKNN *knn, RTKNN_ENTRY *entries, int n)
+{
+  RTKNN_NODE *node;
+  int i, num, left, right;
+  double xmin, xmax, ymin, ymax;
+
+  if ( n == 1 )
+  {
+    const RTGBOX *box = knn->geoms[entries[0].item]->bbox;
+    num = knn->nnodes++;
+    node = &(knn->nodes[num]);
+    node->xmin = box->xmin;
+    node->xmax = box->xmax;
+    node->ymin = box->ymin;
+    node->ymax = box->ymax;
+    node->left = node->right = -1;
+    node->item = entries[0].item;
+    return num;
+  }
+
+  xmin = xmax = entries[0].x;
+  ymin = ymax = entries[0].y;
+  for ( i = 1; i < n; i++ )
+  {
+    xmin = FP_MIN(xmin, entries[i].x);
+    xmax = FP_MAX(xmax, entries[i].x);
+    ymin = FP_MIN(ymin, entries[i].y);
+    ymax = FP_MAX(ymax, entries[i].y);
+  }
+  qsort(entries, n, sizeof(RTKNN_ENTRY),
+        (xmax - xmin) >= (ymax - ymin) ? rtknn_cmp_x : rtknn_cmp_y);
+
+  num = knn->nnodes++;
+  left = rtknn_build_node(ctx, knn, entries, n / 2);
+  right = rtknn_build_node(ctx, knn, entries + n / 2, n - n / 2);
+
+  node = &(knn->nodes[num]);
+  node->left = left;
+  node->right = right;
+  node->item = -1;
+  node->xmin = FP_MIN(knn->nodes[left].xmin, knn->nodes[right].xmin);
+  node->xmax = FP_MAX(knn->nodes[left].xmax, knn->nodes[right].xmax);
+  node->ymin = FP_MIN(knn->nodes[left].ymin, knn->nodes[right].ymin);
+  node->ymax = FP_MAX(knn->nodes[left].ymax, knn->nodes[right].ymax);
+  return num;
+}
+
+RTKNN *
+rtknn_build(const RTCTX *ctx, RTGEOM **geoms, int ngeoms)
+{
+  RTKNN *knn;
+  RTKNN_ENTRY *entries;
+  int i, n;
+
+  if ( ngeoms < 0 )
+  {
+    rterror(ctx, "%s: invalid number of geometries %d", __func__, ngeoms);
+    return NULL;
+  }
+
+  knn = rtalloc(ctx, sizeof(RTKNN));
+  knn->geoms = geoms;
+  knn->ngeoms = ngeoms;
+  knn->nodes = NULL;
+  knn->nnodes = 0;
+  knn->root = -1;
+
+  /* Empty geometries are never anybody's neighbour */
+  entries = rtalloc(ctx, sizeof(RTKNN_ENTRY) * (ngeoms ? ngeoms : 1));
+  n = 0;
+  for ( i = 0; i < ngeoms; i++ )
+  {
+    if ( ! geoms[i] || rtgeom_is_empty(ctx, geoms[i]) )
+      continue;
+    rtknn_add_bbox(ctx, geoms[i]);
+    entries[n].x = (geoms[i]->bbox->xmin + geoms[i]->bbox->xmax) / 2.0;
+    entries[n].y = (geoms[i]->bbox->ymin + geoms[i]->bbox->ymax) / 2.0;
+    entries[n].item = i;
+    n++;
+  }
+
+  if ( n )
+  {
+    knn->nodes = rtalloc(ctx, sizeof(RTKNN_NODE) * (2 * n - 1));
+    knn->root = rtknn_build_node(ctx, knn, entries, n);
+  }
+  rtfree(ctx, entries);
+
+  return knn;
+}
+
+void
+rtknn_free(const RTCTX *ctx, RTKNN *knn)
+{
+  if ( ! knn ) return;
+  if ( knn->nodes )
+    rtfree(ctx, knn->nodes);
+  rtfree(ctx, knn);
+}
+
+/**
+* Search queue entry: a node keyed on the distance to its box, or a
+* geometry keyed on its exact distance (item >= 0).
+*/
+typedef struct
+{
+  double d;
+  int node;
+  int item;
+} RTKNN_PENDING;
+
+typedef struct
+{
+  RTKNN_PENDING *entries;
+  int n, max;
+  RTKNN_PENDING *stack; /* initial storage, not to be freed */
+} RTKNN_QUEUE;
+
+static void
+rtknn_queue_push(const RTCTX *ctx, RTKNN_QUEUE *q, double d, int node, int item)
+{
+  int i, parent;
+
+  if ( q->n == q->max )
+  {
+    q->max *= 2;
+    if ( q->entries == q->stack )
+    {
+      q->entries = rtalloc(ctx, sizeof(RTKNN_PENDING) * q->max);
+      memcpy(q->entries, q->stack, sizeof(RTKNN_PENDING) * q->n);
+    }
+    else
+    {
+      q->entries = rtrealloc(ctx, q->entries, sizeof(RTKNN_PENDING) * q->max);
+    }
+  }
+
+  i = q->n++;
+  while ( i > 0 )
+  {
+    parent = (i - 1) / 2;
+    if ( q->entries[parent].d <= d ) break;
+    q->entries[i] = q->entries[parent];
+    i = parent;
+  }
+  q->entries[i].d = d;
+  q->entries[i].node = node;
+  q->entries[i].item = item;
+}
+
+static RTKNN_PENDING
+rtknn_queue_pop(RTKNN_QUEUE *q)
+{
+  RTKNN_PENDING top = q->entries[0];
+  RTKNN_PENDING last = q->entries[--q->n];
+  int i = 0, child;
+
+  while ( (child = 2 * i + 1) < q->n )
+  {
+    if ( child + 1 < q->n && q->entries[child + 1].d < q->entries[child].d )
+      child++;
+    if ( last.d <= q->entries[child].d ) break;
+    q->entries[i] = q->entries[child];
+    i = child;
+  }
+  if ( q->n )
+    q->entries[i] = last;
+  return top;
+}
+
+static double
+rtknn_box_distance(const RTGBOX *box, const RTKNN_NODE *node)
+{
+  double dx = 0.0, dy = 0.0;
+
+  if ( box->xmax < node->xmin ) dx = node->xmin - box->xmax;
+  else if ( node->xmax < box->xmin ) dx = box->xmin - node->xmax;
+  if ( box->ymax < node->ymin ) dy = node->ymin - box->ymax;
+  else if ( node->ymax < box->ymin ) dy = box->ymin - node->ymax;
+
+  return sqrt(dx*dx + dy*dy);
+}
+
+int
+rtknn_query(const RTCTX *ctx, const RTKNN *knn, const RTGEOM *probe, int k, double max_distance, int *ids, double *distances)
+{
+  RTKNN_PENDING stack[64];
+  RTKNN_QUEUE q;
+  RTKNN_PENDING top;
+  RTGBOX box;
+  const RTKNN_NODE *node;
+  double d;
+  int found = 0;
+
+  if ( knn->root < 0 || k <= 0 )
+    return 0;
+  if ( rtgeom_get_bbox_p(ctx, probe, &box) == RT_FAILURE )
+    return 0;
+  if ( max_distance < 0.0 )
+    max_distance = FLT_MAX;
+
+  q.entries = q.stack = stack;
+  q.n = 0;
+  q.max = 64;
+
+  rtknn_queue_push(ctx, &q, rtknn_box_distance(&box, &(knn->nodes[knn->root])), knn->root, -1);
+
+  while ( q.n && found < k )
+  {
+    top = rtknn_queue_pop(&q);
+
+    /* Everything left in the queue is at least this far */
+    if ( top.d > max_distance )
+      break;
+
+    /* A measured geometry closer than any pending box: next result */
+    if ( top.item >= 0 )
+    {
+      ids[found] = top.item;
+      if ( distances )
+        distances[found] = top.d;
+      found++;
+      continue;
+    }
+
+    node = &(knn->nodes[top.node]);
+    if ( node->item >= 0 )
+    {
+      d = rtgeom_mindistance2d(ctx, probe, knn->geoms[node->item]);
+      if ( d <= max_distance )
+        rtknn_queue_push(ctx, &q, d, -1, node->item);
+      continue;
+    }
+
+    d = rtknn_box_distance(&box, &(knn->nodes[node->left]));
+    if ( d <= max_distance )
+      rtknn_queue_push(ctx, &q, d, node->left, -1);
+    d = rtknn_box_distance(&box, &(knn->nodes[node->right]));
+    if ( d <= max_distance )
+      rtknn_queue_push(ctx, &q, d, node->right, -1);
+  }
+
+  if ( q.entries != q.stack )
+    rtfree(ctx, q.entries);
+
+  return found;
+}
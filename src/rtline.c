@@ -52,6 +52,7 @@ rtline_construct(const RTCTX *ctx, int srid, RTGBOX *bbox, RTPOINTARRAY *points)
 
   result->flags = points->flags;
   RTFLAGS_SET_BBOX(result->flags, bbox?1:0);
+  RTFLAGS_SET_SHARED(result->flags, 0);
 
   RTDEBUGF(ctx, 3, "rtline_construct type=%d", result->type);
 
@@ -334,11 +335,7 @@ rtline_add_rtpoint(const RTCTX *ctx, RTLINE *line, RTPOINT *point, int where)
     return RT_FAILURE;
 
   /* Update the bounding box */
-  if ( line->bbox )
-  {
-    rtgeom_drop_bbox(ctx, rtline_as_rtgeom(ctx, line));
-    rtgeom_add_bbox(ctx, rtline_as_rtgeom(ctx, line));
-  }
+  rtgeom_refresh_bbox(ctx, rtline_as_rtgeom(ctx, line));
 
   return RT_SUCCESS;
 }
@@ -367,11 +364,7 @@ rtline_setPoint4d(const RTCTX *ctx, RTLINE *line, uint32_t index, RTPOINT4D *new
 {
   ptarray_set_point4d(ctx, line->points, index, newpoint);
   /* Update the box, if there is one to update */
-  if ( line->bbox )
-  {
-    rtgeom_drop_bbox(ctx, (RTGEOM*)line);
-    rtgeom_add_bbox(ctx, (RTGEOM*)line);
-  }
+  rtgeom_refresh_bbox(ctx, (RTGEOM*)line);
 }
 
 /**
@@ -401,8 +401,7 @@ rtpoint_clip_to_ordinate_range(const RTCTX *ctx, const RTPOINT *point, char ordi
   /* Set the bbox, if necessary */
   if ( rtgeom_out->bbox )
   {
-    rtgeom_drop_bbox(ctx, (RTGEOM*)rtgeom_out);
-    rtgeom_add_bbox(ctx, (RTGEOM*)rtgeom_out);
+    rtgeom_refresh_bbox(ctx, (RTGEOM*)rtgeom_out);
   }
 
   return rtgeom_out;
@@ -458,8 +457,7 @@ rtmpoint_clip_to_ordinate_range(const RTCTX *ctx, const RTMPOINT *mpoint, char o
   /* Set the bbox, if necessary */
   if ( rtgeom_out->bbox )
   {
-    rtgeom_drop_bbox(ctx, (RTGEOM*)rtgeom_out);
-    rtgeom_add_bbox(ctx, (RTGEOM*)rtgeom_out);
+    rtgeom_refresh_bbox(ctx, (RTGEOM*)rtgeom_out);
   }
 
   return rtgeom_out;
@@ -529,8 +527,7 @@ rtmline_clip_to_ordinate_range(const RTCTX *ctx, const RTMLINE *mline, char ordi
     }
     if ( rtgeom_out->bbox )
     {
-      rtgeom_drop_bbox(ctx, (RTGEOM*)rtgeom_out);
-      rtgeom_add_bbox(ctx, (RTGEOM*)rtgeom_out);
+      rtgeom_refresh_bbox(ctx, (RTGEOM*)rtgeom_out);
     }
 
     if ( ! homogeneous )
@@ -768,8 +765,7 @@ rtline_clip_to_ordinate_range(const RTCTX *ctx, const RTLINE *line, char ordinat
 
   if ( rtgeom_out->bbox && rtgeom_out->ngeoms > 0 )
   {
-    rtgeom_drop_bbox(ctx, (RTGEOM*)rtgeom_out);
-    rtgeom_add_bbox(ctx, (RTGEOM*)rtgeom_out);
+    rtgeom_refresh_bbox(ctx, (RTGEOM*)rtgeom_out);
   }
 
   return rtgeom_out;
@@ -100,7 +100,7 @@ char * pointarray_to_encoded_polyline(const RTCTX *ctx, const RTPOINTARRAY *pa,
     }
   }
 
-  sb = stringbuffer_create(ctx);
+  sb = stringbuffer_create_scratch(ctx);
   for (i=0; i<pa->npoints*2; i++)
   {
     int numberToEncode = delta[i];
@@ -125,7 +125,7 @@ char * pointarray_to_encoded_polyline(const RTCTX *ctx, const RTPOINTARRAY *pa,
 
   rtfree(ctx, delta);
   encoded_polyline = stringbuffer_getstringcopy(ctx, sb);
-  stringbuffer_destroy(ctx, sb);
+  stringbuffer_release(ctx, sb);
 
   return encoded_polyline;
 }
@@ -27,6 +27,7 @@
 
 #include "rttopo_config.h"
 #include "librttopo_geom_internal.h"
+#include "stringbuffer.h"
 #include <string.h>  /* strlen */
 #include <assert.h>
 
@@ -144,15 +145,27 @@ static size_t
 asgeojson_bbox_buf(const RTCTX *ctx, char *output, RTGBOX *bbox, int hasz, int precision)
 {
   char *ptr = output;
-
-  if (!hasz)
-    ptr += sprintf(ptr, "\"bbox\":[%.*f,%.*f,%.*f,%.*f],",
-                   precision, bbox->xmin, precision, bbox->ymin,
-                   precision, bbox->xmax, precision, bbox->ymax);
-  else
-    ptr += sprintf(ptr, "\"bbox\":[%.*f,%.*f,%.*f,%.*f,%.*f,%.*f],",
-                   precision, bbox->xmin, precision, bbox->ymin, precision, bbox->zmin,
-                   precision, bbox->xmax, precision, bbox->ymax, precision, bbox->zmax);
+  char num[OUT_MAX_DIGS_DOUBLE + OUT_MAX_DOUBLE_PRECISION + 1];
+  double ords[6];
+  int i, len, nords = 0;
+
+  ords[nords++] = bbox->xmin;
+  ords[nords++] = bbox->ymin;
+  if (hasz) ords[nords++] = bbox->zmin;
+  ords[nords++] = bbox->xmax;
+  ords[nords++] = bbox->ymax;
+  if (hasz) ords[nords++] = bbox->zmax;
+
+  /* All the requested decimals, as "%.*f" printed them */
+  ptr += sprintf(ptr, "\"bbox\":[");
+  for (i=0; i<nords; i++)
+  {
+    if ( i ) *ptr++ = ',';
+    len = rtprint_double_fixed_padded(ctx, ords[i], precision, num);
+    memcpy(ptr, num, len);
+    ptr += len;
+  }
+  ptr += sprintf(ptr, "],");
 
   return (ptr-output);
 }
@@ -275,7 +288,7 @@ asgeojson_poly_size(const RTCTX *ctx, const RTPOLY *poly, char *srs, RTGBOX *bbo
   if (srs) size += asgeojson_srs_size(ctx, srs);
   if (bbox) size += asgeojson_bbox_size(ctx, RTFLAGS_GET_Z(poly->flags), precision);
   size += sizeof("\"coordinates\":[");
-  for (i=0, size=0; i<poly->nrings; i++)
+  for (i=0; i<poly->nrings; i++)
   {
     size += pointArray_geojson_size(ctx, poly->rings[i], precision);
     size += sizeof("[]");
@@ -696,17 +709,23 @@ asgeojson_geom_buf(const RTCTX *ctx, const RTGEOM *geom, char *output, RTGBOX *b
 static int
 rtprint_double(const RTCTX *ctx, double d, int maxdd, char *buf, size_t bufsize)
 {
+  char tmp[OUT_MAX_DIGS_DOUBLE + OUT_MAX_DOUBLE_PRECISION + 1];
   double ad = fabs(d);
   int ndd = ad < 1 ? 0 : floor(log10(ad))+1; /* non-decimal digits */
+  int len;
   if (fabs(d) < OUT_MAX_DOUBLE)
   {
     if ( maxdd > (OUT_MAX_DOUBLE_PRECISION - ndd) )  maxdd -= ndd;
-    return snprintf(buf, bufsize, "%.*f", maxdd, d);
   }
-  else
+  if ( maxdd > OUT_MAX_DOUBLE_PRECISION ) maxdd = OUT_MAX_DOUBLE_PRECISION;
+  len = rtprint_double_fixed(ctx, d, maxdd, tmp);
+  if ( bufsize )
   {
-    return snprintf(buf, bufsize, "%g", d);
+    size_t n = (size_t)len < bufsize ? (size_t)len : bufsize - 1;
+    memcpy(buf, tmp, n);
+    buf[n] = '\0';
   }
+  return len;
 }
 
 
@@ -741,9 +760,7 @@ pointArray_to_geojson(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int prec
       pt = rt_getPoint2d_cp(ctx, pa, i);
 
       rtprint_double(ctx, pt->x, precision, x, BUFSIZE);
-      trim_trailing_zeros(ctx, x);
       rtprint_double(ctx, pt->y, precision, y, BUFSIZE);
-      trim_trailing_zeros(ctx, y);
 
       if ( i ) ptr += sprintf(ptr, ",");
       ptr += sprintf(ptr, "[%s,%s]", x, y);
@@ -757,11 +774,8 @@ pointArray_to_geojson(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int prec
       pt = rt_getPoint3dz_cp(ctx, pa, i);
 
       rtprint_double(ctx, pt->x, precision, x, BUFSIZE);
-      trim_trailing_zeros(ctx, x);
       rtprint_double(ctx, pt->y, precision, y, BUFSIZE);
-      trim_trailing_zeros(ctx, y);
       rtprint_double(ctx, pt->z, precision, z, BUFSIZE);
-      trim_trailing_zeros(ctx, z);
 
       if ( i ) ptr += sprintf(ptr, ",");
       ptr += sprintf(ptr, "[%s,%s,%s]", x, y, z);
@@ -787,3 +801,416 @@ pointArray_geojson_size(const RTCTX *ctx, RTPOINTARRAY *pa, int precision)
   return (OUT_MAX_DIGS_DOUBLE + precision + sizeof(",,"))
          * 3 * pa->npoints + sizeof(",[]");
 }
+
+
+
+/*
+ * Streaming writer
+ */
+
+/* Buffered output is handed to the sink once it grows past this */
+#define RTGEOJSON_FLUSH_SIZE 65536
+
+/* Room for one formatted ordinate */
+#define RTGEOJSON_ORDSIZE (OUT_MAX_DIGS_DOUBLE + OUT_MAX_DOUBLE_PRECISION + 1)
+
+struct RTGEOJSON_WRITER_T
+{
+  rtgeojson_sink sink;
+  void *arg;
+  stringbuffer_t *sb; /* Reused for all the output */
+  int precision;
+  int opts;
+  int failed; /* A sink or geometry error happened */
+  int nfeatures; /* Features in the open collection, -1 if none is open */
+  RTGBOX box; /* Extent of the coordinates of the current object */
+  uint32_t box_npoints;
+  RTGBOX col_box; /* Extent of the open collection */
+  uint32_t col_npoints;
+  int col_hasz; /* Whether every feature box so far had a Z range */
+};
+
+static int
+geojson_flush(const RTCTX *ctx, RTGEOJSON_WRITER *w)
+{
+  int len = stringbuffer_getlength(ctx, w->sb);
+
+  if ( w->failed )
+    return RT_FAILURE;
+
+  if ( len && w->sink(ctx, stringbuffer_getstring(ctx, w->sb), len, w->arg) != RT_SUCCESS )
+    w->failed = RT_TRUE;
+
+  stringbuffer_clear(ctx, w->sb);
+  return w->failed ? RT_FAILURE : RT_SUCCESS;
+}
+
+static inline void
+geojson_maybe_flush(const RTCTX *ctx, RTGEOJSON_WRITER *w)
+{
+  if ( stringbuffer_getlength(ctx, w->sb) >= RTGEOJSON_FLUSH_SIZE )
+    geojson_flush(ctx, w);
+}
+
+static void
+geojson_bbox(const RTCTX *ctx, RTGEOJSON_WRITER *w, const RTGBOX *box)
+{
+  char buf[6 * RTGEOJSON_ORDSIZE + 16];
+  char *p = buf;
+  int hasz = RTFLAGS_GET_Z(box->flags);
+
+  p += sprintf(p, ",\"bbox\":[");
+  p += rtprint_double(ctx, box->xmin, w->precision, p, RTGEOJSON_ORDSIZE);
+  *p++ = ',';
+  p += rtprint_double(ctx, box->ymin, w->precision, p, RTGEOJSON_ORDSIZE);
+  if ( hasz )
+  {
+    *p++ = ',';
+    p += rtprint_double(ctx, box->zmin, w->precision, p, RTGEOJSON_ORDSIZE);
+  }
+  *p++ = ',';
+  p += rtprint_double(ctx, box->xmax, w->precision, p, RTGEOJSON_ORDSIZE);
+  *p++ = ',';
+  p += rtprint_double(ctx, box->ymax, w->precision, p, RTGEOJSON_ORDSIZE);
+  if ( hasz )
+  {
+    *p++ = ',';
+    p += rtprint_double(ctx, box->zmax, w->precision, p, RTGEOJSON_ORDSIZE);
+  }
+  *p++ = ']';
+  stringbuffer_append_len(ctx, w->sb, buf, p - buf);
+}
+
+/*
+ * Write the positions of a point array, in reverse order if asked,
+ * growing the extent of the current object as they go by.
+ */
+static void
+geojson_ptarray(const RTCTX *ctx, RTGEOJSON_WRITER *w, const RTPOINTARRAY *pa, int reverse)
+{
+  char buf[3 * RTGEOJSON_ORDSIZE + 8];
+  char *p;
+  int hasz = RTFLAGS_GET_Z(pa->flags);
+  int i, n = pa->npoints;
+  RTGBOX *box = &(w->box);
+  double x, y, z = 0;
+
+  for ( i = 0; i < n; i++ )
+  {
+    const double *pt = (const double*)rt_getPoint_internal(ctx, pa, reverse ? n - 1 - i : i);
+
+    x = pt[0];
+    y = pt[1];
+    if ( hasz )
+      z = pt[2];
+
+    p = buf;
+    if ( i ) *p++ = ',';
+    *p++ = '[';
+    p += rtprint_double(ctx, x, w->precision, p, RTGEOJSON_ORDSIZE);
+    *p++ = ',';
+    p += rtprint_double(ctx, y, w->precision, p, RTGEOJSON_ORDSIZE);
+    if ( hasz )
+    {
+      *p++ = ',';
+      p += rtprint_double(ctx, z, w->precision, p, RTGEOJSON_ORDSIZE);
+    }
+    *p++ = ']';
+    stringbuffer_append_len(ctx, w->sb, buf, p - buf);
+
+    if ( w->box_npoints++ == 0 )
+    {
+      box->xmin = box->xmax = x;
+      box->ymin = box->ymax = y;
+      box->zmin = box->zmax = z;
+    }
+    else
+    {
+      box->xmin = FP_MIN(box->xmin, x);
+      box->xmax = FP_MAX(box->xmax, x);
+      box->ymin = FP_MIN(box->ymin, y);
+      box->ymax = FP_MAX(box->ymax, y);
+      box->zmin = FP_MIN(box->zmin, z);
+      box->zmax = FP_MAX(box->zmax, z);
+    }
+
+    geojson_maybe_flush(ctx, w);
+  }
+}
+
+/*
+ * Polygon rings. RFC 7946 wants exterior rings counterclockwise
+ * and holes clockwise; rings the other way round are written
+ * backwards rather than copied.
+ */
+static void
+geojson_rings(const RTCTX *ctx, RTGEOJSON_WRITER *w, const RTPOLY *poly)
+{
+  int i, reverse = RT_FALSE;
+
+  for ( i = 0; i < poly->nrings; i++ )
+  {
+    if ( w->opts & RT_GEOJSON_RFC7946 )
+    {
+      int ccw = ptarray_isccw(ctx, poly->rings[i]);
+      reverse = ( i == 0 ) ? ! ccw : ccw;
+    }
+    stringbuffer_append_len(ctx, w->sb, i ? ",[" : "[", i ? 2 : 1);
+    geojson_ptarray(ctx, w, poly->rings[i], reverse);
+    stringbuffer_append_len(ctx, w->sb, "]", 1);
+  }
+}
+
+/*
+ * Write a geometry object; the outermost one carries the bbox
+ * member when asked for, after its coordinates are known.
+ */
+static int
+geojson_geom(const RTCTX *ctx, RTGEOJSON_WRITER *w, const RTGEOM *geom, int with_bbox)
+{
+  const RTCOLLECTION *col = (const RTCOLLECTION*)geom;
+  stringbuffer_t *sb = w->sb;
+  int i, n;
+
+  switch (geom->type)
+  {
+  case RTPOINTTYPE:
+    stringbuffer_append(ctx, sb, "{\"type\":\"Point\",\"coordinates\":");
+    if ( rtpoint_is_empty(ctx, (RTPOINT*)geom) )
+      stringbuffer_append_len(ctx, sb, "[]", 2);
+    else
+      geojson_ptarray(ctx, w, ((RTPOINT*)geom)->point, RT_FALSE);
+    break;
+
+  case RTLINETYPE:
+    stringbuffer_append(ctx, sb, "{\"type\":\"LineString\",\"coordinates\":[");
+    geojson_ptarray(ctx, w, ((RTLINE*)geom)->points, RT_FALSE);
+    stringbuffer_append_len(ctx, sb, "]", 1);
+    break;
+
+  case RTPOLYGONTYPE:
+    stringbuffer_append(ctx, sb, "{\"type\":\"Polygon\",\"coordinates\":[");
+    geojson_rings(ctx, w, (RTPOLY*)geom);
+    stringbuffer_append_len(ctx, sb, "]", 1);
+    break;
+
+  case RTMULTIPOINTTYPE:
+    stringbuffer_append(ctx, sb, "{\"type\":\"MultiPoint\",\"coordinates\":[");
+    for ( i = 0, n = 0; i < col->ngeoms; i++ )
+    {
+      const RTPOINT *point = (RTPOINT*)col->geoms[i];
+      if ( rtpoint_is_empty(ctx, point) )
+        continue;
+      if ( n++ ) stringbuffer_append_len(ctx, sb, ",", 1);
+      geojson_ptarray(ctx, w, point->point, RT_FALSE);
+    }
+    stringbuffer_append_len(ctx, sb, "]", 1);
+    break;
+
+  case RTMULTILINETYPE:
+    stringbuffer_append(ctx, sb, "{\"type\":\"MultiLineString\",\"coordinates\":[");
+    for ( i = 0; i < col->ngeoms; i++ )
+    {
+      stringbuffer_append_len(ctx, sb, i ? ",[" : "[", i ? 2 : 1);
+      geojson_ptarray(ctx, w, ((RTLINE*)col->geoms[i])->points, RT_FALSE);
+      stringbuffer_append_len(ctx, sb, "]", 1);
+    }
+    stringbuffer_append_len(ctx, sb, "]", 1);
+    break;
+
+  case RTMULTIPOLYGONTYPE:
+    stringbuffer_append(ctx, sb, "{\"type\":\"MultiPolygon\",\"coordinates\":[");
+    for ( i = 0; i < col->ngeoms; i++ )
+    {
+      stringbuffer_append_len(ctx, sb, i ? ",[" : "[", i ? 2 : 1);
+      geojson_rings(ctx, w, (RTPOLY*)col->geoms[i]);
+      stringbuffer_append_len(ctx, sb, "]", 1);
+    }
+    stringbuffer_append_len(ctx, sb, "]", 1);
+    break;
+
+  case RTCOLLECTIONTYPE:
+    stringbuffer_append(ctx, sb, "{\"type\":\"GeometryCollection\",\"geometries\":[");
+    for ( i = 0; i < col->ngeoms; i++ )
+    {
+      if ( i ) stringbuffer_append_len(ctx, sb, ",", 1);
+      if ( geojson_geom(ctx, w, col->geoms[i], RT_FALSE) != RT_SUCCESS )
+        return RT_FAILURE;
+    }
+    stringbuffer_append_len(ctx, sb, "]", 1);
+    break;
+
+  default:
+    w->failed = RT_TRUE;
+    rterror(ctx, "GeoJson: '%s' geometry type not supported.", rttype_name(ctx, geom->type));
+    return RT_FAILURE;
+  }
+
+  if ( with_bbox && w->box_npoints )
+  {
+    RTFLAGS_SET_Z(w->box.flags, RTFLAGS_GET_Z(geom->flags));
+    geojson_bbox(ctx, w, &(w->box));
+  }
+  stringbuffer_append_len(ctx, sb, "}", 1);
+  return RT_SUCCESS;
+}
+
+RTGEOJSON_WRITER *
+rtgeojson_writer_new(const RTCTX *ctx, rtgeojson_sink sink, void *arg, int precision, int opts)
+{
+  RTGEOJSON_WRITER *w;
+
+  if ( ! sink )
+  {
+    rterror(ctx, "%s: null sink", __func__);
+    return NULL;
+  }
+
+  if ( precision > OUT_MAX_DOUBLE_PRECISION ) precision = OUT_MAX_DOUBLE_PRECISION;
+  if ( precision < 0 ) precision = 0;
+
+  w = rtalloc(ctx, sizeof(RTGEOJSON_WRITER));
+  memset(w, 0, sizeof(RTGEOJSON_WRITER));
+  w->sink = sink;
+  w->arg = arg;
+  w->sb = stringbuffer_create_with_size(ctx, RTGEOJSON_FLUSH_SIZE + 1024);
+  w->precision = precision;
+  w->opts = opts;
+  w->nfeatures = -1;
+  return w;
+}
+
+int
+rtgeojson_writer_flush(const RTCTX *ctx, RTGEOJSON_WRITER *w)
+{
+  return geojson_flush(ctx, w);
+}
+
+int
+rtgeojson_writer_free(const RTCTX *ctx, RTGEOJSON_WRITER *w)
+{
+  int ret = geojson_flush(ctx, w);
+  stringbuffer_destroy(ctx, w->sb);
+  rtfree(ctx, w);
+  return ret;
+}
+
+int
+rtgeojson_write_geometry(const RTCTX *ctx, RTGEOJSON_WRITER *w, const RTGEOM *geom)
+{
+  if ( w->failed )
+    return RT_FAILURE;
+
+  w->box_npoints = 0;
+  if ( geojson_geom(ctx, w, geom, w->opts & RT_GEOJSON_BBOX) != RT_SUCCESS )
+    return RT_FAILURE;
+
+  geojson_maybe_flush(ctx, w);
+  return w->failed ? RT_FAILURE : RT_SUCCESS;
+}
+
+int
+rtgeojson_write_collection_start(const RTCTX *ctx, RTGEOJSON_WRITER *w)
+{
+  if ( w->failed )
+    return RT_FAILURE;
+
+  if ( w->nfeatures >= 0 )
+  {
+    rterror(ctx, "%s: a FeatureCollection is already open", __func__);
+    return RT_FAILURE;
+  }
+
+  stringbuffer_append(ctx, w->sb, "{\"type\":\"FeatureCollection\",\"features\":[");
+  w->nfeatures = 0;
+  w->col_npoints = 0;
+  w->col_hasz = RT_TRUE;
+  return RT_SUCCESS;
+}
+
+int
+rtgeojson_write_feature(const RTCTX *ctx, RTGEOJSON_WRITER *w, const RTGEOM *geom, const char *id, const char *properties)
+{
+  if ( w->failed )
+    return RT_FAILURE;
+
+  if ( w->nfeatures > 0 )
+    stringbuffer_append_len(ctx, w->sb, ",", 1);
+  if ( w->nfeatures >= 0 )
+    w->nfeatures++;
+
+  stringbuffer_append(ctx, w->sb, "{\"type\":\"Feature\",");
+  if ( id )
+  {
+    stringbuffer_append(ctx, w->sb, "\"id\":");
+    stringbuffer_append(ctx, w->sb, id);
+    stringbuffer_append_len(ctx, w->sb, ",", 1);
+  }
+
+  stringbuffer_append(ctx, w->sb, "\"geometry\":");
+  w->box_npoints = 0;
+  if ( ! geom )
+    stringbuffer_append(ctx, w->sb, "null");
+  else if ( geojson_geom(ctx, w, geom, RT_FALSE) != RT_SUCCESS )
+    return RT_FAILURE;
+
+  stringbuffer_append(ctx, w->sb, ",\"properties\":");
+  stringbuffer_append(ctx, w->sb, properties ? properties : "null");
+
+  if ( (w->opts & RT_GEOJSON_BBOX) && w->box_npoints )
+  {
+    int hasz = RTFLAGS_GET_Z(geom->flags);
+
+    RTFLAGS_SET_Z(w->box.flags, hasz);
+    geojson_bbox(ctx, w, &(w->box));
+
+    /* Grow the extent of the open collection */
+    if ( w->nfeatures >= 0 )
+    {
+      RTGBOX *box = &(w->box), *col_box = &(w->col_box);
+      if ( w->col_npoints == 0 )
+      {
+        *col_box = *box;
+      }
+      else
+      {
+        col_box->xmin = FP_MIN(col_box->xmin, box->xmin);
+        col_box->xmax = FP_MAX(col_box->xmax, box->xmax);
+        col_box->ymin = FP_MIN(col_box->ymin, box->ymin);
+        col_box->ymax = FP_MAX(col_box->ymax, box->ymax);
+        col_box->zmin = FP_MIN(col_box->zmin, box->zmin);
+        col_box->zmax = FP_MAX(col_box->zmax, box->zmax);
+      }
+      w->col_npoints += w->box_npoints;
+      w->col_hasz = w->col_hasz && hasz;
+    }
+  }
+  stringbuffer_append_len(ctx, w->sb, "}", 1);
+
+  geojson_maybe_flush(ctx, w);
+  return w->failed ? RT_FAILURE : RT_SUCCESS;
+}
+
+int
+rtgeojson_write_collection_end(const RTCTX *ctx, RTGEOJSON_WRITER *w)
+{
+  if ( w->failed )
+    return RT_FAILURE;
+
+  if ( w->nfeatures < 0 )
+  {
+    rterror(ctx, "%s: no FeatureCollection is open", __func__);
+    return RT_FAILURE;
+  }
+
+  stringbuffer_append_len(ctx, w->sb, "]", 1);
+  if ( (w->opts & RT_GEOJSON_BBOX) && w->col_npoints )
+  {
+    RTFLAGS_SET_Z(w->col_box.flags, w->col_hasz);
+    geojson_bbox(ctx, w, &(w->col_box));
+  }
+  stringbuffer_append_len(ctx, w->sb, "}", 1);
+  w->nfeatures = -1;
+
+  return geojson_flush(ctx, w);
+}
@@ -678,17 +678,9 @@ pointArray_toGML2(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int precisio
       const RTPOINT2D *pt;
       pt = rt_getPoint2d_cp(ctx, pa, i);
 
-      if (fabs(pt->x) < OUT_MAX_DOUBLE)
-        sprintf(x, "%.*f", precision, pt->x);
-      else
-        sprintf(x, "%g", pt->x);
-      trim_trailing_zeros(ctx, x);
+      rtprint_double_fixed(ctx, pt->x, precision, x);
 
-      if (fabs(pt->y) < OUT_MAX_DOUBLE)
-        sprintf(y, "%.*f", precision, pt->y);
-      else
-        sprintf(y, "%g", pt->y);
-      trim_trailing_zeros(ctx, y);
+      rtprint_double_fixed(ctx, pt->y, precision, y);
 
       if ( i ) ptr += sprintf(ptr, " ");
       ptr += sprintf(ptr, "%s,%s", x, y);
@@ -701,23 +693,11 @@ pointArray_toGML2(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int precisio
       const RTPOINT3DZ *pt;
       pt = rt_getPoint3dz_cp(ctx, pa, i);
 
-      if (fabs(pt->x) < OUT_MAX_DOUBLE)
-        sprintf(x, "%.*f", precision, pt->x);
-      else
-        sprintf(x, "%g", pt->x);
-      trim_trailing_zeros(ctx, x);
+      rtprint_double_fixed(ctx, pt->x, precision, x);
 
-      if (fabs(pt->y) < OUT_MAX_DOUBLE)
-        sprintf(y, "%.*f", precision, pt->y);
-      else
-        sprintf(y, "%g", pt->y);
-      trim_trailing_zeros(ctx, y);
+      rtprint_double_fixed(ctx, pt->y, precision, y);
 
-      if (fabs(pt->z) < OUT_MAX_DOUBLE)
-        sprintf(z, "%.*f", precision, pt->z);
-      else
-        sprintf(z, "%g", pt->z);
-      trim_trailing_zeros(ctx, z);
+      rtprint_double_fixed(ctx, pt->z, precision, z);
 
       if ( i ) ptr += sprintf(ptr, " ");
       ptr += sprintf(ptr, "%s,%s,%s", x, y, z);
@@ -1925,17 +1905,9 @@ pointArray_toGML3(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int precisio
       const RTPOINT2D *pt;
       pt = rt_getPoint2d_cp(ctx, pa, i);
 
-      if (fabs(pt->x) < OUT_MAX_DOUBLE)
-        sprintf(x, "%.*f", precision, pt->x);
-      else
-        sprintf(x, "%g", pt->x);
-      trim_trailing_zeros(ctx, x);
+      rtprint_double_fixed(ctx, pt->x, precision, x);
 
-      if (fabs(pt->y) < OUT_MAX_DOUBLE)
-        sprintf(y, "%.*f", precision, pt->y);
-      else
-        sprintf(y, "%g", pt->y);
-      trim_trailing_zeros(ctx, y);
+      rtprint_double_fixed(ctx, pt->y, precision, y);
 
       if ( i ) ptr += sprintf(ptr, " ");
       if (IS_DEGREE(opts))
@@ -1951,23 +1923,11 @@ pointArray_toGML3(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int precisio
       const RTPOINT3DZ *pt;
       pt = rt_getPoint3dz_cp(ctx, pa, i);
 
-      if (fabs(pt->x) < OUT_MAX_DOUBLE)
-        sprintf(x, "%.*f", precision, pt->x);
-      else
-        sprintf(x, "%g", pt->x);
-      trim_trailing_zeros(ctx, x);
+      rtprint_double_fixed(ctx, pt->x, precision, x);
 
-      if (fabs(pt->y) < OUT_MAX_DOUBLE)
-        sprintf(y, "%.*f", precision, pt->y);
-      else
-        sprintf(y, "%g", pt->y);
-      trim_trailing_zeros(ctx, y);
+      rtprint_double_fixed(ctx, pt->y, precision, y);
 
-      if (fabs(pt->z) < OUT_MAX_DOUBLE)
-        sprintf(z, "%.*f", precision, pt->z);
-      else
-        sprintf(z, "%g", pt->z);
-      trim_trailing_zeros(ctx, z);
+      rtprint_double_fixed(ctx, pt->z, precision, z);
 
       if ( i ) ptr += sprintf(ptr, " ");
       if (IS_DEGREE(opts))
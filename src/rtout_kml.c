@@ -52,17 +52,17 @@ rtgeom_to_kml2(const RTCTX *ctx, const RTGEOM *geom, int precision, const char *
   if( rtgeom_is_empty(ctx, geom) )
     return NULL;
 
-  sb = stringbuffer_create(ctx);
+  sb = stringbuffer_create_scratch(ctx);
   rv = rtgeom_to_kml2_sb(ctx, geom, precision, prefix, sb);
 
   if ( rv == RT_FAILURE )
   {
-    stringbuffer_destroy(ctx, sb);
+    stringbuffer_release(ctx, sb);
     return NULL;
   }
 
   kml = stringbuffer_getstringcopy(ctx, sb);
-  stringbuffer_destroy(ctx, sb);
+  stringbuffer_release(ctx, sb);
 
   return kml;
 }
@@ -99,6 +99,7 @@ ptarray_to_kml2_sb(const RTCTX *ctx, const RTPOINTARRAY *pa, int precision, stri
   int dims = RTFLAGS_GET_Z(pa->flags) ? 3 : 2;
   RTPOINT4D pt;
   double *d;
+  char num[OUT_MAX_DIGS_DOUBLE + OUT_MAX_DOUBLE_PRECISION + 1];
 
   for ( i = 0; i < pa->npoints; i++ )
   {
@@ -108,15 +109,21 @@ ptarray_to_kml2_sb(const RTCTX *ctx, const RTPOINTARRAY *pa, int precision, stri
     for (j = 0; j < dims; j++)
     {
       if ( j ) stringbuffer_append(ctx, sb,",");
-      if( fabs(d[j]) < OUT_MAX_DOUBLE )
+      if ( precision > OUT_MAX_DOUBLE_PRECISION )
       {
-        if ( stringbuffer_aprintf(ctx, sb, "%.*f", precision, d[j]) < 0 ) return RT_FAILURE;
+        if( fabs(d[j]) < OUT_MAX_DOUBLE )
+        {
+          if ( stringbuffer_aprintf(ctx, sb, "%.*f", precision, d[j]) < 0 ) return RT_FAILURE;
+        }
+        else
+        {
+          if ( stringbuffer_aprintf(ctx, sb, "%g", d[j]) < 0 ) return RT_FAILURE;
+        }
+        stringbuffer_trim_trailing_zeroes(ctx, sb);
+        continue;
       }
-      else
-      {
-        if ( stringbuffer_aprintf(ctx, sb, "%g", d[j]) < 0 ) return RT_FAILURE;
-      }
-      stringbuffer_trim_trailing_zeroes(ctx, sb);
+      rtprint_double_fixed(ctx, d[j], precision, num);
+      stringbuffer_append(ctx, sb, num);
     }
   }
   return RT_SUCCESS;
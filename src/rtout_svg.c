@@ -127,18 +127,10 @@ assvg_point_buf(const RTCTX *ctx, const RTPOINT *point, char * output, int circl
 
   rt_getPoint2d_p(ctx, point->point, 0, &pt);
 
-  if (fabs(pt.x) < OUT_MAX_DOUBLE)
-    sprintf(x, "%.*f", precision, pt.x);
-  else
-    sprintf(x, "%g", pt.x);
-  trim_trailing_zeros(ctx, x);
+  rtprint_double_fixed(ctx, pt.x, precision, x);
 
   /* SVG Y axis is reversed, an no need to transform 0 into -0 */
-  if (fabs(pt.y) < OUT_MAX_DOUBLE)
-    sprintf(y, "%.*f", precision, fabs(pt.y) ? pt.y * -1 : pt.y);
-  else
-    sprintf(y, "%g", fabs(pt.y) ? pt.y * -1 : pt.y);
-  trim_trailing_zeros(ctx, y);
+  rtprint_double_fixed(ctx, fabs(pt.y) ? pt.y * -1 : pt.y, precision, y);
 
   if (circle) ptr += sprintf(ptr, "x=\"%s\" y=\"%s\"", x, y);
   else ptr += sprintf(ptr, "cx=\"%s\" cy=\"%s\"", x, y);
@@ -575,17 +567,9 @@ pointArray_svg_rel(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int close_r
   /* Starting point */
   rt_getPoint2d_p(ctx, pa, 0, &pt);
 
-  if (fabs(pt.x) < OUT_MAX_DOUBLE)
-    sprintf(x, "%.*f", precision, pt.x);
-  else
-    sprintf(x, "%g", pt.x);
-  trim_trailing_zeros(ctx, x);
+  rtprint_double_fixed(ctx, pt.x, precision, x);
 
-  if (fabs(pt.y) < OUT_MAX_DOUBLE)
-    sprintf(y, "%.*f", precision, fabs(pt.y) ? pt.y * -1 : pt.y);
-  else
-    sprintf(y, "%g", fabs(pt.y) ? pt.y * -1 : pt.y);
-  trim_trailing_zeros(ctx, y);
+  rtprint_double_fixed(ctx, fabs(pt.y) ? pt.y * -1 : pt.y, precision, y);
 
   ptr += sprintf(ptr,"%s %s l", x, y);
 
@@ -595,20 +579,10 @@ pointArray_svg_rel(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int close_r
     lpt = pt;
 
     rt_getPoint2d_p(ctx, pa, i, &pt);
-    if (fabs(pt.x -lpt.x) < OUT_MAX_DOUBLE)
-      sprintf(x, "%.*f", precision, pt.x -lpt.x);
-    else
-      sprintf(x, "%g", pt.x -lpt.x);
-    trim_trailing_zeros(ctx, x);
+    rtprint_double_fixed(ctx, pt.x -lpt.x, precision, x);
 
     /* SVG Y axis is reversed, an no need to transform 0 into -0 */
-    if (fabs(pt.y -lpt.y) < OUT_MAX_DOUBLE)
-      sprintf(y, "%.*f", precision,
-              fabs(pt.y -lpt.y) ? (pt.y - lpt.y) * -1: (pt.y - lpt.y));
-    else
-      sprintf(y, "%g",
-              fabs(pt.y -lpt.y) ? (pt.y - lpt.y) * -1: (pt.y - lpt.y));
-    trim_trailing_zeros(ctx, y);
+    rtprint_double_fixed(ctx, fabs(pt.y -lpt.y) ? (pt.y - lpt.y) * -1: (pt.y - lpt.y), precision, y);
 
     ptr += sprintf(ptr," %s %s", x, y);
   }
@@ -638,18 +612,10 @@ pointArray_svg_abs(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int close_r
   {
     rt_getPoint2d_p(ctx, pa, i, &pt);
 
-    if (fabs(pt.x) < OUT_MAX_DOUBLE)
-      sprintf(x, "%.*f", precision, pt.x);
-    else
-      sprintf(x, "%g", pt.x);
-    trim_trailing_zeros(ctx, x);
+    rtprint_double_fixed(ctx, pt.x, precision, x);
 
     /* SVG Y axis is reversed, an no need to transform 0 into -0 */
-    if (fabs(pt.y) < OUT_MAX_DOUBLE)
-      sprintf(y, "%.*f", precision, fabs(pt.y) ? pt.y * -1:pt.y);
-    else
-      sprintf(y, "%g", fabs(pt.y) ? pt.y * -1:pt.y);
-    trim_trailing_zeros(ctx, y);
+    rtprint_double_fixed(ctx, fabs(pt.y) ? pt.y * -1:pt.y, precision, y);
 
     if (i == 1) ptr += sprintf(ptr, " L ");
     else if (i) ptr += sprintf(ptr, " ");
@@ -68,36 +68,22 @@ static uint8_t rtgeom_twkb_type(const RTCTX *ctx, const RTGEOM *geom)
 
 
 /**
-* Calculates the size of the bbox in varints in the form:
+* Writes the bbox in varints in the form:
 * xmin, xdelta, ymin, ydelta
+* into buf, which must hold MAX_BBOX_SIZE bytes, and returns the size
 */
-static size_t sizeof_bbox(const RTCTX *ctx, TWKB_STATE *ts, int ndims)
+static size_t write_bbox(const RTCTX *ctx, TWKB_STATE *ts, int ndims, uint8_t *buf)
 {
   int i;
-  uint8_t buf[16];
   size_t size = 0;
   RTDEBUGF(ctx, 2, "Entered %s", __func__);
   for ( i = 0; i < ndims; i++ )
   {
-    size += varint_s64_encode_buf(ctx, ts->bbox_min[i], buf);
-    size += varint_s64_encode_buf(ctx, (ts->bbox_max[i] - ts->bbox_min[i]), buf);
+    size += varint_s64_encode_buf(ctx, ts->bbox_min[i], buf + size);
+    size += varint_s64_encode_buf(ctx, (ts->bbox_max[i] - ts->bbox_min[i]), buf + size);
   }
   return size;
 }
-/**
-* Writes the bbox in varints in the form:
-* xmin, xdelta, ymin, ydelta
-*/
-static void write_bbox(const RTCTX *ctx, TWKB_STATE *ts, int ndims)
-{
-  int i;
-  RTDEBUGF(ctx, 2, "Entered %s", __func__);
-  for ( i = 0; i < ndims; i++ )
-  {
-    bytebuffer_append_varint(ctx, ts->header_buf, ts->bbox_min[i]);
-    bytebuffer_append_varint(ctx, ts->header_buf, (ts->bbox_max[i] - ts->bbox_min[i]));
-  }
-}
 
 
 /**
@@ -109,9 +95,10 @@ static int ptarray_to_twkb_buf(const RTCTX *ctx, const RTPOINTARRAY *pa, TWKB_GL
 {
   int ndims = RTFLAGS_NDIMS(pa->flags);
   int i, j;
-  bytebuffer_t b;
-  bytebuffer_t *b_p;
+  bytebuffer_t *b_p = ts->geom_buf;
   int64_t nextdelta[MAX_N_DIMS];
+  int64_t deltas[TWKB_DELTA_BLOCK];
+  size_t ndeltas = 0;
   int npoints = 0;
   size_t npoints_offset = 0;
 
@@ -125,34 +112,15 @@ static int ptarray_to_twkb_buf(const RTCTX *ctx, const RTPOINTARRAY *pa, TWKB_GL
     return 0;
   }
 
-  /* If npoints is more than 127 it is unpredictable how many bytes npoints will need */
-  /* Then we have to store the deltas in a temp buffer to later add them after npoints */
-  /* If noints is below 128 we know 1 byte will be needed */
-  /* Then we can make room for that 1 byte at once and write to */
-  /* ordinary buffer */
-  if( pa->npoints > 127 )
+  /* We do not know how many points we will keep until they are written, */
+  /* so remember where npoints goes. Below 128 points it takes one byte, */
+  /* which we reserve now; otherwise it is inserted at the end. */
+  /* We store an offset, as the buffer may be reallocated. */
+  if ( register_npoints )
   {
-    /* Independent buffer to hold the coordinates, so we can put the npoints */
-    /* into the stream once we know how many points we actually have */
-    bytebuffer_init_with_size(ctx, &b, 3 * ndims * pa->npoints);
-    b_p = &b;
-  }
-  else
-  {
-    /* We give an alias to our ordinary buffer */
-    b_p = ts->geom_buf;
-    if ( register_npoints )
-    {
-      /* We do not store a pointer to the place where we want the npoints value */
-      /* Instead we store how far from the beginning of the buffer we want the value */
-      /* That is because we otherwise will get in trouble if the buffer is reallocated */
-      npoints_offset = b_p->writecursor - b_p->buf_start;
-
-      /* We just move the cursor 1 step to make room for npoints byte */
-      /* We use the function append_byte even if we have no value yet, */
-      /* since that gives us the check for big enough buffer and moves the cursor */
+    npoints_offset = b_p->writecursor - b_p->buf_start;
+    if ( pa->npoints <= 127 )
       bytebuffer_append_byte(ctx, b_p, 0);
-    }
   }
 
   for ( i = 0; i < pa->npoints; i++ )
@@ -181,11 +149,16 @@ static int ptarray_to_twkb_buf(const RTCTX *ctx, const RTPOINTARRAY *pa, TWKB_GL
     /* We really added a point, so... */
     npoints++;
 
-    /* Write this vertex to the temporary buffer as varints */
+    /* Queue this vertex, the deltas are written as varints in batches */
     for ( j = 0; j < ndims; j++ )
     {
       ts->accum_rels[j] += nextdelta[j];
-      bytebuffer_append_varint(ctx, b_p, nextdelta[j]);
+      deltas[ndeltas++] = nextdelta[j];
+    }
+    if ( ndeltas > TWKB_DELTA_BLOCK - MAX_N_DIMS )
+    {
+      bytebuffer_append_varints(ctx, b_p, deltas, ndeltas);
+      ndeltas = 0;
     }
 
     /* See if this coordinate expands the bounding box */
@@ -203,24 +176,22 @@ static int ptarray_to_twkb_buf(const RTCTX *ctx, const RTPOINTARRAY *pa, TWKB_GL
 
   }
 
-  if ( pa->npoints > 127 )
-  {
-    /* Now write the temporary results into the main buffer */
-    /* First the npoints */
-    if ( register_npoints )
-      bytebuffer_append_uvarint(ctx, ts->geom_buf, npoints);
-    /* Now the coordinates */
-    bytebuffer_append_bytebuffer(ctx, ts->geom_buf, b_p);
-
-    /* Clear our temporary buffer */
-    rtfree(ctx, b.buf_start);
-  }
-  else
+  if ( ndeltas )
+    bytebuffer_append_varints(ctx, b_p, deltas, ndeltas);
+
+  /* Now that we know it, write the npoints value where it belongs */
+  if ( register_npoints )
   {
-    /* If we didn't use a temp buffer, we just write that npoints value */
-    /* to where it belongs*/
-    if ( register_npoints )
+    if ( pa->npoints <= 127 )
+    {
       varint_u64_encode_buf(ctx, npoints, b_p->buf_start + npoints_offset);
+    }
+    else
+    {
+      uint8_t buf[VARINT_MAX_SIZE];
+      size_t size = varint_u64_encode_buf(ctx, npoints, buf);
+      bytebuffer_insert_bulk(ctx, b_p, npoints_offset, buf, size);
+    }
   }
 
   return 0;
@@ -319,7 +290,8 @@ static int rtmulti_to_twkb_buf(const RTCTX *ctx, const RTCOLLECTION *col, TWKB_G
     if ( col->type == RTMULTIPOINTTYPE && rtgeom_is_empty(ctx, col->geoms[i]) )
       continue;
 
-    rtgeom_to_twkb_buf(ctx, col->geoms[i], globals, ts);
+    if ( rtgeom_to_twkb_buf(ctx, col->geoms[i], globals, ts) )
+      return -1;
   }
   return 0;
 }
@@ -351,7 +323,8 @@ static int rtcollection_to_twkb_buf(const RTCTX *ctx, const RTCOLLECTION *col, T
   /* Write in the sub-geometries */
   for ( i = 0; i < col->ngeoms; i++ )
   {
-    rtgeom_write_to_buffer(ctx, col->geoms[i], globals, ts);
+    if ( rtgeom_write_to_buffer(ctx, col->geoms[i], globals, ts) )
+      return -1;
   }
   return 0;
 }
@@ -400,6 +373,7 @@ static int rtgeom_to_twkb_buf(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLOBALS
     /* Unknown type! */
     default:
       rterror(ctx, "Unsupported geometry type: %s [%d]", rttype_name(ctx, (geom)->type), (geom)->type);
+      return -1;
   }
 
   return 0;
@@ -409,13 +383,17 @@ static int rtgeom_to_twkb_buf(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLOBALS
 static int rtgeom_write_to_buffer(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLOBALS *globals, TWKB_STATE *parent_state)
 {
   int i, is_empty, has_z, has_m, ndims;
-  size_t bbox_size = 0, optional_precision_byte = 0;
+  size_t header_size = 0, start, bbox_size = 0, optional_precision_byte = 0;
   uint8_t flag = 0, type_prec = 0;
+  uint8_t header[MAX_HEADER_SIZE];
+  uint8_t bbox[MAX_BBOX_SIZE];
 
+  /* The geometry is written straight into the shared output buffer, */
+  /* and its header slipped in front of it once the size and bbox are known */
   TWKB_STATE child_state;
   memset(&child_state, 0, sizeof(TWKB_STATE));
-  child_state.header_buf = bytebuffer_create_with_size(ctx, 16);
-  child_state.geom_buf = bytebuffer_create_with_size(ctx, 64);
+  child_state.nested = 1;
+  child_state.geom_buf = parent_state->geom_buf;
   child_state.idlist = parent_state->idlist;
 
   /* Read dimensionality from input */
@@ -427,15 +405,11 @@ static int rtgeom_write_to_buffer(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLO
   /* Do we need extended precision? If we have a Z or M we do. */
   optional_precision_byte = (has_z || has_m);
 
-  /* Both X and Y dimension use the same precision */
-  globals->factor[0] = pow(10, globals->prec_xy);
-  globals->factor[1] = globals->factor[0];
-
   /* Z and M dimensions have their own precisions */
   if ( has_z )
-    globals->factor[2] = pow(10, globals->prec_z);
+    globals->factor[2] = globals->factor_z;
   if ( has_m )
-    globals->factor[2 + has_z] = pow(10, globals->prec_m);
+    globals->factor[2 + has_z] = globals->factor_m;
 
   /* Reset stats */
   for ( i = 0; i < MAX_N_DIMS; i++ )
@@ -449,14 +423,17 @@ static int rtgeom_write_to_buffer(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLO
 
   /* RTTYPE/PRECISION BYTE */
   if ( abs(globals->prec_xy) > 7 )
+  {
     rterror(ctx, "%s: X/Z precision cannot be greater than 7 or less than -7", __func__);
+    return -1;
+  }
 
   /* Read the TWKB type number from the geometry */
   RTTYPE_PREC_SET_TYPE(type_prec, rtgeom_twkb_type(ctx, geom));
   /* Zig-zag the precision value before encoding it since it is a signed value */
   TYPE_PREC_SET_PREC(type_prec, zigzag8(ctx, globals->prec_xy));
   /* Write the type and precision byte */
-  bytebuffer_append_byte(ctx, child_state.header_buf, type_prec);
+  header[header_size++] = type_prec;
 
   /* METADATA BYTE */
   /* Set first bit if we are going to store bboxes */
@@ -470,7 +447,7 @@ static int rtgeom_write_to_buffer(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLO
   /* Empty? */
   FIRST_BYTE_SET_EMPTY(flag, is_empty);
   /* Write the header byte */
-  bytebuffer_append_byte(ctx, child_state.header_buf, flag);
+  header[header_size++] = flag;
 
   /* EXTENDED PRECISION BYTE (OPTIONAL) */
   /* If needed, write the extended dim byte */
@@ -479,16 +456,22 @@ static int rtgeom_write_to_buffer(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLO
     uint8_t flag = 0;
 
     if ( has_z && ( globals->prec_z > 7 || globals->prec_z < 0 ) )
+    {
       rterror(ctx, "%s: Z precision cannot be negative or greater than 7", __func__);
+      return -1;
+    }
 
     if ( has_m && ( globals->prec_m > 7 || globals->prec_m < 0 ) )
+    {
       rterror(ctx, "%s: M precision cannot be negative or greater than 7", __func__);
+      return -1;
+    }
 
     HIGHER_DIM_SET_HASZ(flag, has_z);
     HIGHER_DIM_SET_HASM(flag, has_m);
     HIGHER_DIM_SET_PRECZ(flag, globals->prec_z);
     HIGHER_DIM_SET_PRECM(flag, globals->prec_m);
-    bytebuffer_append_byte(ctx, child_state.header_buf, flag);
+    header[header_size++] = flag;
   }
 
   /* It the geometry is empty, we're almost done */
@@ -498,21 +481,20 @@ static int rtgeom_write_to_buffer(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLO
     /* all following content, which is zero because */
     /* there is none */
     if ( globals->variant & TWKB_SIZE )
-      bytebuffer_append_byte(ctx, child_state.header_buf, 0);
+      header[header_size++] = 0;
 
-    bytebuffer_append_bytebuffer(ctx, parent_state->geom_buf, child_state.header_buf);
-    bytebuffer_destroy(ctx, child_state.header_buf);
-    bytebuffer_destroy(ctx, child_state.geom_buf);
+    bytebuffer_append_bulk(ctx, parent_state->geom_buf, header, header_size);
     return 0;
   }
 
   /* Write the TWKB into the output buffer */
-  rtgeom_to_twkb_buf(ctx, geom, globals, &child_state);
+  start = bytebuffer_getlength(ctx, child_state.geom_buf);
+  if ( rtgeom_to_twkb_buf(ctx, geom, globals, &child_state) )
+    return -1;
 
-  /*If we have a header_buf, we know that this function is called inside a collection*/
-  /*and then we have to merge the bboxes of the included geometries*/
-  /*and put the result to the parent (the collection)*/
-  if( (globals->variant & TWKB_BBOX) && parent_state->header_buf )
+  /*If we are inside a collection, we have to merge the bboxes*/
+  /*of the included geometries and put the result to the parent*/
+  if( (globals->variant & TWKB_BBOX) && parent_state->nested )
   {
     RTDEBUG(ctx, 4,"Merge bboxes");
     for ( i = 0; i < ndims; i++ )
@@ -525,11 +507,10 @@ static int rtgeom_write_to_buffer(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLO
   }
 
   /* Did we have a box? If so, how big? */
-  bbox_size = 0;
   if( globals->variant & TWKB_BBOX )
   {
     RTDEBUG(ctx, 4,"We want boxes and will calculate required size");
-    bbox_size = sizeof_bbox(ctx, &child_state, ndims);
+    bbox_size = write_bbox(ctx, &child_state, ndims, bbox);
   }
 
   /* Write the size if wanted */
@@ -537,20 +518,37 @@ static int rtgeom_write_to_buffer(const RTCTX *ctx, const RTGEOM *geom, TWKB_GLO
   {
     /* Here we have to add what we know will be written to header */
     /* buffer after size value is written */
-    size_t size_to_register = bytebuffer_getlength(ctx, child_state.geom_buf);
+    size_t size_to_register = bytebuffer_getlength(ctx, child_state.geom_buf) - start;
     size_to_register += bbox_size;
-    bytebuffer_append_uvarint(ctx, child_state.header_buf, size_to_register);
+    header_size += varint_u64_encode_buf(ctx, size_to_register, header + header_size);
   }
 
-  if( globals->variant & TWKB_BBOX )
-    write_bbox(ctx, &child_state, ndims);
+  memcpy(header + header_size, bbox, bbox_size);
+  header_size += bbox_size;
+  bytebuffer_insert_bulk(ctx, parent_state->geom_buf, start, header, header_size);
+  return 0;
+}
 
-  bytebuffer_append_bytebuffer(ctx, parent_state->geom_buf,child_state.header_buf);
-  bytebuffer_append_bytebuffer(ctx, parent_state->geom_buf,child_state.geom_buf);
 
-  bytebuffer_destroy(ctx, child_state.header_buf);
-  bytebuffer_destroy(ctx, child_state.geom_buf);
-  return 0;
+/**
+* Set up the globals once for any number of geometries
+*/
+static void
+twkb_globals_init(const RTCTX *ctx, TWKB_GLOBALS *tg, uint8_t variant,
+               int8_t precision_xy, int8_t precision_z, int8_t precision_m)
+{
+  memset(tg, 0, sizeof(TWKB_GLOBALS));
+
+  tg->variant = variant;
+  tg->prec_xy = precision_xy;
+  tg->prec_z = precision_z;
+  tg->prec_m = precision_m;
+
+  /* Both X and Y dimension use the same precision */
+  tg->factor[0] = pow(10, precision_xy);
+  tg->factor[1] = tg->factor[0];
+  tg->factor_z = pow(10, precision_z);
+  tg->factor_m = pow(10, precision_m);
 }
 
 
@@ -572,12 +570,7 @@ rtgeom_to_twkb_with_idlist(const RTCTX *ctx, const RTGEOM *geom, int64_t *idlist
   uint8_t *twkb;
 
   memset(&ts, 0, sizeof(TWKB_STATE));
-  memset(&tg, 0, sizeof(TWKB_GLOBALS));
-
-  tg.variant = variant;
-  tg.prec_xy = precision_xy;
-  tg.prec_z = precision_z;
-  tg.prec_m = precision_m;
+  twkb_globals_init(ctx, &tg, variant, precision_xy, precision_z, precision_m);
 
   if ( idlist && ! rtgeom_is_collection(ctx, geom) )
   {
@@ -593,15 +586,14 @@ rtgeom_to_twkb_with_idlist(const RTCTX *ctx, const RTGEOM *geom, int64_t *idlist
   }
 
   ts.idlist = idlist;
-  ts.header_buf = NULL;
-  ts.geom_buf = bytebuffer_create(ctx);
-  rtgeom_write_to_buffer(ctx, geom, &tg, &ts);
-
-  if ( twkb_size )
-    *twkb_size = bytebuffer_getlength(ctx, ts.geom_buf);
+  ts.geom_buf = bytebuffer_create_scratch(ctx);
+  if ( rtgeom_write_to_buffer(ctx, geom, &tg, &ts) )
+  {
+    bytebuffer_release(ctx, ts.geom_buf);
+    return NULL;
+  }
 
-  twkb = ts.geom_buf->buf_start;
-  rtfree(ctx, ts.geom_buf);
+  twkb = bytebuffer_release_bytes(ctx, ts.geom_buf, twkb_size);
   return twkb;
 }
 
@@ -615,3 +607,53 @@ rtgeom_to_twkb(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant,
 }
 
 
+uint8_t*
+rtgeom_to_twkb_batch(const RTCTX *ctx, RTGEOM **geoms, int ngeoms, int64_t **idlists,
+               uint8_t variant, int8_t precision_xy, int8_t precision_z, int8_t precision_m,
+               size_t *offsets, size_t *twkb_size)
+{
+  TWKB_GLOBALS tg;
+  TWKB_STATE ts;
+  bytebuffer_t *buf;
+  int i;
+
+  RTDEBUGF(ctx, 2, "Entered %s", __func__);
+
+  if ( twkb_size ) *twkb_size = 0;
+
+  if ( ngeoms < 0 )
+  {
+    rterror(ctx, "Cannot convert %d geometries into TWKB.", ngeoms);
+    return NULL;
+  }
+
+  twkb_globals_init(ctx, &tg, variant, precision_xy, precision_z, precision_m);
+
+  /* One output buffer for the whole batch, each TWKB is appended to it */
+  buf = bytebuffer_create_scratch(ctx);
+
+  for ( i = 0; i < ngeoms; i++ )
+  {
+    offsets[i] = bytebuffer_getlength(ctx, buf);
+    if ( ! geoms[i] )
+      continue;
+
+    memset(&ts, 0, sizeof(TWKB_STATE));
+    ts.idlist = idlists ? idlists[i] : NULL;
+    if ( ts.idlist && ! rtgeom_is_collection(ctx, geoms[i]) )
+    {
+      bytebuffer_release(ctx, buf);
+      rterror(ctx, "Only collections can support ID lists");
+      return NULL;
+    }
+    ts.geom_buf = buf;
+    if ( rtgeom_write_to_buffer(ctx, geoms[i], &tg, &ts) )
+    {
+      bytebuffer_release(ctx, buf);
+      return NULL;
+    }
+  }
+  offsets[ngeoms] = bytebuffer_getlength(ctx, buf);
+
+  return bytebuffer_release_bytes(ctx, buf, twkb_size);
+}
@@ -44,8 +44,14 @@
 /* Maximum number of geometry dimmensions that internal arrays can hold */
 #define MAX_N_DIMS 4
 
-#define MAX_BBOX_SIZE 64
-#define MAX_SIZE_SIZE 8
+/* Number of coordinate deltas buffered before encoding them as varints */
+#define TWKB_DELTA_BLOCK 256
+
+#define MAX_BBOX_SIZE (2 * MAX_N_DIMS * VARINT_MAX_SIZE)
+#define MAX_SIZE_SIZE VARINT_MAX_SIZE
+
+/* Type/precision, metadata and extended dimension bytes, size and bbox */
+#define MAX_HEADER_SIZE (3 + MAX_SIZE_SIZE + MAX_BBOX_SIZE)
 
 
 /**
@@ -82,13 +88,15 @@ typedef struct
   int8_t prec_z;
   int8_t prec_m;
   float factor[4]; /*What factor to multiply the coordiinates with to get the requested precision*/
+  float factor_z;
+  float factor_m;
 } TWKB_GLOBALS;
 
 typedef struct
 {
   uint8_t variant;  /*options that change at runtime*/
-  bytebuffer_t *header_buf;
-  bytebuffer_t *geom_buf;
+  int nested; /* below the top level, member bboxes merge into this one */
+  bytebuffer_t *geom_buf; /* output, shared by all levels */
   int hasz;
   int hasm;
   const int64_t *idlist;
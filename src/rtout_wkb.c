@@ -30,18 +30,46 @@
 #include "librttopo_geom_internal.h"
 #include "rtgeom_log.h"
 
-static uint8_t* rtgeom_to_wkb_buf(const RTCTX *ctx, const RTGEOM *geom, uint8_t *buf, uint8_t variant);
-static size_t rtgeom_to_wkb_size(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant);
+static uint8_t* rtgeom_to_wkb_buf_rec(const RTCTX *ctx, const RTGEOM *geom, uint8_t *buf, uint8_t variant);
+static size_t rtgeom_to_wkb_size_rec(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant);
 
 /*
-* Look-up table for hex writer
+* Look-up table for hex writer: the two digits of every byte value
 */
-static char *hexchr = "0123456789ABCDEF";
+static const char hexpairs[513] =
+  "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+  "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+  "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+  "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+  "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+  "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+  "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+  "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+/*
+* Hex encode size bytes into 2*size characters, reversing their order
+* when swap is set. Returns the position after the last character.
+*/
+static uint8_t* hex_from_bytes_buf(const uint8_t *bytes, size_t size, uint8_t *buf, int swap)
+{
+  size_t i;
+
+  if ( swap )
+  {
+    for( i = 0; i < size; i++ )
+      memcpy(buf + 2*i, hexpairs + 2*bytes[size - 1 - i], 2);
+  }
+  else
+  {
+    for( i = 0; i < size; i++ )
+      memcpy(buf + 2*i, hexpairs + 2*bytes[i], 2);
+  }
+  return buf + 2*size;
+}
 
 char* hexbytes_from_bytes(const RTCTX *ctx, uint8_t *bytes, size_t size)
 {
   char *hex;
-  int i;
   if ( ! bytes || ! size )
   {
     rterror(ctx, "hexbutes_from_bytes: invalid input");
@@ -49,13 +77,7 @@ char* hexbytes_from_bytes(const RTCTX *ctx, uint8_t *bytes, size_t size)
   }
   hex = rtalloc(ctx, size * 2 + 1);
   hex[2*size] = '\0';
-  for( i = 0; i < size; i++ )
-  {
-    /* Top four bits to 0-F */
-    hex[2*i] = hexchr[bytes[i] >> 4];
-    /* Bottom four bits to 0-F */
-    hex[2*i+1] = hexchr[bytes[i] & 0x0F];
-  }
+  hex_from_bytes_buf(bytes, size, (uint8_t*)hex, RT_FALSE);
   return hex;
 }
 
@@ -207,18 +229,8 @@ static uint8_t* integer_to_wkb_buf(const RTCTX *ctx, const int ival, uint8_t *bu
   RTDEBUGF(ctx, 4, "Writing value '%u'", ival);
   if ( variant & RTWKB_HEX )
   {
-    int swap = wkb_swap_bytes(ctx, variant);
     /* Machine/request arch mismatch, so flip byte order */
-    for ( i = 0; i < RTWKB_INT_SIZE; i++ )
-    {
-      int j = (swap ? RTWKB_INT_SIZE - 1 - i : i);
-      uint8_t b = iptr[j];
-      /* Top four bits to 0-F */
-      buf[2*i] = hexchr[b >> 4];
-      /* Bottom four bits to 0-F */
-      buf[2*i+1] = hexchr[b & 0x0F];
-    }
-    return buf + (2 * RTWKB_INT_SIZE);
+    return hex_from_bytes_buf((uint8_t*)iptr, RTWKB_INT_SIZE, buf, wkb_swap_bytes(ctx, variant));
   }
   else
   {
@@ -254,18 +266,8 @@ static uint8_t* double_to_wkb_buf(const RTCTX *ctx, const double d, uint8_t *buf
 
   if ( variant & RTWKB_HEX )
   {
-    int swap =  wkb_swap_bytes(ctx, variant);
     /* Machine/request arch mismatch, so flip byte order */
-    for ( i = 0; i < RTWKB_DOUBLE_SIZE; i++ )
-    {
-      int j = (swap ? RTWKB_DOUBLE_SIZE - 1 - i : i);
-      uint8_t b = dptr[j];
-      /* Top four bits to 0-F */
-      buf[2*i] = hexchr[b >> 4];
-      /* Bottom four bits to 0-F */
-      buf[2*i+1] = hexchr[b & 0x0F];
-    }
-    return buf + (2 * RTWKB_DOUBLE_SIZE);
+    return hex_from_bytes_buf((uint8_t*)dptr, RTWKB_DOUBLE_SIZE, buf, wkb_swap_bytes(ctx, variant));
   }
   else
   {
@@ -385,13 +387,20 @@ static uint8_t* ptarray_to_wkb_buf(const RTCTX *ctx, const RTPOINTARRAY *pa, uin
   if ( ! ( variant & RTWKB_NO_NPOINTS ) )
     buf = integer_to_wkb_buf(ctx, pa->npoints, buf, variant);
 
-  /* Bulk copy the coordinates when: dimensionality matches, output format */
-  /* is not hex, and output endian matches internal endian. */
-  if ( pa->npoints && (dims == pa_dims) && ! wkb_swap_bytes(ctx, variant) && ! (variant & RTWKB_HEX)  )
+  /* Bulk copy the coordinates when: dimensionality matches and output */
+  /* endian matches internal endian. Hex output is encoded in one run. */
+  if ( pa->npoints && (dims == pa_dims) && ! wkb_swap_bytes(ctx, variant) )
   {
     size_t size = pa->npoints * dims * RTWKB_DOUBLE_SIZE;
-    memcpy(buf, rt_getPoint_internal(ctx, pa, 0), size);
-    buf += size;
+    if ( variant & RTWKB_HEX )
+    {
+      buf = hex_from_bytes_buf(rt_getPoint_internal(ctx, pa, 0), size, buf, RT_FALSE);
+    }
+    else
+    {
+      memcpy(buf, rt_getPoint_internal(ctx, pa, 0), size);
+      buf += size;
+    }
   }
   /* Copy coordinates one-by-one otherwise */
   else
@@ -614,7 +623,7 @@ static size_t rtcollection_to_wkb_size(const RTCTX *ctx, const RTCOLLECTION *col
   for ( i = 0; i < col->ngeoms; i++ )
   {
     /* size of subgeom */
-    size += rtgeom_to_wkb_size(ctx, (RTGEOM*)col->geoms[i], variant | RTWKB_NO_SRID);
+    size += rtgeom_to_wkb_size_rec(ctx, (RTGEOM*)col->geoms[i], variant | RTWKB_NO_SRID);
   }
 
   return size;
@@ -638,7 +647,7 @@ static uint8_t* rtcollection_to_wkb_buf(const RTCTX *ctx, const RTCOLLECTION *co
      inherit from their parents. */
   for ( i = 0; i < col->ngeoms; i++ )
   {
-    buf = rtgeom_to_wkb_buf(ctx, col->geoms[i], buf, variant | RTWKB_NO_SRID);
+    buf = rtgeom_to_wkb_buf_rec(ctx, col->geoms[i], buf, variant | RTWKB_NO_SRID);
   }
 
   return buf;
@@ -647,7 +656,7 @@ static uint8_t* rtcollection_to_wkb_buf(const RTCTX *ctx, const RTCOLLECTION *co
 /*
 * GEOMETRY
 */
-static size_t rtgeom_to_wkb_size(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant)
+static size_t rtgeom_to_wkb_size_rec(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant)
 {
   size_t size = 0;
 
@@ -706,7 +715,7 @@ static size_t rtgeom_to_wkb_size(const RTCTX *ctx, const RTGEOM *geom, uint8_t v
 
 /* TODO handle the TRIANGLE type properly */
 
-static uint8_t* rtgeom_to_wkb_buf(const RTCTX *ctx, const RTGEOM *geom, uint8_t *buf, uint8_t variant)
+static uint8_t* rtgeom_to_wkb_buf_rec(const RTCTX *ctx, const RTGEOM *geom, uint8_t *buf, uint8_t variant)
 {
 
   /* Do not simplify empties when outputting to canonical form */
@@ -752,6 +761,159 @@ static uint8_t* rtgeom_to_wkb_buf(const RTCTX *ctx, const RTGEOM *geom, uint8_t
   return 0;
 }
 
+/*
+* If neither or both byte orders are specified, choose the native order
+*/
+static uint8_t wkb_variant_endian(const RTCTX *ctx, uint8_t variant)
+{
+  if ( ! (variant & RTWKB_NDR || variant & RTWKB_XDR) ||
+         (variant & RTWKB_NDR && variant & RTWKB_XDR) )
+  {
+    if ( getMachineEndian(ctx) == NDR )
+      variant = variant | RTWKB_NDR;
+    else
+      variant = variant | RTWKB_XDR;
+  }
+  return variant;
+}
+
+/**
+* Size of the RTWKB output of a geometry, as reported by rtgeom_to_wkb:
+* hex output takes two characters per byte plus a null terminator.
+* Returns 0 for a NULL geometry.
+*/
+size_t rtgeom_to_wkb_size(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant)
+{
+  size_t size = rtgeom_to_wkb_size_rec(ctx, geom, variant);
+
+  /* Hex string takes twice as much space as binary + a null character */
+  if ( size && (variant & RTWKB_HEX) )
+    size = 2 * size + 1;
+
+  return size;
+}
+
+/**
+* Write the RTWKB of a geometry into buf, which has room for the
+* wkb_size bytes returned by rtgeom_to_wkb_size. Returns wkb_size,
+* or 0 on error.
+*/
+static size_t rtgeom_to_wkb_sized(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, uint8_t *buf, size_t wkb_size)
+{
+  uint8_t *end;
+
+  variant = wkb_variant_endian(ctx, variant);
+
+  /* Write the RTWKB into the output buffer */
+  end = rtgeom_to_wkb_buf_rec(ctx, geom, buf, variant);
+
+  /* Null the last byte if this is a hex output */
+  if ( variant & RTWKB_HEX )
+  {
+    *end = '\0';
+    end++;
+  }
+
+  RTDEBUGF(ctx, 4,"end (%p) - buf (%p) = %d", end, buf, end - buf);
+
+  /* The end pointer should now land at the end of the computed size. Let's check. */
+  if ( wkb_size != (end - buf) )
+  {
+    rterror(ctx, "Output RTWKB is not the same size as the allocated buffer.");
+    return 0;
+  }
+
+  return wkb_size;
+}
+
+/**
+* Write the RTWKB of a geometry into a caller supplied buffer of
+* buf_size bytes. Returns the number of bytes written, the same as
+* rtgeom_to_wkb_size, or 0 on error.
+*/
+size_t rtgeom_to_wkb_buf(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, uint8_t *buf, size_t buf_size)
+{
+  size_t wkb_size;
+
+  if ( geom == NULL )
+  {
+    rterror(ctx, "Cannot convert NULL into RTWKB.");
+    return 0;
+  }
+
+  /* Calculate the required size of the output buffer */
+  wkb_size = rtgeom_to_wkb_size(ctx, geom, variant);
+  RTDEBUGF(ctx, 4, "RTWKB output size: %d", wkb_size);
+
+  if ( wkb_size == 0 )
+  {
+    rterror(ctx, "Error calculating output RTWKB buffer size.");
+    return 0;
+  }
+  if ( wkb_size > buf_size )
+  {
+    rterror(ctx, "RTWKB output needs %lu bytes, buffer has %lu.", (unsigned long)wkb_size, (unsigned long)buf_size);
+    return 0;
+  }
+
+  return rtgeom_to_wkb_sized(ctx, geom, variant, buf, wkb_size);
+}
+
+/**
+* Write the RTWKB of ngeoms geometries one after the other into one
+* allocated buffer. Geometry i lands at offsets[i] and takes
+* offsets[i+1] - offsets[i] bytes, so offsets must have room for
+* ngeoms + 1 entries. NULL geometries take no room. Returns the buffer,
+* never NULL on success even when nothing was written, or NULL on error.
+*/
+uint8_t* rtgeom_to_wkb_batch(const RTCTX *ctx, RTGEOM **geoms, int ngeoms, uint8_t variant, size_t *offsets, size_t *size_out)
+{
+  uint8_t *buf;
+  size_t size, total = 0;
+  int i;
+
+  if ( size_out ) *size_out = 0;
+
+  if ( ngeoms < 0 )
+  {
+    rterror(ctx, "Cannot convert %d geometries into RTWKB.", ngeoms);
+    return NULL;
+  }
+
+  offsets[0] = 0;
+  for ( i = 0; i < ngeoms; i++ )
+  {
+    if ( geoms[i] )
+    {
+      size = rtgeom_to_wkb_size(ctx, geoms[i], variant);
+      if ( size == 0 )
+      {
+        rterror(ctx, "Error calculating output RTWKB buffer size.");
+        return NULL;
+      }
+      total += size;
+    }
+    offsets[i+1] = total;
+  }
+
+  /* Room for one byte at least, so that success is never NULL */
+  buf = rtalloc(ctx, total ? total : 1);
+
+  for ( i = 0; i < ngeoms; i++ )
+  {
+    if ( offsets[i+1] == offsets[i] )
+      continue;
+    if ( ! rtgeom_to_wkb_sized(ctx, geoms[i], variant, buf + offsets[i], offsets[i+1] - offsets[i]) )
+    {
+      rtfree(ctx, buf);
+      return NULL;
+    }
+  }
+
+  if ( size_out ) *size_out = total;
+  return buf;
+}
+
 /**
 * Convert RTGEOM to a char* in RTWKB format. Caller is responsible for freeing
 * the returned array.
@@ -767,7 +929,6 @@ uint8_t* rtgeom_to_wkb(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, si
 {
   size_t buf_size;
   uint8_t *buf = NULL;
-  uint8_t *wkb_out = NULL;
 
   /* Initialize output size */
   if ( size_out ) *size_out = 0;
@@ -781,7 +942,6 @@ uint8_t* rtgeom_to_wkb(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, si
 
   /* Calculate the required size of the output buffer */
   buf_size = rtgeom_to_wkb_size(ctx, geom, variant);
-  RTDEBUGF(ctx, 4, "RTWKB output size: %d", buf_size);
 
   if ( buf_size == 0 )
   {
@@ -790,23 +950,6 @@ uint8_t* rtgeom_to_wkb(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, si
     return NULL;
   }
 
-  /* Hex string takes twice as much space as binary + a null character */
-  if ( variant & RTWKB_HEX )
-  {
-    buf_size = 2 * buf_size + 1;
-    RTDEBUGF(ctx, 4, "Hex RTWKB output size: %d", buf_size);
-  }
-
-  /* If neither or both variants are specified, choose the native order */
-  if ( ! (variant & RTWKB_NDR || variant & RTWKB_XDR) ||
-         (variant & RTWKB_NDR && variant & RTWKB_XDR) )
-  {
-    if ( getMachineEndian(ctx) == NDR )
-      variant = variant | RTWKB_NDR;
-    else
-      variant = variant | RTWKB_XDR;
-  }
-
   /* Allocate the buffer */
   buf = rtalloc(ctx, buf_size);
 
@@ -817,38 +960,19 @@ uint8_t* rtgeom_to_wkb(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, si
     return NULL;
   }
 
-  /* Retain a pointer to the front of the buffer for later */
-  wkb_out = buf;
-
-  /* Write the RTWKB into the output buffer */
-  buf = rtgeom_to_wkb_buf(ctx, geom, buf, variant);
-
-  /* Null the last byte if this is a hex output */
-  if ( variant & RTWKB_HEX )
-  {
-    *buf = '\0';
-    buf++;
-  }
-
-  RTDEBUGF(ctx, 4,"buf (%p) - wkb_out (%p) = %d", buf, wkb_out, buf - wkb_out);
-
-  /* The buffer pointer should now land at the end of the allocated buffer space. Let's check. */
-  if ( buf_size != (buf - wkb_out) )
+  if ( rtgeom_to_wkb_sized(ctx, geom, variant, buf, buf_size) != buf_size )
   {
-    RTDEBUG(ctx, 4,"Output RTWKB is not the same size as the allocated buffer.");
-    rterror(ctx, "Output RTWKB is not the same size as the allocated buffer.");
-    rtfree(ctx, wkb_out);
+    rtfree(ctx, buf);
     return NULL;
   }
 
   /* Report output size */
   if ( size_out ) *size_out = buf_size;
 
-  return wkb_out;
+  return buf;
 }
 
 char* rtgeom_to_hexwkb(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, size_t *size_out)
 {
   return (char*)rtgeom_to_wkb(ctx, geom, variant | RTWKB_HEX, size_out);
 }
-
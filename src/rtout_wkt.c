@@ -87,6 +87,7 @@ static void ptarray_to_wkt_sb(const RTCTX *ctx, const RTPOINTARRAY *ptarray, str
   /* OGC only includes X/Y */
   int dimensions = 2;
   int i, j;
+  char num[2 * OUT_MAX_DIGS_DOUBLE + 1];
 
   /* ISO and extended formats include all dimensions */
   if ( variant & ( RTWKT_ISO | RTWKT_EXTENDED ) )
@@ -110,7 +111,16 @@ static void ptarray_to_wkt_sb(const RTCTX *ctx, const RTPOINTARRAY *ptarray, str
       /* Spaces before every ordinate but the first */
       if ( j > 0 )
         stringbuffer_append(ctx, sb, " ");
-      stringbuffer_aprintf(ctx, sb, "%.*g", precision, dbl_ptr[j]);
+      if ( precision < 0 )
+        rtprint_double_shortest(ctx, dbl_ptr[j], num);
+      else if ( precision <= OUT_MAX_DIGS_DOUBLE )
+        rtprint_double_general(ctx, dbl_ptr[j], precision, num, sizeof(num));
+      else
+      {
+        stringbuffer_aprintf(ctx, sb, "%.*g", precision, dbl_ptr[j]);
+        continue;
+      }
+      stringbuffer_append(ctx, sb, num);
     }
   }
 
@@ -674,7 +684,7 @@ char* rtgeom_to_wkt(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, int p
   char *str = NULL;
   if ( geom == NULL )
     return NULL;
-  sb = stringbuffer_create(ctx);
+  sb = stringbuffer_create_scratch(ctx);
   /* Extended mode starts with an "SRID=" section for geoms that have one */
   if ( (variant & RTWKT_EXTENDED) && rtgeom_has_srid(ctx, geom) )
   {
@@ -689,7 +699,7 @@ char* rtgeom_to_wkt(const RTCTX *ctx, const RTGEOM *geom, uint8_t variant, int p
   str = stringbuffer_getstringcopy(ctx, sb);
   if ( size_out )
     *size_out = stringbuffer_getlength(ctx, sb) + 1;
-  stringbuffer_destroy(ctx, sb);
+  stringbuffer_release(ctx, sb);
   return str;
 }
 
@@ -850,17 +850,9 @@ pointArray_toX3D3(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int precisio
         RTPOINT2D pt;
         rt_getPoint2d_p(ctx, pa, i, &pt);
 
-        if (fabs(pt.x) < OUT_MAX_DOUBLE)
-          sprintf(x, "%.*f", precision, pt.x);
-        else
-          sprintf(x, "%g", pt.x);
-        trim_trailing_zeros(ctx, x);
+        rtprint_double_fixed(ctx, pt.x, precision, x);
 
-        if (fabs(pt.y) < OUT_MAX_DOUBLE)
-          sprintf(y, "%.*f", precision, pt.y);
-        else
-          sprintf(y, "%g", pt.y);
-        trim_trailing_zeros(ctx, y);
+        rtprint_double_fixed(ctx, pt.y, precision, y);
 
         if ( i )
           ptr += sprintf(ptr, " ");
@@ -882,23 +874,11 @@ pointArray_toX3D3(const RTCTX *ctx, RTPOINTARRAY *pa, char *output, int precisio
         RTPOINT4D pt;
         rt_getPoint4d_p(ctx, pa, i, &pt);
 
-        if (fabs(pt.x) < OUT_MAX_DOUBLE)
-          sprintf(x, "%.*f", precision, pt.x);
-        else
-          sprintf(x, "%g", pt.x);
-        trim_trailing_zeros(ctx, x);
+        rtprint_double_fixed(ctx, pt.x, precision, x);
 
-        if (fabs(pt.y) < OUT_MAX_DOUBLE)
-          sprintf(y, "%.*f", precision, pt.y);
-        else
-          sprintf(y, "%g", pt.y);
-        trim_trailing_zeros(ctx, y);
+        rtprint_double_fixed(ctx, pt.y, precision, y);
 
-        if (fabs(pt.z) < OUT_MAX_DOUBLE)
-          sprintf(z, "%.*f", precision, pt.z);
-        else
-          sprintf(z, "%g", pt.z);
-        trim_trailing_zeros(ctx, z);
+        rtprint_double_fixed(ctx, pt.z, precision, z);
 
         if ( i )
           ptr += sprintf(ptr, " ");
@@ -183,6 +183,10 @@ rtpoly_add_ring(const RTCTX *ctx, RTPOLY *poly, RTPOINTARRAY *pa)
   poly->rings[poly->nrings] = pa;
   poly->nrings++;
 
+  /* A new shell changes the box */
+  if ( poly->nrings == 1 )
+    rtgeom_refresh_bbox(ctx, (RTGEOM*)poly);
+
   return RT_SUCCESS;
 }
 
@@ -0,0 +1,156 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ *
+ * Native 2D binary predicates. GEOS is only called for the few
+ * configurations the native code can't settle (see rtprepared.c).
+ *
+ **********************************************************************/
+
+
+#include "rttopo_config.h"
+
+/*#define RTGEOM_DEBUG_LEVEL 4*/
+#include "rtgeom_log.h"
+
+#include "librttopo_geom_internal.h"
+
+
+static double
+rtpredicate_box_distance(const RTGBOX *b1, const RTGBOX *b2)
+{
+  double dx = 0.0, dy = 0.0;
+
+  if ( b1->xmax < b2->xmin ) dx = b2->xmin - b1->xmax;
+  else if ( b2->xmax < b1->xmin ) dx = b1->xmin - b2->xmax;
+  if ( b1->ymax < b2->ymin ) dy = b2->ymin - b1->ymax;
+  else if ( b2->ymax < b1->ymin ) dy = b1->ymin - b2->ymax;
+
+  return sqrt(dx*dx + dy*dy);
+}
+
+int
+rtgeom_intersects(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2)
+{
+  RTGBOX b1, b2;
+
+  if ( rtgeom_get_bbox_p(ctx, geom1, &b1) == RT_FAILURE ||
+       rtgeom_get_bbox_p(ctx, geom2, &b2) == RT_FAILURE )
+    return RT_FALSE;
+
+  if ( ! gbox_overlaps_2d(ctx, &b1, &b2) )
+    return RT_FALSE;
+
+  /* Stops at the first contact found */
+  return rtgeom_mindistance2d_tolerance(ctx, geom1, geom2, 0.0) == 0.0;
+}
+
+int
+rtgeom_dwithin(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2, double distance)
+{
+  RTGBOX b1, b2;
+
+  if ( distance < 0.0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero\n");
+    return RT_FALSE;
+  }
+
+  if ( rtgeom_get_bbox_p(ctx, geom1, &b1) == RT_FAILURE ||
+       rtgeom_get_bbox_p(ctx, geom2, &b2) == RT_FAILURE )
+    return RT_FALSE;
+
+  if ( rtpredicate_box_distance(&b1, &b2) > distance )
+    return RT_FALSE;
+
+  return rtgeom_mindistance2d_tolerance(ctx, geom1, geom2, distance) <= distance;
+}
+
+/**
+* Location of a point in a polygon, without building any tree.
+*/
+static int
+rtpredicate_poly_locate_point(const RTCTX *ctx, const RTPOLY *poly, const RTPOINT2D *pt)
+{
+  int i, loc;
+
+  loc = ptarray_contains_point(ctx, poly->rings[0], pt);
+  if ( loc != RT_INSIDE )
+    return loc;
+
+  for ( i = 1; i < poly->nrings; i++ )
+  {
+    loc = ptarray_contains_point(ctx, poly->rings[i], pt);
+    if ( loc == RT_INSIDE )
+      return RT_OUTSIDE;
+    if ( loc == RT_BOUNDARY )
+      return RT_BOUNDARY;
+  }
+  return RT_INSIDE;
+}
+
+static int
+rtpredicate_covers_contains(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2, int want_contains)
+{
+  RTGBOX b1, b2;
+  RTPREPARED *prep;
+  int result;
+
+  if ( rtgeom_get_bbox_p(ctx, geom1, &b1) == RT_FAILURE ||
+       rtgeom_get_bbox_p(ctx, geom2, &b2) == RT_FAILURE )
+    return RT_FALSE;
+
+  if ( ! gbox_contains_2d(ctx, &b1, &b2) )
+    return RT_FALSE;
+
+  if ( rtgeom_has_arc(ctx, geom1) )
+    return want_contains ? rtgeom_contains_geos(ctx, geom1, geom2) :
+                           rtgeom_covers_geos(ctx, geom1, geom2);
+
+  /* Point in polygon, the common case, needs no trees */
+  if ( geom1->type == RTPOLYGONTYPE && geom2->type == RTPOINTTYPE )
+  {
+    const RTPOINT2D *pt = rt_getPoint2d_cp(ctx, ((RTPOINT*)geom2)->point, 0);
+    int loc = rtpredicate_poly_locate_point(ctx, (RTPOLY*)geom1, pt);
+    return want_contains ? loc == RT_INSIDE : loc != RT_OUTSIDE;
+  }
+
+  prep = rtgeom_prepare(ctx, geom1);
+  if ( ! prep )
+    return -1;
+  if ( want_contains )
+    result = rtprepared_contains(ctx, prep, geom2);
+  else
+    result = rtprepared_covers(ctx, prep, geom2);
+  rtprepared_free(ctx, prep);
+
+  return result;
+}
+
+int
+rtgeom_contains(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2)
+{
+  return rtpredicate_covers_contains(ctx, geom1, geom2, RT_TRUE);
+}
+
+int
+rtgeom_covers(const RTCTX *ctx, const RTGEOM *geom1, const RTGEOM *geom2)
+{
+  return rtpredicate_covers_contains(ctx, geom1, geom2, RT_FALSE);
+}
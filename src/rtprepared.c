@@ -0,0 +1,930 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ *
+ * Prepared geometries: per-ring edge trees built once and reused
+ * for many point-in-polygon, intersection and distance probes.
+ *
+ **********************************************************************/
+
+
+#include "rttopo_config.h"
+#include <float.h>
+
+/*#define RTGEOM_DEBUG_LEVEL 4*/
+#include "rtgeom_log.h"
+
+#include "librttopo_geom_internal.h"
+#include "rttree.h"
+
+
+/**
+* One simple component of the prepared geometry: a point, a line or
+* an areal element (polygon or triangle), with one tree per point
+* array. Trees are NULL for empty arrays.
+*/
+typedef struct
+{
+  const RTGEOM *geom;
+  const RTPOINT2D *first; /* first vertex, for containment tests */
+  double xmin, xmax, ymin, ymax;
+  int nrings;
+  RECT_NODE **rings;
+} RTPREPARED_PART;
+
+struct RTPREPARED_T
+{
+  const RTGEOM *geom;
+  int nparts;
+  int maxparts;
+  int nareas;
+  RTPREPARED_PART *parts;
+};
+
+
+static int
+rtprepared_is_area(const RTGEOM *geom)
+{
+  return geom->type == RTPOLYGONTYPE || geom->type == RTTRIANGLETYPE;
+}
+
+static int
+rtprepared_add_ptarray(const RTCTX *ctx, const RTGEOM *geom, int index, const RTPOINTARRAY *pa, void *data)
+{
+  RTPREPARED *prep = (RTPREPARED*)data;
+  RTPREPARED_PART *part;
+  RECT_NODE *tree;
+
+  if ( index == 0 )
+  {
+    if ( prep->nparts == prep->maxparts )
+    {
+      prep->maxparts = prep->maxparts ? prep->maxparts * 2 : 4;
+      prep->parts = rtrealloc(ctx, prep->parts, sizeof(RTPREPARED_PART) * prep->maxparts);
+    }
+    part = &(prep->parts[prep->nparts++]);
+    part->geom = geom;
+    part->first = NULL;
+    part->xmin = part->ymin = FLT_MAX;
+    part->xmax = part->ymax = -1 * FLT_MAX;
+    part->nrings = 0;
+    part->rings = rtalloc(ctx, sizeof(RECT_NODE*) *
+      (geom->type == RTPOLYGONTYPE ? ((RTPOLY*)geom)->nrings : 1));
+    if ( rtprepared_is_area(geom) )
+      prep->nareas++;
+  }
+  part = &(prep->parts[prep->nparts - 1]);
+
+  /* Points, and lines collapsed to a single location, get vertex leaves */
+  tree = NULL;
+  if ( geom->type != RTPOINTTYPE )
+    tree = rect_tree_new(ctx, pa);
+  if ( ! tree )
+    tree = rect_tree_new_points(ctx, pa);
+
+  part->rings[part->nrings++] = tree;
+  if ( tree )
+  {
+    if ( index == 0 )
+      part->first = rt_getPoint2d_cp(ctx, pa, 0);
+    part->xmin = FP_MIN(part->xmin, tree->xmin);
+    part->xmax = FP_MAX(part->xmax, tree->xmax);
+    part->ymin = FP_MIN(part->ymin, tree->ymin);
+    part->ymax = FP_MAX(part->ymax, tree->ymax);
+  }
+  return 0;
+}
+
+RTPREPARED *
+rtgeom_prepare(const RTCTX *ctx, const RTGEOM *geom)
+{
+  RTPREPARED *prep;
+
+  if ( geom && rtgeom_has_arc(ctx, geom) )
+  {
+    rterror(ctx, "%s: curved geometries are not supported, stroke them first", __func__);
+    return NULL;
+  }
+
+  prep = rtalloc(ctx, sizeof(RTPREPARED));
+  prep->geom = geom;
+  prep->nparts = prep->maxparts = prep->nareas = 0;
+  prep->parts = NULL;
+
+  if ( rtgeom_visit_ptarrays(ctx, geom, rtprepared_add_ptarray, prep) != 0 )
+  {
+    rtprepared_free(ctx, prep);
+    return NULL;
+  }
+  return prep;
+}
+
+void
+rtprepared_free(const RTCTX *ctx, RTPREPARED *prep)
+{
+  int i, j;
+
+  if ( ! prep ) return;
+
+  for ( i = 0; i < prep->nparts; i++ )
+  {
+    RTPREPARED_PART *part = &(prep->parts[i]);
+    for ( j = 0; j < part->nrings; j++ )
+    {
+      if ( part->rings[j] )
+        rect_tree_free(ctx, part->rings[j]);
+    }
+    rtfree(ctx, part->rings);
+  }
+  if ( prep->parts )
+    rtfree(ctx, prep->parts);
+  rtfree(ctx, prep);
+}
+
+/**
+* Point in areal part: inside the shell, outside every hole.
+*/
+static int
+rtprepared_part_contains_point(const RTCTX *ctx, const RTPREPARED_PART *part, const RTPOINT2D *pt)
+{
+  int i, wn, on_boundary = RT_FALSE;
+
+  if ( pt->x < part->xmin || pt->x > part->xmax ||
+       pt->y < part->ymin || pt->y > part->ymax ||
+       ! part->rings[0] )
+    return RT_OUTSIDE;
+
+  wn = rect_tree_winding_number(ctx, part->rings[0], pt, &on_boundary);
+  if ( on_boundary )
+    return RT_BOUNDARY;
+  if ( wn == 0 )
+    return RT_OUTSIDE;
+
+  for ( i = 1; i < part->nrings; i++ )
+  {
+    if ( ! part->rings[i] ) continue;
+    wn = rect_tree_winding_number(ctx, part->rings[i], pt, &on_boundary);
+    if ( on_boundary )
+      return RT_BOUNDARY;
+    if ( wn != 0 )
+      return RT_OUTSIDE;
+  }
+
+  return RT_INSIDE;
+}
+
+static int
+rtprepared_point_location(const RTCTX *ctx, const RTPREPARED *prep, const RTPOINT2D *pt)
+{
+  int i, r, result = RT_OUTSIDE;
+
+  for ( i = 0; i < prep->nparts; i++ )
+  {
+    if ( ! rtprepared_is_area(prep->parts[i].geom) )
+      continue;
+    r = rtprepared_part_contains_point(ctx, &(prep->parts[i]), pt);
+    if ( r == RT_INSIDE )
+      return RT_INSIDE;
+    if ( r == RT_BOUNDARY )
+      result = RT_BOUNDARY;
+  }
+  return result;
+}
+
+int
+rtprepared_contains_point(const RTCTX *ctx, const RTPREPARED *prep, const RTPOINT2D *pt)
+{
+  return rtprepared_point_location(ctx, prep, pt);
+}
+
+/**
+* Does any areal part of a cover the first vertex of any part of b?
+*/
+static int
+rtprepared_covers_any_part(const RTCTX *ctx, const RTPREPARED *a, const RTPREPARED *b)
+{
+  int i;
+
+  if ( ! a->nareas )
+    return RT_FALSE;
+
+  for ( i = 0; i < b->nparts; i++ )
+  {
+    if ( b->parts[i].first &&
+         rtprepared_point_location(ctx, a, b->parts[i].first) != RT_OUTSIDE )
+      return RT_TRUE;
+  }
+  return RT_FALSE;
+}
+
+static double
+rtprepared_part_box_distance(const RTPREPARED_PART *p1, const RTPREPARED_PART *p2)
+{
+  double dx = 0.0, dy = 0.0;
+
+  if ( p1->xmax < p2->xmin ) dx = p2->xmin - p1->xmax;
+  else if ( p2->xmax < p1->xmin ) dx = p1->xmin - p2->xmax;
+  if ( p1->ymax < p2->ymin ) dy = p2->ymin - p1->ymax;
+  else if ( p2->ymax < p1->ymin ) dy = p1->ymin - p2->ymax;
+
+  return sqrt(dx*dx + dy*dy);
+}
+
+/**
+* Minimum distance between two prepared geometries, zero when either
+* one's area covers part of the other. Stops as soon as a distance at
+* or below threshold is found.
+*/
+static double
+rtprepared_distance(const RTCTX *ctx, const RTPREPARED *a, const RTPREPARED *b, double threshold)
+{
+  int i, j, ri, rj;
+  double d, mindist = FLT_MAX;
+
+  if ( ! a->nparts || ! b->nparts )
+    return FLT_MAX;
+
+  if ( rtprepared_covers_any_part(ctx, a, b) ||
+       rtprepared_covers_any_part(ctx, b, a) )
+    return 0.0;
+
+  for ( i = 0; i < a->nparts; i++ )
+  {
+    const RTPREPARED_PART *pa = &(a->parts[i]);
+    for ( j = 0; j < b->nparts; j++ )
+    {
+      const RTPREPARED_PART *pb = &(b->parts[j]);
+      if ( rtprepared_part_box_distance(pa, pb) >= mindist )
+        continue;
+      for ( ri = 0; ri < pa->nrings; ri++ )
+      {
+        if ( ! pa->rings[ri] ) continue;
+        for ( rj = 0; rj < pb->nrings; rj++ )
+        {
+          if ( ! pb->rings[rj] ) continue;
+          d = rect_tree_distance_tree(ctx, pa->rings[ri], pb->rings[rj], threshold);
+          if ( d < mindist )
+          {
+            mindist = d;
+            if ( mindist <= threshold )
+              return mindist;
+          }
+        }
+      }
+    }
+  }
+  return mindist;
+}
+
+/**
+* Run a distance query against probe. Single points, the common case,
+* are wrapped on the stack; anything else gets its own temporary trees.
+*/
+static double
+rtprepared_distance_probe(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe, double threshold)
+{
+  RTPREPARED *pprobe;
+  double d;
+
+  if ( ! probe || rtgeom_is_empty(ctx, probe) )
+    return FLT_MAX;
+
+  if ( probe->type == RTPOINTTYPE )
+  {
+    RTPREPARED pt_prep;
+    RTPREPARED_PART pt_part;
+    RECT_NODE pt_node;
+    RECT_NODE *pt_ring = &pt_node;
+
+    pt_node.p1 = pt_node.p2 = (RTPOINT2D*)rt_getPoint2d_cp(ctx, ((RTPOINT*)probe)->point, 0);
+    pt_node.xmin = pt_node.xmax = pt_node.p1->x;
+    pt_node.ymin = pt_node.ymax = pt_node.p1->y;
+    pt_node.p3 = NULL;
+    pt_node.left_node = pt_node.right_node = NULL;
+
+    pt_part.geom = probe;
+    pt_part.first = pt_node.p1;
+    pt_part.xmin = pt_part.xmax = pt_node.xmin;
+    pt_part.ymin = pt_part.ymax = pt_node.ymin;
+    pt_part.nrings = 1;
+    pt_part.rings = &pt_ring;
+
+    pt_prep.geom = probe;
+    pt_prep.nparts = pt_prep.maxparts = 1;
+    pt_prep.nareas = 0;
+    pt_prep.parts = &pt_part;
+
+    return rtprepared_distance(ctx, prep, &pt_prep, threshold);
+  }
+
+  pprobe = rtgeom_prepare(ctx, probe);
+  if ( ! pprobe )
+    return FLT_MAX;
+  d = rtprepared_distance(ctx, prep, pprobe, threshold);
+  rtprepared_free(ctx, pprobe);
+  return d;
+}
+
+int
+rtprepared_intersects(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe)
+{
+  return rtprepared_distance_probe(ctx, prep, probe, 0.0) == 0.0;
+}
+
+int
+rtprepared_dwithin(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe, double distance)
+{
+  if ( distance < 0.0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero\n");
+    return RT_FALSE;
+  }
+  return rtprepared_distance_probe(ctx, prep, probe, distance) <= distance;
+}
+
+double
+rtprepared_mindistance(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe)
+{
+  return rtprepared_distance_probe(ctx, prep, probe, 0.0);
+}
+
+double
+rtprepared_mindistance_tolerance(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe, double tolerance)
+{
+  return rtprepared_distance_probe(ctx, prep, probe, tolerance);
+}
+
+/*
+* Where the points of a probe fall with respect to an areal prepared
+* geometry, as a set of flags.
+*/
+#define RTPREP_LOC_IN  1
+#define RTPREP_LOC_BND 2
+#define RTPREP_LOC_OUT 4
+
+static int
+rtprepared_loc_flag(int loc)
+{
+  if ( loc == RT_INSIDE ) return RTPREP_LOC_IN;
+  if ( loc == RT_BOUNDARY ) return RTPREP_LOC_BND;
+  return RTPREP_LOC_OUT;
+}
+
+/**
+* An edge being cut where it meets the boundary of the prepared
+* geometry: parameters along the edge of every meeting point, and
+* the parameter ranges running along the boundary.
+*/
+typedef struct
+{
+  const RTPOINT2D *p;
+  const RTPOINT2D *q;
+  double xmin, xmax, ymin, ymax;
+  double *t;
+  int nt, maxt;
+  double *ov;
+  int nov, maxov;
+} RTPREPARED_EDGE;
+
+static void
+rtprepared_edge_add_t(const RTCTX *ctx, RTPREPARED_EDGE *e, double t)
+{
+  if ( e->nt == e->maxt )
+  {
+    e->maxt *= 2;
+    e->t = rtrealloc(ctx, e->t, sizeof(double) * e->maxt);
+  }
+  e->t[e->nt++] = t;
+}
+
+static void
+rtprepared_edge_add_overlap(const RTCTX *ctx, RTPREPARED_EDGE *e, double lo, double hi)
+{
+  if ( e->nov + 2 > e->maxov )
+  {
+    e->maxov *= 2;
+    e->ov = rtrealloc(ctx, e->ov, sizeof(double) * e->maxov);
+  }
+  e->ov[e->nov++] = lo;
+  e->ov[e->nov++] = hi;
+}
+
+static void
+rtprepared_edge_cut(const RTCTX *ctx, RTPREPARED_EDGE *e, const RECT_NODE *node)
+{
+  const RTPOINT2D *p = e->p, *q = e->q, *c, *d;
+  double dx, dy, ex, ey, s1, s2, s3, s4, t;
+
+  if ( node->xmin > e->xmax || node->xmax < e->xmin ||
+       node->ymin > e->ymax || node->ymax < e->ymin )
+    return;
+
+  if ( ! node->p1 )
+  {
+    rtprepared_edge_cut(ctx, e, node->left_node);
+    rtprepared_edge_cut(ctx, e, node->right_node);
+    return;
+  }
+
+  c = node->p1;
+  d = node->p2;
+  if ( c->x == d->x && c->y == d->y )
+    return;
+
+  /* Sides of c and d with respect to pq */
+  dx = q->x - p->x;
+  dy = q->y - p->y;
+  s1 = dx * (c->y - p->y) - dy * (c->x - p->x);
+  s2 = dx * (d->y - p->y) - dy * (d->x - p->x);
+
+  /* Collinear: keep the shared range, if any */
+  if ( s1 == 0.0 && s2 == 0.0 )
+  {
+    double len2 = dx*dx + dy*dy;
+    double tc = ((c->x - p->x) * dx + (c->y - p->y) * dy) / len2;
+    double td = ((d->x - p->x) * dx + (d->y - p->y) * dy) / len2;
+    double lo = FP_MAX(0.0, FP_MIN(tc, td));
+    double hi = FP_MIN(1.0, FP_MAX(tc, td));
+    if ( lo > hi ) return;
+    rtprepared_edge_add_t(ctx, e, lo);
+    rtprepared_edge_add_t(ctx, e, hi);
+    if ( lo < hi )
+      rtprepared_edge_add_overlap(ctx, e, lo, hi);
+    return;
+  }
+  if ( (s1 > 0 && s2 > 0) || (s1 < 0 && s2 < 0) )
+    return;
+
+  /* Sides of p and q with respect to cd */
+  ex = d->x - c->x;
+  ey = d->y - c->y;
+  s3 = ex * (p->y - c->y) - ey * (p->x - c->x);
+  s4 = ex * (q->y - c->y) - ey * (q->x - c->x);
+  if ( (s3 > 0 && s4 > 0) || (s3 < 0 && s4 < 0) || s3 == s4 )
+    return;
+
+  t = s3 / (s3 - s4);
+  rtprepared_edge_add_t(ctx, e, FP_MAX(0.0, FP_MIN(1.0, t)));
+}
+
+static int
+rtprepared_cmp_double(const void *a, const void *b)
+{
+  double da = *(const double*)a, db = *(const double*)b;
+  return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+/**
+* Locate every point of pa, vertices and edges, against the areal
+* parts of prep. Edges are cut where they meet a ring and each piece
+* is located by its mid point. Stops as soon as one of the stop flags
+* is found. Returns the flags found.
+*/
+static int
+rtprepared_locate_ptarray(const RTCTX *ctx, const RTPREPARED *prep, const RTPOINTARRAY *pa, int stop)
+{
+  RTPREPARED_EDGE e;
+  const RTPOINT2D *p, *q;
+  RTPOINT2D m;
+  int i, j, k, r, flags = 0;
+  double mid;
+
+  for ( i = 0; i < pa->npoints; i++ )
+  {
+    flags |= rtprepared_loc_flag(rtprepared_point_location(ctx, prep, rt_getPoint2d_cp(ctx, pa, i)));
+    if ( flags & stop )
+      return flags;
+  }
+
+  e.maxt = 16;
+  e.t = rtalloc(ctx, sizeof(double) * e.maxt);
+  e.maxov = 16;
+  e.ov = rtalloc(ctx, sizeof(double) * e.maxov);
+
+  for ( i = 1; i < pa->npoints && ! (flags & stop); i++ )
+  {
+    p = rt_getPoint2d_cp(ctx, pa, i - 1);
+    q = rt_getPoint2d_cp(ctx, pa, i);
+    if ( p->x == q->x && p->y == q->y )
+      continue;
+
+    e.p = p;
+    e.q = q;
+    e.xmin = FP_MIN(p->x, q->x);
+    e.xmax = FP_MAX(p->x, q->x);
+    e.ymin = FP_MIN(p->y, q->y);
+    e.ymax = FP_MAX(p->y, q->y);
+    e.nt = e.nov = 0;
+    rtprepared_edge_add_t(ctx, &e, 0.0);
+    rtprepared_edge_add_t(ctx, &e, 1.0);
+
+    for ( j = 0; j < prep->nparts; j++ )
+    {
+      const RTPREPARED_PART *part = &(prep->parts[j]);
+      if ( ! rtprepared_is_area(part->geom) ) continue;
+      for ( r = 0; r < part->nrings; r++ )
+      {
+        if ( part->rings[r] )
+          rtprepared_edge_cut(ctx, &e, part->rings[r]);
+      }
+    }
+
+    qsort(e.t, e.nt, sizeof(double), rtprepared_cmp_double);
+
+    for ( k = 1; k < e.nt; k++ )
+    {
+      int on_boundary = RT_FALSE;
+
+      if ( e.t[k] <= e.t[k-1] ) continue;
+      mid = (e.t[k-1] + e.t[k]) / 2.0;
+
+      for ( r = 0; r < e.nov; r += 2 )
+      {
+        if ( e.ov[r] <= mid && mid <= e.ov[r+1] )
+        {
+          on_boundary = RT_TRUE;
+          break;
+        }
+      }
+      if ( on_boundary )
+      {
+        flags |= RTPREP_LOC_BND;
+      }
+      else
+      {
+        m.x = p->x + mid * (q->x - p->x);
+        m.y = p->y + mid * (q->y - p->y);
+        flags |= rtprepared_loc_flag(rtprepared_point_location(ctx, prep, &m));
+      }
+      if ( flags & stop ) break;
+    }
+  }
+
+  rtfree(ctx, e.t);
+  rtfree(ctx, e.ov);
+  return flags;
+}
+
+typedef struct
+{
+  const RTPREPARED *prep;
+  int flags;      /* all locations found so far */
+  int poly_flags; /* locations found for the rings of the current polygon */
+  int has_area;
+  int degenerate;
+} RTPREPARED_RELATE;
+
+static int
+rtprepared_relate_ptarray(const RTCTX *ctx, const RTGEOM *geom, int index, const RTPOINTARRAY *pa, void *data)
+{
+  RTPREPARED_RELATE *rel = (RTPREPARED_RELATE*)data;
+  int f = rtprepared_locate_ptarray(ctx, rel->prep, pa, RTPREP_LOC_OUT);
+
+  rel->flags |= f;
+  if ( f & RTPREP_LOC_OUT )
+    return 1;
+
+  if ( rtprepared_is_area(geom) )
+  {
+    int nrings = geom->type == RTPOLYGONTYPE ? ((RTPOLY*)geom)->nrings : 1;
+    rel->has_area = RT_TRUE;
+    if ( index == 0 )
+      rel->poly_flags = 0;
+    rel->poly_flags |= f;
+    /* Rings all along our boundary: the interior could be either side */
+    if ( index == nrings - 1 && ! (rel->poly_flags & RTPREP_LOC_IN) )
+      rel->degenerate = RT_TRUE;
+  }
+  return 0;
+}
+
+/**
+* Is pt on one of the segments, or one of the points, under node?
+*/
+static int
+rtprepared_tree_covers_point(const RTCTX *ctx, const RECT_NODE *node, const RTPOINT2D *pt)
+{
+  const RTPOINT2D *c, *d;
+
+  if ( ! node ||
+       pt->x < node->xmin || pt->x > node->xmax ||
+       pt->y < node->ymin || pt->y > node->ymax )
+    return RT_FALSE;
+
+  if ( ! node->p1 )
+    return rtprepared_tree_covers_point(ctx, node->left_node, pt) ||
+           rtprepared_tree_covers_point(ctx, node->right_node, pt);
+
+  /* Within the box of cd already, so on cd when collinear with it */
+  c = node->p1;
+  d = node->p2;
+  return (d->x - c->x) * (pt->y - c->y) - (d->y - c->y) * (pt->x - c->x) == 0.0;
+}
+
+static int
+rtprepared_linear_covers_point(const RTCTX *ctx, const RTPREPARED *prep, const RTPOINT2D *pt)
+{
+  int i;
+
+  for ( i = 0; i < prep->nparts; i++ )
+  {
+    const RTPREPARED_PART *part = &(prep->parts[i]);
+    if ( pt->x < part->xmin || pt->x > part->xmax ||
+         pt->y < part->ymin || pt->y > part->ymax )
+      continue;
+    if ( rtprepared_tree_covers_point(ctx, part->rings[0], pt) )
+      return RT_TRUE;
+  }
+  return RT_FALSE;
+}
+
+/**
+* Mod-2 rule: pt is on the boundary of the linear prepared geometry
+* when it ends an odd number of its unclosed lines.
+*/
+static int
+rtprepared_linear_is_boundary(const RTCTX *ctx, const RTPREPARED *prep, const RTPOINT2D *pt)
+{
+  const RTPOINT2D *a, *b;
+  const RTPOINTARRAY *pa;
+  int i, n = 0;
+
+  for ( i = 0; i < prep->nparts; i++ )
+  {
+    if ( prep->parts[i].geom->type != RTLINETYPE )
+      continue;
+    pa = ((RTLINE*)prep->parts[i].geom)->points;
+    if ( pa->npoints < 2 )
+      continue;
+    a = rt_getPoint2d_cp(ctx, pa, 0);
+    b = rt_getPoint2d_cp(ctx, pa, pa->npoints - 1);
+    if ( a->x == b->x && a->y == b->y )
+      continue;
+    if ( a->x == pt->x && a->y == pt->y ) n++;
+    if ( b->x == pt->x && b->y == pt->y ) n++;
+  }
+  return n % 2;
+}
+
+/**
+* Do the ranges running along the prepared lines cover the whole edge?
+*/
+static int
+rtprepared_edge_covered(RTPREPARED_EDGE *e)
+{
+  double reach = 0.0;
+  int r;
+
+  /* Sort the (lo, hi) pairs by lo and sweep */
+  qsort(e->ov, e->nov / 2, 2 * sizeof(double), rtprepared_cmp_double);
+  for ( r = 0; r < e->nov && reach < 1.0; r += 2 )
+  {
+    if ( e->ov[r] > reach )
+      return RT_FALSE;
+    reach = FP_MAX(reach, e->ov[r+1]);
+  }
+  return reach >= 1.0;
+}
+
+/**
+* Locate the points, lines and polygons of a probe against a prepared
+* geometry made of lines only, or of points only. Vertices must lie
+* on the prepared geometry and every edge must run along it.
+*/
+static int
+rtprepared_relate_linear_ptarray(const RTCTX *ctx, const RTGEOM *geom, int index, const RTPOINTARRAY *pa, void *data)
+{
+  RTPREPARED_RELATE *rel = (RTPREPARED_RELATE*)data;
+  const RTPREPARED *prep = rel->prep;
+  const RTPOINT2D *p, *q;
+  RTPREPARED_EDGE e;
+  int i, j, covered = RT_TRUE, has_edge = RT_FALSE;
+
+  /* Polygons of non-zero area are never covered by lines or points */
+  if ( rtprepared_is_area(geom) )
+  {
+    if ( index == 0 )
+    {
+      rel->has_area = RT_TRUE;
+      if ( rtgeom_area(ctx, geom) > 0.0 )
+      {
+        rel->flags |= RTPREP_LOC_OUT;
+        return 1;
+      }
+      rel->degenerate = RT_TRUE;
+    }
+    return 0;
+  }
+
+  for ( i = 0; i < pa->npoints; i++ )
+  {
+    p = rt_getPoint2d_cp(ctx, pa, i);
+    if ( ! rtprepared_linear_covers_point(ctx, prep, p) )
+    {
+      rel->flags |= RTPREP_LOC_OUT;
+      return 1;
+    }
+    /* The interior of a point is the point itself */
+    if ( geom->type == RTPOINTTYPE && ! (rel->flags & RTPREP_LOC_IN) )
+      rel->flags |= rtprepared_linear_is_boundary(ctx, prep, p) ? RTPREP_LOC_BND : RTPREP_LOC_IN;
+  }
+  if ( geom->type == RTPOINTTYPE )
+    return 0;
+
+  e.maxt = 16;
+  e.t = rtalloc(ctx, sizeof(double) * e.maxt);
+  e.maxov = 16;
+  e.ov = rtalloc(ctx, sizeof(double) * e.maxov);
+
+  for ( i = 1; i < pa->npoints && covered; i++ )
+  {
+    p = rt_getPoint2d_cp(ctx, pa, i - 1);
+    q = rt_getPoint2d_cp(ctx, pa, i);
+    if ( p->x == q->x && p->y == q->y )
+      continue;
+
+    e.p = p;
+    e.q = q;
+    e.xmin = FP_MIN(p->x, q->x);
+    e.xmax = FP_MAX(p->x, q->x);
+    e.ymin = FP_MIN(p->y, q->y);
+    e.ymax = FP_MAX(p->y, q->y);
+    e.nt = e.nov = 0;
+    for ( j = 0; j < prep->nparts; j++ )
+    {
+      if ( prep->parts[j].rings[0] )
+        rtprepared_edge_cut(ctx, &e, prep->parts[j].rings[0]);
+    }
+    covered = rtprepared_edge_covered(&e);
+    has_edge = RT_TRUE;
+  }
+
+  rtfree(ctx, e.t);
+  rtfree(ctx, e.ov);
+
+  if ( ! covered )
+  {
+    rel->flags |= RTPREP_LOC_OUT;
+    return 1;
+  }
+  /* A covered stretch of line has points off the finite boundary */
+  if ( has_edge )
+    rel->flags |= RTPREP_LOC_IN;
+  else
+    rel->degenerate = RT_TRUE;
+  return 0;
+}
+
+/**
+* Covers and contains for prepared geometries made of lines only, or
+* of points only. Mixes of points and lines need the boundary rules
+* of GEOS and are left to it, as are zero-area polygons and lines
+* collapsed to a point in the probe.
+*/
+static int
+rtprepared_relate_linear(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe, int *covers, int *contains)
+{
+  RTPREPARED_RELATE rel;
+  RTGBOX box;
+  int i, npoints = 0;
+
+  for ( i = 0; i < prep->nparts; i++ )
+  {
+    if ( prep->parts[i].geom->type == RTPOINTTYPE )
+      npoints++;
+  }
+  if ( npoints && npoints != prep->nparts )
+    return RT_FAILURE;
+
+  if ( rtgeom_get_bbox_p(ctx, probe, &box) == RT_FAILURE )
+    return RT_SUCCESS; /* empty probe */
+
+  if ( rtgeom_has_arc(ctx, probe) )
+    return RT_FAILURE;
+
+  rel.prep = prep;
+  rel.flags = rel.poly_flags = 0;
+  rel.has_area = rel.degenerate = RT_FALSE;
+  if ( rtgeom_visit_ptarrays(ctx, probe, rtprepared_relate_linear_ptarray, &rel) != 0 )
+    return RT_SUCCESS; /* part of the probe is outside */
+
+  if ( rel.degenerate )
+    return RT_FAILURE;
+
+  *covers = RT_TRUE;
+  *contains = (rel.flags & RTPREP_LOC_IN) ? RT_TRUE : RT_FALSE;
+  return RT_SUCCESS;
+}
+
+static const RTPOINTARRAY *
+rtprepared_part_ptarray(const RTPREPARED_PART *part, int i)
+{
+  if ( part->geom->type == RTPOLYGONTYPE )
+    return ((RTPOLY*)part->geom)->rings[i];
+  return ((RTLINE*)part->geom)->points;
+}
+
+/**
+* Work out whether the prepared geometry covers and contains probe.
+* Returns RT_FAILURE when that can't be decided from vertex and edge
+* locations alone: areas mixed with lines or points, curves, polygons
+* whose rings all run along our boundary, or boundaries shared between
+* our own parts.
+*/
+static int
+rtprepared_relate(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe, int *covers, int *contains)
+{
+  RTPREPARED_RELATE rel;
+  RTGBOX box;
+  int i, j;
+
+  *covers = *contains = RT_FALSE;
+
+  if ( ! prep->nparts || ! probe )
+    return RT_SUCCESS;
+
+  if ( ! prep->nareas )
+    return rtprepared_relate_linear(ctx, prep, probe, covers, contains);
+
+  if ( prep->nareas != prep->nparts )
+    return RT_FAILURE;
+
+  if ( rtgeom_get_bbox_p(ctx, probe, &box) == RT_FAILURE )
+    return RT_SUCCESS; /* empty probe */
+
+  if ( rtgeom_has_arc(ctx, probe) )
+    return RT_FAILURE;
+
+  rel.prep = prep;
+  rel.flags = rel.poly_flags = 0;
+  rel.has_area = rel.degenerate = RT_FALSE;
+  if ( rtgeom_visit_ptarrays(ctx, probe, rtprepared_relate_ptarray, &rel) != 0 )
+    return RT_SUCCESS; /* part of the probe is outside */
+
+  if ( rel.degenerate )
+    return RT_FAILURE;
+
+  /* None of our boundary may run through the interior of the probe */
+  if ( rel.has_area )
+  {
+    RTPREPARED *pprobe = rtgeom_prepare(ctx, probe);
+    int f = 0;
+
+    if ( ! pprobe )
+      return RT_FAILURE;
+    for ( i = 0; i < prep->nparts && ! (f & RTPREP_LOC_IN); i++ )
+    {
+      const RTPREPARED_PART *part = &(prep->parts[i]);
+      for ( j = 0; j < part->nrings && ! (f & RTPREP_LOC_IN); j++ )
+        f |= rtprepared_locate_ptarray(ctx, pprobe, rtprepared_part_ptarray(part, j), RTPREP_LOC_IN);
+    }
+    rtprepared_free(ctx, pprobe);
+
+    if ( f & RTPREP_LOC_IN )
+      return prep->nareas > 1 ? RT_FAILURE : RT_SUCCESS;
+  }
+
+  *covers = RT_TRUE;
+  if ( rel.flags & RTPREP_LOC_IN )
+    *contains = RT_TRUE;
+  else if ( prep->nareas > 1 )
+    return RT_FAILURE; /* probe may run along an edge shared by two parts */
+
+  return RT_SUCCESS;
+}
+
+int
+rtprepared_covers(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe)
+{
+  int covers, contains;
+
+  if ( rtprepared_relate(ctx, prep, probe, &covers, &contains) == RT_SUCCESS )
+    return covers;
+  return rtgeom_covers_geos(ctx, prep->geom, probe);
+}
+
+int
+rtprepared_contains(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *probe)
+{
+  int covers, contains;
+
+  if ( rtprepared_relate(ctx, prep, probe, &covers, &contains) == RT_SUCCESS )
+    return contains;
+  return rtgeom_contains_geos(ctx, prep->geom, probe);
+}
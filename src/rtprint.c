@@ -27,7 +27,10 @@
 
 #include "rttopo_config.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
 #include "librttopo_geom_internal.h"
 
 /* Ensures the given lat and lon are in the "normal" range:
@@ -425,3 +428,552 @@ char* rtpoint_to_latlon(const RTCTX *ctx, const RTPOINT * pt, const char *format
   p = rt_getPoint2d_cp(ctx, pt->point, 0);
   return rtdoubles_to_latlon(ctx, p->y, p->x, format);
 }
+
+
+/**********************************************************************
+* Locale independent double to text conversion for the writers.
+*
+* Ordinates are turned into exact decimal integers (the double times
+* a power of ten, correctly rounded half to even like the C library
+* does) with 128 bit arithmetic, which covers the magnitudes and
+* precisions seen in practice. Anything outside that range goes to
+* the C library, with the decimal separator put back to a dot.
+*/
+
+/* Unsigned 128 bit integer, least significant limb first */
+typedef struct
+{
+  uint32_t w[4];
+} RTPRINT_U128;
+
+/* Largest power of five and of ten fitting a limb */
+#define RTPRINT_POW5_STEP 13
+#define RTPRINT_POW5_MAX 1220703125U
+#define RTPRINT_POW10_STEP 9
+#define RTPRINT_POW10_MAX 1000000000U
+
+/* Exact conversion limits, see rtprint_scaled */
+#define RTPRINT_MAX_SCALE 32
+#define RTPRINT_MAX_FIXED 22
+
+static const uint32_t rtprint_pow5[RTPRINT_POW5_STEP + 1] = {
+  1U, 5U, 25U, 125U, 625U, 3125U, 15625U, 78125U, 390625U, 1953125U,
+  9765625U, 48828125U, 244140625U, 1220703125U
+};
+
+static const uint32_t rtprint_pow10[RTPRINT_POW10_STEP + 1] = {
+  1U, 10U, 100U, 1000U, 10000U, 100000U, 1000000U, 10000000U,
+  100000000U, 1000000000U
+};
+
+static void
+u128_set(RTPRINT_U128 *a, uint64_t v)
+{
+  a->w[0] = (uint32_t)v;
+  a->w[1] = (uint32_t)(v >> 32);
+  a->w[2] = a->w[3] = 0;
+}
+
+static int
+u128_is_zero(const RTPRINT_U128 *a)
+{
+  return ! ( a->w[0] | a->w[1] | a->w[2] | a->w[3] );
+}
+
+static int
+u128_cmp(const RTPRINT_U128 *a, const RTPRINT_U128 *b)
+{
+  int i;
+  for ( i = 3; i >= 0; i-- )
+  {
+    if ( a->w[i] != b->w[i] )
+      return a->w[i] < b->w[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+/* a -= b, with a >= b */
+static void
+u128_sub(RTPRINT_U128 *a, const RTPRINT_U128 *b)
+{
+  uint64_t borrow = 0, d;
+  int i;
+  for ( i = 0; i < 4; i++ )
+  {
+    d = (uint64_t)a->w[i] - b->w[i] - borrow;
+    a->w[i] = (uint32_t)d;
+    borrow = (d >> 63) & 1;
+  }
+}
+
+static void
+u128_mul_small(RTPRINT_U128 *a, uint32_t f)
+{
+  uint64_t carry = 0, p;
+  int i;
+  for ( i = 0; i < 4; i++ )
+  {
+    p = (uint64_t)a->w[i] * f + carry;
+    a->w[i] = (uint32_t)p;
+    carry = p >> 32;
+  }
+}
+
+static void
+u128_mul_pow5(RTPRINT_U128 *a, int n)
+{
+  for ( ; n > RTPRINT_POW5_STEP; n -= RTPRINT_POW5_STEP )
+    u128_mul_small(a, RTPRINT_POW5_MAX);
+  u128_mul_small(a, rtprint_pow5[n]);
+}
+
+static void
+u128_mul_pow10(RTPRINT_U128 *a, int n)
+{
+  for ( ; n > RTPRINT_POW10_STEP; n -= RTPRINT_POW10_STEP )
+    u128_mul_small(a, RTPRINT_POW10_MAX);
+  u128_mul_small(a, rtprint_pow10[n]);
+}
+
+/* a /= d, returning the remainder */
+static uint32_t
+u128_divmod_small(RTPRINT_U128 *a, uint32_t d)
+{
+  uint64_t r = 0, cur;
+  int i;
+  for ( i = 3; i >= 0; i-- )
+  {
+    cur = (r << 32) | a->w[i];
+    a->w[i] = (uint32_t)(cur / d);
+    r = cur % d;
+  }
+  return (uint32_t)r;
+}
+
+static int
+u128_bit(const RTPRINT_U128 *a, int n)
+{
+  return (a->w[n >> 5] >> (n & 31)) & 1;
+}
+
+/* Any bit set below bit n? */
+static int
+u128_any_below(const RTPRINT_U128 *a, int n)
+{
+  int i;
+  for ( i = 0; i < (n >> 5); i++ )
+    if ( a->w[i] ) return RT_TRUE;
+  if ( n & 31 )
+    return ( a->w[n >> 5] & ((1U << (n & 31)) - 1) ) != 0;
+  return RT_FALSE;
+}
+
+static void
+u128_shl(RTPRINT_U128 *a, int n)
+{
+  int limbs = n >> 5, bits = n & 31, i;
+  for ( i = 3; i >= 0; i-- )
+  {
+    uint32_t hi = i - limbs >= 0 ? a->w[i - limbs] : 0;
+    uint32_t lo = i - limbs - 1 >= 0 ? a->w[i - limbs - 1] : 0;
+    a->w[i] = bits ? (hi << bits) | (lo >> (32 - bits)) : hi;
+  }
+}
+
+/* a = round(a / 2^n), ties to even */
+static void
+u128_shr_round(RTPRINT_U128 *a, int n)
+{
+  int half, sticky, limbs, bits, i;
+
+  if ( n <= 0 )
+    return;
+  if ( n > 128 )
+  {
+    u128_set(a, 0);
+    return;
+  }
+
+  half = u128_bit(a, n - 1);
+  sticky = u128_any_below(a, n - 1);
+
+  if ( n == 128 )
+  {
+    u128_set(a, 0);
+  }
+  else
+  {
+    limbs = n >> 5;
+    bits = n & 31;
+    for ( i = 0; i < 4; i++ )
+    {
+      uint32_t lo = i + limbs < 4 ? a->w[i + limbs] : 0;
+      uint32_t hi = i + limbs + 1 < 4 ? a->w[i + limbs + 1] : 0;
+      a->w[i] = bits ? (lo >> bits) | (hi << (32 - bits)) : lo;
+    }
+  }
+
+  /* a += 1 */
+  if ( half && ( sticky || (a->w[0] & 1) ) )
+  {
+    for ( i = 0; i < 4; i++ )
+      if ( ++(a->w[i]) ) break;
+  }
+}
+
+/* Decimal digits of a, most significant first, "0" for zero */
+static int
+u128_digits(RTPRINT_U128 a, char *out)
+{
+  char tmp[48];
+  int n = 0, i;
+  uint32_t chunk;
+
+  do
+  {
+    chunk = u128_divmod_small(&a, RTPRINT_POW10_MAX);
+    for ( i = 0; i < RTPRINT_POW10_STEP; i++ )
+    {
+      tmp[n++] = '0' + chunk % 10;
+      chunk /= 10;
+      if ( ! chunk && u128_is_zero(&a) ) break;
+    }
+  }
+  while ( ! u128_is_zero(&a) );
+
+  for ( i = 0; i < n; i++ )
+    out[i] = tmp[n - 1 - i];
+  return n;
+}
+
+/*
+* Split a finite double into m * 2^e. Returns the biased exponent.
+*/
+static int
+rtprint_decompose(double d, uint64_t *m, int *e)
+{
+  uint64_t bits;
+  int biased;
+
+  memcpy(&bits, &d, sizeof(double));
+  biased = (int)((bits >> 52) & 0x7FF);
+  *m = bits & ((((uint64_t)1) << 52) - 1);
+  if ( biased )
+  {
+    *m |= ((uint64_t)1) << 52;
+    *e = biased - 1075;
+  }
+  else
+  {
+    *e = -1074;
+  }
+  return biased;
+}
+
+/*
+* n = round(|d| * 10^scale), exact. Needs 0 <= scale <= RTPRINT_MAX_SCALE
+* and a result below 2^128.
+*/
+static void
+rtprint_scaled(double d, int scale, RTPRINT_U128 *n)
+{
+  uint64_t m;
+  int e;
+
+  rtprint_decompose(d, &m, &e);
+  u128_set(n, m);
+  u128_mul_pow5(n, scale);
+  if ( e + scale >= 0 )
+    u128_shl(n, e + scale);
+  else
+    u128_shr_round(n, -(e + scale));
+}
+
+/*
+* Write the digits of n with the given number of decimals, dropping
+* trailing zeros (and the dot when none is left) if asked to.
+*/
+static int
+rtprint_place_dot(int negative, const RTPRINT_U128 *n, int decimals, int trim, char *buf)
+{
+  char digits[48];
+  int ndigits, len = 0, intdigits, i;
+
+  ndigits = u128_digits(*n, digits);
+
+  /* Drop trailing zeros of the fraction */
+  while ( trim && decimals > 0 && ndigits > 1 && digits[ndigits - 1] == '0' )
+  {
+    ndigits--;
+    decimals--;
+  }
+  if ( trim && ndigits == 1 && digits[0] == '0' )
+    decimals = 0;
+
+  if ( negative )
+    buf[len++] = '-';
+
+  intdigits = ndigits - decimals;
+  if ( intdigits <= 0 )
+  {
+    buf[len++] = '0';
+    buf[len++] = '.';
+    for ( i = intdigits; i < 0; i++ )
+      buf[len++] = '0';
+    memcpy(buf + len, digits, ndigits);
+    len += ndigits;
+  }
+  else
+  {
+    memcpy(buf + len, digits, intdigits);
+    len += intdigits;
+    if ( decimals )
+    {
+      buf[len++] = '.';
+      memcpy(buf + len, digits + intdigits, decimals);
+      len += decimals;
+    }
+  }
+  buf[len] = '\0';
+  return len;
+}
+
+/*
+* Put a dot back where the current locale wrote its own separator.
+*/
+static int
+rtprint_dot_separator(char *buf)
+{
+  char *p;
+  for ( p = buf; *p; p++ )
+  {
+    if ( ! strchr("0123456789+-eEnNaAiIfF", *p) )
+      *p = '.';
+  }
+  return p - buf;
+}
+
+/*
+* Exact %.*g when it prints in positional notation. Returns 0 when
+* the exact path can't be used, otherwise the decimal exponent and
+* leaves round(|d| * 10^scale) in n.
+*/
+static int
+rtprint_general_exact(double ad, int precision, RTPRINT_U128 *n, int *scale, int *exponent)
+{
+  RTPRINT_U128 lo, hi;
+  int x, tries;
+
+  x = (int)floor(log10(ad));
+  for ( tries = 0; tries < 3; tries++ )
+  {
+    *scale = precision - 1 - x;
+    if ( *scale < 0 || *scale > RTPRINT_MAX_SCALE )
+      return RT_FALSE;
+    rtprint_scaled(ad, *scale, n);
+
+    u128_set(&lo, 1);
+    u128_mul_pow10(&lo, precision - 1);
+    hi = lo;
+    u128_mul_small(&hi, 10);
+
+    if ( u128_cmp(n, &lo) < 0 )
+    {
+      x--;
+      continue;
+    }
+    /* Maybe rounded up from below: one more digit tells */
+    if ( u128_cmp(n, &lo) == 0 && *scale < RTPRINT_MAX_SCALE )
+    {
+      RTPRINT_U128 below;
+      rtprint_scaled(ad, *scale + 1, &below);
+      if ( u128_cmp(&below, &hi) < 0 )
+      {
+        *n = below;
+        (*scale)++;
+        x--;
+      }
+    }
+    if ( u128_cmp(n, &hi) > 0 )
+    {
+      x++;
+      continue;
+    }
+    /* Rounded up to the next power of ten */
+    if ( u128_cmp(n, &hi) == 0 )
+    {
+      x++;
+      (*scale)--;
+      u128_divmod_small(n, 10);
+    }
+    *exponent = x;
+    /* Exponent notation is left to the C library */
+    return ( x >= -4 && x < precision );
+  }
+  return RT_FALSE;
+}
+
+/**
+* Same text as sprintf("%.*f") followed by trim_trailing_zeros for
+* values below OUT_MAX_DOUBLE, and as "%g" above it, whatever the
+* locale. buf needs OUT_MAX_DIGS_DOUBLE + precision + 1 bytes.
+* Returns the length of the text.
+*/
+int
+rtprint_double_fixed(const RTCTX *ctx, double d, int precision, char *buf)
+{
+  RTPRINT_U128 n;
+
+  if ( fabs(d) < OUT_MAX_DOUBLE && precision >= 0 && precision <= RTPRINT_MAX_FIXED )
+  {
+    rtprint_scaled(d, precision, &n);
+    return rtprint_place_dot(signbit(d), &n, precision, RT_TRUE, buf);
+  }
+
+  if ( fabs(d) < OUT_MAX_DOUBLE )
+  {
+    sprintf(buf, "%.*f", precision, d);
+    rtprint_dot_separator(buf);
+    trim_trailing_zeros(ctx, buf);
+    return strlen(buf);
+  }
+
+  sprintf(buf, "%g", d);
+  return rtprint_dot_separator(buf);
+}
+
+/**
+* Same as rtprint_double_fixed, keeping the trailing zeros: the text
+* of sprintf("%.*f") below OUT_MAX_DOUBLE. Same buffer size.
+*/
+int
+rtprint_double_fixed_padded(const RTCTX *ctx, double d, int precision, char *buf)
+{
+  RTPRINT_U128 n;
+
+  if ( fabs(d) < OUT_MAX_DOUBLE && precision >= 0 && precision <= RTPRINT_MAX_FIXED )
+  {
+    rtprint_scaled(d, precision, &n);
+    return rtprint_place_dot(signbit(d), &n, precision, RT_FALSE, buf);
+  }
+
+  if ( fabs(d) < OUT_MAX_DOUBLE )
+    sprintf(buf, "%.*f", precision, d);
+  else
+    sprintf(buf, "%g", d);
+  return rtprint_dot_separator(buf);
+}
+
+/**
+* Same text as snprintf("%.*g"), whatever the locale.
+* Returns the length of the text, truncated to bufsize - 1.
+*/
+int
+rtprint_double_general(const RTCTX *ctx, double d, int precision, char *buf, size_t bufsize)
+{
+  RTPRINT_U128 n;
+  char tmp[64];
+  int scale, exponent, len;
+
+  if ( precision < 0 ) precision = 6;
+  if ( precision == 0 ) precision = 1;
+
+  if ( d == 0.0 )
+    return snprintf(buf, bufsize, "%s", signbit(d) ? "-0" : "0");
+
+  if ( isfinite(d) && precision <= RTPRINT_MAX_SCALE &&
+       rtprint_general_exact(fabs(d), precision, &n, &scale, &exponent) )
+  {
+    len = rtprint_place_dot(d < 0, &n, scale, RT_TRUE, tmp);
+    if ( (size_t)len >= bufsize )
+      len = bufsize - 1;
+    memcpy(buf, tmp, len);
+    buf[len] = '\0';
+    return len;
+  }
+
+  snprintf(buf, bufsize, "%.*g", precision, d);
+  return rtprint_dot_separator(buf);
+}
+
+/*
+* Does n * 10^-scale read back as d? True when it lies within half a
+* unit in the last place of d, ties going to the even mantissa.
+*/
+static int
+rtprint_round_trips(double d, const RTPRINT_U128 *n, int scale)
+{
+  RTPRINT_U128 a, b, diff, bound;
+  uint64_t m;
+  int e, biased, cmp;
+
+  biased = rtprint_decompose(d, &m, &e);
+  if ( e >= 0 || -e + 2 + 57 > 127 )
+    return -1;
+
+  /* a = n * 2^(2-e), b = 4 m 10^scale: both sides scaled by 10^scale 2^(2-e) */
+  a = *n;
+  u128_shl(&a, 2 - e);
+  u128_set(&b, m);
+  u128_mul_pow10(&b, scale);
+  u128_shl(&b, 2);
+
+  cmp = u128_cmp(&a, &b);
+  if ( cmp >= 0 )
+  {
+    diff = a;
+    u128_sub(&diff, &b);
+    u128_set(&bound, 2);
+  }
+  else
+  {
+    diff = b;
+    u128_sub(&diff, &a);
+    /* The gap below a power of two is half as wide */
+    u128_set(&bound, ( m == (((uint64_t)1) << 52) && biased > 1 ) ? 1 : 2);
+  }
+  u128_mul_pow10(&bound, scale);
+
+  cmp = u128_cmp(&diff, &bound);
+  return cmp < 0 || ( cmp == 0 && ! (m & 1) );
+}
+
+/**
+* Shortest text that reads back as the same double, in "%.*g" form.
+* buf needs OUT_MAX_DIGS_DOUBLE + 10 bytes. Returns the length.
+*/
+int
+rtprint_double_shortest(const RTCTX *ctx, double d, char *buf)
+{
+  RTPRINT_U128 n;
+  int precision, scale, exponent, ok;
+
+  if ( d == 0.0 || ! isfinite(d) )
+    return rtprint_double_general(ctx, d, 17, buf, OUT_MAX_DIGS_DOUBLE + 10);
+
+  /*
+   * Any normal double has a 15 digit form that %g trims down to its
+   * shortest one. Subnormals carry fewer digits, so the shortest form
+   * can be shorter than their 15 digit rounding: search from 1.
+   */
+  precision = fabs(d) < DBL_MIN ? 1 : 15;
+  for ( ; precision < 17; precision++ )
+  {
+    if ( rtprint_general_exact(fabs(d), precision, &n, &scale, &exponent) )
+      ok = rtprint_round_trips(d, &n, scale);
+    else
+      ok = -1;
+
+    if ( ok == 1 )
+      return rtprint_place_dot(d < 0, &n, scale, RT_TRUE, buf);
+    if ( ok == 0 )
+      continue;
+
+    /* Let the C library convert both ways, in the same locale */
+    snprintf(buf, OUT_MAX_DIGS_DOUBLE + 10, "%.*g", precision, d);
+    if ( strtod(buf, NULL) == d )
+      return rtprint_dot_separator(buf);
+  }
+
+  return rtprint_double_general(ctx, d, 17, buf, OUT_MAX_DIGS_DOUBLE + 10);
+}
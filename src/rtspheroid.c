@@ -44,7 +44,10 @@ void spheroid_init(const RTCTX *ctx, SPHEROID *s, double a, double b)
   s->b = b;
   s->f = (a - b) / a;
   s->e_sq = (a*a - b*b)/(a*a);
+  s->e = sqrt(s->e_sq);
   s->radius = (2.0 * a + b ) / 3.0;
+  s->area_scale = b * b / 2.0;
+  s->area_k = s->e > 0.0 ? 1.0 / (2.0 * s->e) : 0.0;
 }
 
 #if ! PROJ_GEODESIC
@@ -419,90 +422,153 @@ static inline double spheroid_prime_vertical_radius_of_curvature(const RTCTX *ct
   return spheroid->a / (sqrt(1.0 - spheroid->e_sq * POW2(sin(latitude))));
 }
 
-static inline double spheroid_parallel_arc_length(const RTCTX *ctx, double latitude, double deltaLongitude, const SPHEROID *spheroid)
+/**
+* Radius of the parallel at latitude, the length of one radian of
+* longitude along it.
+*/
+static inline double spheroid_parallel_radius(const RTCTX *ctx, double latitude, const SPHEROID *spheroid)
 {
   return spheroid_prime_vertical_radius_of_curvature(ctx, latitude, spheroid)
-         * cos(latitude)
-         * deltaLongitude;
+         * cos(latitude);
 }
 
+/**
+* The latitude term q of the area of boxes bounded by meridians and
+* parallels (Bagratuni 1967), from the sine of the latitude. Spheres
+* have no log term, and q is twice the sine.
+*/
+static inline double spheroid_area_q(double sin_phi, const SPHEROID *spheroid)
+{
+  if ( spheroid->area_k == 0.0 )
+    return 2.0 * sin_phi;
+  return sin_phi / (1.0 - spheroid->e_sq * sin_phi * sin_phi) +
+         spheroid->area_k * log((1.0 + spheroid->e * sin_phi) / (1.0 - spheroid->e * sin_phi));
+}
 
 /**
 * Computes the area on the spheroid of a box bounded by meridians and
-* parallels. The box is defined by two points, the South West corner
-* and the North East corner. Formula based on Bagratuni 1967.
+* parallels, delta_lon wide, from the q terms of its south and north
+* latitudes. Formula based on Bagratuni 1967.
 *
-* @param southWestCorner - lower left corner of bounding box.
-* @param northEastCorner - upper right corner of bounding box.
 * @return area in square meters.
 */
-static double spheroid_boundingbox_area(const RTCTX *ctx, const GEOGRAPHIC_POINT *southWestCorner, const GEOGRAPHIC_POINT *northEastCorner, const SPHEROID *spheroid)
-{
-  double z0 = (northEastCorner->lon - southWestCorner->lon) * POW2(spheroid->b) / 2.0;
-  double e = sqrt(spheroid->e_sq);
-  double sinPhi1 = sin(southWestCorner->lat);
-  double sinPhi2 = sin(northEastCorner->lat);
-  double t1p1 = sinPhi1 / (1.0 - spheroid->e_sq * sinPhi1 * sinPhi1);
-  double t1p2 = sinPhi2 / (1.0 - spheroid->e_sq * sinPhi2 * sinPhi2);
-  double oneOver2e = 1.0 / (2.0 * e);
-  double t2p1 = oneOver2e * log((1.0 + e * sinPhi1) / (1.0 - e * sinPhi1));
-  double t2p2 = oneOver2e * log((1.0 + e * sinPhi2) / (1.0 - e * sinPhi2));
-  return z0 * (t1p2 + t2p2) - z0 * (t1p1 + t2p1);
+static inline double spheroid_boundingbox_area(double delta_lon, double q_south, double q_north, const SPHEROID *spheroid)
+{
+  double z0 = delta_lon * spheroid->area_scale;
+  return z0 * q_north - z0 * q_south;
+}
+
+/**
+* Vertex of a ring with the terms of the strip area that only depend
+* on its latitude.
+*/
+typedef struct
+{
+  GEOGRAPHIC_POINT g;
+  double q;      /* spheroid_area_q of the latitude */
+  double radius; /* spheroid_parallel_radius of the latitude */
+} SPHEROID_AREA_POINT;
+
+static inline void spheroid_area_point_init(const RTCTX *ctx, const GEOGRAPHIC_POINT *g, const SPHEROID *spheroid, SPHEROID_AREA_POINT *p)
+{
+  p->g = *g;
+  p->q = spheroid_area_q(sin(g->lat), spheroid);
+  p->radius = spheroid_parallel_radius(ctx, g->lat, spheroid);
 }
 
 /**
 * This function doesn't work for edges crossing the dateline or in the southern
 * hemisphere. Points are pre-conditioned in ptarray_area_spheroid.
+* q_min is the q term of the lowest latitude of the ring.
 */
-static double spheroid_striparea(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, double latitude_min, const SPHEROID *spheroid)
+static double spheroid_striparea(const RTCTX *ctx, const SPHEROID_AREA_POINT *a, const SPHEROID_AREA_POINT *b, double q_min, const SPHEROID *spheroid)
 {
-  GEOGRAPHIC_POINT A, B, mL, nR;
   double deltaLng, baseArea, topArea;
-  double bE, tE, ratio, sign;
-
-  A = *a;
-  B = *b;
-
-  mL.lat = latitude_min;
-  mL.lon = FP_MIN(A.lon, B.lon);
-  nR.lat = FP_MIN(A.lat, B.lat);
-  nR.lon = FP_MAX(A.lon, B.lon);
-  RTDEBUGF(ctx, 4, "mL (%.12g %.12g)", mL.lat, mL.lon);
-  RTDEBUGF(ctx, 4, "nR (%.12g %.12g)", nR.lat, nR.lon);
-  baseArea = spheroid_boundingbox_area(ctx, &mL, &nR, spheroid);
-  RTDEBUGF(ctx, 4, "baseArea %.12g", baseArea);
+  double q_low, q_high, bE, tE, ratio, sign;
 
-  mL.lat = FP_MIN(A.lat, B.lat);
-  mL.lon = FP_MIN(A.lon, B.lon);
-  nR.lat = FP_MAX(A.lat, B.lat);
-  nR.lon = FP_MAX(A.lon, B.lon);
-  RTDEBUGF(ctx, 4, "mL (%.12g %.12g)", mL.lat, mL.lon);
-  RTDEBUGF(ctx, 4, "nR (%.12g %.12g)", nR.lat, nR.lon);
-  topArea = spheroid_boundingbox_area(ctx, &mL, &nR, spheroid);
-  RTDEBUGF(ctx, 4, "topArea %.12g", topArea);
+  if ( a->g.lat <= b->g.lat )
+  {
+    q_low = a->q;
+    q_high = b->q;
+  }
+  else
+  {
+    q_low = b->q;
+    q_high = a->q;
+  }
 
-  deltaLng = B.lon - A.lon;
+  deltaLng = b->g.lon - a->g.lon;
   RTDEBUGF(ctx, 4, "deltaLng %.12g", deltaLng);
-  bE = spheroid_parallel_arc_length(ctx, A.lat, deltaLng, spheroid);
-  tE = spheroid_parallel_arc_length(ctx, B.lat, deltaLng, spheroid);
+
+  baseArea = spheroid_boundingbox_area(fabs(deltaLng), q_min, q_low, spheroid);
+  RTDEBUGF(ctx, 4, "baseArea %.12g", baseArea);
+  topArea = spheroid_boundingbox_area(fabs(deltaLng), q_low, q_high, spheroid);
+  RTDEBUGF(ctx, 4, "topArea %.12g", topArea);
+
+  bE = a->radius * deltaLng;
+  tE = b->radius * deltaLng;
   RTDEBUGF(ctx, 4, "bE %.12g", bE);
   RTDEBUGF(ctx, 4, "tE %.12g", tE);
 
   ratio = (bE + tE)/tE;
-  sign = signum(B.lon - A.lon);
+  sign = signum(deltaLng);
   return (baseArea + topArea / ratio) * sign;
 }
 
+/**
+* Strip area under the edge from a to b, computed on points along the
+* geodesic when it spans delta_lon_tolerance or more of longitude.
+*/
+static double spheroid_edge_area(const RTCTX *ctx, const SPHEROID_AREA_POINT *a, const SPHEROID_AREA_POINT *b, double delta_lon_tolerance, double q_min, const SPHEROID *spheroid)
+{
+  SPHEROID_AREA_POINT p, q;
+  GEOGRAPHIC_POINT g;
+  double delta_lon = fabs(b->g.lon - a->g.lon);
+  double step, distance, pDistance, azimuth;
+  double area = 0.0;
+
+  RTDEBUGF(ctx, 4, "a(%.18g %.18g) b(%.18g %.18g)", a->g.lat, a->g.lon, b->g.lat, b->g.lon);
+  RTDEBUGF(ctx, 4, "delta_lon %.18g", delta_lon);
+
+  if ( delta_lon <= 0.0 )
+    return 0.0;
+
+  if ( delta_lon < delta_lon_tolerance )
+    return spheroid_striparea(ctx, a, b, q_min, spheroid);
+
+  step = floor(delta_lon / delta_lon_tolerance);
+  distance = spheroid_distance(ctx, &(a->g), &(b->g), spheroid);
+  pDistance = 0.0;
+  step = distance / step;
+  RTDEBUGF(ctx, 4, "step %.18g", step);
+  p = *a;
+  while (pDistance < (distance - step * 1.01))
+  {
+    azimuth = spheroid_direction(ctx, &(p.g), &(b->g), spheroid);
+    pDistance = pDistance + step;
+    spheroid_project(ctx, &(p.g), spheroid, step, azimuth, &g);
+    spheroid_area_point_init(ctx, &g, spheroid, &q);
+    area += spheroid_striparea(ctx, &p, &q, q_min, spheroid);
+    p = q;
+  }
+  area += spheroid_striparea(ctx, &p, b, q_min, spheroid);
+  return area;
+}
+
+#define SPHEROID_AREA_BLOCK 64
+
 static double ptarray_area_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa, const SPHEROID *spheroid)
 {
-  GEOGRAPHIC_POINT a, b;
-  RTPOINT2D p;
-  int i;
+  SPHEROID_AREA_POINT block[SPHEROID_AREA_BLOCK];
+  SPHEROID_AREA_POINT a, b;
+  GEOGRAPHIC_POINT g;
+  const RTPOINT2D *pt;
+  int i, j, n;
   double area = 0.0;
   RTGBOX gbox2d;
   int in_south = RT_FALSE;
   double delta_lon_tolerance;
-  double latitude_min;
+  double latitude_min, q_min;
 
   gbox2d.flags = gflags(ctx, 0, 0, 0);
 
@@ -533,102 +599,58 @@ static double ptarray_area_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa, co
     delta_lon_tolerance = (90.0 / (fabs(gbox2d.ymax) / 8.0) - 2.0) / 10000.0;
     latitude_min = deg2rad(gbox2d.ymin);
   }
-
-  /* Initialize first point */
-  rt_getPoint2d_p(ctx, pa, 0, &p);
-  geographic_point_init(ctx, p.x, p.y, &a);
-
-  for ( i = 1; i < pa->npoints; i++ )
+  q_min = spheroid_area_q(sin(latitude_min), spheroid);
+
+  /*
+  * Vertices are flipped into the north if in south, and get their
+  * latitude terms computed a block at a time. Only longitudes change
+  * when edges are shifted off the dateline below.
+  */
+  for ( i = 0; i < pa->npoints; i += n )
   {
-    GEOGRAPHIC_POINT a1, b1;
-    double strip_area = 0.0;
-    double delta_lon = 0.0;
-    RTDEBUGF(ctx, 4, "edge #%d", i);
-
-    rt_getPoint2d_p(ctx, pa, i, &p);
-    geographic_point_init(ctx, p.x, p.y, &b);
-
-    a1 = a;
-    b1 = b;
-
-    /* Flip into north if in south */
-    if ( in_south )
+    n = FP_MIN(pa->npoints - i, SPHEROID_AREA_BLOCK);
+    for ( j = 0; j < n; j++ )
     {
-      a1.lat = -1.0 * a1.lat;
-      b1.lat = -1.0 * b1.lat;
+      pt = rt_getPoint2d_cp(ctx, pa, i + j);
+      geographic_point_init(ctx, pt->x, pt->y, &g);
+      if ( in_south )
+        g.lat = -1.0 * g.lat;
+      spheroid_area_point_init(ctx, &g, spheroid, &block[j]);
     }
 
-    RTDEBUGF(ctx, 4, "in_south %d", in_south);
-
-    RTDEBUGF(ctx, 4, "crosses_dateline(ctx, a, b) %d", crosses_dateline(ctx, &a, &b) );
-
-    if ( crosses_dateline(ctx, &a, &b) )
+    for ( j = 0; j < n; j++ )
     {
-      double shift;
-
-      if ( a1.lon > 0.0 )
-        shift = (M_PI - a1.lon) + 0.088; /* About 5deg more */
-      else
-        shift = (M_PI - b1.lon) + 0.088; /* About 5deg more */
-
-      RTDEBUGF(ctx, 4, "shift: %.8g", shift);
-      RTDEBUGF(ctx, 4, "before shift a1(%.8g %.8g) b1(%.8g %.8g)", a1.lat, a1.lon, b1.lat, b1.lon);
-      point_shift(ctx, &a1, shift);
-      point_shift(ctx, &b1, shift);
-      RTDEBUGF(ctx, 4, "after shift a1(%.8g %.8g) b1(%.8g %.8g)", a1.lat, a1.lon, b1.lat, b1.lon);
-
-    }
-
-
-    delta_lon = fabs(b1.lon - a1.lon);
-
-    RTDEBUGF(ctx, 4, "a1(%.18g %.18g) b1(%.18g %.18g)", a1.lat, a1.lon, b1.lat, b1.lon);
-    RTDEBUGF(ctx, 4, "delta_lon %.18g", delta_lon);
-    RTDEBUGF(ctx, 4, "delta_lon_tolerance %.18g", delta_lon_tolerance);
+      if ( i + j == 0 )
+      {
+        a = block[0];
+        continue;
+      }
+      b = block[j];
+      RTDEBUGF(ctx, 4, "edge #%d", i + j);
 
-    if ( delta_lon > 0.0 )
-    {
-      if ( delta_lon < delta_lon_tolerance )
+      if ( crosses_dateline(ctx, &(a.g), &(b.g)) )
       {
-        strip_area = spheroid_striparea(ctx, &a1, &b1, latitude_min, spheroid);
-        RTDEBUGF(ctx, 4, "strip_area %.12g", strip_area);
-        area += strip_area;
+        SPHEROID_AREA_POINT a1 = a, b1 = b;
+        double shift;
+
+        if ( a1.g.lon > 0.0 )
+          shift = (M_PI - a1.g.lon) + 0.088; /* About 5deg more */
+        else
+          shift = (M_PI - b1.g.lon) + 0.088; /* About 5deg more */
+
+        RTDEBUGF(ctx, 4, "shift: %.8g", shift);
+        point_shift(ctx, &(a1.g), shift);
+        point_shift(ctx, &(b1.g), shift);
+        area += spheroid_edge_area(ctx, &a1, &b1, delta_lon_tolerance, q_min, spheroid);
       }
       else
       {
-        GEOGRAPHIC_POINT p, q;
-        double step = floor(delta_lon / delta_lon_tolerance);
-        double distance = spheroid_distance(ctx, &a1, &b1, spheroid);
-        double pDistance = 0.0;
-        int j = 0;
-        RTDEBUGF(ctx, 4, "step %.18g", step);
-        RTDEBUGF(ctx, 4, "distance %.18g", distance);
-        step = distance / step;
-        RTDEBUGF(ctx, 4, "step %.18g", step);
-        p = a1;
-        while (pDistance < (distance - step * 1.01))
-        {
-          double azimuth = spheroid_direction(ctx, &p, &b1, spheroid);
-          j++;
-          RTDEBUGF(ctx, 4, "  iteration %d", j);
-          RTDEBUGF(ctx, 4, "  azimuth %.12g", azimuth);
-          pDistance = pDistance + step;
-          RTDEBUGF(ctx, 4, "  pDistance %.12g", pDistance);
-          spheroid_project(ctx, &p, spheroid, step, azimuth, &q);
-          strip_area = spheroid_striparea(ctx, &p, &q, latitude_min, spheroid);
-          RTDEBUGF(ctx, 4, "  strip_area %.12g", strip_area);
-          area += strip_area;
-          RTDEBUGF(ctx, 4, "  area %.12g", area);
-          p.lat = q.lat;
-          p.lon = q.lon;
-        }
-        strip_area = spheroid_striparea(ctx, &p, &b1, latitude_min, spheroid);
-        area += strip_area;
+        area += spheroid_edge_area(ctx, &a, &b, delta_lon_tolerance, q_min, spheroid);
       }
-    }
 
-    /* B gets incremented in the next loop, so we save the value here */
-    a = b;
+      /* B gets incremented in the next loop, so we save the value here */
+      a = b;
+    }
   }
   return fabs(area);
 }
@@ -700,3 +722,279 @@ double rtgeom_area_spheroid(const RTCTX *ctx, const RTGEOM *rtgeom, const SPHERO
 
 
 
+
+
+/*
+* Batch geodesic inverse problem. Points are loaded a block at a time
+* into flat arrays of radians and latitude sines and cosines, computed
+* once per vertex, so that the per pair loops run over plain arrays
+* the compiler can vectorize.
+*/
+
+#define RT_GEODESIC_BLOCK 64
+
+typedef struct
+{
+  double lon[RT_GEODESIC_BLOCK + 1];
+  double lat[RT_GEODESIC_BLOCK + 1];
+  double sin_phi[RT_GEODESIC_BLOCK + 1]; /* of the latitude, or of the reduced one */
+  double cos_phi[RT_GEODESIC_BLOCK + 1];
+} RTGEODESIC_BLOCK;
+
+static void rtgeodesic_block_load(const RTCTX *ctx, const RTPOINTARRAY *pa, int start, int n, const SPHEROID *s, RTGEODESIC_MODE mode, RTGEODESIC_BLOCK *blk)
+{
+  const RTPOINT2D *p;
+  GEOGRAPHIC_POINT g;
+  double omf = 1.0 - s->f;
+  double tan_u;
+  int i;
+
+  for ( i = 0; i < n; i++ )
+  {
+    p = rt_getPoint2d_cp(ctx, pa, start + i);
+    geographic_point_init(ctx, p->x, p->y, &g);
+    blk->lon[i] = g.lon;
+    blk->lat[i] = g.lat;
+  }
+
+  if ( mode == RTGEODESIC_FAST )
+  {
+    for ( i = 0; i < n; i++ )
+    {
+      blk->sin_phi[i] = sin(blk->lat[i]);
+      blk->cos_phi[i] = cos(blk->lat[i]);
+    }
+  }
+  else if ( mode == RTGEODESIC_VINCENTY || ! PROJ_GEODESIC )
+  {
+    /* Reduced latitude, tan(u) = (1-f) tan(lat) */
+    for ( i = 0; i < n; i++ )
+    {
+      tan_u = omf * tan(blk->lat[i]);
+      blk->cos_phi[i] = 1.0 / sqrt(1.0 + tan_u * tan_u);
+      blk->sin_phi[i] = tan_u * blk->cos_phi[i];
+    }
+  }
+}
+
+static inline double rtgeodesic_azimuth_normalize(double azimuth)
+{
+  if ( azimuth < 0.0 )
+    azimuth += 2.0 * M_PI;
+  if ( azimuth >= 2.0 * M_PI )
+    azimuth -= 2.0 * M_PI;
+  return azimuth;
+}
+
+/**
+* Great circle distances on the sphere of the spheroid mean radius,
+* with the same arithmetic as sphere_distance.
+*/
+static void rtgeodesic_fast(int n, const RTGEODESIC_BLOCK *b1, int o1, const RTGEODESIC_BLOCK *b2, int o2, const SPHEROID *s, double *distances, double *azimuths)
+{
+  double d_lon, sin_d_lon, cos_d_lon, y, x;
+  int i;
+
+  for ( i = 0; i < n; i++ )
+  {
+    d_lon = b2->lon[i + o2] - b1->lon[i + o1];
+    sin_d_lon = sin(d_lon);
+    cos_d_lon = cos(d_lon);
+    y = b2->cos_phi[i + o2] * sin_d_lon;
+    x = b1->cos_phi[i + o1] * b2->sin_phi[i + o2] - b1->sin_phi[i + o1] * b2->cos_phi[i + o2] * cos_d_lon;
+    if ( distances )
+      distances[i] = s->radius * atan2(sqrt(POW2(y) + POW2(x)),
+        b1->sin_phi[i + o1] * b2->sin_phi[i + o2] + b1->cos_phi[i + o1] * b2->cos_phi[i + o2] * cos_d_lon);
+    if ( azimuths )
+      azimuths[i] = rtgeodesic_azimuth_normalize(atan2(y, x));
+  }
+}
+
+/**
+* Vincenty's inverse solution from reduced latitudes, as in
+* spheroid_distance and spheroid_direction but solving for both with
+* a single iteration. Falls back to the sphere when the iteration
+* doesn't give a number (nearly antipodal points).
+*/
+static void rtgeodesic_vincenty_pair(double sin_u1, double cos_u1, double sin_u2, double cos_u2, double omega, const SPHEROID *s, double *distance, double *azimuth)
+{
+  double f = s->f;
+  double lambda = omega, last_lambda;
+  double sin_lambda, cos_lambda, y, x;
+  double sin_sigma, cos_sigma, sigma, sigma0 = 0.0;
+  double sin_alpha, cos_sq_alpha, cos2_sigma_m, c;
+  double u_sq, big_a, big_b, delta_sigma, d;
+  int i = 0;
+
+  do
+  {
+    sin_lambda = sin(lambda);
+    cos_lambda = cos(lambda);
+    y = cos_u2 * sin_lambda;
+    x = cos_u1 * sin_u2 - sin_u1 * cos_u2 * cos_lambda;
+    sin_sigma = sqrt(POW2(y) + POW2(x));
+    cos_sigma = sin_u1 * sin_u2 + cos_u1 * cos_u2 * cos_lambda;
+
+    /* Same point => zero distance */
+    if ( sin_sigma == 0.0 && cos_sigma > 0.0 )
+    {
+      if ( distance ) *distance = 0.0;
+      if ( azimuth ) *azimuth = 0.0;
+      return;
+    }
+
+    sigma = atan2(sin_sigma, cos_sigma);
+    if ( i == 0 )
+      sigma0 = sigma;
+    sin_alpha = cos_u1 * cos_u2 * sin_lambda / sin_sigma;
+    cos_sq_alpha = 1.0 - POW2(sin_alpha);
+
+    /* Along the equator cos_sq_alpha is zero, and so is the term */
+    cos2_sigma_m = cos_sq_alpha != 0.0 ? cos_sigma - 2.0 * sin_u1 * sin_u2 / cos_sq_alpha : 0.0;
+
+    /* Numerical stability issue, cos2 is in range */
+    if ( cos2_sigma_m > 1.0 )
+      cos2_sigma_m = 1.0;
+    if ( cos2_sigma_m < -1.0 )
+      cos2_sigma_m = -1.0;
+
+    c = (f / 16.0) * cos_sq_alpha * (4.0 + f * (4.0 - 3.0 * cos_sq_alpha));
+    last_lambda = lambda;
+    lambda = omega + (1.0 - c) * f * sin_alpha * (sigma + c * sin_sigma *
+             (cos2_sigma_m + c * cos_sigma * (-1.0 + 2.0 * POW2(cos2_sigma_m))));
+    i++;
+  }
+  while ( (i < 999) && (lambda != 0.0) && (fabs((last_lambda - lambda) / lambda) > 1.0e-9) );
+
+  if ( distance )
+  {
+    u_sq = cos_sq_alpha * (POW2(s->a) - POW2(s->b)) / POW2(s->b);
+    big_a = 1.0 + (u_sq / 16384.0) * (4096.0 + u_sq * (-768.0 + u_sq * (320.0 - 175.0 * u_sq)));
+    big_b = (u_sq / 1024.0) * (256.0 + u_sq * (-128.0 + u_sq * (74.0 - 47.0 * u_sq)));
+    delta_sigma = big_b * sin_sigma * (cos2_sigma_m + (big_b / 4.0) * (cos_sigma * (-1.0 + 2.0 * POW2(cos2_sigma_m)) -
+                  (big_b / 6.0) * cos2_sigma_m * (-3.0 + 4.0 * POW2(sin_sigma)) * (-3.0 + 4.0 * POW2(cos2_sigma_m))));
+    d = s->b * big_a * (sigma - delta_sigma);
+    *distance = d == d ? d : s->radius * sigma0;
+  }
+  if ( azimuth )
+  {
+    y = cos_u2 * sin(lambda);
+    x = cos_u1 * sin_u2 - sin_u1 * cos_u2 * cos(lambda);
+    *azimuth = rtgeodesic_azimuth_normalize(atan2(y, x));
+  }
+}
+
+static void rtgeodesic_vincenty(int n, const RTGEODESIC_BLOCK *b1, int o1, const RTGEODESIC_BLOCK *b2, int o2, const SPHEROID *s, double *distances, double *azimuths)
+{
+  int i;
+
+  for ( i = 0; i < n; i++ )
+  {
+    rtgeodesic_vincenty_pair(b1->sin_phi[i + o1], b1->cos_phi[i + o1],
+                             b2->sin_phi[i + o2], b2->cos_phi[i + o2],
+                             b2->lon[i + o2] - b1->lon[i + o1], s,
+                             distances ? distances + i : NULL,
+                             azimuths ? azimuths + i : NULL);
+  }
+}
+
+#if PROJ_GEODESIC
+/**
+* GeographicLib (Karney 2013) inverse solutions, with the geodesic
+* set up once for all the pairs.
+*/
+static void rtgeodesic_karney(const struct geod_geodesic *gd, int n, const RTGEODESIC_BLOCK *b1, int o1, const RTGEODESIC_BLOCK *b2, int o2, double *distances, double *azimuths)
+{
+  double s12, azi1;
+  int i;
+
+  for ( i = 0; i < n; i++ )
+  {
+    geod_inverse(gd, b1->lat[i + o1] * 180.0 / M_PI, b1->lon[i + o1] * 180.0 / M_PI,
+                 b2->lat[i + o2] * 180.0 / M_PI, b2->lon[i + o2] * 180.0 / M_PI,
+                 &s12, &azi1, 0);
+    if ( distances )
+      distances[i] = s12;
+    if ( azimuths )
+      azimuths[i] = rtgeodesic_azimuth_normalize(azi1 * M_PI / 180.0);
+  }
+}
+#endif /* PROJ_GEODESIC */
+
+static void rtgeodesic_solve(const RTCTX *ctx, int n, const RTGEODESIC_BLOCK *b1, int o1, const RTGEODESIC_BLOCK *b2, int o2, const SPHEROID *s, RTGEODESIC_MODE mode, double *distances, double *azimuths)
+{
+  if ( mode == RTGEODESIC_FAST )
+  {
+    rtgeodesic_fast(n, b1, o1, b2, o2, s, distances, azimuths);
+    return;
+  }
+#if PROJ_GEODESIC
+  if ( mode == RTGEODESIC_KARNEY )
+  {
+    struct geod_geodesic gd;
+    geod_init(&gd, s->a, s->f);
+    rtgeodesic_karney(&gd, n, b1, o1, b2, o2, distances, azimuths);
+    return;
+  }
+#endif
+  rtgeodesic_vincenty(n, b1, o1, b2, o2, s, distances, azimuths);
+}
+
+static int rtgeodesic_mode_check(const RTCTX *ctx, RTGEODESIC_MODE mode)
+{
+  if ( mode != RTGEODESIC_FAST && mode != RTGEODESIC_VINCENTY && mode != RTGEODESIC_KARNEY )
+  {
+    rterror(ctx, "unknown geodesic mode %d", mode);
+    return RT_FALSE;
+  }
+  return RT_TRUE;
+}
+
+int ptarray_geodesic_segments(const RTCTX *ctx, const RTPOINTARRAY *pa, const SPHEROID *s, RTGEODESIC_MODE mode, double *distances, double *azimuths)
+{
+  RTGEODESIC_BLOCK blk;
+  int start, n, nsegs;
+
+  if ( ! rtgeodesic_mode_check(ctx, mode) )
+    return -1;
+  if ( ! pa || pa->npoints < 2 )
+    return 0;
+
+  nsegs = pa->npoints - 1;
+  for ( start = 0; start < nsegs; start += n )
+  {
+    n = FP_MIN(nsegs - start, RT_GEODESIC_BLOCK);
+    /* Segment i runs from vertex i to vertex i+1 of the block */
+    rtgeodesic_block_load(ctx, pa, start, n + 1, s, mode, &blk);
+    rtgeodesic_solve(ctx, n, &blk, 0, &blk, 1, s, mode,
+                     distances ? distances + start : NULL,
+                     azimuths ? azimuths + start : NULL);
+  }
+  return nsegs;
+}
+
+int ptarray_geodesic_pairs(const RTCTX *ctx, const RTPOINTARRAY *pa1, const RTPOINTARRAY *pa2, const SPHEROID *s, RTGEODESIC_MODE mode, double *distances, double *azimuths)
+{
+  RTGEODESIC_BLOCK blk1, blk2;
+  int start, n, npairs;
+
+  if ( ! rtgeodesic_mode_check(ctx, mode) )
+    return -1;
+  if ( pa1->npoints != pa2->npoints )
+  {
+    rterror(ctx, "ptarray_geodesic_pairs: point arrays have different sizes (%d and %d)", pa1->npoints, pa2->npoints);
+    return -1;
+  }
+
+  npairs = pa1->npoints;
+  for ( start = 0; start < npairs; start += n )
+  {
+    n = FP_MIN(npairs - start, RT_GEODESIC_BLOCK);
+    rtgeodesic_block_load(ctx, pa1, start, n, s, mode, &blk1);
+    rtgeodesic_block_load(ctx, pa2, start, n, s, mode, &blk2);
+    rtgeodesic_solve(ctx, n, &blk1, 0, &blk2, 0, s, mode,
+                     distances ? distances + start : NULL,
+                     azimuths ? azimuths + start : NULL);
+  }
+  return npairs;
+}
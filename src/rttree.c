@@ -24,6 +24,7 @@
 
 
 #include "rttopo_config.h"
+#include <string.h>
 #include "librttopo_geom_internal.h"
 #include "rtgeom_log.h"
 #include "rttree.h"
@@ -142,6 +143,7 @@ RECT_NODE* rect_node_leaf_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i)
   node = rtalloc(ctx, sizeof(RECT_NODE));
   node->p1 = p1;
   node->p2 = p2;
+  node->p3 = NULL;
   node->xmin = FP_MIN(p1->x,p2->x);
   node->xmax = FP_MAX(p1->x,p2->x);
   node->ymin = FP_MIN(p1->y,p2->y);
@@ -160,6 +162,7 @@ RECT_NODE* rect_node_internal_new(const RTCTX *ctx, RECT_NODE *left_node, RECT_N
   RECT_NODE *node = rtalloc(ctx, sizeof(RECT_NODE));
   node->p1 = NULL;
   node->p2 = NULL;
+  node->p3 = NULL;
   node->xmin = FP_MIN(left_node->xmin, right_node->xmin);
   node->xmax = FP_MAX(left_node->xmax, right_node->xmax);
   node->ymin = FP_MIN(left_node->ymin, right_node->ymin);
@@ -170,40 +173,69 @@ RECT_NODE* rect_node_internal_new(const RTCTX *ctx, RECT_NODE *left_node, RECT_N
 }
 
 /**
-* Build a tree of nodes from a point array, one node per edge, and each
-* with an associated measure range along a one-dimensional space. We
-* can then search that space as a range tree.
+* Create a new degenerate leaf node for a single vertex, so that isolated
+* points can live in the same trees as edges.
 */
-RECT_NODE* rect_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
+RECT_NODE* rect_node_point_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i)
 {
-  int num_edges, num_children, num_parents;
-  int i, j;
-  RECT_NODE **nodes;
+  RECT_NODE *node = rtalloc(ctx, sizeof(RECT_NODE));
+  node->p1 = node->p2 = (RTPOINT2D*)rt_getPoint_internal(ctx, pa, i);
+  node->p3 = NULL;
+  node->xmin = node->xmax = node->p1->x;
+  node->ymin = node->ymax = node->p1->y;
+  node->left_node = NULL;
+  node->right_node = NULL;
+  return node;
+}
+
+/**
+* Create a new leaf node for the arc starting at vertex i, with the
+* bounds of the full arc rather than of its three control points.
+*/
+RECT_NODE* rect_node_leaf_arc_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i)
+{
+  RTPOINT2D *p1, *p2, *p3;
   RECT_NODE *node;
-  RECT_NODE *tree;
+  RTGBOX gbox;
 
-  if ( pa->npoints < 2 )
-  {
+  p1 = (RTPOINT2D*)rt_getPoint_internal(ctx, pa, i);
+  p2 = (RTPOINT2D*)rt_getPoint_internal(ctx, pa, i+1);
+  p3 = (RTPOINT2D*)rt_getPoint_internal(ctx, pa, i+2);
+
+  /* Zero length arc, doesn't get a node */
+  if ( FP_EQUALS(p1->x, p3->x) && FP_EQUALS(p1->y, p3->y) &&
+       FP_EQUALS(p1->x, p2->x) && FP_EQUALS(p1->y, p2->y) )
     return NULL;
-  }
 
-  /*
-  ** First create a flat list of nodes, one per edge.
-  ** For each vertex, transform into our one-dimensional measure.
-  ** Hopefully, when projected, the points turn into a fairly
-  ** uniformly distributed collection of measures.
-  */
-  num_edges = pa->npoints - 1;
-  nodes = rtalloc(ctx, sizeof(RECT_NODE*) * pa->npoints);
-  j = 0;
-  for ( i = 0; i < num_edges; i++ )
+  if ( rt_arc_calculate_gbox_cartesian_2d(ctx, p1, p2, p3, &gbox) == RT_FAILURE )
+    return NULL;
+
+  node = rtalloc(ctx, sizeof(RECT_NODE));
+  node->p1 = p1;
+  node->p2 = p3;
+  node->p3 = p2;
+  node->xmin = gbox.xmin;
+  node->xmax = gbox.xmax;
+  node->ymin = gbox.ymin;
+  node->ymax = gbox.ymax;
+  node->left_node = NULL;
+  node->right_node = NULL;
+  return node;
+}
+
+/**
+* Pair up a flat list of nodes level by level until a single root
+* remains. Consumes (frees) the list, returns NULL if it was empty.
+*/
+static RECT_NODE* rect_tree_build(const RTCTX *ctx, RECT_NODE **nodes, int num_children)
+{
+  int num_parents, j;
+  RECT_NODE *tree;
+
+  if ( num_children == 0 )
   {
-    node = rect_node_leaf_new(ctx, pa, i);
-    if ( node ) /* Not zero length? */
-    {
-      nodes[j] = node;
-      j++;
-    }
+    rtfree(ctx, nodes);
+    return NULL;
   }
 
   /*
@@ -213,7 +245,6 @@ RECT_NODE* rect_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
   ** reasonable amount of sorting already.
   */
 
-  num_children = j;
   num_parents = num_children / 2;
   while ( num_parents > 0 )
   {
@@ -245,6 +276,357 @@ RECT_NODE* rect_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
   rtfree(ctx, nodes);
 
   return tree;
+}
+
+/**
+* Build a tree of nodes from a point array, one node per edge, and each
+* with an associated measure range along a one-dimensional space. We
+* can then search that space as a range tree.
+* Returns NULL if the array has no edge of non-zero length.
+*/
+RECT_NODE* rect_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  int num_edges;
+  int i, j;
+  RECT_NODE **nodes;
+  RECT_NODE *node;
+
+  if ( pa->npoints < 2 )
+  {
+    return NULL;
+  }
+
+  /*
+  ** First create a flat list of nodes, one per edge.
+  ** For each vertex, transform into our one-dimensional measure.
+  ** Hopefully, when projected, the points turn into a fairly
+  ** uniformly distributed collection of measures.
+  */
+  num_edges = pa->npoints - 1;
+  nodes = rtalloc(ctx, sizeof(RECT_NODE*) * pa->npoints);
+  j = 0;
+  for ( i = 0; i < num_edges; i++ )
+  {
+    node = rect_node_leaf_new(ctx, pa, i);
+    if ( node ) /* Not zero length? */
+    {
+      nodes[j] = node;
+      j++;
+    }
+  }
+
+  return rect_tree_build(ctx, nodes, j);
+}
+
+/**
+* Build a tree of degenerate leaf nodes, one per vertex of the point array.
+* Returns NULL for an empty array.
+*/
+RECT_NODE* rect_tree_new_points(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  int i;
+  RECT_NODE **nodes;
+
+  if ( pa->npoints < 1 )
+  {
+    return NULL;
+  }
+
+  nodes = rtalloc(ctx, sizeof(RECT_NODE*) * pa->npoints);
+  for ( i = 0; i < pa->npoints; i++ )
+    nodes[i] = rect_node_point_new(ctx, pa, i);
+
+  return rect_tree_build(ctx, nodes, pa->npoints);
+}
+
+/**
+* Build a tree of arc leaves from a circular string point array.
+* Returns NULL if the array has no arc of non-zero length.
+*/
+RECT_NODE* rect_tree_new_arcs(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  int i, j;
+  RECT_NODE **nodes;
+  RECT_NODE *node;
+
+  if ( pa->npoints < 3 )
+  {
+    return NULL;
+  }
+
+  nodes = rtalloc(ctx, sizeof(RECT_NODE*) * (pa->npoints / 2));
+  j = 0;
+  for ( i = 0; i + 2 < pa->npoints; i += 2 )
+  {
+    node = rect_node_leaf_arc_new(ctx, pa, i);
+    if ( node )
+    {
+      nodes[j] = node;
+      j++;
+    }
+  }
+
+  return rect_tree_build(ctx, nodes, j);
+}
+
+/**
+* Winding number of a ring tree around a point, following the same rules
+* as ptarray_contains_point_partial. Only edges crossing the point's
+* y-range and lying (at least partly) east of it can contribute, so
+* every other branch of the tree is skipped.
+* Sets *on_boundary to RT_TRUE if the point lies on an edge.
+* Straight edges only, arc leaves are not handled.
+*/
+int rect_tree_winding_number(const RTCTX *ctx, const RECT_NODE *node, const RTPOINT2D *pt, int *on_boundary)
+{
+  double side;
+  const RTPOINT2D *seg1, *seg2;
+
+  if ( pt->y < node->ymin || pt->y > node->ymax || pt->x > node->xmax )
+    return 0;
+
+  if ( ! rect_node_is_leaf(ctx, node) )
+  {
+    int wn = rect_tree_winding_number(ctx, node->left_node, pt, on_boundary);
+    if ( *on_boundary ) return 0;
+    return wn + rect_tree_winding_number(ctx, node->right_node, pt, on_boundary);
+  }
+
+  seg1 = node->p1;
+  seg2 = node->p2;
+
+  /* Zero length segments are ignored. */
+  if ( seg1 == seg2 || (seg1->x == seg2->x && seg1->y == seg2->y) )
+    return 0;
+
+  side = rt_segment_side(ctx, seg1, seg2, pt);
+
+  /* On the segment line and within its extent? Boundary. */
+  if ( side == 0 && pt->x >= node->xmin )
+  {
+    *on_boundary = RT_TRUE;
+    return 0;
+  }
+
+  /* Upward crossing, point to the left of the edge */
+  if ( side < 0 && seg1->y <= pt->y && pt->y < seg2->y )
+    return 1;
+
+  /* Downward crossing, point to the right of the edge */
+  if ( side > 0 && seg2->y <= pt->y && pt->y < seg1->y )
+    return -1;
+
+  return 0;
+}
+
+/**
+* Distance between the boxes of two nodes, zero if they overlap.
+*/
+static double rect_node_distance(const RECT_NODE *n1, const RECT_NODE *n2)
+{
+  double dx = 0.0, dy = 0.0;
+
+  if ( n1->xmax < n2->xmin )
+    dx = n2->xmin - n1->xmax;
+  else if ( n2->xmax < n1->xmin )
+    dx = n1->xmin - n2->xmax;
+
+  if ( n1->ymax < n2->ymin )
+    dy = n2->ymin - n1->ymax;
+  else if ( n2->ymax < n1->ymin )
+    dy = n1->ymin - n2->ymax;
+
+  if ( dx == 0.0 ) return dy;
+  if ( dy == 0.0 ) return dx;
+  return sqrt(dx*dx + dy*dy);
+}
+
+static double rect_node_size(const RECT_NODE *n)
+{
+  return (n->xmax - n->xmin) + (n->ymax - n->ymin);
+}
+
+/**
+* Distance between two leaves, whatever mix of segments, arcs and
+* vertices they are.
+*/
+static void rect_leaf_distance(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2, DISTPTS *dl)
+{
+  int twist = dl->twisted;
+
+  if ( n1->p3 && n2->p3 )
+  {
+    rt_dist2d_arc_arc(ctx, n1->p1, n1->p3, n1->p2, n2->p1, n2->p3, n2->p2, dl);
+  }
+  else if ( n2->p3 )
+  {
+    rt_dist2d_seg_arc(ctx, n1->p1, n1->p2, n2->p1, n2->p3, n2->p2, dl);
+  }
+  else if ( n1->p3 )
+  {
+    dl->twisted = -1 * twist;
+    rt_dist2d_seg_arc(ctx, n2->p1, n2->p2, n1->p1, n1->p3, n1->p2, dl);
+  }
+  else
+  {
+    rt_dist2d_seg_seg(ctx, n1->p1, n1->p2, n2->p1, n2->p2, dl);
+  }
+  dl->twisted = twist;
+}
+
+/**
+* A pair of nodes waiting in the search queue, keyed on the distance
+* between their boxes, which no pair of leaves below them can beat.
+*/
+typedef struct
+{
+  const RECT_NODE *n1;
+  const RECT_NODE *n2;
+  double d;
+} RECT_PAIR;
+
+typedef struct
+{
+  RECT_PAIR *pairs;
+  int npairs;
+  int maxpairs;
+  RECT_PAIR *stack; /* initial storage, not to be freed */
+} RECT_QUEUE;
+
+static void rect_queue_push(const RTCTX *ctx, RECT_QUEUE *q, const RECT_NODE *n1, const RECT_NODE *n2, double d)
+{
+  int i, parent;
+
+  if ( q->npairs == q->maxpairs )
+  {
+    q->maxpairs *= 2;
+    if ( q->pairs == q->stack )
+    {
+      q->pairs = rtalloc(ctx, sizeof(RECT_PAIR) * q->maxpairs);
+      memcpy(q->pairs, q->stack, sizeof(RECT_PAIR) * q->npairs);
+    }
+    else
+    {
+      q->pairs = rtrealloc(ctx, q->pairs, sizeof(RECT_PAIR) * q->maxpairs);
+    }
+  }
+
+  /* Sift up */
+  i = q->npairs++;
+  while ( i > 0 )
+  {
+    parent = (i - 1) / 2;
+    if ( q->pairs[parent].d <= d ) break;
+    q->pairs[i] = q->pairs[parent];
+    i = parent;
+  }
+  q->pairs[i].n1 = n1;
+  q->pairs[i].n2 = n2;
+  q->pairs[i].d = d;
+}
+
+static RECT_PAIR rect_queue_pop(RECT_QUEUE *q)
+{
+  RECT_PAIR top = q->pairs[0];
+  RECT_PAIR last = q->pairs[--q->npairs];
+  int i = 0, child;
+
+  /* Sift the last pair down from the root */
+  while ( (child = 2 * i + 1) < q->npairs )
+  {
+    if ( child + 1 < q->npairs && q->pairs[child + 1].d < q->pairs[child].d )
+      child++;
+    if ( last.d <= q->pairs[child].d ) break;
+    q->pairs[i] = q->pairs[child];
+    i = child;
+  }
+  if ( q->npairs )
+    q->pairs[i] = last;
+  return top;
+}
 
+/**
+* Minimum distance between the edges (segments, arcs or vertices) of
+* two trees, accumulated into dl the same way the brute-force
+* rt_dist2d_ptarray_* functions do. Node pairs are visited closest
+* box first, so the search ends as soon as the nearest pending box
+* is no closer than the best distance found, or once that distance
+* is within dl->tolerance.
+* Area containment is up to the caller.
+*/
+int rect_tree_mindistance(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2, DISTPTS *dl)
+{
+  RECT_PAIR stack[64];
+  RECT_QUEUE q;
+  RECT_PAIR pair;
+  const RECT_NODE *a, *b;
+  double d;
+
+  if ( dl->mode != DIST_MIN )
+  {
+    rterror(ctx, "rect_tree_mindistance only supports mindistance");
+    return RT_FALSE;
+  }
+
+  q.pairs = q.stack = stack;
+  q.npairs = 0;
+  q.maxpairs = 64;
+
+  rect_queue_push(ctx, &q, n1, n2, rect_node_distance(n1, n2));
+
+  while ( q.npairs )
+  {
+    pair = rect_queue_pop(&q);
+
+    /* Nothing left in the queue can do better */
+    if ( pair.d >= dl->distance )
+      break;
+
+    if ( rect_node_is_leaf(ctx, pair.n1) && rect_node_is_leaf(ctx, pair.n2) )
+    {
+      rect_leaf_distance(ctx, pair.n1, pair.n2, dl);
+      if ( dl->distance <= dl->tolerance )
+        break;
+      continue;
+    }
+
+    /* Split the larger internal node */
+    if ( rect_node_is_leaf(ctx, pair.n1) ||
+         ( ! rect_node_is_leaf(ctx, pair.n2) && rect_node_size(pair.n2) > rect_node_size(pair.n1) ) )
+    {
+      a = pair.n2->left_node; b = pair.n2->right_node;
+      d = rect_node_distance(pair.n1, a);
+      if ( d < dl->distance ) rect_queue_push(ctx, &q, pair.n1, a, d);
+      d = rect_node_distance(pair.n1, b);
+      if ( d < dl->distance ) rect_queue_push(ctx, &q, pair.n1, b, d);
+    }
+    else
+    {
+      a = pair.n1->left_node; b = pair.n1->right_node;
+      d = rect_node_distance(a, pair.n2);
+      if ( d < dl->distance ) rect_queue_push(ctx, &q, a, pair.n2, d);
+      d = rect_node_distance(b, pair.n2);
+      if ( d < dl->distance ) rect_queue_push(ctx, &q, b, pair.n2, d);
+    }
+  }
+
+  if ( q.pairs != q.stack )
+    rtfree(ctx, q.pairs);
+
+  return RT_TRUE;
 }
 
+/**
+* Minimum distance between the edges of two trees, stopping as soon
+* as a distance at or below threshold is found (pass 0 for an exact
+* minimum). See rect_tree_mindistance.
+*/
+double rect_tree_distance_tree(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2, double threshold)
+{
+  DISTPTS dl;
+  rt_dist2d_distpts_init(ctx, &dl, DIST_MIN);
+  dl.tolerance = threshold;
+  dl.twisted = 1;
+  rect_tree_mindistance(ctx, n1, n2, &dl);
+  return dl.distance;
+}
@@ -22,6 +22,10 @@
  *
  **********************************************************************/
 
+#ifndef _RTTREE_H
+#define _RTTREE_H 1
+
+#include "measures.h"
 
 typedef struct rect_node
 {
@@ -33,6 +37,7 @@ typedef struct rect_node
   struct rect_node *right_node;
   RTPOINT2D *p1;
   RTPOINT2D *p2;
+  RTPOINT2D *p3; /* arc leaves only: mid point, p2 is then the arc end */
 } RECT_NODE;
 
 int rect_tree_contains_point(const RTCTX *ctx, const RECT_NODE *tree, const RTPOINT2D *pt, int *on_boundary);
@@ -40,4 +45,13 @@ int rect_tree_intersects_tree(const RTCTX *ctx, const RECT_NODE *tree1, const RE
 void rect_tree_free(const RTCTX *ctx, RECT_NODE *node);
 RECT_NODE* rect_node_leaf_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i);
 RECT_NODE* rect_node_internal_new(const RTCTX *ctx, RECT_NODE *left_node, RECT_NODE *right_node);
+RECT_NODE* rect_node_point_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i);
 RECT_NODE* rect_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa);
+RECT_NODE* rect_tree_new_points(const RTCTX *ctx, const RTPOINTARRAY *pa);
+RECT_NODE* rect_node_leaf_arc_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i);
+RECT_NODE* rect_tree_new_arcs(const RTCTX *ctx, const RTPOINTARRAY *pa);
+int rect_tree_winding_number(const RTCTX *ctx, const RECT_NODE *tree, const RTPOINT2D *pt, int *on_boundary);
+int rect_tree_mindistance(const RTCTX *ctx, const RECT_NODE *tree1, const RECT_NODE *tree2, DISTPTS *dl);
+double rect_tree_distance_tree(const RTCTX *ctx, const RECT_NODE *tree1, const RECT_NODE *tree2, double threshold);
+
+#endif /* !defined _RTTREE_H */
@@ -0,0 +1,481 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ *
+ * Bounding volume hierarchy over the points, segments and faces of a
+ * geometry, used to prune the 3D distance calculations.
+ *
+ **********************************************************************/
+
+
+#include "rttopo_config.h"
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+
+/*#define RTGEOM_DEBUG_LEVEL 4*/
+#include "rtgeom_log.h"
+
+#include "librttopo_geom_internal.h"
+#include "rttree3d.h"
+
+
+typedef struct
+{
+  RECT3D_NODE *leaves;
+  int nleaves;
+  int maxleaves;
+} RECT3D_BUILDER;
+
+static RECT3D_NODE* rect3d_leaf_new(const RTCTX *ctx, RECT3D_BUILDER *b, const RTGEOM *geom, int i)
+{
+  RECT3D_NODE *leaf;
+
+  if ( b->nleaves == b->maxleaves )
+  {
+    b->maxleaves = b->maxleaves ? b->maxleaves * 2 : 16;
+    b->leaves = rtrealloc(ctx, b->leaves, sizeof(RECT3D_NODE) * b->maxleaves);
+  }
+  leaf = &(b->leaves[b->nleaves++]);
+  leaf->xmin = leaf->ymin = leaf->zmin = FLT_MAX;
+  leaf->xmax = leaf->ymax = leaf->zmax = -1 * FLT_MAX;
+  leaf->left_node = leaf->right_node = NULL;
+  leaf->geom = geom;
+  leaf->i = i;
+  return leaf;
+}
+
+static void rect3d_node_add_point(const RTCTX *ctx, RECT3D_NODE *node, const RTPOINTARRAY *pa, int i)
+{
+  RTPOINT3DZ p;
+
+  rt_getPoint3dz_p(ctx, pa, i, &p);
+  node->xmin = FP_MIN(node->xmin, p.x);
+  node->xmax = FP_MAX(node->xmax, p.x);
+  node->ymin = FP_MIN(node->ymin, p.y);
+  node->ymax = FP_MAX(node->ymax, p.y);
+  node->zmin = FP_MIN(node->zmin, p.z);
+  node->zmax = FP_MAX(node->zmax, p.z);
+}
+
+/**
+* One leaf per point and per line segment. Polygons and triangles
+* are measured as a whole, so they get a single leaf, which their
+* holes only enlarge.
+*/
+static int rect3d_add_ptarray(const RTCTX *ctx, const RTGEOM *geom, int index, const RTPOINTARRAY *pa, void *data)
+{
+  RECT3D_BUILDER *b = (RECT3D_BUILDER*)data;
+  RECT3D_NODE *leaf;
+  int i;
+
+  switch ( geom->type )
+  {
+  case RTPOINTTYPE:
+    if ( pa->npoints < 1 ) return 0;
+    leaf = rect3d_leaf_new(ctx, b, geom, 0);
+    rect3d_node_add_point(ctx, leaf, pa, 0);
+    return 0;
+
+  case RTLINETYPE:
+    for ( i = 0; i < pa->npoints - 1; i++ )
+    {
+      leaf = rect3d_leaf_new(ctx, b, geom, i);
+      rect3d_node_add_point(ctx, leaf, pa, i);
+      rect3d_node_add_point(ctx, leaf, pa, i + 1);
+    }
+    return 0;
+
+  case RTPOLYGONTYPE:
+  case RTTRIANGLETYPE:
+    if ( pa->npoints < 1 ) return 0;
+    if ( index == 0 )
+      leaf = rect3d_leaf_new(ctx, b, geom, 0);
+    else if ( b->nleaves && b->leaves[b->nleaves - 1].geom == geom )
+      leaf = &(b->leaves[b->nleaves - 1]);
+    else
+      return 0;
+    for ( i = 0; i < pa->npoints; i++ )
+      rect3d_node_add_point(ctx, leaf, pa, i);
+    return 0;
+
+  default:
+    rterror(ctx, "Unsupported geometry type: %s", rttype_name(ctx, geom->type));
+    return -1;
+  }
+}
+
+static int rect3d_cmp_x(const void *a, const void *b)
+{
+  const RECT3D_NODE *na = *(RECT3D_NODE * const *)a;
+  const RECT3D_NODE *nb = *(RECT3D_NODE * const *)b;
+  double ca = na->xmin + na->xmax, cb = nb->xmin + nb->xmax;
+  return ca < cb ? -1 : (ca > cb ? 1 : 0);
+}
+
+static int rect3d_cmp_y(const void *a, const void *b)
+{
+  const RECT3D_NODE *na = *(RECT3D_NODE * const *)a;
+  const RECT3D_NODE *nb = *(RECT3D_NODE * const *)b;
+  double ca = na->ymin + na->ymax, cb = nb->ymin + nb->ymax;
+  return ca < cb ? -1 : (ca > cb ? 1 : 0);
+}
+
+static int rect3d_cmp_z(const void *a, const void *b)
+{
+  const RECT3D_NODE *na = *(RECT3D_NODE * const *)a;
+  const RECT3D_NODE *nb = *(RECT3D_NODE * const *)b;
+  double ca = na->zmin + na->zmax, cb = nb->zmin + nb->zmax;
+  return ca < cb ? -1 : (ca > cb ? 1 : 0);
+}
+
+/**
+* Build the subtree over items[0..n-1], splitting at the median of
+* the longest side of the leaf centers' extent.
+*/
+static RECT3D_NODE* rect3d_tree_build(RECT3D_TREE *tree, RECT3D_NODE **items, int n)
+{
+  RECT3D_NODE *node, *left, *right;
+  double xmin, xmax, ymin, ymax, zmin, zmax, dx, dy, dz;
+  int i;
+
+  if ( n == 1 )
+    return items[0];
+
+  /* Extents of the doubled centers, only compared with each other */
+  xmin = ymin = zmin = FLT_MAX;
+  xmax = ymax = zmax = -1 * FLT_MAX;
+  for ( i = 0; i < n; i++ )
+  {
+    xmin = FP_MIN(xmin, items[i]->xmin + items[i]->xmax);
+    xmax = FP_MAX(xmax, items[i]->xmin + items[i]->xmax);
+    ymin = FP_MIN(ymin, items[i]->ymin + items[i]->ymax);
+    ymax = FP_MAX(ymax, items[i]->ymin + items[i]->ymax);
+    zmin = FP_MIN(zmin, items[i]->zmin + items[i]->zmax);
+    zmax = FP_MAX(zmax, items[i]->zmin + items[i]->zmax);
+  }
+  dx = xmax - xmin;
+  dy = ymax - ymin;
+  dz = zmax - zmin;
+  if ( dx >= dy && dx >= dz )
+    qsort(items, n, sizeof(RECT3D_NODE*), rect3d_cmp_x);
+  else if ( dy >= dz )
+    qsort(items, n, sizeof(RECT3D_NODE*), rect3d_cmp_y);
+  else
+    qsort(items, n, sizeof(RECT3D_NODE*), rect3d_cmp_z);
+
+  node = &(tree->nodes[tree->nnodes++]);
+  left = rect3d_tree_build(tree, items, n / 2);
+  right = rect3d_tree_build(tree, items + n / 2, n - n / 2);
+
+  node->left_node = left;
+  node->right_node = right;
+  node->geom = NULL;
+  node->i = 0;
+  node->xmin = FP_MIN(left->xmin, right->xmin);
+  node->xmax = FP_MAX(left->xmax, right->xmax);
+  node->ymin = FP_MIN(left->ymin, right->ymin);
+  node->ymax = FP_MAX(left->ymax, right->ymax);
+  node->zmin = FP_MIN(left->zmin, right->zmin);
+  node->zmax = FP_MAX(left->zmax, right->zmax);
+  return node;
+}
+
+/**
+* Build the hierarchy over geom, which is borrowed and must outlive
+* the tree. An empty geometry gives a tree with a NULL root.
+* Returns NULL on unsupported input (curves).
+*/
+RECT3D_TREE* rect3d_tree_new(const RTCTX *ctx, const RTGEOM *geom)
+{
+  RECT3D_BUILDER b;
+  RECT3D_TREE *tree;
+  RECT3D_NODE **items;
+  int i, n;
+
+  b.leaves = NULL;
+  b.nleaves = b.maxleaves = 0;
+  if ( rtgeom_visit_ptarrays(ctx, geom, rect3d_add_ptarray, &b) != 0 )
+  {
+    if ( b.leaves ) rtfree(ctx, b.leaves);
+    return NULL;
+  }
+
+  tree = rtalloc(ctx, sizeof(RECT3D_TREE));
+  tree->root = NULL;
+  tree->nodes = NULL;
+  tree->nnodes = 0;
+
+  n = b.nleaves;
+  if ( ! n )
+  {
+    if ( b.leaves ) rtfree(ctx, b.leaves);
+    return tree;
+  }
+
+  /* Leaves first, then the internal nodes as the build creates them */
+  tree->nodes = rtalloc(ctx, sizeof(RECT3D_NODE) * (2 * n - 1));
+  memcpy(tree->nodes, b.leaves, sizeof(RECT3D_NODE) * n);
+  rtfree(ctx, b.leaves);
+  tree->nnodes = n;
+
+  items = rtalloc(ctx, sizeof(RECT3D_NODE*) * n);
+  for ( i = 0; i < n; i++ )
+    items[i] = &(tree->nodes[i]);
+  tree->root = rect3d_tree_build(tree, items, n);
+  rtfree(ctx, items);
+
+  return tree;
+}
+
+void rect3d_tree_free(const RTCTX *ctx, RECT3D_TREE *tree)
+{
+  if ( ! tree ) return;
+  if ( tree->nodes )
+    rtfree(ctx, tree->nodes);
+  rtfree(ctx, tree);
+}
+
+/**
+* Distance between the boxes of two nodes, zero if they overlap.
+*/
+static double rect3d_node_distance(const RECT3D_NODE *n1, const RECT3D_NODE *n2)
+{
+  double dx = 0.0, dy = 0.0, dz = 0.0;
+
+  if ( n1->xmax < n2->xmin ) dx = n2->xmin - n1->xmax;
+  else if ( n2->xmax < n1->xmin ) dx = n1->xmin - n2->xmax;
+  if ( n1->ymax < n2->ymin ) dy = n2->ymin - n1->ymax;
+  else if ( n2->ymax < n1->ymin ) dy = n1->ymin - n2->ymax;
+  if ( n1->zmax < n2->zmin ) dz = n2->zmin - n1->zmax;
+  else if ( n2->zmax < n1->zmin ) dz = n1->zmin - n2->zmax;
+
+  return sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+/**
+* Distance between the farthest corners of the boxes of two nodes.
+*/
+static double rect3d_node_maxdistance(const RECT3D_NODE *n1, const RECT3D_NODE *n2)
+{
+  double dx = FP_MAX(n1->xmax - n2->xmin, n2->xmax - n1->xmin);
+  double dy = FP_MAX(n1->ymax - n2->ymin, n2->ymax - n1->ymin);
+  double dz = FP_MAX(n1->zmax - n2->zmin, n2->zmax - n1->zmin);
+
+  return sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+static double rect3d_node_size(const RECT3D_NODE *n)
+{
+  return (n->xmax - n->xmin) + (n->ymax - n->ymin) + (n->zmax - n->zmin);
+}
+
+/**
+* Search key of a pair of nodes: the lowest distance any two leaves
+* below them can have when looking for the minimum, the negated
+* highest one when looking for the maximum. Lower keys come first.
+*/
+static double rect3d_pair_key(const RECT3D_NODE *n1, const RECT3D_NODE *n2, int mode)
+{
+  if ( mode == DIST_MIN )
+    return rect3d_node_distance(n1, n2);
+  return -1 * rect3d_node_maxdistance(n1, n2);
+}
+
+/* Pairs keyed at or above this can't improve on dl */
+static double rect3d_best_key(const DISTPTS3D *dl)
+{
+  return dl->mode == DIST_MIN ? dl->distance : -1 * dl->distance;
+}
+
+/**
+* A line segment leaf seen as a two point line, borrowing the
+* coordinates of its line.
+*/
+typedef struct
+{
+  RTLINE line;
+  RTPOINTARRAY pa;
+} RECT3D_SEGMENT;
+
+static const RTGEOM* rect3d_leaf_geom(const RTCTX *ctx, const RECT3D_NODE *node, RECT3D_SEGMENT *seg)
+{
+  const RTLINE *line;
+
+  if ( node->geom->type != RTLINETYPE )
+    return node->geom;
+
+  line = (const RTLINE*)node->geom;
+  seg->pa.serialized_pointlist = rt_getPoint_internal(ctx, line->points, node->i);
+  seg->pa.flags = line->points->flags;
+  RTFLAGS_SET_READONLY(seg->pa.flags, 1);
+  seg->pa.npoints = seg->pa.maxpoints = 2;
+  seg->line.type = RTLINETYPE;
+  seg->line.flags = line->flags;
+  seg->line.bbox = NULL;
+  seg->line.srid = line->srid;
+  seg->line.points = &(seg->pa);
+  return (RTGEOM*)&(seg->line);
+}
+
+static int rect3d_leaf_distance(const RTCTX *ctx, const RECT3D_NODE *n1, const RECT3D_NODE *n2, DISTPTS3D *dl)
+{
+  RECT3D_SEGMENT s1, s2;
+
+  return rt_dist3d_distribute_bruteforce(ctx,
+           rect3d_leaf_geom(ctx, n1, &s1), rect3d_leaf_geom(ctx, n2, &s2), dl);
+}
+
+typedef struct
+{
+  const RECT3D_NODE *n1;
+  const RECT3D_NODE *n2;
+  double d;
+} RECT3D_PAIR;
+
+typedef struct
+{
+  RECT3D_PAIR *pairs;
+  int npairs;
+  int maxpairs;
+  RECT3D_PAIR *stack; /* initial storage, not to be freed */
+} RECT3D_QUEUE;
+
+static void rect3d_queue_push(const RTCTX *ctx, RECT3D_QUEUE *q, const RECT3D_NODE *n1, const RECT3D_NODE *n2, double d)
+{
+  int i, parent;
+
+  if ( q->npairs == q->maxpairs )
+  {
+    q->maxpairs *= 2;
+    if ( q->pairs == q->stack )
+    {
+      q->pairs = rtalloc(ctx, sizeof(RECT3D_PAIR) * q->maxpairs);
+      memcpy(q->pairs, q->stack, sizeof(RECT3D_PAIR) * q->npairs);
+    }
+    else
+    {
+      q->pairs = rtrealloc(ctx, q->pairs, sizeof(RECT3D_PAIR) * q->maxpairs);
+    }
+  }
+
+  i = q->npairs++;
+  while ( i > 0 )
+  {
+    parent = (i - 1) / 2;
+    if ( q->pairs[parent].d <= d ) break;
+    q->pairs[i] = q->pairs[parent];
+    i = parent;
+  }
+  q->pairs[i].n1 = n1;
+  q->pairs[i].n2 = n2;
+  q->pairs[i].d = d;
+}
+
+static RECT3D_PAIR rect3d_queue_pop(RECT3D_QUEUE *q)
+{
+  RECT3D_PAIR top = q->pairs[0];
+  RECT3D_PAIR last = q->pairs[--q->npairs];
+  int i = 0, child;
+
+  while ( (child = 2 * i + 1) < q->npairs )
+  {
+    if ( child + 1 < q->npairs && q->pairs[child + 1].d < q->pairs[child].d )
+      child++;
+    if ( last.d <= q->pairs[child].d ) break;
+    q->pairs[i] = q->pairs[child];
+    i = child;
+  }
+  if ( q->npairs )
+    q->pairs[i] = last;
+  return top;
+}
+
+/**
+* Minimum or maximum (following dl->mode) distance between the
+* leaves of two trees, accumulated into dl exactly as
+* rt_dist3d_recursive would. Node pairs are visited most promising
+* box first, so the search ends as soon as no pending pair can
+* improve on the distance found, or once a minimum distance is
+* within dl->tolerance.
+*/
+int rect3d_tree_distance(const RTCTX *ctx, const RECT3D_TREE *tree1, const RECT3D_TREE *tree2, DISTPTS3D *dl)
+{
+  RECT3D_PAIR stack[64];
+  RECT3D_QUEUE q;
+  RECT3D_PAIR pair;
+  const RECT3D_NODE *a, *b;
+  double d;
+  int ret = RT_TRUE;
+
+  if ( ! tree1->root || ! tree2->root )
+    return RT_TRUE;
+
+  q.pairs = q.stack = stack;
+  q.npairs = 0;
+  q.maxpairs = 64;
+
+  rect3d_queue_push(ctx, &q, tree1->root, tree2->root,
+                    rect3d_pair_key(tree1->root, tree2->root, dl->mode));
+
+  while ( q.npairs )
+  {
+    pair = rect3d_queue_pop(&q);
+
+    /* Nothing left in the queue can do better */
+    if ( pair.d >= rect3d_best_key(dl) )
+      break;
+
+    if ( pair.n1->geom && pair.n2->geom )
+    {
+      if ( ! rect3d_leaf_distance(ctx, pair.n1, pair.n2, dl) )
+      {
+        ret = RT_FALSE;
+        break;
+      }
+      if ( dl->mode == DIST_MIN && dl->distance <= dl->tolerance )
+        break;
+      continue;
+    }
+
+    /* Split the larger internal node */
+    if ( pair.n1->geom ||
+         ( ! pair.n2->geom && rect3d_node_size(pair.n2) > rect3d_node_size(pair.n1) ) )
+    {
+      a = pair.n2->left_node; b = pair.n2->right_node;
+      d = rect3d_pair_key(pair.n1, a, dl->mode);
+      if ( d < rect3d_best_key(dl) ) rect3d_queue_push(ctx, &q, pair.n1, a, d);
+      d = rect3d_pair_key(pair.n1, b, dl->mode);
+      if ( d < rect3d_best_key(dl) ) rect3d_queue_push(ctx, &q, pair.n1, b, d);
+    }
+    else
+    {
+      a = pair.n1->left_node; b = pair.n1->right_node;
+      d = rect3d_pair_key(a, pair.n2, dl->mode);
+      if ( d < rect3d_best_key(dl) ) rect3d_queue_push(ctx, &q, a, pair.n2, d);
+      d = rect3d_pair_key(b, pair.n2, dl->mode);
+      if ( d < rect3d_best_key(dl) ) rect3d_queue_push(ctx, &q, b, pair.n2, d);
+    }
+  }
+
+  if ( q.pairs != q.stack )
+    rtfree(ctx, q.pairs);
+
+  return ret;
+}
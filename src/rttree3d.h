@@ -0,0 +1,56 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+#ifndef _RTTREE3D_H
+#define _RTTREE3D_H 1
+
+#include "measures3d.h"
+
+/**
+* Node of a 3D bounding volume hierarchy. Leaves hold a point, a
+* line segment (geom is the line, i the segment start) or a whole
+* polygon or triangle; internal nodes have a NULL geom.
+*/
+typedef struct rect3d_node
+{
+  double xmin;
+  double xmax;
+  double ymin;
+  double ymax;
+  double zmin;
+  double zmax;
+  struct rect3d_node *left_node;
+  struct rect3d_node *right_node;
+  const RTGEOM *geom;
+  int i;
+} RECT3D_NODE;
+
+typedef struct
+{
+  RECT3D_NODE *root;
+  RECT3D_NODE *nodes; /* storage for all the nodes */
+  int nnodes;
+} RECT3D_TREE;
+
+RECT3D_TREE* rect3d_tree_new(const RTCTX *ctx, const RTGEOM *geom);
+void rect3d_tree_free(const RTCTX *ctx, RECT3D_TREE *tree);
+int rect3d_tree_distance(const RTCTX *ctx, const RECT3D_TREE *tree1, const RECT3D_TREE *tree2, DISTPTS3D *dl);
+
+#endif /* !defined _RTTREE3D_H */
@@ -37,6 +37,8 @@
 /*#define RTGEOM_DEBUG_LEVEL 4*/
 #include "librttopo_geom_internal.h"
 #include "rtgeom_log.h"
+#include "stringbuffer.h"
+#include "bytebuffer.h"
 
 /* Global variables */
 
@@ -160,6 +162,8 @@ rtgeom_init(rtallocator allocator,
   ctx->error_logger = default_errorreporter;
   ctx->debug_logger = default_debuglogger;
 
+  ctx->bbox_cache = RTBBOX_CACHE_TOP;
+
   return ctx;
 }
 
@@ -168,6 +172,7 @@ rtgeom_finish(RTCTX *ctx)
 {
   if (ctx->gctx != NULL)
     GEOS_finish_r(ctx->gctx);
+  rtgeom_set_scratch_size(ctx, 0);
   ctx->rtfree_var(ctx);
 }
 
@@ -192,6 +197,32 @@ rtgeom_set_debug_logger(RTCTX *ctx, rtdebuglogger logger, void *arg)
   ctx->debug_logger_arg = arg;
 }
 
+void
+rtgeom_set_bbox_cache(RTCTX *ctx, RTBBOXCACHE policy)
+{
+  ctx->bbox_cache = policy;
+}
+
+void
+rtgeom_set_scratch_size(RTCTX *ctx, size_t max_size)
+{
+  stringbuffer_t *sb = ctx->scratch_sb;
+  bytebuffer_t *bb = ctx->scratch_bb;
+
+  /* Drop the kept buffers that are now too big */
+  ctx->scratch_max_size = max_size;
+  if ( sb && sb->capacity > max_size )
+  {
+    stringbuffer_destroy(ctx, sb);
+    ctx->scratch_sb = NULL;
+  }
+  if ( bb && bb->capacity > max_size )
+  {
+    bytebuffer_destroy(ctx, bb);
+    ctx->scratch_bb = NULL;
+  }
+}
+
 void
 rtnotice(const RTCTX *ctx, const char *fmt, ...)
 {
@@ -65,6 +65,37 @@ stringbuffer_destroy(const RTCTX *ctx, stringbuffer_t *s)
   if ( s ) rtfree(ctx, s);
 }
 
+/**
+* Take the idle stringbuffer_t kept on the context, if any, or allocate
+* a new one. Give it back with stringbuffer_release.
+*/
+stringbuffer_t*
+stringbuffer_create_scratch(const RTCTX *ctx)
+{
+  stringbuffer_t *s = ctx->scratch_sb;
+
+  if ( ! s )
+    return stringbuffer_create(ctx);
+
+  ((RTCTX*)ctx)->scratch_sb = NULL;
+  stringbuffer_clear(ctx, s);
+  return s;
+}
+
+/**
+* Keep the stringbuffer_t on the context for the next
+* stringbuffer_create_scratch if reuse is enabled and there is room,
+* free it otherwise.
+*/
+void
+stringbuffer_release(const RTCTX *ctx, stringbuffer_t *s)
+{
+  if ( ! ctx->scratch_sb && s->capacity <= ctx->scratch_max_size )
+    ((RTCTX*)ctx)->scratch_sb = s;
+  else
+    stringbuffer_destroy(ctx, s);
+}
+
 /**
 * Reset the stringbuffer_t. Useful for starting a fresh string
 * without the expense of freeing and re-allocating a new
@@ -124,6 +155,19 @@ stringbuffer_append(const RTCTX *ctx, stringbuffer_t *s, const char *a)
   s->str_end += alen;
 }
 
+/**
+* Append the first alen bytes of the specified string to the
+* stringbuffer, for callers that already know the length.
+*/
+void
+stringbuffer_append_len(const RTCTX *ctx, stringbuffer_t *s, const char *a, size_t alen)
+{
+  stringbuffer_makeroom(ctx, s, alen + 1);
+  memcpy(s->str_end, a, alen);
+  s->str_end += alen;
+  *(s->str_end) = '\0';
+}
+
 /**
 * Returns a reference to the internal string being managed by
 * the stringbuffer. The current string will be null-terminated
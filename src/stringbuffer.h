@@ -47,10 +47,13 @@ stringbuffer_t;
 extern stringbuffer_t *stringbuffer_create_with_size(const RTCTX *ctx, size_t size);
 extern stringbuffer_t *stringbuffer_create(const RTCTX *ctx);
 extern void stringbuffer_destroy(const RTCTX *ctx, stringbuffer_t *sb);
+extern stringbuffer_t *stringbuffer_create_scratch(const RTCTX *ctx);
+extern void stringbuffer_release(const RTCTX *ctx, stringbuffer_t *sb);
 extern void stringbuffer_clear(const RTCTX *ctx, stringbuffer_t *sb);
 void stringbuffer_set(const RTCTX *ctx, stringbuffer_t *sb, const char *s);
 void stringbuffer_copy(const RTCTX *ctx, stringbuffer_t *sb, stringbuffer_t *src);
 extern void stringbuffer_append(const RTCTX *ctx, stringbuffer_t *sb, const char *s);
+extern void stringbuffer_append_len(const RTCTX *ctx, stringbuffer_t *sb, const char *s, size_t alen);
 extern int stringbuffer_aprintf(const RTCTX *ctx, stringbuffer_t *sb, const char *fmt, ...);
 extern const char *stringbuffer_getstring(const RTCTX *ctx, stringbuffer_t *sb);
 extern char *stringbuffer_getstringcopy(const RTCTX *ctx, stringbuffer_t *sb);
@@ -30,6 +30,18 @@
 #include "rtgeom_log.h"
 #include "librttopo_geom.h"
 
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VARINT_SSE2 1
+#endif
+
+/* The batch decoder reads little endian words and picks bits out of them */
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || \
+    defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM64)
+#define VARINT_WORD_DECODE 1
+#endif
+
 /* -------------------------------------------------------------------------------- */
 
 static size_t
@@ -167,6 +179,158 @@ varint_size(const RTCTX *ctx, const uint8_t *the_start, const uint8_t *the_end)
   return 0;
 }
 
+/* -------------------------------------------------------------------------------- */
+
+/* Encode a batch of signed varints, returns the number of bytes written */
+size_t
+varint_s64_encode_n(const RTCTX *ctx, const int64_t *vals, size_t n, uint8_t *buf)
+{
+  uint8_t *ptr = buf;
+  size_t i;
+
+  for ( i = 0; i < n; i++ )
+  {
+    uint64_t q = zigzag64(ctx, vals[i]);
+
+    /* Deltas are small, so take one and two byte values without looping */
+    if ( q < 0x80 )
+    {
+      *ptr++ = (uint8_t)q;
+    }
+    else if ( q < 0x4000 )
+    {
+      ptr[0] = (uint8_t)(0x80 | (q & 0x7f));
+      ptr[1] = (uint8_t)(q >> 7);
+      ptr += 2;
+    }
+    else
+    {
+      ptr += _varint_u64_encode_buf(ctx, q, ptr);
+    }
+  }
+  return ptr - buf;
+}
+
+#ifdef VARINT_WORD_DECODE
+
+static inline int
+_varint_ctz(uint32_t v)
+{
+#if defined(__GNUC__)
+  return __builtin_ctz(v);
+#else
+  int n = 0;
+  while ( ! (v & 1) )
+  {
+    v >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+/*
+* Bit i is set when byte i of the 16 starting at ptr ends a varint,
+* that is when its high bit is clear.
+*/
+static inline uint32_t
+_varint_stop_mask16(const uint8_t *ptr)
+{
+#ifdef VARINT_SSE2
+  return ~(uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ptr)) & 0xffff;
+#else
+  uint64_t lo, hi;
+  memcpy(&lo, ptr, 8);
+  memcpy(&hi, ptr + 8, 8);
+  /* Gather the high bit of each byte into the top byte */
+  lo = (((lo >> 7) & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56;
+  hi = (((hi >> 7) & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56;
+  return ~(uint32_t)(lo | (hi << 8)) & 0xffff;
+#endif
+}
+
+/*
+* Value of a varint of at most 8 bytes, given those bytes as a little
+* endian word.
+*/
+static inline uint64_t
+_varint_u64_from_word(uint64_t w, int len)
+{
+  w &= ~((uint64_t)0) >> (64 - 8 * len);
+  /* Squeeze out the high bits: 7 bit groups to 14, then 28, then 56 */
+  w = (w & 0x007f007f007f007fULL) | ((w & 0x7f007f007f007f00ULL) >> 1);
+  w = (w & 0x00003fff00003fffULL) | ((w & 0x3fff00003fff0000ULL) >> 2);
+  w = (w & 0x000000000fffffffULL) | ((w & 0x0fffffff00000000ULL) >> 4);
+  return w;
+}
+
+#endif /* VARINT_WORD_DECODE */
+
+/*
+* Decode a batch of signed varints. Where the input allows it, the
+* varint ends in each 16 byte window are found at once from the high
+* bits and each value is picked out of a single word, rather than
+* looping over bytes.
+*/
+size_t
+varint_s64_decode_n(const RTCTX *ctx, const uint8_t *the_start, const uint8_t *the_end, int64_t *vals, size_t n)
+{
+  const uint8_t *ptr = the_start;
+  size_t i = 0, size;
+
+#ifdef VARINT_WORD_DECODE
+  /* The window is 16 bytes, but a value starting near its end is read as a word */
+  while ( i < n && the_end - ptr >= 24 )
+  {
+    uint32_t stops = _varint_stop_mask16(ptr);
+    int done = 0;
+
+    if ( stops == 0xffff && n - i >= 16 )
+    {
+      int k;
+      for ( k = 0; k < 16; k++ )
+        vals[i + k] = unzigzag64(ctx, ptr[k]);
+      i += 16;
+      ptr += 16;
+      continue;
+    }
+
+    while ( stops && i < n )
+    {
+      int end = _varint_ctz(stops) + 1;
+      int len = end - done;
+      if ( len <= 8 )
+      {
+        uint64_t w;
+        memcpy(&w, ptr + done, 8);
+        vals[i++] = unzigzag64(ctx, _varint_u64_from_word(w, len));
+      }
+      else
+      {
+        vals[i++] = varint_s64_decode(ctx, ptr + done, the_end, &size);
+      }
+      done = end;
+      stops &= stops - 1;
+    }
+
+    /* No varint ends in this window, let the byte loop report it */
+    if ( ! done )
+      break;
+    ptr += done;
+  }
+#endif
+
+  while ( i < n )
+  {
+    size = 0;
+    vals[i++] = varint_s64_decode(ctx, ptr, the_end, &size);
+    if ( ! size )
+      return 0;
+    ptr += size;
+  }
+  return ptr - the_start;
+}
+
 uint64_t zigzag64(const RTCTX *ctx, int64_t val)
 {
   return (val << 1) ^ (val >> 63);
@@ -184,26 +348,16 @@ uint8_t zigzag8(const RTCTX *ctx, int8_t val)
 
 int64_t unzigzag64(const RTCTX *ctx, uint64_t val)
 {
-        if ( val & 0x01 )
-            return -1 * (int64_t)((val+1) >> 1);
-        else
-            return (int64_t)(val >> 1);
+  /* Written without (val+1) so the largest value does not wrap to zero */
+  return (int64_t)((val >> 1) ^ (~(val & 1) + 1));
 }
 
 int32_t unzigzag32(const RTCTX *ctx, uint32_t val)
 {
-        if ( val & 0x01 )
-            return -1 * (int32_t)((val+1) >> 1);
-        else
-            return (int32_t)(val >> 1);
+  return (int32_t)((val >> 1) ^ (~(val & 1) + 1));
 }
 
 int8_t unzigzag8(const RTCTX *ctx, uint8_t val)
 {
-        if ( val & 0x01 )
-            return -1 * (int8_t)((val+1) >> 1);
-        else
-            return (int8_t)(val >> 1);
+  return (int8_t)((val >> 1) ^ (uint8_t)(~(val & 1) + 1));
 }
-
-
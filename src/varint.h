@@ -45,6 +45,14 @@ uint64_t varint_u64_decode(const RTCTX *ctx, const uint8_t *the_start, const uin
 
 size_t varint_size(const RTCTX *ctx, const uint8_t *the_start, const uint8_t *the_end);
 
+/* Longest encoding of a 64bit varint */
+#define VARINT_MAX_SIZE 10
+
+/* Batch versions, buf must have room for n * VARINT_MAX_SIZE bytes. */
+size_t varint_s64_encode_n(const RTCTX *ctx, const int64_t *vals, size_t n, uint8_t *buf);
+/* Returns the number of bytes read, or 0 on error. */
+size_t varint_s64_decode_n(const RTCTX *ctx, const uint8_t *the_start, const uint8_t *the_end, int64_t *vals, size_t n);
+
 uint64_t zigzag64(const RTCTX *ctx, int64_t val);
 uint32_t zigzag32(const RTCTX *ctx, int32_t val);
 uint8_t zigzag8(const RTCTX *ctx, int8_t val);